@@ -3,6 +3,8 @@
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/failsafe_assert.h>
 #include <tilck/common/fat32_base.h>
+#include <tilck/common/lz4.h>
+#include <tilck/common/arch/generic_x86/x86_utils.h>
 
 /* We HAVE to undef our ASSERT because the gnu-efi headers define it */
 #undef ASSERT
@@ -70,6 +72,119 @@ end:
    return status;
 }
 
+/*
+ * Reads the LZ4-compressed ramdisk in chunks, decompressing all the completely
+ * read compressed chunks after each ReadDisk() call. ReadDisk() is synchronous
+ * so I/O and decompression don't really overlap, but the decompression always
+ * works on data just read, still hot in the CPU caches.
+ */
+static EFI_STATUS
+ReadCompressedRamdiskWithProgress(UINTN CurrRow,
+                                  EFI_DISK_IO_PROTOCOL *prot,
+                                  UINT32 MediaId,
+                                  struct fat_compr_rd_info *info,
+                                  void *RamdiskBuf,
+                                  void *Buffer)
+{
+   const UINTN ChunkSize = 128 * KB;
+   struct lz4_chunked_ctx ctx;
+   EFI_STATUS status = EFI_SUCCESS;
+   UINTN done = 0;
+
+   lz4_chunked_ctx_init(&ctx,
+                        Buffer,
+                        RamdiskBuf,
+                        info->raw_size,
+                        info->chunk_size);
+
+   while (done < info->data_size) {
+
+      const UINTN n = MIN(ChunkSize, info->data_size - done);
+
+      if (done > 0) {
+         ShowProgress(ST->ConOut,
+                      CurrRow,
+                      LOADING_RAMDISK_STR,
+                      done,
+                      info->data_size);
+      }
+
+      status = prot->ReadDisk(prot,
+                              MediaId,
+                              info->data_off + done,
+                              n,
+                              (char *)Buffer + done);
+      HANDLE_EFI_ERROR("ReadDisk");
+
+      done += n;
+
+      if (lz4_chunked_decompress(&ctx, (u32)done) < 0) {
+         Print(L"\r\nCorrupted compressed ramdisk at offset %u\r\n",
+               ctx.src_off);
+         status = EFI_VOLUME_CORRUPTED;
+         goto end;
+      }
+   }
+
+   if (!lz4_chunked_done(&ctx)) {
+      Print(L"\r\nTruncated compressed ramdisk: %u/%u\r\n",
+            ctx.dst_off, ctx.dst_size);
+      status = EFI_VOLUME_CORRUPTED;
+      goto end;
+   }
+
+   ShowProgress(ST->ConOut,
+                CurrRow,
+                LOADING_RAMDISK_STR,
+                info->data_size,
+                info->data_size);
+
+end:
+   return status;
+}
+
+static EFI_STATUS
+LoadCompressedRamdisk(EFI_DISK_IO_PROTOCOL *ioprot,
+                      UINT32 MediaId,
+                      struct fat_compr_rd_info *info,
+                      EFI_PHYSICAL_ADDRESS *ramdisk_paddr_ref,
+                      UINTN CurrConsoleRow)
+{
+   EFI_STATUS status;
+   EFI_PHYSICAL_ADDRESS buf_paddr = 0;
+   const UINTN buf_pages = (info->data_size / PAGE_SIZE) + 1;
+
+   /* See the comment about AllocateMaxAddress in LoadRamdisk() */
+   *ramdisk_paddr_ref = LINEAR_MAPPING_SIZE;
+   status = BS->AllocatePages(AllocateMaxAddress,
+                              EfiLoaderData,
+                              (info->raw_size / PAGE_SIZE) + 2,
+                              ramdisk_paddr_ref);
+   HANDLE_EFI_ERROR("AllocatePages");
+
+   /* The buffer for the compressed data is temporary: it can be anywhere */
+   status = BS->AllocatePages(AllocateAnyPages,
+                              EfiLoaderData,
+                              buf_pages,
+                              &buf_paddr);
+   HANDLE_EFI_ERROR("AllocatePages");
+
+   status = ReadCompressedRamdiskWithProgress(CurrConsoleRow,
+                                              ioprot,
+                                              MediaId,
+                                              info,
+                                              TO_PTR(*ramdisk_paddr_ref),
+                                              TO_PTR(buf_paddr));
+   HANDLE_EFI_ERROR("ReadCompressedRamdiskWithProgress");
+
+end:
+
+   if (buf_paddr)
+      BS->FreePages(buf_paddr, buf_pages);
+
+   return status;
+}
+
 EFI_STATUS
 LoadRamdisk(EFI_SYSTEM_TABLE *ST,
             EFI_HANDLE image,
@@ -87,6 +202,9 @@ LoadRamdisk(EFI_SYSTEM_TABLE *ST,
    u32 total_used_bytes;
    u32 ff_clu_off;
    void *fat_hdr;
+   struct fat_compr_rd_info compr_info, *ci;
+   bool compressed = false;
+   UINT64 load_start, load_cycles;
 
    status = BS->OpenProtocol(loaded_image->DeviceHandle,
                              &BlockIoProtocol,
@@ -105,6 +223,7 @@ LoadRamdisk(EFI_SYSTEM_TABLE *ST,
    HANDLE_EFI_ERROR("Getting a DiskIOProtocol handle");
 
    Print(LOADING_RAMDISK_STR);
+   load_start = RDTSC();
 
    *ramdisk_paddr_ref = 0;
    status = BS->AllocatePages(AllocateAnyPages,
@@ -124,9 +243,26 @@ LoadRamdisk(EFI_SYSTEM_TABLE *ST,
    sector_size = fat_get_sector_size(fat_hdr);
    total_fat_size = (fat_get_first_data_sector(fat_hdr) + 1) * sector_size;
 
+   if ((ci = fat_get_compr_rd_info(fat_hdr))) {
+      compr_info = *ci;       /* the page will be freed: copy the info */
+      compressed = true;
+   }
+
    status = BS->FreePages(*ramdisk_paddr_ref, 1);
    HANDLE_EFI_ERROR("FreePages");
 
+   if (compressed) {
+      status = LoadCompressedRamdisk(ioprot,
+                                     blockio->Media->MediaId,
+                                     &compr_info,
+                                     ramdisk_paddr_ref,
+                                     CurrConsoleRow);
+      HANDLE_EFI_ERROR("LoadCompressedRamdisk");
+      fat_hdr = TO_PTR(*ramdisk_paddr_ref);
+      total_used_bytes = compr_info.raw_size;
+      goto loaded;
+   }
+
    /* Now allocate memory for storing the whole FAT table */
 
    status = BS->AllocatePages(AllocateAnyPages,
@@ -187,9 +323,16 @@ LoadRamdisk(EFI_SYSTEM_TABLE *ST,
                                  fat_hdr);
    HANDLE_EFI_ERROR("ReadDiskWithProgress");
 
+loaded:
+   load_cycles = RDTSC() - load_start;
+
    ST->ConOut->SetCursorPosition(ST->ConOut, 0, 2);
    Print(LOADING_RAMDISK_STR);
    Print(L"[ OK ]\r\n");
+   Print(L"Ramdisk: %u KB%s, loaded in %u M cycles\r\n",
+         total_used_bytes / KB,
+         compressed ? L" (lz4)" : L"",
+         (UINT32)(load_cycles / 1000000));
    ff_clu_off = fat_get_first_free_cluster_off(fat_hdr);
 
    if (ff_clu_off < total_used_bytes) {
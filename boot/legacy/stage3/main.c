@@ -2,6 +2,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/fat32_base.h>
+#include <tilck/common/lz4.h>
 #include <tilck/common/utils.h>
 #include <tilck/common/arch/generic_x86/x86_utils.h>
 #include <tilck/common/arch/generic_x86/cpu_features.h>
@@ -211,6 +212,60 @@ read_sectors_with_progress(const char *prefix_str,
    dump_progress(prefix_str, count, count);
 }
 
+/*
+ * Reads the LZ4-compressed ramdisk in chunks, decompressing all the completely
+ * read compressed chunks after each read. Since BIOS disk reads are
+ * synchronous, I/O and decompression cannot really overlap, but this way the
+ * decompression streams through data just read (still in the CPU caches) and
+ * the progress reflects the whole work done.
+ */
+static void
+read_compr_ramdisk_with_progress(const char *prefix_str,
+                                 struct fat_compr_rd_info *info,
+                                 u32 rd_paddr,
+                                 u32 buf_paddr)
+{
+   const u32 chunk_sectors = 256;
+   const u32 count = (info->data_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+   const u32 first_sector = RAMDISK_SECTOR + info->data_off / SECTOR_SIZE;
+   struct lz4_chunked_ctx ctx;
+   u32 sectors_read = 0;
+
+   lz4_chunked_ctx_init(&ctx,
+                        (void *)buf_paddr,
+                        (void *)rd_paddr,
+                        info->raw_size,
+                        info->chunk_size);
+
+   while (sectors_read < count) {
+
+      const u32 n = MIN(chunk_sectors, count - sectors_read);
+
+      if (sectors_read > 0)
+         dump_progress(prefix_str, sectors_read, count);
+
+      read_sectors(buf_paddr + sectors_read * SECTOR_SIZE,
+                   first_sector + sectors_read,
+                   n);
+
+      sectors_read += n;
+
+      if (lz4_chunked_decompress(&ctx, MIN(sectors_read * SECTOR_SIZE,
+                                           info->data_size)) < 0)
+      {
+         printk("\n");
+         panic("Corrupted compressed ramdisk at offset %u", ctx.src_off);
+      }
+   }
+
+   if (!lz4_chunked_done(&ctx)) {
+      printk("\n");
+      panic("Truncated compressed ramdisk: %u/%u", ctx.dst_off, ctx.dst_size);
+   }
+
+   dump_progress(prefix_str, count, count);
+}
+
 static void
 write_ok_msg(void)
 {
@@ -230,6 +285,9 @@ void bootloader_main(void)
    void *entry;
    bool success;
    struct mem_info mi;
+   struct fat_compr_rd_info compr_info, *ci;
+   bool compressed = false;
+   u64 load_start, load_cycles;
 
    vga_set_video_mode(VGA_COLOR_TEXT_MODE_80x25);
    init_bt();
@@ -266,23 +324,37 @@ void bootloader_main(void)
       panic("read_write_params failed");
 
    printk(LOADING_RAMDISK_STR);
+   load_start = RDTSC();
    free_mem = get_usable_mem_or_panic(&mi, KERNEL_MAX_END_PADDR, SECTOR_SIZE);
 
    // Read FAT's header
    read_sectors(free_mem, RAMDISK_SECTOR, 1 /* read just 1 sector */);
 
-   calculate_ramdisk_fat_size((void *)free_mem);
+   if ((ci = fat_get_compr_rd_info((void *)free_mem))) {
+      compr_info = *ci;          /* free_mem will be re-used: copy the info */
+      compressed = true;
+   }
 
-   free_mem =
-      get_usable_mem_or_panic(&mi,
-                              KERNEL_MAX_END_PADDR,
-                              SECTOR_SIZE * (ramdisk_first_data_sector + 1));
+   if (compressed) {
+
+      /* The compressed ramdisk contains already only the used bytes */
+      rd_size = compr_info.raw_size;
+
+   } else {
+
+      calculate_ramdisk_fat_size((void *)free_mem);
 
-   // Now read all the meta-data up to the first data sector.
-   read_sectors(free_mem, RAMDISK_SECTOR, ramdisk_first_data_sector + 1);
+      free_mem =
+         get_usable_mem_or_panic(&mi,
+                                 KERNEL_MAX_END_PADDR,
+                                 SECTOR_SIZE * (ramdisk_first_data_sector + 1));
 
-   // Finally we're able to determine how big is the fatpart (pure data)
-   rd_size = fat_calculate_used_bytes((void *)free_mem);
+      // Now read all the meta-data up to the first data sector.
+      read_sectors(free_mem, RAMDISK_SECTOR, ramdisk_first_data_sector + 1);
+
+      // Finally we're able to determine how big is the fatpart (pure data)
+      rd_size = fat_calculate_used_bytes((void *)free_mem);
+   }
 
    /* Calculate rd_size in sectors, rounding up at SECTOR_SIZE */
    rd_sectors = (rd_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
@@ -298,15 +370,46 @@ void bootloader_main(void)
    }
 
    rd_paddr = free_mem;
-   read_sectors_with_progress(LOADING_RAMDISK_STR,
-                              rd_paddr,
-                              RAMDISK_SECTOR,
-                              rd_sectors);
+
+   if (compressed) {
+
+      const u32 data_sectors =
+         (compr_info.data_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+      ulong buf_paddr =
+         get_usable_mem(&mi,
+                        rd_paddr + SECTOR_SIZE * rd_sectors + 4 * KB,
+                        SECTOR_SIZE * data_sectors);
+
+      if (!buf_paddr) {
+         panic("Unable to allocate %u KB for the compressed ramdisk",
+               SECTOR_SIZE * data_sectors / KB);
+      }
+
+      read_compr_ramdisk_with_progress(LOADING_RAMDISK_STR,
+                                       &compr_info,
+                                       rd_paddr,
+                                       buf_paddr);
+
+   } else {
+
+      read_sectors_with_progress(LOADING_RAMDISK_STR,
+                                 rd_paddr,
+                                 RAMDISK_SECTOR,
+                                 rd_sectors);
+   }
+
+   load_cycles = RDTSC() - load_start;
 
    bt_movecur(bt_get_curr_row(), 0);
    printk(LOADING_RAMDISK_STR);
    write_ok_msg();
 
+   printk("Ramdisk: %u KB%s, loaded in %u M cycles\n",
+          rd_size / KB,
+          compressed ? " (lz4)" : "",
+          (u32)(load_cycles / 1000000));
+
    ff_clu_off = fat_get_first_free_cluster_off((void *)free_mem);
 
    if (ff_clu_off < rd_size) {
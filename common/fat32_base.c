@@ -24,13 +24,13 @@
 #define FAT_ENTRY_LAST                       ((char)0)
 #define FAT_ENTRY_AVAILABLE                  ((char)0xE5)
 
-static u8 shortname_checksum(u8 *shortname)
+u8 fat_get_short_name_checksum(const char *shortname)
 {
    u8 sum = 0;
 
    for (int i = 0; i < 11; i++) {
       // NOTE: The operation is an unsigned char rotate right
-      sum = (u8)( ((sum & 1u) ? 0x80u : 0u) + (sum >> 1u) + *shortname++ );
+      sum = (u8)( ((sum & 1u) ? 0x80u : 0u) + (sum >> 1u) + (u8)*shortname++ );
    }
 
    return sum;
@@ -229,7 +229,7 @@ static const char *
 finalize_long_name(struct fat_walk_long_name_ctx *ctx,
                    struct fat_entry *e)
 {
-   const s16 e_checksum = shortname_checksum((u8 *)e->DIR_Name);
+   const s16 e_checksum = fat_get_short_name_checksum(e->DIR_Name);
 
    if (ctx->lname_chksum == e_checksum) {
       ctx->lname_buf[ctx->lname_sz] = 0;
@@ -913,3 +913,19 @@ void fat_align_first_data_sector(struct fat_hdr *hdr, u32 page_size)
    /* Finally, zero the data now part of the reserved sectors */
    bzero(data, rem);
 }
+
+struct fat_compr_rd_info *fat_get_compr_rd_info(struct fat_hdr *hdr)
+{
+   struct fat_compr_rd_info *info =
+      (void *)((char *)hdr + FAT_COMPR_RD_INFO_OFF);
+
+   STATIC_ASSERT(FAT_COMPR_RD_INFO_OFF + sizeof(*info) <= 510);
+
+   if (strncmp(info->magic, FAT_COMPR_RD_MAGIC, sizeof(info->magic)))
+      return NULL;
+
+   if (!info->data_size || !info->raw_size || !info->chunk_size)
+      return NULL;
+
+   return info;
+}
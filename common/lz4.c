@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/failsafe_assert.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/lz4.h>
+
+/*
+ * LZ4 block decompressor, written from the format's public specification:
+ *
+ *    https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ *
+ * Each sequence is: token, [literal length ext], literals, offset (16-bit LE),
+ * [match length ext]. The last sequence contains only literals.
+ */
+
+static bool
+lz4_read_len_ext(const u8 **ip_ref, const u8 *iend, u32 *len)
+{
+   const u8 *ip = *ip_ref;
+   u8 b;
+
+   do {
+
+      if (ip >= iend)
+         return false;
+
+      b = *ip++;
+      *len += b;
+
+   } while (b == 255);
+
+   *ip_ref = ip;
+   return true;
+}
+
+int lz4_decompress_block(const void *src, u32 src_len, void *dst, u32 dst_cap)
+{
+   const u8 *ip = src;
+   const u8 *const iend = ip + src_len;
+   u8 *const ostart = dst;
+   u8 *op = dst;
+   u8 *const oend = op + dst_cap;
+
+   while (ip < iend) {
+
+      const u32 token = *ip++;
+      const u8 *match;
+      u32 len, off;
+
+      /* Literals */
+      len = token >> 4;
+
+      if (len == 15 && !lz4_read_len_ext(&ip, iend, &len))
+         return -1;
+
+      if (len > (u32)(iend - ip) || len > (u32)(oend - op))
+         return -1;
+
+      memcpy(op, ip, len);
+      op += len;
+      ip += len;
+
+      if (ip == iend)
+         break;         /* the last sequence has no match part */
+
+      /* Match */
+      if (iend - ip < 2)
+         return -1;
+
+      off = (u32)ip[0] | ((u32)ip[1] << 8);
+      ip += 2;
+
+      if (!off || off > (u32)(op - ostart))
+         return -1;
+
+      len = token & 15;
+
+      if (len == 15 && !lz4_read_len_ext(&ip, iend, &len))
+         return -1;
+
+      len += 4;
+
+      if (len > (u32)(oend - op))
+         return -1;
+
+      match = op - off;
+
+      if (off >= len) {
+
+         memcpy(op, match, len);
+         op += len;
+
+      } else {
+
+         /* Overlapping copy: it must proceed byte by byte */
+         while (len--)
+            *op++ = *match++;
+      }
+   }
+
+   return (int)(op - ostart);
+}
+
+int lz4_chunked_decompress(struct lz4_chunked_ctx *ctx, u32 src_avail)
+{
+   while (!lz4_chunked_done(ctx)) {
+
+      const u8 *chunk = ctx->src + ctx->src_off;
+      const u32 exp = MIN(ctx->chunk_size, ctx->dst_size - ctx->dst_off);
+      u32 hdr, clen;
+
+      if (src_avail - ctx->src_off < LZ4_CHUNK_HDR_SIZE)
+         break;         /* we need more data */
+
+      hdr = (u32)chunk[0]         |
+            (u32)chunk[1] << 8    |
+            (u32)chunk[2] << 16   |
+            (u32)chunk[3] << 24;
+
+      clen = hdr & ~LZ4_CHUNK_STORED;
+
+      if (src_avail - ctx->src_off - LZ4_CHUNK_HDR_SIZE < clen)
+         break;         /* we need more data */
+
+      chunk += LZ4_CHUNK_HDR_SIZE;
+
+      if (hdr & LZ4_CHUNK_STORED) {
+
+         if (clen != exp)
+            return -1;
+
+         memcpy(ctx->dst + ctx->dst_off, chunk, clen);
+
+      } else {
+
+         if (lz4_decompress_block(chunk, clen,
+                                  ctx->dst + ctx->dst_off, exp) != (int)exp)
+         {
+            return -1;
+         }
+      }
+
+      ctx->src_off += LZ4_CHUNK_HDR_SIZE + clen;
+      ctx->dst_off += exp;
+   }
+
+   return 0;
+}
@@ -33,6 +33,7 @@
 
 /* Constants that have no reason to be changed */
 #define KMALLOC_FREE_MEM_POISON_VAL    0xFAABCAFE
+#define TASK_ALLOC_CACHE_POISON_VAL    0xFAABDEAD
 
 /* Special advanced developer-only debug utils */
 #define KMUTEX_STATS_ENABLED                    0
@@ -107,7 +108,19 @@
 #define FBCON_OPT_FUNCS_MIN_FREE_HEAP       (16 * MB)
 #define WTH_MAX_THREADS                            64
 #define WTH_MAX_PRIO_QUEUE_SIZE                    40
-#define WTH_KB_QUEUE_SIZE                          80
+#define WTH_SOFTIRQ_QUEUE_SIZE                      4
+#define WTH_LONG_JOB_TICKS                 (TIMER_HZ / 10)
+#define SOFTIRQ_MAX_COUNT                          16
+#define SOFTIRQ_INPUT_BUDGET                       64
+#define SOFTIRQ_MAX_RESTART                        10
+#define SERIAL_TX_BUF_SIZE                 (4 * KB)
+#define SERIAL_RX_BUF_SIZE                        256
+#define KMSG_BUF_SIZE                     (32 * KB)
+#define KMUTEX_ADAPTIVE_YIELDS                      3
+#define KMUTEX_PI_MAX_DEPTH                         8
+#define SCHED_RR_TIMESLICE_TICKS (SCHED_RR_TIMESLICE_MS * TIMER_HZ / 1000)
+#define SCHED_RT_PERIOD_TICKS                TIMER_HZ
+#define SCHED_RT_RUNTIME_TICKS       (TIMER_HZ * 95 / 100)
 
 /*
  * User tasks constants
@@ -132,6 +145,7 @@
 #define USER_ARGS_PAGE_COUNT                                    1
 #define USERAPP_MAX_ARGS_COUNT                                 32
 #define MAX_SCRIPT_REC                                          2
+#define TASK_ALLOC_CACHE_SIZE                                   4
 
 #if KERNEL_BIG_IO_BUF
    #define IO_COPYBUF_PAGE_COUNT                               63
@@ -132,6 +132,7 @@ fat_get_rootdir(struct fat_hdr *hdr,
                 u32 *cluster /*out*/);
 
 void fat_get_short_name(struct fat_entry *entry, char *destbuf);
+u8 fat_get_short_name_checksum(const char *shortname);
 
 u32 fat_get_sector_for_cluster(struct fat_hdr *hdr, u32 N);
 
@@ -283,6 +284,30 @@ void fat_compact_clusters(struct fat_hdr *hdr);
 bool fat_is_first_data_sector_aligned(struct fat_hdr *hdr, u32 page_size);
 void fat_align_first_data_sector(struct fat_hdr *hdr, u32 page_size);
 
+/*
+ * Tilck-specific: descriptor of an LZ4-compressed copy of the ramdisk, written
+ * by `fathack --compress` in the (unused) boot code area of FAT's first sector.
+ * The compressed data is stored in the same partition, in clusters after the
+ * last used one, marked as BAD in the FAT in order to protect them. See lz4.h
+ * for the format of the compressed data.
+ */
+
+#define FAT_COMPR_RD_MAGIC                            "TILCKLZ4"
+#define FAT_COMPR_RD_INFO_OFF                              0x180
+
+struct fat_compr_rd_info {
+
+   char magic[8];
+   u32 data_off;        /* offset of the compressed data in the partition */
+   u32 data_size;       /* size of the compressed data */
+   u32 raw_size;        /* size of the ramdisk, once decompressed */
+   u32 chunk_size;      /* size of each decompressed chunk */
+
+} PACKED;
+
+/* Returns the compressed ramdisk descriptor, if present, or NULL */
+struct fat_compr_rd_info *fat_get_compr_rd_info(struct fat_hdr *hdr);
+
 void
 fat_read_whole_file(struct fat_hdr *hdr,
                     struct fat_entry *entry,
@@ -34,6 +34,7 @@
 #define TIMER_HZ               (@TIMER_HZ@)
 #define TTY_COUNT              (@TTY_COUNT@)
 #define MAX_HANDLES            (@MAX_HANDLES@)
+#define SCHED_RR_TIMESLICE_MS  (@SCHED_RR_TIMESLICE_MS@)
 
 /* enabled by default */
 #cmakedefine01 KRN_TRACK_NESTED_INTERR
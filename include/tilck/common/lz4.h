@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+/*
+ * Minimal LZ4 support: only the raw *block* format is supported, not the
+ * LZ4 frame format. On the top of it, we use a trivial chunked format:
+ *
+ *    [u32 hdr][data] [u32 hdr][data] ...
+ *
+ * where each chunk decompresses to exactly `chunk_size` bytes (except the last
+ * one) and `hdr` contains the size of `data`. When LZ4_CHUNK_STORED is set in
+ * `hdr`, the chunk is stored uncompressed (incompressible data).
+ *
+ * The chunked format allows the decompression to proceed while the compressed
+ * data is still being read from the disk.
+ */
+
+#define LZ4_CHUNK_STORED                                   (1u << 31)
+#define LZ4_CHUNK_HDR_SIZE                                          4
+
+/* Worst-case compressed size of a block of `n` bytes */
+#define LZ4_COMPRESS_BOUND(n)                       ((n) + (n) / 255 + 16)
+
+struct lz4_chunked_ctx {
+
+   const u8 *src;      /* compressed data (chunk headers included) */
+   u8 *dst;            /* destination buffer */
+   u32 src_off;        /* offset in `src` of the next chunk header */
+   u32 dst_off;        /* bytes decompressed so far */
+   u32 dst_size;       /* total size of the decompressed data */
+   u32 chunk_size;     /* size of each decompressed chunk */
+};
+
+/*
+ * Decompresses a single LZ4 block. Returns the number of bytes written to
+ * `dst` or -1 in case of corrupted input.
+ */
+int lz4_decompress_block(const void *src, u32 src_len, void *dst, u32 dst_cap);
+
+static inline void
+lz4_chunked_ctx_init(struct lz4_chunked_ctx *ctx,
+                     const void *src,
+                     void *dst,
+                     u32 dst_size,
+                     u32 chunk_size)
+{
+   ctx->src = (const u8 *)src;
+   ctx->dst = (u8 *)dst;
+   ctx->src_off = 0;
+   ctx->dst_off = 0;
+   ctx->dst_size = dst_size;
+   ctx->chunk_size = chunk_size;
+}
+
+static inline bool lz4_chunked_done(struct lz4_chunked_ctx *ctx)
+{
+   return ctx->dst_off == ctx->dst_size;
+}
+
+/*
+ * Decompresses all the chunks fully contained in the first `src_avail` bytes
+ * of `ctx->src` which have not been decompressed yet. Returns 0 in case of
+ * success (even if no chunk could be processed) and -1 on corrupted input.
+ */
+int lz4_chunked_decompress(struct lz4_chunked_ctx *ctx, u32 src_avail);
@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/lz4.h>
+
+/*
+ * Simple greedy LZ4 block compressor (single-entry hash table, no lazy
+ * matching). The ratio is lower than the one of the reference implementation,
+ * but the output is a fully valid LZ4 block and that's all we need.
+ *
+ * NOTE: the code is in a source-header (.c.h) for the same reason as
+ * simple_elf_loader.c.h: only the build apps (fathack) and the unit tests
+ * need a compressor, while the bootloaders need only the decompressor.
+ */
+
+#define LZ4_HASH_LOG                                   12
+#define LZ4_HASH_SIZE                   (1u << LZ4_HASH_LOG)
+#define LZ4_MIN_MATCH                                   4
+#define LZ4_LAST_LITERALS                               5
+#define LZ4_MF_LIMIT                                   12
+#define LZ4_MAX_OFFSET                              65535
+
+static inline u32 lz4_read32(const u8 *p)
+{
+   u32 v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+static inline u32 lz4_hash(u32 seq)
+{
+   return (seq * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+static u8 *lz4_write_len_ext(u8 *op, u32 len)
+{
+   while (len >= 255) {
+      *op++ = 255;
+      len -= 255;
+   }
+
+   *op++ = (u8)len;
+   return op;
+}
+
+static u8 *
+lz4_emit_sequence(u8 *op,
+                  const u8 *lit, u32 lit_len,
+                  u32 off, u32 match_len)
+{
+   u8 *const token = op++;
+
+   if (lit_len >= 15) {
+      *token = 15 << 4;
+      op = lz4_write_len_ext(op, lit_len - 15);
+   } else {
+      *token = (u8)(lit_len << 4);
+   }
+
+   memcpy(op, lit, lit_len);
+   op += lit_len;
+
+   if (!match_len)
+      return op;        /* last sequence: literals only */
+
+   *op++ = (u8)(off & 0xff);
+   *op++ = (u8)(off >> 8);
+
+   match_len -= LZ4_MIN_MATCH;
+
+   if (match_len >= 15) {
+      *token |= 15;
+      op = lz4_write_len_ext(op, match_len - 15);
+   } else {
+      *token |= (u8)match_len;
+   }
+
+   return op;
+}
+
+/*
+ * Compresses `len` bytes from `src` into `dst`, which must be at least
+ * LZ4_COMPRESS_BOUND(len) bytes big. `ht` is a scratch buffer of
+ * LZ4_HASH_SIZE elements. Returns the size of the compressed block.
+ */
+static u32
+lz4_compress_block(const void *src, u32 len, void *dst, u32 *ht)
+{
+   const u8 *const in = (const u8 *)src;
+   u8 *const ostart = (u8 *)dst;
+   u8 *op = ostart;
+   u32 anchor = 0;
+   u32 i = 0;
+
+   memset(ht, 0, LZ4_HASH_SIZE * sizeof(*ht));
+
+   if (len > LZ4_MF_LIMIT) {
+
+      const u32 mf_limit = len - LZ4_MF_LIMIT;
+      const u32 match_end_limit = len - LZ4_LAST_LITERALS;
+
+      while (i < mf_limit) {
+
+         const u32 seq = lz4_read32(in + i);
+         const u32 h = lz4_hash(seq);
+         const u32 ref = ht[h];       /* candidate position + 1, 0 = empty */
+         u32 m, mlen;
+
+         ht[h] = i + 1;
+
+         if (!ref ||
+             i - (ref - 1) > LZ4_MAX_OFFSET ||
+             lz4_read32(in + ref - 1) != seq)
+         {
+            i++;
+            continue;
+         }
+
+         m = ref - 1;
+         mlen = LZ4_MIN_MATCH;
+
+         while (i + mlen < match_end_limit && in[m + mlen] == in[i + mlen])
+            mlen++;
+
+         op = lz4_emit_sequence(op, in + anchor, i - anchor, i - m, mlen);
+         i += mlen;
+         anchor = i;
+      }
+   }
+
+   op = lz4_emit_sequence(op, in + anchor, len - anchor, 0, 0);
+   return (u32)(op - ostart);
+}
+
+/*
+ * Compresses `len` bytes from `src` using the chunked format described in
+ * lz4.h. `dst` must be big enough for the worst case, which is:
+ *
+ *    chunks_count * (LZ4_CHUNK_HDR_SIZE + LZ4_COMPRESS_BOUND(chunk_size))
+ *
+ * Returns the total size of the compressed data.
+ */
+static u32
+lz4_compress_chunked(const void *src,
+                     u32 len,
+                     void *dst,
+                     u32 chunk_size,
+                     u32 *ht)
+{
+   const u8 *in = (const u8 *)src;
+   u8 *op = (u8 *)dst;
+
+   for (u32 off = 0; off < len; off += chunk_size) {
+
+      const u32 n = MIN(chunk_size, len - off);
+      u8 *const hdr = op;
+      u32 clen, hval;
+
+      op += LZ4_CHUNK_HDR_SIZE;
+      clen = lz4_compress_block(in + off, n, op, ht);
+
+      if (clen >= n) {
+         memcpy(op, in + off, n);
+         clen = n;
+         hval = n | LZ4_CHUNK_STORED;
+      } else {
+         hval = clen;
+      }
+
+      hdr[0] = (u8)(hval);
+      hdr[1] = (u8)(hval >> 8);
+      hdr[2] = (u8)(hval >> 16);
+      hdr[3] = (u8)(hval >> 24);
+      op += clen;
+   }
+
+   return (u32)(op - (u8 *)dst);
+}
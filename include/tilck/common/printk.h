@@ -15,6 +15,10 @@
       int vsnprintk(char *buf, size_t size, const char *fmt, va_list args);
       int snprintk(char *buf, size_t size, const char *fmt, ...);
       void printk_flush_ringbuf(void);
+      void init_printk_flusher(void);
+
+      /* Set while printk() writes to the term: its callees must not sleep */
+      extern bool __in_printk;
 
    #endif
 
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #pragma once
+#include <tilck/common/basic_defs.h>
 #include <sys/syscall.h>         // system header
 
 #define TILCK_CMD_SYSCALL    499
@@ -14,11 +15,86 @@ enum tilck_cmd {
    TILCK_CMD_QEMU_POWEROFF       = 4,
    TILCK_CMD_SET_SAT_ENABLED     = 5,
    TILCK_CMD_DEBUG_PANEL         = 6,
+   TILCK_CMD_GET_FAULTS_CNT      = 7,
+   TILCK_CMD_GETDENTS_STAT       = 8,
+   TILCK_CMD_PROF                = 9,
 
    /* Number of elements in the enum */
-   TILCK_CMD_COUNT               = 7,
+   TILCK_CMD_COUNT               = 10,
 };
 
+/* Sub-commands of TILCK_CMD_PROF (the sampling profiler) */
+enum tilck_prof_op {
+
+   TILCK_PROF_START              = 0,  /* a1: flags, a2: max samples */
+   TILCK_PROF_STOP               = 1,
+   TILCK_PROF_GET_INFO           = 2,  /* a1: struct tilck_prof_info * */
+   TILCK_PROF_READ               = 3,  /* a1: first, a2: buf, a3: count */
+   TILCK_PROF_GET_SYM            = 4,  /* a1: kernel addr, a2: buf, a3: size */
+   TILCK_PROF_RESET              = 5,
+};
+
+#define TILCK_PROF_FL_STACKS             (1 << 0)   /* walk the stack */
+#define TILCK_PROF_SAMPLE_USER           (1 << 0)   /* sample in user mode */
+
+#define TILCK_PROF_MAX_FRAMES                 14
+#define TILCK_PROF_DEFAULT_SAMPLES          4096
+#define TILCK_PROF_MAX_SAMPLES             32768
+
+/*
+ * A sample taken by the profiler at each timer tick. `ip` is the address of
+ * the interrupted instruction, while `frames` contains the return addresses
+ * found by walking the frame pointers (callers first, from the innermost).
+ */
+struct tilck_prof_sample {
+
+   u32 tid;
+   u16 flags;
+   u16 n_frames;
+   ulong ip;
+   ulong frames[TILCK_PROF_MAX_FRAMES];
+};
+
+struct tilck_prof_info {
+
+   u32 running;
+   u32 flags;
+   u32 samples;
+   u32 max_samples;
+   u32 lost;
+   u32 hz;
+};
+
+/*
+ * Record returned by TILCK_CMD_GETDENTS_STAT: a directory entry, like struct
+ * linux_dirent64, plus the attributes that lstat() would return for it. All
+ * the records are aligned at 8 bytes and `d_reclen` is their full size.
+ */
+struct tilck_dirent_stat {
+
+   u64 d_ino;
+   u64 d_off;
+   u64 size;
+   u64 blocks;
+   s64 mtime;
+   s64 ctime;
+   u32 mtime_nsec;
+   u32 ctime_nsec;
+   u32 dev;
+   u32 rdev;
+   u32 mode;
+   u32 nlink;
+   u32 uid;
+   u32 gid;
+   u32 blksize;
+   u16 d_reclen;
+   u8 d_type;
+   u8 unused;
+   char d_name[];
+};
+
+STATIC_ASSERT(sizeof(struct tilck_dirent_stat) == 88);
+
 #if defined(__x86_64__)
 
    #define STAT_SYSCALL_N      SYS_stat
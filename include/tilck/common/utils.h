@@ -141,3 +141,25 @@ round_down_at64(u64 n, u64 unit)
 {
    return (n / unit) * unit;
 }
+
+/* Bitmaps: arrays of ulong, with bit `i` in word `i / NBITS` */
+
+#define BITMAP_WORDS(nbits)             (((nbits) + NBITS - 1) / NBITS)
+
+static ALWAYS_INLINE void
+bitmap_set(ulong *bm, ulong i)
+{
+   bm[i / NBITS] |= (1ul << (i % NBITS));
+}
+
+static ALWAYS_INLINE void
+bitmap_clear(ulong *bm, ulong i)
+{
+   bm[i / NBITS] &= ~(1ul << (i % NBITS));
+}
+
+static ALWAYS_INLINE bool
+bitmap_test(const ulong *bm, ulong i)
+{
+   return !!(bm[i / NBITS] & (1ul << (i % NBITS)));
+}
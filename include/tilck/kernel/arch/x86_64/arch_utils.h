@@ -32,6 +32,29 @@ static ALWAYS_INLINE void set_return_register(regs_t *r, ulong value)
    NOT_IMPLEMENTED();
 }
 
+static ALWAYS_INLINE void set_user_stack_register(regs_t *r, ulong value)
+{
+   NOT_IMPLEMENTED();
+}
+
+static ALWAYS_INLINE ulong regs_get_ip(regs_t *r)
+{
+   NOT_IMPLEMENTED();
+   return 0;
+}
+
+static ALWAYS_INLINE ulong regs_get_frame_ptr(regs_t *r)
+{
+   NOT_IMPLEMENTED();
+   return 0;
+}
+
+static ALWAYS_INLINE bool regs_in_user_mode(regs_t *r)
+{
+   NOT_IMPLEMENTED();
+   return false;
+}
+
 static ALWAYS_INLINE ulong get_curr_stack_ptr(void)
 {
    NOT_IMPLEMENTED();
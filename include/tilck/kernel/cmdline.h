@@ -12,5 +12,6 @@ extern void (*self_test_to_run)(void);
 extern int kopt_tty_count;
 extern bool kopt_serial_console;
 extern bool kopt_sched_alive_thread;
+extern bool kopt_rw_initrd;
 
 void parse_kernel_cmdline(const char *cmdline);
@@ -6,6 +6,7 @@
 #include <tilck/common/fat32_base.h>
 
 #include <tilck/kernel/sync.h>
+#include <tilck/kernel/rwlock.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/fs/vfs_base.h>
 
@@ -28,6 +29,29 @@ struct fat_fs_device_data {
     * regular fat_entry.
     */
    struct fat_entry *root_dir_entries;
+
+   /* Members used only in r/w mode */
+
+   struct rwlock_wp rwlock;      /* fs structure lock (see struct fs_ops) */
+   struct rwlock_wp data_lock;   /* FAT table, cluster data and file sizes */
+
+   size_t rd_size;               /* in-memory size of the ramdisk */
+   u32 max_cluster;              /* last cluster fully inside the ramdisk */
+   u32 free_clu_hint;            /* where to start searching a free cluster */
+   u32 chain_gen;                /* incremented when any chain is shortened */
+
+   /*
+    * Write-back state. Changes to the FAT table are done only on the first
+    * FAT, while the dirty sectors are tracked in `dirty_fat_secs` and copied
+    * to the other FATs in batch, by fat_flush(). The same applies to the
+    * FSInfo sector on FAT32. The data clusters are modified in place, but
+    * they're tracked as well in `dirty_clusters`: that's what a block-device
+    * backed FAT would need to write back.
+    */
+   ulong *dirty_clusters;        /* bitmap, 1 bit per cluster */
+   ulong *dirty_fat_secs;        /* bitmap, 1 bit per sector of FAT #0 */
+   u32 dirty_clusters_cnt;
+   u32 dirty_fat_secs_cnt;
 };
 
 struct fatfs_handle {
@@ -37,12 +61,22 @@ struct fatfs_handle {
 
    /* fs-specific members */
    struct fat_entry *e;
-   u32 curr_cluster;
+   u32 curr_cluster;       /* cluster containing the file offset curr_off */
+   offt curr_off;          /* file offset of the beginning of curr_cluster */
+   u32 curr_gen;           /* value of `chain_gen` when the cursor was set */
+   bool written;           /* the handle has been used for writing */
 };
 
 struct fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags);
 void fat_umount_ramdisk(struct fs *fs);
 
+/*
+ * Propagates the batched FAT changes (see struct fat_fs_device_data) and
+ * clears the dirty bitmaps. Returns the number of data clusters that were
+ * dirty. Does nothing on read-only mounts.
+ */
+u32 fat_flush(struct fs *fs);
+
 struct datetime
 fat_datetime_to_regular_datetime(u16 date, u16 time, u8 timetenth);
 
@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/kernel/fs/vfs_base.h>
+
+#define PROCFS_USER_HZ                100   /* sysconf(_SC_CLK_TCK) */
+
+struct fs *create_procfs(void);
+void init_procfs(void);
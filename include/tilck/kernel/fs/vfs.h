@@ -16,12 +16,15 @@
 #include <tilck/kernel/hal_types.h>
 #include <tilck/kernel/sync.h>
 
+struct tilck_dirent_stat;
+
 struct vfs_dent64 {
 
    tilck_ino_t ino;
    enum vfs_entry_type type;
    u8 name_len;               /* NODE: includes the final '\0' */
    const char *name;
+   vfs_inode_ptr_t inode;     /* optional, used by vfs_getdents_stat() */
 };
 
 typedef int (*get_dents_func_cb) (struct vfs_dent64 *, void *);
@@ -68,7 +71,10 @@ typedef int     (*func_exlock_noblk) (struct fs *, vfs_inode_ptr_t);
 typedef ssize_t        (*func_read)         (fs_handle, char *, size_t);
 typedef ssize_t        (*func_write)        (fs_handle, char *, size_t);
 typedef offt           (*func_seek)         (fs_handle, offt, int);
+typedef ssize_t        (*func_pread)        (fs_handle, char *, size_t, offt);
+typedef ssize_t        (*func_pwrite)       (fs_handle, char *, size_t, offt);
 typedef int            (*func_ioctl)        (fs_handle, ulong, void *);
+typedef int            (*func_fadvise)      (fs_handle, offt, offt, int);
 
 typedef int            (*func_mmap)         (struct user_mapping *,
                                              pdir_t *,
@@ -149,8 +155,21 @@ struct file_ops {
    func_readv readv;                   /* if NULL, emulated in non-atomic way */
    func_writev writev;                 /* if NULL, emulated in non-atomic way */
 
+   /*
+    * Positional read/write: they must NOT use nor change the handle's `pos`.
+    * If NULL, they're emulated with seek + read/write (see vfs_pread()).
+    */
+   func_pread pread;
+   func_pwrite pwrite;
+
    func_handle_fault handle_fault;     /* if NULL -> false     */
 
+   /*
+    * Access pattern hints from fadvise() and readahead(). The `advice` is
+    * validated by vfs_fadvise(). If NULL, all the hints are just ignored.
+    */
+   func_fadvise fadvise;
+
    /*
     * Optional, r/w/e ready funcs
     *
@@ -173,6 +192,10 @@ void vfs_init_fs_handle_base_fields(struct fs_handle_base *hb,
                                     const struct file_ops *fops);
 
 int vfs_stat64(const char *path, struct stat64 *statbuf, bool res_last_sl);
+int vfs_fstatat64(fs_handle dirh,
+                  const char *path,
+                  struct stat64 *statbuf,
+                  bool res_last_sl);
 int vfs_open(const char *path, fs_handle *out, int flags, mode_t mode);
 int vfs_unlink(const char *path);
 int vfs_mkdir(const char *path, mode_t mode);
@@ -190,8 +213,10 @@ int vfs_ftruncate(fs_handle h, offt length);
 int vfs_ioctl(fs_handle h, ulong request, void *argp);
 int vfs_fstat64(fs_handle h, struct stat64 *statbuf);
 int vfs_getdents64(fs_handle h, struct linux_dirent64 *dirp, u32 bs);
+int vfs_getdents_stat(fs_handle h, struct tilck_dirent_stat *dirp, u32 bs);
 int vfs_fchmod(fs_handle h, mode_t mode);
 int vfs_futimens(fs_handle h, const struct k_timespec64 times[2]);
+int vfs_fadvise(fs_handle h, offt off, offt len, int advice);
 offt vfs_seek(fs_handle h, s64 off, int whence);
 
 int vfs_read_ready(fs_handle h);
@@ -201,10 +226,27 @@ struct kcond *vfs_get_rready_cond(fs_handle h);
 struct kcond *vfs_get_wready_cond(fs_handle h);
 struct kcond *vfs_get_except_cond(fs_handle h);
 
+/*
+ * Wake-up keys used by poll() and select() when waiting on the conditions
+ * above. Files using a single kcond for all the events (e.g. pipes) signal it
+ * with the proper KCOND_KEY_* key; all the others just signal KCOND_KEY_ANY.
+ */
+#define VFS_RREADY_KEYS        (KCOND_KEY_READ | KCOND_KEY_HUP)
+#define VFS_WREADY_KEYS        (KCOND_KEY_WRITE | KCOND_KEY_HUP)
+#define VFS_EXCEPT_KEYS        (KCOND_KEY_HUP)
+
 ssize_t vfs_read(fs_handle h, void *buf, size_t buf_size);
 ssize_t vfs_write(fs_handle h, void *buf, size_t buf_size);
 ssize_t vfs_readv(fs_handle h, const struct iovec *iov, int iovcnt);
 ssize_t vfs_writev(fs_handle h, const struct iovec *iov, int iovcnt);
+ssize_t vfs_pread(fs_handle h, void *buf, size_t buf_size, offt off);
+ssize_t vfs_pwrite(fs_handle h, void *buf, size_t buf_size, offt off);
+
+ssize_t
+vfs_preadv(fs_handle h, const struct iovec *iov, int iovcnt, offt off);
+
+ssize_t
+vfs_pwritev(fs_handle h, const struct iovec *iov, int iovcnt, offt off);
 
 int vfs_exlock_noblock(struct fs *fs, vfs_inode_ptr_t i);
 int vfs_exunlock(struct fs *fs, vfs_inode_ptr_t i);
@@ -279,6 +321,17 @@ vfs_resolve(const char *path,
             bool exlock,
             bool res_last_sl);
 
+/*
+ * Like vfs_resolve(), but relative paths are resolved starting from the
+ * directory `dirh` (if not NULL) instead of the current working directory.
+ */
+int
+vfs_resolve_at(fs_handle dirh,
+               const char *path,
+               struct vfs_path *rp,
+               bool exlock,
+               bool res_last_sl);
+
 int mp_init(struct fs *root_fs);
 int mp_add(struct fs *fs, const char *target_path);
 int mp_remove(const char *target_path);
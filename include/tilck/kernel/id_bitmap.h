@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/utils.h>
+
+/*
+ * Two-level bitmap allocator for small integer IDs, like pids and kernel tids.
+ *
+ * `bits` has one bit per ID, set when the ID is in use. `full` has one bit per
+ * word of `bits`, set when all the IDs in that word are in use. Looking for a
+ * free ID costs at most a scan of `full` plus a single word of `bits`, no
+ * matter how many IDs are currently in use.
+ *
+ * The caller provides the storage, sized with the ID_BITMAP_*WORDS() macros.
+ */
+struct id_bitmap {
+
+   ulong *bits;
+   ulong *full;
+   int max_id;             /* the biggest valid ID */
+   int last;               /* last ID returned by id_bitmap_next_free() */
+};
+
+#define ID_BITMAP_WORDS(max_id)            BITMAP_WORDS((max_id) + 1)
+#define ID_BITMAP_FULL_WORDS(max_id)       BITMAP_WORDS(ID_BITMAP_WORDS(max_id))
+
+void
+id_bitmap_init(struct id_bitmap *b, ulong *bits, ulong *full, int max_id);
+
+void id_bitmap_set(struct id_bitmap *b, int id);
+void id_bitmap_clear(struct id_bitmap *b, int id);
+bool id_bitmap_test(struct id_bitmap *b, int id);
+
+/* Returns the lowest free ID >= `from`, or -1 if there isn't any */
+int id_bitmap_find_free(struct id_bitmap *b, int from);
+
+/*
+ * Returns the first free ID after the last one returned by this function,
+ * wrapping around at max_id, or -1 if all the IDs are in use. It does NOT
+ * mark the ID as used: that's up to the caller, with id_bitmap_set().
+ */
+int id_bitmap_next_free(struct id_bitmap *b);
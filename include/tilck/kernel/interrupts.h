@@ -4,6 +4,8 @@
 #include <tilck/kernel/list.h>
 #include <tilck/kernel/hal_types.h>
 
+extern regs_t *__curr_irq_regs;
+
 void set_fault_handler(int fault, void *ptr);
 void exit_fault_handler_state(void);
 
@@ -30,3 +32,12 @@ static inline void nested_interrupts_drop_top_syscall(void) { }
 static inline void panic_dump_nested_interrupts(void) { }
 static inline void check_in_no_other_irq_than_timer(void) { }
 #endif
+
+/*
+ * Returns the registers saved on entry of the IRQ currently being handled, or
+ * NULL when we're not running an IRQ handler.
+ */
+static ALWAYS_INLINE regs_t *get_curr_irq_regs(void)
+{
+   return __curr_irq_regs;
+}
@@ -21,7 +21,12 @@ struct irq_handler_node {
    };
 
 
+extern u32 irq_count[256];             /* IRQs received, spurious excluded */
+extern u32 unhandled_irq_count[256];   /* IRQs not handled by any handler */
+extern u32 spur_irq_count;
+
 void init_irq_handling();
+irq_handler_t irq_get_handler(int irq);
 
 void irq_install_handler(u8 irq, struct irq_handler_node *n);
 void irq_uninstall_handler(u8 irq, struct irq_handler_node *n);
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+#define KMSG_REC_MAX_TEXT                  256
+#define KMSG_TEXT_BUF_SIZE                 (KMSG_REC_MAX_TEXT + 64)
+
+/* Record flags */
+#define KMSG_FL_NO_PREFIX               (1 << 0)  /* no timestamp prefix */
+#define KMSG_FL_NO_CONSOLE              (1 << 1)  /* already written there */
+
+/*
+ * A reader of the kernel log. Each reader has its own position: the log is
+ * never consumed, the oldest records just get overwritten when it's full.
+ * A zeroed reader starts from the oldest record still in the log.
+ */
+struct kmsg_reader {
+
+   u32 pos;                /* position of the next record in the log */
+   u32 seq;                /* its sequence number, 0 for a new reader */
+};
+
+struct kmsg_rec_info {
+
+   u64 sys_time;           /* when the record was written */
+   u32 seq;                /* sequence number, starting from 1 */
+   u32 lost;               /* records overwritten before we could read them */
+   u8 color;
+   u8 flags;
+};
+
+bool kmsg_write(const char *buf, u32 len, u8 color, u8 flags);
+int kmsg_read(struct kmsg_reader *r,
+              char *buf,
+              u32 size,
+              struct kmsg_rec_info *info);
+
+int kmsg_read_text(struct kmsg_reader *r,
+                   char *buf,
+                   u32 size,
+                   u8 skip_flags,
+                   u8 *color);
+
+bool kmsg_can_read(struct kmsg_reader *r);
+u32 kmsg_get_lost_count(void);
+void kmsg_wakeup_readers(void);
+void init_kmsg_dev(void);
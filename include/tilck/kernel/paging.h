@@ -126,6 +126,24 @@ void *hi_vmem_reserve(size_t size);
  */
 void hi_vmem_release(void *ptr, size_t size);
 
+/* Info about a page mapped in the user part of a page directory */
+struct user_page_info {
+
+   ulong vaddr;
+   u32 ref_count;       /* ref-count of the pageframe */
+   bool rw;             /* writable, even if it's currently a CoW page */
+   bool shared;         /* shared mapping (e.g. MAP_SHARED) */
+   bool zero;           /* the page maps the global zero_page */
+};
+
+typedef void (*user_page_cb)(struct user_page_info *, void *);
+
+/*
+ * Calls `cb` for each page mapped in the user part of `pdir`, in order of
+ * vaddr. It must be called with preemption disabled.
+ */
+void pdir_for_each_user_page(pdir_t *pdir, user_page_cb cb, void *arg);
+
 int virtual_read(pdir_t *pdir, void *extern_va, void *dest, size_t len);
 int virtual_write(pdir_t *pdir, void *extern_va, void *src, size_t len);
 
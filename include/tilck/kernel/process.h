@@ -37,6 +37,42 @@ struct mappings_info {
    struct list mappings;
 };
 
+struct session {
+
+   int sid;
+   struct bintree_node node;        /* node in the tree of sessions, by sid */
+   struct list groups;              /* process groups in this session */
+};
+
+struct process_group {
+
+   int pgid;
+   int count;                       /* number of processes in the group */
+   struct session *s;
+   struct bintree_node node;        /* node in the tree of groups, by pgid */
+   struct list_node s_node;         /* node in session's `groups` list */
+   struct list members;             /* processes, through their `pgrp_node` */
+};
+
+/*
+ * Resource usage of a process or of its terminated children. The counters
+ * are ulong, like the `long` fields of struct rusage: that also keeps struct
+ * process small enough.
+ */
+struct proc_rusage {
+
+   u64 utime;           /* time spent in user mode, in nanoseconds */
+   u64 stime;           /* time spent in kernel mode, in nanoseconds */
+   u64 rchar;           /* bytes read by read-like syscalls */
+   u64 wchar;           /* bytes written by write-like syscalls */
+   ulong minflt;        /* resolved page faults, including CoW */
+   ulong nvcsw;         /* voluntary context switches */
+   ulong nivcsw;        /* involuntary context switches */
+   ulong syscalls;      /* total number of syscalls */
+   ulong syscr;         /* number of read-like syscalls */
+   ulong syscw;         /* number of write-like syscalls */
+};
+
 struct process {
 
    REF_COUNTED_OBJECT;
@@ -53,6 +89,8 @@ struct process {
 
    struct list children;
 
+   struct list_node pgrp_node;            /* node in the group's members */
+
    void *proc_tty;
    bool did_call_execve;
    bool did_set_tty_medium_raw;
@@ -62,6 +100,8 @@ struct process {
    bool inherited_mmap_heap;
 
    int *set_child_tid;                    /* NOTE: this is an user pointer */
+   ulong faults_cnt;                      /* resolved user page faults */
+   struct proc_rusage children_ru;        /* usage of the waited children */
 
    struct kmutex fslock;                  /* protects `handles` and `cwd` */
    mode_t umask;
@@ -124,7 +164,11 @@ task_is_parent(struct task *parent, struct task *child)
    return child->pi->parent_pid == parent->pi->pid;
 }
 
-int do_fork(bool vfork);
+void process_get_rusage(struct process *pi, struct proc_rusage *ru);
+void proc_rusage_add(struct proc_rusage *dst, const struct proc_rusage *src);
+void proc_rusage_to_k_rusage(const struct proc_rusage *ru, struct k_rusage *kr);
+
+int do_fork(bool vfork, void *child_stack);
 void handle_vforked_child_move_on(struct process *pi);
 int first_execve(const char *abs_path, const char *const *argv);
 
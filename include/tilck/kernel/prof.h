@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/syscalls.h>
+
+extern volatile bool __prof_running;
+
+void prof_take_sample(void);
+int sys_tilck_prof(ulong op, ulong a1, ulong a2, ulong a3);
+
+/*
+ * Called by the timer IRQ handler at every tick: when the profiler is not
+ * running, it costs just a load and a (predicted) branch.
+ */
+static ALWAYS_INLINE void prof_timer_tick(void)
+{
+   if (UNLIKELY(__prof_running))
+      prof_take_sample();
+}
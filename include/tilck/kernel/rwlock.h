@@ -2,6 +2,7 @@
 
 #pragma once
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/atomics.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
 
@@ -73,3 +74,71 @@ void rwlock_wp_exunlock(struct rwlock_wp *rw);
    }
 
 #endif
+
+/*
+ * Reader-biased rwlock
+ *
+ * Readers take and release the lock with a single atomic operation on `cnt`,
+ * as long as no writer is pending: the kmutex and the kcond are used only in
+ * the slow paths (writers, and readers finding a writer pending). A pending
+ * writer blocks new readers, so writers do not starve.
+ */
+
+#define RWLOCK_RB_WRITER                               (1 << 30)
+
+struct rwlock_rb {
+
+   ATOMIC(int) cnt;           /* readers count | RWLOCK_RB_WRITER */
+   struct task *ex_owner;
+   struct kmutex m;           /* slow paths only */
+   struct kcond c;
+   bool rec;                  /* is exlock operation recursive */
+   u16 rc;                    /* recursive locking count */
+};
+
+#define STATIC_RWLOCK_RB_INIT(rw, recursive)             \
+   {                                                     \
+      .cnt = 0,                                          \
+      .ex_owner = NULL,                                  \
+      .m = STATIC_KMUTEX_INIT(rw.m, KMUTEX_FL_ADAPTIVE), \
+      .c = STATIC_KCOND_INIT(rw.c),                      \
+      .rec = recursive,                                  \
+      .rc = 0,                                           \
+   }
+
+void rwlock_rb_init(struct rwlock_rb *rw, bool recursive);
+void rwlock_rb_destroy(struct rwlock_rb *rw);
+void rwlock_rb_exlock(struct rwlock_rb *rw);
+void rwlock_rb_exunlock(struct rwlock_rb *rw);
+void rwlock_rb_shlock_slow(struct rwlock_rb *rw);
+void rwlock_rb_shunlock_slow(struct rwlock_rb *rw);
+
+static ALWAYS_INLINE void rwlock_rb_shlock(struct rwlock_rb *rw)
+{
+   if (atomic_fetch_add_explicit(&rw->cnt, 1, mo_acquire) & RWLOCK_RB_WRITER)
+      rwlock_rb_shlock_slow(rw);
+}
+
+static ALWAYS_INLINE void rwlock_rb_shunlock(struct rwlock_rb *rw)
+{
+   int old = atomic_fetch_sub_explicit(&rw->cnt, 1, mo_release);
+
+   /* The last reader leaving while a writer is waiting for it */
+   if (old == (RWLOCK_RB_WRITER | 1))
+      rwlock_rb_shunlock_slow(rw);
+}
+
+#ifdef DEBUG
+
+   static inline bool rwlock_rb_is_shlocked(struct rwlock_rb *rw)
+   {
+      int cnt = atomic_load_explicit(&rw->cnt, mo_relaxed);
+      return (cnt & ~RWLOCK_RB_WRITER) > 0;
+   }
+
+   static inline bool rwlock_rb_holding_exlock(struct rwlock_rb *rw)
+   {
+      return rw->ex_owner == get_curr_task();
+   }
+
+#endif
@@ -12,6 +12,24 @@
 
 #define TIME_SLICE_TICKS (TIMER_HZ / 20)
 
+/* Scheduling priorities, see struct task */
+#define MIN_NICE                    -20
+#define MAX_NICE                     19
+#define MAX_RT_PRIO                 100
+#define MAX_PRIO                    (MAX_RT_PRIO + 40)
+#define DEFAULT_PRIO                (MAX_RT_PRIO + 20)
+#define NICE_TO_PRIO(n)             ((u8)(DEFAULT_PRIO + (n)))
+#define PRIO_TO_NICE(p)             ((int)(p) - DEFAULT_PRIO)
+#define MIN_RT_PRIORITY               1
+#define MAX_RT_PRIORITY             (MAX_RT_PRIO - 1)
+
+/* Scheduling policies, as in Linux */
+#define SCHED_OTHER                   0
+#define SCHED_FIFO                    1
+#define SCHED_RR                      2
+#define SCHED_BATCH                   3
+#define SCHED_IDLE                    5
+
 enum task_state {
    TASK_STATE_INVALID   = 0,
    TASK_STATE_RUNNABLE  = 1,
@@ -37,7 +55,30 @@ struct sched_ticks {
 
    u32 timeslice;       /* ticks counter for the current time slice */
    u64 total;           /* total life-time ticks */
-   u64 total_kernel;    /* total life-time ticks spent in kernel */
+   u64 vruntime;        /* total ticks weighted by the nice value */
+};
+
+/* System-wide counters, in ticks, of the time spent by the CPU */
+struct sched_cpu_ticks {
+
+   u64 user;            /* running user code */
+   u64 system;          /* running kernel code, except the idle task */
+   u64 idle;            /* running the idle task */
+};
+
+/* Per-task resource usage counters, see getrusage(2) */
+struct task_rusage {
+
+   u64 runtime;         /* precise time spent on the CPU, in TSC cycles */
+   u64 last_switch;     /* TSC value when the task got the CPU */
+   u32 kernel_ticks;    /* ticks sampled while running kernel code */
+   u32 nvcsw;           /* voluntary context switches */
+   u32 nivcsw;          /* involuntary context switches */
+   u32 syscalls;        /* total number of syscalls */
+   u32 syscr;           /* number of read-like syscalls */
+   u32 syscw;           /* number of write-like syscalls */
+   u64 rchar;           /* bytes read by read-like syscalls */
+   u64 wchar;           /* bytes written by write-like syscalls */
 };
 
 struct task {
@@ -82,6 +123,7 @@ struct task {
 
    s32 wstatus;                       /* waitpid's wstatus  */
    struct sched_ticks ticks;          /* scheduler counters */
+   struct task_rusage ru;             /* resource usage counters */
 
    void *kernel_stack;
    void *args_copybuf;
@@ -106,6 +148,26 @@ struct task {
    /* The task was sleeping on a timer and has just been woken up */
    bool timer_ready;
 
+   /* Number of kmutexes currently held by this task */
+   u8 kmutexes_held;
+
+   /*
+    * Scheduling priorities, with the same scale used by Linux: lower values
+    * mean higher priority and [MAX_RT_PRIO, MAX_PRIO) is the range of the
+    * regular tasks, mapped 1:1 to nice values. The effective priority `prio`
+    * can be temporarily lower than its normal one because of priority
+    * inheritance (see kmutex.c).
+    *
+    * Real-time tasks (SCHED_FIFO and SCHED_RR) have a `rt_priority` in
+    * [MIN_RT_PRIORITY, MAX_RT_PRIORITY], mapped to the [0, MAX_RT_PRIO) range
+    * in reverse order, as in Linux. Their `static_prio` keeps the nice value,
+    * used again if the task goes back to the fair class.
+    */
+   u8 static_prio;
+   u8 prio;
+   u8 policy;
+   u8 rt_priority;
+
    /*
     * For kernel threads, this is a function pointer of the thread's entry
     * point. For user processes/threads, it is unused for the moment. In the
@@ -211,6 +273,20 @@ static ALWAYS_INLINE bool is_worker_thread(struct task *ti)
    return ti->worker_thread != NULL;
 }
 
+static ALWAYS_INLINE bool is_rt_task(struct task *ti)
+{
+   return ti->rt_priority > 0;
+}
+
+/* The priority of the task, without any priority inheritance boost */
+static ALWAYS_INLINE u8 task_normal_prio(struct task *ti)
+{
+   if (is_rt_task(ti))
+      return (u8)(MAX_RT_PRIO - 1 - ti->rt_priority);
+
+   return ti->static_prio;
+}
+
 /*
  * This wrapper is useful for adding ASSERTs and getting a backtrace containing
  * the caller's EIP in case of a failure.
@@ -285,6 +361,9 @@ int get_curr_tid(void);
 int get_curr_pid(void);
 void save_current_task_state(regs_t *);
 void sched_account_ticks(void);
+void sched_get_cpu_ticks(struct sched_cpu_ticks *out);
+void sched_account_switch(struct task *prev, struct task *next);
+void task_get_cpu_times(struct task *ti, u64 *utime_ns, u64 *stime_ns);
 int create_new_pid(void);
 int create_new_kernel_tid(void);
 void task_info_reset_kernel_stack(struct task *ti);
@@ -309,6 +388,16 @@ NODISCARD int kthread_create(kthread_func_ptr fun, int fl, void *arg);
 int iterate_over_tasks(bintree_visit_cb func, void *arg);
 int sched_count_proc_in_group(int pgid);
 int sched_get_session_of_group(int pgid);
+int sched_set_pgrp(struct process *pi, int pgid);
+int sched_new_session(struct process *pi);
+int sched_get_nice(int which, int who, int *nice);
+int sched_set_nice(int which, int who, int nice);
+void sched_set_task_prio(struct task *ti, u8 static_prio);
+int sched_set_task_policy(struct task *ti, int policy, int rt_priority);
+int sched_set_policy(int tid, int policy, int rt_priority);
+int sched_get_policy(int tid, int *policy, int *rt_priority);
+void sched_yield_curr(void);
+void sched_yield_to_hint(struct task *ti);
 
 struct process *task_get_pi_opaque(struct task *ti);
 void process_set_tty(struct process *pi, void *t);
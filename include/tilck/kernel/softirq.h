@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/worker_thread.h>
+
+/*
+ * Soft IRQs: bottom halves identified by a pending bit, instead of a job per
+ * interrupt. Raising an already pending soft IRQ does nothing, so a burst of
+ * interrupts gets coalesced into a single run of its handler.
+ *
+ * All the soft IRQs run in a dedicated worker thread, with preemption
+ * disabled: handlers must never sleep. Each run, a handler is expected to
+ * process at most `budget` units of work (bytes, scancodes, etc.) and to
+ * return true if there's still work to do. In that case, it will run again
+ * after the other pending soft IRQs got their turn.
+ *
+ * The work needing preemption enabled can be deferred with
+ * softirq_queue_work(): the work item runs in the same worker thread, so it
+ * must never wait for other threads (e.g. for the reader of a full buffer).
+ * Meanwhile, no soft IRQ would run, including the timer.
+ */
+
+typedef bool (*softirq_func_t)(void *ctx, u32 budget);
+
+struct softirq_stats {
+
+   u32 raised;          /* calls to softirq_raise() */
+   u32 coalesced;       /* raises while already pending */
+   u32 runs;            /* calls of the handler */
+   u32 over_budget;     /* runs that left some work to do */
+};
+
+int softirq_register(const char *name,
+                     softirq_func_t func,
+                     void *ctx,
+                     u32 budget);
+
+void softirq_unregister(int nr);
+void softirq_raise(int nr);
+bool softirq_queue_work(struct wth_work *w);
+const char *softirq_get_name(int nr);
+bool softirq_get_stats(int nr, struct softirq_stats *stats);
+void init_softirqs(void);
@@ -26,6 +26,18 @@ enum wo_type {
 #define WEXTRA_TASK_STOPPED      1
 #define WEXTRA_TASK_CONTINUED    2
 
+/* wait_obj flags */
+#define WOBJ_FL_NON_EXCL         (1 << 0)  /* always woken up by signal_one */
+
+/*
+ * Wake-up keys: a kcond waiter can specify the events it's interested in and
+ * gets woken up only by signals having at least one of those keys.
+ */
+#define KCOND_KEY_READ           (1 << 0)
+#define KCOND_KEY_WRITE          (1 << 1)
+#define KCOND_KEY_HUP            (1 << 2)
+#define KCOND_KEY_ANY            0xff
+
 /*
  * wait_obj is used internally in struct task for referring to an object that
  * is blocking that task (keeping it in a sleep state).
@@ -39,6 +51,8 @@ struct wait_obj {
    };
 
    u16 extra;                        /* extra info about the waiting reason  */
+   u8 flags;                         /* WOBJ_FL_* flags                      */
+   u8 keys;                          /* KCOND_KEY_* keys, for kcond waiters  */
    enum wo_type type;                /* type of the object we're waiting for */
    struct list_node wait_list_node;  /* node in waited object's waiting list */
 };
@@ -75,6 +89,13 @@ void wait_obj_set(struct wait_obj *wo,
                   void *ptr_or_data,
                   struct list *wait_list);
 
+void wait_obj_set_ex(struct wait_obj *wo,
+                     enum wo_type type,
+                     void *ptr_or_data,
+                     struct list *wait_list,
+                     u8 flags,
+                     u8 keys);
+
 void *wait_obj_reset(struct wait_obj *wo);
 
 static ALWAYS_INLINE void *
@@ -95,6 +116,13 @@ void task_set_wait_obj(struct task *ti,
                        u16 extra,
                        struct list *wait_list);
 
+void task_set_wait_obj_keys(struct task *ti,
+                            enum wo_type type,
+                            void *ptr_or_data,
+                            u16 extra,
+                            struct list *wait_list,
+                            u8 keys);
+
 void *task_reset_wait_obj(struct task *ti);
 
 struct multi_obj_waiter *allocate_mobj_waiter(u32 elems);
@@ -107,6 +135,12 @@ void mobj_waiter_set(struct multi_obj_waiter *w,
                      void *ptr,
                      struct list *wait_list);
 
+void mobj_waiter_set_key(struct multi_obj_waiter *w,
+                         u32 index,
+                         void *ptr,
+                         struct list *wait_list,
+                         u8 keys);
+
 void kernel_sleep_on_waiter(struct multi_obj_waiter *w);
 
 /*
@@ -150,13 +184,19 @@ struct kmutex {
 #define STATIC_KMUTEX_INIT(m, fl)                 \
    {                                              \
       .owner_task = NULL,                         \
-      .flags = 0,                                 \
+      .flags = (fl),                              \
       .lock_count = 0,                            \
       .wait_list = make_list(m.wait_list),        \
    }
 
 #define KMUTEX_FL_RECURSIVE                                (1 << 0)
 
+/*
+ * Adaptive mutex: when contended, yield the CPU to a preempted owner a few
+ * times before going to sleep. Good for locks with short critical sections.
+ */
+#define KMUTEX_FL_ADAPTIVE                                 (1 << 2)
+
 #if KERNEL_SELFTESTS
 
    /*
@@ -179,6 +219,14 @@ bool kmutex_is_curr_task_holding_lock(struct kmutex *m);
 
 /*
  * A basic implementation of condition variables similar to the pthread ones.
+ *
+ * Waiters are either exclusive (tasks blocked in kcond_wait()) or not
+ * (multi_obj_waiter elements, used by poll() and select()). A signal wakes
+ * up all the non-exclusive waiters, but just one exclusive waiter, unless it
+ * is a broadcast. Each waiter has also a set of keys (KCOND_KEY_*): signals
+ * with a key skip the waiters not interested in it. That allows N tasks to
+ * block on the same object without all of them waking up to fight for a
+ * single byte of data.
  */
 
 struct kcond {
@@ -195,17 +243,33 @@ struct kcond {
 
 void kcond_init(struct kcond *c);
 void kcond_destory(struct kcond *c);
-void kcond_signal_int(struct kcond *c, bool all);
-bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks);
+void kcond_signal_int(struct kcond *c, u8 key, bool all);
+bool kcond_wait_key(struct kcond *c, struct kmutex *m, u32 timeout, u8 keys);
 bool kcond_is_anyone_waiting(struct kcond *c);
 
+static inline bool
+kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks)
+{
+   return kcond_wait_key(c, m, timeout_ticks, KCOND_KEY_ANY);
+}
+
 static inline void kcond_signal_one(struct kcond *c)
 {
-   kcond_signal_int(c, false);
+   kcond_signal_int(c, KCOND_KEY_ANY, false);
 }
 
 static inline void kcond_signal_all(struct kcond *c)
 {
-   kcond_signal_int(c, true);
+   kcond_signal_int(c, KCOND_KEY_ANY, true);
+}
+
+static inline void kcond_signal_key_one(struct kcond *c, u8 key)
+{
+   kcond_signal_int(c, key, false);
+}
+
+static inline void kcond_signal_key_all(struct kcond *c, u8 key)
+{
+   kcond_signal_int(c, key, true);
 }
 
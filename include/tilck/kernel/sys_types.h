@@ -44,6 +44,48 @@ struct linux_dirent64 {
    char           d_name[]; /* Filename (null-terminated) */
 };
 
+/*
+ * From the man page of statx(). Defined here as `k_statx` in order to avoid
+ * conflicts with the libc headers, which might or might not define it.
+ */
+struct k_statx_timestamp {
+   s64 tv_sec;
+   u32 tv_nsec;
+   s32 __reserved;
+};
+
+struct k_statx {
+   u32 stx_mask;           /* Mask of bits indicating filled fields */
+   u32 stx_blksize;        /* Block size for filesystem I/O */
+   u64 stx_attributes;     /* Extra file attribute indicators */
+   u32 stx_nlink;          /* Number of hard links */
+   u32 stx_uid;            /* User ID of owner */
+   u32 stx_gid;            /* Group ID of owner */
+   u16 stx_mode;           /* File type and mode */
+   u16 __spare0;
+   u64 stx_ino;            /* Inode number */
+   u64 stx_size;           /* Total size in bytes */
+   u64 stx_blocks;         /* Number of 512B blocks allocated */
+   u64 stx_attributes_mask;
+
+   struct k_statx_timestamp stx_atime;    /* Last access */
+   struct k_statx_timestamp stx_btime;    /* Creation */
+   struct k_statx_timestamp stx_ctime;    /* Last status change */
+   struct k_statx_timestamp stx_mtime;    /* Last modification */
+
+   u32 stx_rdev_major;     /* Major ID (if this file represents a device) */
+   u32 stx_rdev_minor;     /* Minor ID (if this file represents a device) */
+   u32 stx_dev_major;      /* Major ID of the device containing the fs */
+   u32 stx_dev_minor;      /* Minor ID of the device containing the fs */
+
+   u64 __spare2[14];
+};
+
+STATIC_ASSERT(sizeof(struct k_statx) == 256);
+
+#define K_STATX_BASIC_STATS                                0x000007ffU
+#define K_STATX__RESERVED                                  0x80000000U
+
 #define K_SIGACTION_MASK_WORDS 2
 
 struct k_sigaction {
@@ -98,6 +140,11 @@ struct k_timespec64 {
    long tv_nsec;
 };
 
+struct k_sched_param {
+
+   int sched_priority;
+};
+
 #ifndef O_DIRECTORY
    #define O_DIRECTORY __O_DIRECTORY
 #endif
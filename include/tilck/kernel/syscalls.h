@@ -78,7 +78,7 @@ int sys_pause(); // TODO: update once signals are implemented
 int sys_utime(const char *u_path, const struct utimbuf *u_times);
 int sys_access(const char *u_path, mode_t mode);
 
-CREATE_STUB_SYSCALL_IMPL(sys_nice)
+int sys_nice(int inc);
 
 int sys_sync();
 int sys_kill(int pid, int sig);
@@ -131,8 +131,8 @@ CREATE_STUB_SYSCALL_IMPL(sys_sigpending)
 CREATE_STUB_SYSCALL_IMPL(sys_sethostname)
 CREATE_STUB_SYSCALL_IMPL(sys_setrlimit)
 CREATE_STUB_SYSCALL_IMPL(sys_old_getrlimit)
-CREATE_STUB_SYSCALL_IMPL(sys_getrusage)
 
+int sys_getrusage(int who, struct k_rusage *u_usage);
 int sys_gettimeofday(struct timeval *tv, struct timezone *tz);
 
 CREATE_STUB_SYSCALL_IMPL(sys_settimeofday)
@@ -162,8 +162,8 @@ CREATE_STUB_SYSCALL_IMPL(sys_ftruncate)
 int sys_fchmod(int fd, mode_t mode);
 
 CREATE_STUB_SYSCALL_IMPL(sys_fchown16)
-CREATE_STUB_SYSCALL_IMPL(sys_getpriority)
-CREATE_STUB_SYSCALL_IMPL(sys_setpriority)
+int sys_getpriority(int which, int who);
+int sys_setpriority(int which, int who, int prio);
 CREATE_STUB_SYSCALL_IMPL(sys_statfs)
 CREATE_STUB_SYSCALL_IMPL(sys_fstatfs)
 CREATE_STUB_SYSCALL_IMPL(sys_ioperm)
@@ -190,7 +190,13 @@ CREATE_STUB_SYSCALL_IMPL(sys_ipc)
 int sys_fsync(int fd);
 
 CREATE_STUB_SYSCALL_IMPL(sys_sigreturn)
-CREATE_STUB_SYSCALL_IMPL(sys_clone)
+
+int sys_clone(ulong flags,
+              void *child_stack,
+              int *ptid,
+              void *tls,
+              int *ctid);
+
 CREATE_STUB_SYSCALL_IMPL(sys_setdomainname)
 
 int sys_newuname(struct utsname *buf);
@@ -234,16 +240,18 @@ CREATE_STUB_SYSCALL_IMPL(sys_mlock)
 CREATE_STUB_SYSCALL_IMPL(sys_munlock)
 CREATE_STUB_SYSCALL_IMPL(sys_mlockall)
 CREATE_STUB_SYSCALL_IMPL(sys_munlockall)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_setparam)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_getparam)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_setscheduler)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_getscheduler)
+int sys_sched_setparam(int pid, const struct k_sched_param *param);
+int sys_sched_getparam(int pid, struct k_sched_param *param);
 
-int sys_sched_yield(void);
+int sys_sched_setscheduler(int pid,
+                           int policy,
+                           const struct k_sched_param *param);
 
-CREATE_STUB_SYSCALL_IMPL(sys_sched_get_priority_max)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_set_priority_min)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_rr_get_interval_time32)
+int sys_sched_getscheduler(int pid);
+int sys_sched_yield(void);
+int sys_sched_get_priority_max(int policy);
+int sys_sched_get_priority_min(int policy);
+int sys_sched_rr_get_interval_time32(int pid, struct k_timespec32 *tp);
 
 int sys_nanosleep_time32(const struct k_timespec32 *req,
                          struct k_timespec32 *rem);
@@ -277,8 +285,10 @@ CREATE_STUB_SYSCALL_IMPL(sys_rt_sigpending)
 CREATE_STUB_SYSCALL_IMPL(sys_rt_sigtimedwait_time32)
 CREATE_STUB_SYSCALL_IMPL(sys_rt_sigqueueinfo)
 CREATE_STUB_SYSCALL_IMPL(sys_rt_sigsuspend)
-CREATE_STUB_SYSCALL_IMPL(sys_pread64)
-CREATE_STUB_SYSCALL_IMPL(sys_pwrite64)
+
+int sys_pread64(int fd, void *buf, size_t count, s64 off);
+int sys_pwrite64(int fd, const void *buf, size_t count, s64 off);
+
 CREATE_STUB_SYSCALL_IMPL(sys_chown16)
 
 int sys_getcwd(char *buf, size_t size);
@@ -333,7 +343,7 @@ int sys_getdents64(int fd, struct linux_dirent64 *dirp, u32 buf_size);
 int sys_fcntl64(int fd, int cmd, int arg);
 int sys_gettid();
 
-CREATE_STUB_SYSCALL_IMPL(sys_readahead)
+int sys_readahead(int fd, s64 off, size_t count);
 CREATE_STUB_SYSCALL_IMPL(sys_setxattr)
 CREATE_STUB_SYSCALL_IMPL(sys_lsetxattr)
 CREATE_STUB_SYSCALL_IMPL(sys_fsetxattr)
@@ -362,7 +372,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_io_destroy)
 CREATE_STUB_SYSCALL_IMPL(sys_io_getevents)
 CREATE_STUB_SYSCALL_IMPL(sys_io_submit)
 CREATE_STUB_SYSCALL_IMPL(sys_io_cancel)
-CREATE_STUB_SYSCALL_IMPL(sys_fadvise64)
+int sys_fadvise64(int fd, s64 off, size_t len, int advice);
 
 NORETURN int sys_exit_group(int status);
 
@@ -392,7 +402,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_fstatfs64)
 int sys_tgkill(int pid /* linux: tgid */, int tid, int sig);
 int sys_utimes(const char *u_path, const struct timeval u_times[2]);
 
-CREATE_STUB_SYSCALL_IMPL(sys_fadvise64_64)
+int sys_fadvise64_64(int fd, s64 off, s64 len, int advice);
 CREATE_STUB_SYSCALL_IMPL(sys_mbind)
 CREATE_STUB_SYSCALL_IMPL(sys_get_mempolicy)
 CREATE_STUB_SYSCALL_IMPL(sys_set_mempolicy)
@@ -421,7 +431,10 @@ CREATE_STUB_SYSCALL_IMPL(sys_fchownat)
 int sys_futimesat(int dirfd, const char *u_path,
                   const struct timeval times[2]);
 
-CREATE_STUB_SYSCALL_IMPL(sys_fstatat64)
+int sys_fstatat64(int dirfd,
+                  const char *u_path,
+                  struct stat64 *u_st,
+                  int flags);
 CREATE_STUB_SYSCALL_IMPL(sys_unlinkat)
 CREATE_STUB_SYSCALL_IMPL(sys_renameat)
 CREATE_STUB_SYSCALL_IMPL(sys_linkat)
@@ -459,8 +472,13 @@ CREATE_STUB_SYSCALL_IMPL(sys_dup3)
 int sys_pipe2(int u_pipefd[2], int flags);
 
 CREATE_STUB_SYSCALL_IMPL(sys_inotify_init1)
-CREATE_STUB_SYSCALL_IMPL(sys_preadv)
-CREATE_STUB_SYSCALL_IMPL(sys_pwritev)
+
+int sys_preadv(int fd, const struct iovec *iov, int iovcnt,
+               ulong pos_low, ulong pos_high);
+
+int sys_pwritev(int fd, const struct iovec *iov, int iovcnt,
+                ulong pos_low, ulong pos_high);
+
 CREATE_STUB_SYSCALL_IMPL(sys_rt_tgsigqueueinfo)
 CREATE_STUB_SYSCALL_IMPL(sys_perf_event_open)
 CREATE_STUB_SYSCALL_IMPL(sys_recvmmsg_time32)
@@ -505,12 +523,21 @@ CREATE_STUB_SYSCALL_IMPL(sys_userfaultfd)
 CREATE_STUB_SYSCALL_IMPL(sys_membarrier)
 CREATE_STUB_SYSCALL_IMPL(sys_mlock2)
 CREATE_STUB_SYSCALL_IMPL(sys_copy_file_range)
-CREATE_STUB_SYSCALL_IMPL(sys_preadv2)
-CREATE_STUB_SYSCALL_IMPL(sys_pwritev2)
+
+int sys_preadv2(int fd, const struct iovec *iov, int iovcnt,
+                ulong pos_low, ulong pos_high, int flags);
+
+int sys_pwritev2(int fd, const struct iovec *iov, int iovcnt,
+                 ulong pos_low, ulong pos_high, int flags);
+
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_mprotect)
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_alloc)
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_free)
-CREATE_STUB_SYSCALL_IMPL(sys_statx)
+int sys_statx(int dirfd,
+              const char *u_path,
+              int flags,
+              u32 mask,
+              struct k_statx *u_statxbuf);
 CREATE_STUB_SYSCALL_IMPL(sys_arch_prctl)
 CREATE_STUB_SYSCALL_IMPL(sys_io_pgetevents_time32)
 CREATE_STUB_SYSCALL_IMPL(sys_rseq)
@@ -548,7 +575,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_mq_timedreceive)
 CREATE_STUB_SYSCALL_IMPL(sys_semtimedop)
 CREATE_STUB_SYSCALL_IMPL(sys_rt_sigtimedwait)
 CREATE_STUB_SYSCALL_IMPL(sys_futex)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_rr_get_interval)
+int sys_sched_rr_get_interval(int pid, struct k_timespec64 *tp);
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_send_signal)
 CREATE_STUB_SYSCALL_IMPL(sys_io_uring_setup)
 CREATE_STUB_SYSCALL_IMPL(sys_io_uring_enter)
@@ -563,3 +590,4 @@ CREATE_STUB_SYSCALL_IMPL(sys_pidfd_open)
 CREATE_STUB_SYSCALL_IMPL(sys_clone3)
 
 int sys_tilck_cmd(int cmd_n, ulong a1, ulong a2, ulong a3, ulong a4);
+int sys_tilck_getdents_stat(int fd, struct tilck_dirent_stat *u_dirp, u32 bs);
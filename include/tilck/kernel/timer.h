@@ -5,4 +5,5 @@
 #include <tilck/kernel/hal_types.h>
 
 u64 get_ticks(void);
+u32 timer_add_pending_ticks(u32 ticks);
 void init_timer(void);
@@ -2,6 +2,32 @@
 
 #pragma once
 #include <tilck/common/basic_defs.h>
+#include <tilck/kernel/list.h>
+
+/*
+ * Work items: deferred work embedded in the objects of the caller. Unlike the
+ * jobs, work items are queued in intrusive lists: queueing never fails and
+ * never allocates, so it's safe in IRQ context as well.
+ *
+ * Queueing an item that's still pending does nothing: the item itself is the
+ * coalescing key and its function will run just once. The pending state is
+ * cleared right before running the function, so an item can be queued again
+ * while it runs (e.g. to handle the events arrived in the meanwhile).
+ */
+
+#define WTH_WORK_IDLE                                  0
+#define WTH_WORK_DELAYED                               1
+#define WTH_WORK_QUEUED                                2
+
+struct wth_work {
+
+   struct list_node node;
+   void (*func)(void *);
+   void *arg;
+   u32 delay;              /* ticks left, for delayed items */
+   s16 wth;                /* target worker thread */
+   u8 state;               /* WTH_WORK_* */
+};
 
 void init_worker_threads();
 struct task *wth_get_task(int wth);
@@ -9,3 +35,14 @@ struct task *wth_get_runnable_thread(void);
 int wth_create_thread(int priority, u16 queue_size);
 u32 wth_get_queue_size(int wth);
 NODISCARD bool wth_enqueue_job(int wth, void (*func)(void *), void *arg);
+
+void wth_work_init(struct wth_work *w, void (*func)(void *), void *arg);
+bool wth_queue_work(int wth, struct wth_work *w);
+bool wth_queue_delayed_work(int wth, struct wth_work *w, u32 ticks);
+bool wth_cancel_work(struct wth_work *w);
+bool wth_is_work_pending(struct wth_work *w);
+
+/* Used by the timer */
+bool wth_any_delayed_work(void);
+void wth_tick_delayed_works(u32 ticks);
+void wth_check_long_jobs(void);
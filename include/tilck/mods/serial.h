@@ -4,6 +4,9 @@
 #include <tilck/common/basic_defs.h>
 
 void init_serial_port(u16 port);
+bool serial_is_present(u16 port);
+u32 serial_get_tx_fifo_size(u16 port);
+void serial_enable_tx_intr(u16 port, bool enable);
 
 bool serial_read_ready(u16 port);
 void serial_wait_for_read(u16 port);
@@ -12,5 +15,7 @@ char serial_read(u16 port);
 bool serial_write_ready(u16 port);
 void serial_wait_for_write(u16 port);
 void serial_write(u16 port, char c);
+void serial_write_nowait(u16 port, char c);
+void serial_write_buf(u16 port, const char *buf, size_t len);
 
 void early_init_serial_ports(void);
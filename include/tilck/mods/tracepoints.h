@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck_gen_headers/config_modules.h>
+#include <tilck/common/basic_defs.h>
+
+/*
+ * Static tracepoints in the hot paths of the kernel (scheduler, page faults,
+ * IRQs, kmalloc etc.), emitting events in the trace buffer of the tracing
+ * module, along with the syscall events.
+ *
+ * On i386, each tracepoint site is just a 5-byte NOP, recorded in the
+ * `.tp_sites` section: enabling a tracepoint means hot-patching all of its
+ * sites with a JMP to the slow path, which calls trace_tracepoint_int().
+ * Therefore, the cost of disabled tracepoints is close to zero. In the unit
+ * tests, where the kernel code cannot be patched, tracepoints just check the
+ * `enabled` flag instead.
+ */
+
+enum tp_id {
+
+   tp_sched_switch,  /* prev tid, next tid, prev task state */
+   tp_page_fault,    /* vaddr, eip, err_code */
+   tp_cow,           /* vaddr, 1 if the page has been copied, 0 otherwise */
+   tp_irq,           /* irq, handled (bool), cycles spent in the handlers */
+   tp_wth_job,       /* worker thread, func, arg, success (bool) */
+   tp_kmalloc,       /* size, returned ptr, flags */
+
+   /* Number of elements in the enum */
+   TP_COUNT,
+};
+
+struct tracepoint {
+   const char *name;
+   bool enabled;
+};
+
+/* A tracepoint site in the kernel's code (see tp_static_branch below) */
+struct tp_site {
+   u32 code;         /* address of the 5-byte NOP */
+   u32 target;       /* address of the tracepoint's slow path */
+   u32 id;           /* enum tp_id */
+};
+
+extern struct tracepoint __tracepoints[TP_COUNT];
+
+void
+trace_tracepoint_int(enum tp_id id, ulong a1, ulong a2, ulong a3, ulong a4);
+
+int
+tracepoint_set_enabled(enum tp_id id, bool enabled);
+
+int
+get_enabled_tracepoints_count(void);
+
+void
+get_enabled_tracepoints_str(char *buf, size_t len);
+
+int
+set_enabled_tracepoints(const char *str);
+
+#if defined(__i386__) && !defined(UNIT_TEST_ENVIRONMENT)
+
+   #define TP_NOP5     ".byte 0x0f, 0x1f, 0x44, 0x00, 0x00\n\t"
+
+   #define tp_static_branch(id)                                              \
+      ({                                                                     \
+         __label__ l_on, l_out;                                              \
+         bool __tp_on = false;                                               \
+         asm goto("1: " TP_NOP5                                              \
+                  ".pushsection .tp_sites, \"aw\"\n\t"                       \
+                  ".long 1b, %l[l_on], %c0\n\t"                              \
+                  ".popsection\n\t"                                          \
+                  : /* no outputs */                                         \
+                  : "i" (id)                                                 \
+                  : /* no clobbers */                                        \
+                  : l_on);                                                   \
+         goto l_out;                                                         \
+      l_on:                                                                  \
+         __tp_on = true;                                                     \
+      l_out:                                                                 \
+         __tp_on;                                                            \
+      })
+
+#else
+
+   #define tp_static_branch(id)     UNLIKELY(__tracepoints[id].enabled)
+
+#endif
+
+#if MOD_tracing
+
+   #define tp_enabled(id)           tp_static_branch(id)
+
+#else
+
+   #define tp_enabled(id)           false
+
+#endif
+
+#define trace_tp(id, a1, a2, a3, a4)                                         \
+   do {                                                                      \
+      if (tp_enabled(id)) {                                                  \
+         trace_tracepoint_int(id,                                            \
+                              (ulong)(a1),                                   \
+                              (ulong)(a2),                                   \
+                              (ulong)(a3),                                   \
+                              (ulong)(a4));                                  \
+      }                                                                      \
+   } while (0)
+
+#define trace_sched_switch(prev, next, prev_state)                           \
+   trace_tp(tp_sched_switch, prev, next, prev_state, 0)
+
+#define trace_page_fault(vaddr, eip, err_code)                               \
+   trace_tp(tp_page_fault, vaddr, eip, err_code, 0)
+
+#define trace_cow(vaddr, copied)                                             \
+   trace_tp(tp_cow, vaddr, copied, 0, 0)
+
+#define trace_irq(irq, handled, cycles)                                      \
+   trace_tp(tp_irq, irq, handled, cycles, 0)
+
+#define trace_wth_job(wth, func, arg, success)                               \
+   trace_tp(tp_wth_job, wth, func, arg, success)
+
+#define trace_kmalloc(size, ptr, flags)                                      \
+   trace_tp(tp_kmalloc, size, ptr, flags, 0)
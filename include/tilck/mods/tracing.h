@@ -2,7 +2,9 @@
 
 #pragma once
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/atomics.h>
 #include <tilck/kernel/syscalls.h>
+#include <tilck/mods/tracepoints.h>
 
 #define INVALID_SYSCALL           ((u32) -1)
 #define NO_SLOT                           -1
@@ -12,8 +14,21 @@ enum trace_event_type {
    te_invalid,
    te_sys_enter,
    te_sys_exit,
+
+   /* Static tracepoints: same order as in enum tp_id */
+   te_sched_switch,
+   te_page_fault,
+   te_cow,
+   te_irq,
+   te_wth_job,
+   te_kmalloc,
 };
 
+#define TE_FIRST_TP                                       te_sched_switch
+
+STATIC_ASSERT(te_kmalloc - TE_FIRST_TP == tp_kmalloc);
+STATIC_ASSERT(te_kmalloc - TE_FIRST_TP == TP_COUNT - 1);
+
 struct trace_event {
 
    enum trace_event_type type;
@@ -44,6 +59,59 @@ struct trace_event {
 
 STATIC_ASSERT(sizeof(struct trace_event) <= 256);
 
+/*
+ * Binary format of the records in the trace buffer, which is also the format
+ * exported as-is by /dev/trace. Each record is a struct trace_rec followed by
+ * `n_params` saved parameters, each one encoded as:
+ *
+ *    [u8 param index] [u8 len] [`len` bytes of data]
+ *
+ * where the data is the content of the param's slot in struct trace_event,
+ * without the trailing zero bytes. Records are aligned at TRACE_REC_ALIGN
+ * bytes and `h.size` is their full size, padding included. Syscalls without
+ * saved parameters, like getpid(), produce just the header (48 bytes on i386)
+ * instead of a whole 256-byte struct trace_event.
+ */
+
+#define TRACE_REC_ALIGN                                     8
+#define TRACE_REC_MAX_SIZE                                320
+#define TRACE_REC_PAD                                    0xff  /* rec type */
+
+struct trace_rec_hdr {
+
+   u16 size;               /* full size of the record, padding included */
+   u8 type;                /* enum trace_event_type or TRACE_REC_PAD */
+   u8 flags;               /* internal use only, always 0 in /dev/trace */
+};
+
+struct trace_rec {
+
+   union {
+      struct trace_rec_hdr h;
+      ATOMIC(u32) __hdr;   /* written last, in order to commit the record */
+   };
+
+   u16 sys;
+   u8 n_params;            /* number of saved params after the header */
+   u8 unused;
+   int tid;
+   long retval;
+   u64 sys_time;
+   ulong args[6];
+   u8 params[];
+};
+
+STATIC_ASSERT(sizeof(struct trace_rec_hdr) == sizeof(u32));
+STATIC_ASSERT((sizeof(struct trace_rec) % TRACE_REC_ALIGN) == 0);
+STATIC_ASSERT(
+   sizeof(struct trace_rec) + 6 * 2 + sizeof(((struct trace_event *)0)->fmt0)
+      <= TRACE_REC_MAX_SIZE
+);
+STATIC_ASSERT(
+   sizeof(struct trace_rec) + 6 * 2 + sizeof(((struct trace_event *)0)->fmt1)
+      <= TRACE_REC_MAX_SIZE
+);
+
 enum sys_param_ui_type {
 
    ui_type_other,
@@ -186,6 +254,25 @@ set_traced_syscalls(const char *str);
 int
 tracing_get_in_buffer_events_count(void);
 
+u32
+tracing_get_lost_events_count(void);
+
+void
+init_tracing_ring(void);
+
+void
+tracing_write_event(struct trace_event *e);
+
+void
+tracing_write_tp_event(enum trace_event_type type,
+                       ulong a1,
+                       ulong a2,
+                       ulong a3,
+                       ulong a4);
+
+void
+init_tracepoints(void);
+
 extern const struct syscall_info *tracing_metadata;
 extern const struct sys_param_type ptype_int;
 extern const struct sys_param_type ptype_voidp;
@@ -214,6 +301,12 @@ tracing_is_enabled_on_sys(u32 sys_n)
    return traced_syscalls[sys_n];
 }
 
+static ALWAYS_INLINE bool
+te_is_syscall(enum trace_event_type t)
+{
+   return t == te_sys_enter || t == te_sys_exit;
+}
+
 static ALWAYS_INLINE bool
 exp_block(const struct syscall_info *si)
 {
@@ -188,7 +188,7 @@ static void *syscalls[MAX_SYSCALLS] =
    [157] = sys_sched_getscheduler,
    [158] = sys_sched_yield,
    [159] = sys_sched_get_priority_max,
-   [160] = sys_sched_set_priority_min,
+   [160] = sys_sched_get_priority_min,
    [161] = sys_sched_rr_get_interval_time32,
    [162] = sys_nanosleep_time32,
    [163] = sys_mremap,
@@ -508,6 +508,7 @@ void handle_syscall(regs_t *r)
 
    set_current_task_in_kernel();
    DEBUG_VALIDATE_STACK_PTR();
+   curr->ru.syscalls++;
    enable_preemption();
    {
       process_signals();
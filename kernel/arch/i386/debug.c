@@ -123,6 +123,8 @@ void debug_qemu_turn_off_machine(void)
    if (!in_hypervisor())
       return;
 
+   /* Don't lose the messages still not written on the console */
+   printk_flush_ringbuf();
    outb(0xf4, 0x00);
 }
 
@@ -9,6 +9,7 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/mods/tracepoints.h>
 
 #include "idt_int.h"
 #include "pic.c.h"
@@ -34,6 +35,7 @@ static struct list irq_handlers_lists[16] = {
    make_list(irq_handlers_lists[15]),
 };
 
+u32 irq_count[256];
 u32 unhandled_irq_count[256];
 u32 spur_irq_count;
 
@@ -51,6 +53,27 @@ void irq_install_handler(u8 irq, struct irq_handler_node *n)
    irq_clear_mask(irq);
 }
 
+/* Returns the handler of the first node installed for `irq`, if any */
+irq_handler_t irq_get_handler(int irq)
+{
+   struct irq_handler_node *n = NULL;
+   ulong var;
+
+   if (irq < 0 || irq >= (int)ARRAY_SIZE(irq_handlers_lists))
+      return NULL;
+
+   disable_interrupts(&var);
+   {
+      if (!list_is_empty(&irq_handlers_lists[irq])) {
+         n = list_first_obj(&irq_handlers_lists[irq],
+                            struct irq_handler_node,
+                            node);
+      }
+   }
+   enable_interrupts(&var);
+   return n ? n->handler : NULL;
+}
+
 /* This clears the handler for a given IRQ */
 void irq_uninstall_handler(u8 irq, struct irq_handler_node *n)
 {
@@ -198,10 +221,12 @@ void arch_irq_handling(regs_t *r)
 {
    enum irq_action hret = IRQ_UNHANDLED;
    const int irq = r->int_num - 32;
+   u64 start = 0;
 
    if (is_spur_irq(irq))
       return;
 
+   irq_count[irq]++;
    handle_irq_set_mask(irq);
    push_nested_interrupt(r->int_num);
    ASSERT(!are_interrupts_enabled());
@@ -213,6 +238,10 @@ void arch_irq_handling(regs_t *r)
     * otherwise we'll start getting a lot of spurious interrupts!
     */
    pic_send_eoi(irq);
+
+   if (tp_enabled(tp_irq))
+      start = RDTSC();
+
    enable_interrupts_forced();
 
    {
@@ -230,6 +259,8 @@ void arch_irq_handling(regs_t *r)
    if (hret == IRQ_UNHANDLED)
       unhandled_irq_count[irq]++;
 
+   trace_irq(irq, hret != IRQ_UNHANDLED, start ? RDTSC() - start : 0);
+
    pop_nested_interrupt();
    handle_irq_clear_mask(irq);
 
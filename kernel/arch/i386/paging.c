@@ -16,7 +16,9 @@
 #include <tilck/kernel/system_mmap.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/signal.h>
+#include <tilck/kernel/process.h>
 #include <tilck/kernel/process_mm.h>
+#include <tilck/mods/tracepoints.h>
 
 #include "paging_int.h"
 
@@ -158,6 +160,8 @@ bool handle_potential_cow(void *context)
       pt->pages[pt_index].rw = true;
       pt->pages[pt_index].avail = 0;
       invalidate_page_hw(vaddr);
+      get_curr_proc()->faults_cnt++;
+      trace_cow(vaddr, false);
       return true;
    }
 
@@ -189,6 +193,8 @@ bool handle_potential_cow(void *context)
 
    // Copy back the page.
    memcpy32(page_vaddr, page_size_buf, PAGE_SIZE / 4);
+   get_curr_proc()->faults_cnt++;
+   trace_cow(vaddr, true);
    return true;
 }
 
@@ -215,6 +221,8 @@ void handle_page_fault_int(regs_t *r)
    int sig = SIGSEGV;
    struct user_mapping *um;
 
+   trace_page_fault(vaddr, r->eip, r->err_code);
+
    if (!us) {
       /*
        * Tilck does not support kernel-space page faults caused by the kernel,
@@ -235,8 +243,10 @@ void handle_page_fault_int(regs_t *r)
        */
       if (!!(um->prot & PROT_WRITE) || !rw) {
 
-         if (vfs_handle_fault(um->h, (void *)vaddr, p, rw))
+         if (vfs_handle_fault(um->h, (void *)vaddr, p, rw)) {
+            get_curr_proc()->faults_cnt++;
             return;
+         }
 
          sig = SIGBUS;
       }
@@ -813,6 +823,41 @@ void pdir_destroy(pdir_t *pdir)
 }
 
 
+void pdir_for_each_user_page(pdir_t *pdir, user_page_cb cb, void *arg)
+{
+   const ulong zero_paddr = KERNEL_VA_TO_PA(&zero_page);
+   struct user_page_info info;
+
+   ASSERT(!is_preemption_enabled());
+
+   for (u32 i = 0; i < KERNEL_BASE_PD_IDX; i++) {
+
+      if (!pdir->entries[i].present)
+         continue;
+
+      page_table_t *pt = pdir_get_page_table(pdir, i);
+
+      for (u32 j = 0; j < 1024; j++) {
+
+         const union x86_page p = pt->pages[j];
+         const ulong paddr = (ulong)p.pageAddr << PAGE_SHIFT;
+
+         if (!p.present)
+            continue;
+
+         info = (struct user_page_info) {
+            .vaddr = (i << BIG_PAGE_SHIFT) | (j << PAGE_SHIFT),
+            .ref_count = pf_ref_count_get(paddr),
+            .rw = p.rw || (p.avail & PAGE_COW_ORIG_RW),
+            .shared = !!(p.avail & PAGE_SHARED),
+            .zero = paddr == zero_paddr,
+         };
+
+         cb(&info, arg);
+      }
+   }
+}
+
 void map_4mb_page_int(pdir_t *pdir,
                       void *vaddrp,
                       ulong paddr,
@@ -16,6 +16,7 @@
 #include <tilck/kernel/syscalls.h>
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/irq.h>
+#include <tilck/mods/tracepoints.h>
 
 #include "gdt_int.h"
 
@@ -284,11 +285,14 @@ setup_first_process(pdir_t *pdir, struct task **ti_ref)
       return -ENOMEM;
 
    pi = ti->pi;
-   pi->pgid = 1;
-   pi->sid = 1;
    pi->umask = 0022;
    ti->state = TASK_STATE_RUNNING;
    add_task(ti);
+
+   /* Move init from the kernel's process group to its own session */
+   if (sched_new_session(pi) < 0)
+      panic("Unable to create the session of init");
+
    memcpy(pi->str_cwd, "/", 2);
    *ti_ref = ti;
    return 0;
@@ -463,6 +467,9 @@ NORETURN void switch_to_task(struct task *ti)
     */
    ASSERT(state->eflags & EFLAGS_IF);
 
+   trace_sched_switch(curr->tid, ti->tid, curr->state);
+   sched_account_switch(curr, ti);
+
    /* Do as much as possible work before disabling the interrupts */
    task_change_state(ti, TASK_STATE_RUNNING);
    ti->ticks.timeslice = 0;
@@ -14,6 +14,7 @@ void (*self_test_to_run)(void);
 int kopt_tty_count = TTY_COUNT;
 bool kopt_serial_console;
 bool kopt_sched_alive_thread;
+bool kopt_rw_initrd;
 
 /* static variables */
 
@@ -101,6 +102,11 @@ parse_arg_state_initial(int arg_num, const char *arg, size_t arg_len)
       return;
    }
 
+   if (!strcmp(arg, "-rw_initrd")) {
+      kopt_rw_initrd = true;
+      return;
+   }
+
    if (!strcmp(arg, "-tty_count")) {
       kernel_arg_parser_state = SET_TTY_COUNT;
       return;
@@ -54,8 +54,11 @@ static int fork_dup_all_handles(struct process *pi)
    return 0;
 }
 
-// Returns child's pid
-int do_fork(bool vfork)
+/*
+ * Returns child's pid. When `child_stack` is not NULL, the child starts
+ * running in user space with that stack pointer: that's used by clone().
+ */
+int do_fork(bool vfork, void *child_stack)
 {
    int pid;
    int rc = -EAGAIN;
@@ -103,6 +106,9 @@ int do_fork(bool vfork)
    *child->state_regs = *curr->state_regs; // copy parent's regs_t
    set_return_register(child->state_regs, 0);
 
+   if (child_stack)
+      set_user_stack_register(child->state_regs, (ulong)child_stack);
+
    // Make the parent to get child's pid as return value.
    set_return_register(curr->state_regs, (ulong) child->tid);
 
@@ -378,6 +378,7 @@ static int devfs_getdents(fs_handle h, get_dents_func_cb vfs_cb, void *arg)
          .type = dh->dpos->type,
          .name_len = (u8) strlen(dh->dpos->name) + 1,
          .name = dh->dpos->name,
+         .inode = dh->dpos,
       };
 
       if ((rc = vfs_cb(&dent, arg)))
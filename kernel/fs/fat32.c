@@ -9,12 +9,31 @@
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/user.h>
+#include <tilck/kernel/fs/flock.h>
+#include <tilck/kernel/sched.h>
 
 #include <dirent.h> // system header
+#include <fcntl.h>  // system header
 
 int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags);
 int fat_munmap(fs_handle h, void *vaddrp, size_t len);
 int fat_ramdisk_prepare_for_mmap(struct fat_fs_device_data *d, size_t rd_size);
+void fat_ramdisk_set_rw(struct fat_fs_device_data *d, size_t rd_size, bool rw);
+
+/* fat32_rw.c */
+int fat_rw_init(struct fat_fs_device_data *d, size_t rd_size);
+void fat_rw_destroy(struct fat_fs_device_data *d);
+ssize_t fat_write(fs_handle handle, char *buf, size_t len);
+ssize_t fat_pwrite(fs_handle handle, char *buf, size_t len, offt pos);
+int fat_truncate_entry(struct fs *fs, struct fat_entry *e, offt len);
+int fat_mkdir(struct vfs_path *p, mode_t mode);
+
+int
+fat_create_entry(struct fs *fs,
+                 struct fat_entry *dir,
+                 const char *name,
+                 bool is_dir,
+                 struct fat_entry **out);
 
 /*
  * Special fat_walk() wrapper handling the special case where `e` is NOT a dir
@@ -36,33 +55,100 @@ STATIC void
 fat_close(fs_handle handle)
 {
    struct fatfs_handle *h = (struct fatfs_handle *)handle;
+
+   if (h->written)
+      fat_flush(h->fs);
+
    kfree2(h, sizeof(struct fatfs_handle));
 }
 
-STATIC ssize_t
-fat_read(fs_handle handle, char *buf, size_t bufsize)
+/*
+ * Returns the cluster containing the file offset `off` and moves the handle's
+ * cursor there. If `off` is past the end of the cluster chain, leaves the
+ * cursor on the last cluster of the chain and returns 0. Returns 0 also when
+ * the file has no clusters at all: in that case, `h->curr_cluster` is 0.
+ *
+ * The cursor allows sequential reads and writes to walk the chain only once,
+ * instead of walking it from the beginning at every call.
+ */
+u32 fat_get_cluster_for_off(struct fatfs_handle *h, offt off)
 {
-   struct fatfs_handle *h = (struct fatfs_handle *) handle;
    struct fat_fs_device_data *d = h->fs->device_data;
-   offt fsize = (offt)h->e->DIR_FileSize;
-   offt written_to_buf = 0;
+   const offt clu_size = (offt)d->cluster_size;
+   u32 clu, gen;
+   offt clu_off;
+
+   /*
+    * Readers sharing the same handle (e.g. threads using pread() on the same
+    * fd) might update the cursor concurrently: read and store it atomically.
+    */
+   disable_preemption();
+   {
+      clu = h->curr_cluster;
+      clu_off = h->curr_off;
+      gen = h->curr_gen;
+   }
+   enable_preemption();
 
-   if (h->pos >= fsize) {
+   if (!clu || gen != d->chain_gen || off < clu_off) {
 
-      /*
-       * The cursor is at the end or past the end: nothing to read.
-       */
+      /* The cursor is invalid or it's after `off`: start from the beginning */
+      clu = fat_get_first_cluster(h->e);
+      clu_off = 0;
+      gen = d->chain_gen;
+   }
 
-      return 0;
+   while (clu && off >= clu_off + clu_size) {
+
+      const u32 next = fat_read_fat_entry(d->hdr, d->type, 0, clu);
+
+      if (fat_is_end_of_clusterchain(d->type, next))
+         break;
+
+      // we do not expect BAD CLUSTERS
+      ASSERT(!fat_is_bad_cluster(d->type, next));
+
+      clu = next;
+      clu_off += clu_size;
    }
 
-   do {
+   disable_preemption();
+   {
+      h->curr_cluster = clu;
+      h->curr_off = clu_off;
+      h->curr_gen = gen;
+   }
+   enable_preemption();
 
-      char *data = fat_get_pointer_to_cluster_data(d->hdr, h->curr_cluster);
+   if (!clu || off >= clu_off + clu_size)
+      return 0; /* No clusters at all or `off` is past the end of the chain */
+
+   return clu;
+}
 
-      const offt file_rem       = fsize - h->pos;
+/*
+ * Reads up to `bufsize` bytes at the offset `pos`. Does not change the
+ * handle's position.
+ */
+static ssize_t
+fat_read_at_nolock(struct fatfs_handle *h, char *buf, size_t bufsize, offt pos)
+{
+   struct fat_fs_device_data *d = h->fs->device_data;
+   offt fsize = (offt)h->e->DIR_FileSize;
+   offt written_to_buf = 0;
+
+   while (written_to_buf < (offt)bufsize && pos < fsize) {
+
+      const u32 clu = fat_get_cluster_for_off(h, pos);
+
+      if (!clu)
+         break; /* The chain is shorter than the file: corrupted fs */
+
+      char *data = fat_get_pointer_to_cluster_data(d->hdr, clu);
+
+      const offt file_rem       = fsize - pos;
       const offt buf_rem        = (offt)bufsize - written_to_buf;
-      const offt cluster_off    = h->pos % (offt)d->cluster_size;
+      const offt cluster_off    = pos % (offt)d->cluster_size;
       const offt cluster_rem    = (offt)d->cluster_size - cluster_off;
       const offt to_read        = MIN3(cluster_rem, buf_rem, file_rem);
 
@@ -70,96 +156,75 @@ fat_read(fs_handle handle, char *buf, size_t bufsize)
 
       memcpy(buf + written_to_buf, data + cluster_off, (size_t)to_read);
       written_to_buf += to_read;
-      h->pos += to_read;
+      pos += to_read;
+   }
 
-      if (to_read < cluster_rem) {
+   return (ssize_t)written_to_buf;
+}
 
-         /*
-          * We read less than cluster_rem because the buf was not big enough
-          * or because the file was not big enough. In either case, we cannot
-          * continue.
-          */
-         break;
-      }
+static ssize_t
+fat_read_at(struct fatfs_handle *h, char *buf, size_t bufsize, offt pos)
+{
+   struct fat_fs_device_data *d = h->fs->device_data;
+   ssize_t rc;
 
-      // find the next cluster
-      u32 fatval = fat_read_fat_entry(d->hdr, d->type, 0, h->curr_cluster);
+   if (!(h->fs->flags & VFS_FS_RW))
+      return fat_read_at_nolock(h, buf, bufsize, pos);
 
-      if (fat_is_end_of_clusterchain(d->type, fatval)) {
-         ASSERT(h->pos == fsize);
-         break;
-      }
-
-      // we do not expect BAD CLUSTERS
-      ASSERT(!fat_is_bad_cluster(d->type, fatval));
+   rwlock_wp_shlock(&d->data_lock);
+   {
+      rc = fat_read_at_nolock(h, buf, bufsize, pos);
+   }
+   rwlock_wp_shunlock(&d->data_lock);
+   return rc;
+}
 
-      h->curr_cluster = fatval; // go reading the new cluster in the chain.
+STATIC ssize_t
+fat_read(fs_handle handle, char *buf, size_t bufsize)
+{
+   struct fatfs_handle *h = (struct fatfs_handle *) handle;
+   ssize_t rc = fat_read_at(h, buf, bufsize, h->pos);
 
-   } while (true);
+   if (rc > 0)
+      h->pos += rc;
 
-   return (ssize_t)written_to_buf;
+   return rc;
 }
 
-
-STATIC int
-fat_rewind(fs_handle handle)
+STATIC ssize_t
+fat_pread(fs_handle handle, char *buf, size_t bufsize, offt pos)
 {
-   struct fatfs_handle *h = (struct fatfs_handle *) handle;
-   h->pos = 0;
-   h->curr_cluster = fat_get_first_cluster(h->e);
-   return 0;
+   return fat_read_at(handle, buf, bufsize, pos);
 }
 
-STATIC offt
-fat_seek_forward(fs_handle handle, offt dist)
+/*
+ * The FAT ramdisk is entirely in memory and fat_mmap() maps all the clusters
+ * of a file upfront, so there's nothing to read ahead nor any page faults to
+ * save. The only thing that a hint can avoid is the walk of the cluster chain:
+ * on POSIX_FADV_WILLNEED, move the handle's cursor to `off`, so that the next
+ * read at that offset won't need to walk the chain from its beginning.
+ * Sequential accesses don't need any help, because of the cursor.
+ */
+STATIC int
+fat_fadvise(fs_handle handle, offt off, offt len, int advice)
 {
    struct fatfs_handle *h = (struct fatfs_handle *) handle;
    struct fat_fs_device_data *d = h->fs->device_data;
-   offt fsize = (offt)h->e->DIR_FileSize;
-   offt moved_distance = 0;
 
-   if (dist == 0)
-      return h->pos;
+   if (advice != POSIX_FADV_WILLNEED || h->e->directory)
+      return 0;
 
-   if (h->pos + dist > fsize) {
-      /* Allow, like Linux does, to seek past the end of a file. */
-      h->pos += dist;
-      h->curr_cluster = (u32) -1; /* invalid cluster */
-      return (offt) h->pos;
+   if (!(h->fs->flags & VFS_FS_RW)) {
+      fat_get_cluster_for_off(h, off);
+      return 0;
    }
 
-   do {
-
-      const offt file_rem       = fsize - h->pos;
-      const offt dist_rem       = dist - moved_distance;
-      const offt cluster_off    = h->pos % (offt)d->cluster_size;
-      const offt cluster_rem    = (offt)d->cluster_size - cluster_off;
-      const offt to_move        = MIN3(cluster_rem, dist_rem, file_rem);
-
-      ASSERT(to_move >= 0);
-
-      moved_distance += to_move;
-      h->pos += to_move;
-
-      if (to_move < cluster_rem)
-         break;
-
-      // find the next cluster
-      u32 fatval = fat_read_fat_entry(d->hdr, d->type, 0, h->curr_cluster);
-
-      if (fat_is_end_of_clusterchain(d->type, fatval)) {
-         ASSERT(h->pos == fsize);
-         break;
-      }
-
-      // we do not expect BAD CLUSTERS
-      ASSERT(!fat_is_bad_cluster(d->type, fatval));
-
-      h->curr_cluster = fatval; // go reading the new cluster in the chain.
-
-   } while (true);
-
-   return (offt)h->pos;
+   rwlock_wp_shlock(&d->data_lock);
+   {
+      fat_get_cluster_for_off(h, off);
+   }
+   rwlock_wp_shunlock(&d->data_lock);
+   return 0;
 }
 
 struct fat_count_dirents_ctx {
@@ -224,51 +289,34 @@ fat_seek(fs_handle handle, offt off, int whence)
       return fat_seek_dir(fh, off);
    }
 
-   offt curr_pos = fh->pos;
+   /*
+    * NOTE: there's no need to walk the cluster chain here: that's done lazily
+    * by fat_get_cluster_for_off(), on the next read or write. Like Linux, we
+    * allow seeking past the end of a file.
+    */
 
    switch (whence) {
 
       case SEEK_SET:
-
-         if (off < 0)
-            return -EINVAL; /* invalid negative offset */
-
-         fat_rewind(handle);
          break;
 
       case SEEK_END:
-
-         if (off >= 0)
-            break;
-
-         struct fatfs_handle *h = (struct fatfs_handle *) handle;
-         off = (offt) h->e->DIR_FileSize + off;
-
-         if (off < 0)
-            return -EINVAL;
-
-         fat_rewind(handle);
+         off += (offt)fh->e->DIR_FileSize;
          break;
 
       case SEEK_CUR:
-
-         if (off < 0) {
-
-            off = curr_pos + off;
-
-            if (off < 0)
-               return -EINVAL;
-
-            fat_rewind(handle);
-         }
-
+         off += fh->pos;
          break;
 
       default:
          return -EINVAL;
    }
 
-   return fat_seek_forward(handle, off);
+   if (off < 0)
+      return -EINVAL; /* invalid negative offset */
+
+   fh->pos = off;
+   return fh->pos;
 }
 
 struct datetime
@@ -355,15 +403,21 @@ fat_getdents_cb(struct fat_hdr *hdr,
    char short_name[16];
    const char *entname = long_name ? long_name : short_name;
    struct fat_getdents_ctx *ctx = arg;
+   size_t len;
 
    if (entname == short_name)
       fat_get_short_name(entry, short_name);
 
+   len = strlen(entname);
+
    struct vfs_dent64 dent = {
       .ino  = fat_entry_to_inode(hdr, entry),
       .type = entry->directory ? VFS_DIR : VFS_FILE,
-      .name_len = (u8) strlen(entname) + 1,
+      .name_len = (u8) len + 1,
       .name = entname,
+
+      /* "." and ".." are not the real entries of the directories */
+      .inode = is_dot_or_dotdot(entname, (int)len) ? NULL : entry,
    };
 
    return ctx->vfs_cb(&dent, ctx->vfs_ctx);
@@ -402,44 +456,42 @@ static int fat_getdents(fs_handle h, get_dents_func_cb cb, void *arg)
 
 STATIC void fat_exclusive_lock(struct fs *fs)
 {
+   struct fat_fs_device_data *d = fs->device_data;
+
    if (!(fs->flags & VFS_FS_RW))
       return; /* read-only: no lock is needed */
 
-   NOT_IMPLEMENTED();
+   rwlock_wp_exlock(&d->rwlock);
 }
 
 STATIC void fat_exclusive_unlock(struct fs *fs)
 {
+   struct fat_fs_device_data *d = fs->device_data;
+
    if (!(fs->flags & VFS_FS_RW))
       return; /* read-only: no lock is needed */
 
-   NOT_IMPLEMENTED();
+   rwlock_wp_exunlock(&d->rwlock);
 }
 
 STATIC void fat_shared_lock(struct fs *fs)
 {
-   if (!(fs->flags & VFS_FS_RW))
-      return; /* read-only: no lock is needed */
-
-   NOT_IMPLEMENTED();
-}
+   struct fat_fs_device_data *d = fs->device_data;
 
-STATIC void fat_shared_unlock(struct fs *fs)
-{
    if (!(fs->flags & VFS_FS_RW))
       return; /* read-only: no lock is needed */
 
-   NOT_IMPLEMENTED();
+   rwlock_wp_shlock(&d->rwlock);
 }
 
-STATIC ssize_t fat_write(fs_handle h, char *buf, size_t len)
+STATIC void fat_shared_unlock(struct fs *fs)
 {
-   struct fs *fs = get_fs(h);
+   struct fat_fs_device_data *d = fs->device_data;
 
    if (!(fs->flags & VFS_FS_RW))
-      return -EBADF; /* read-only file system: can't write */
+      return; /* read-only: no lock is needed */
 
-   NOT_IMPLEMENTED();
+   rwlock_wp_shunlock(&d->rwlock);
 }
 
 STATIC int fat_ioctl(fs_handle h, ulong request, void *arg)
@@ -452,11 +504,34 @@ static const struct file_ops static_ops_fat =
    .read = fat_read,
    .seek = fat_seek,
    .write = fat_write,
+   .pread = fat_pread,
+   .pwrite = fat_pwrite,
    .ioctl = fat_ioctl,
    .mmap = fat_mmap,
    .munmap = fat_munmap,
+   .fadvise = fat_fadvise,
 };
 
+static int
+fat_open_existing_checks(struct fs *fs, struct fat_entry *e, int fl)
+{
+   if ((fl & O_CREAT) && (fl & O_EXCL))
+      return -EEXIST;
+
+   if (!(fs->flags & VFS_FS_RW))
+      if (fl & (O_WRONLY | O_RDWR))
+         return -EROFS;
+
+   if ((fl & (O_WRONLY | O_RDWR)) && (e->directory || e->volume_id))
+      return -EISDIR;
+
+   /* See ramfs_open_existing_checks() */
+   if ((fl & O_TRUNC) && !(fl & (O_WRONLY | O_RDWR)))
+      return -EINVAL;
+
+   return 0;
+}
+
 STATIC int
 fat_open(struct vfs_path *p, fs_handle *out, int fl, mode_t mode)
 {
@@ -465,30 +540,56 @@ fat_open(struct vfs_path *p, fs_handle *out, int fl, mode_t mode)
    struct fat_fs_path *fp = (struct fat_fs_path *)&p->fs_path;
    struct fat_entry *e = fp->entry;
    struct fat_fs_device_data *d = fs->device_data;
+   struct locked_file *lf = NULL;
+   int rc;
 
    if (!e) {
 
+      if (!(fl & O_CREAT))
+         return -ENOENT;
+
       if (!(fs->flags & VFS_FS_RW))
-         if (fl & O_CREAT)
-            return -EROFS;
+         return -EROFS;
 
-      return -ENOENT;
+      rc = fat_create_entry(fs, fp->parent_entry, p->last_comp, false, &e);
+
+      if (rc)
+         return rc;
+
+   } else {
+
+      if ((rc = fat_open_existing_checks(fs, e, fl)))
+         return rc;
    }
 
-   if ((fl & O_CREAT) && (fl & O_EXCL))
-      return -EEXIST;
+   if (fl & (O_WRONLY | O_RDWR)) {
 
-   if (!(fs->flags & VFS_FS_RW))
-      if (fl & (O_WRONLY | O_RDWR))
-         return -EROFS;
+      if ((rc = acquire_subsys_flock(fs, e, SUBSYS_VFS, &lf)))
+         return rc;
+
+      if (fl & O_TRUNC) {
+         if ((rc = fat_truncate_entry(fs, e, 0))) {
+            release_subsys_flock(lf);
+            return rc;
+         }
+      }
+   }
+
+   if (!(h = kzmalloc(sizeof(struct fatfs_handle)))) {
+
+      if (lf)
+         release_subsys_flock(lf);
 
-   if (!(h = kzmalloc(sizeof(struct fatfs_handle))))
       return -ENOMEM;
+   }
 
    vfs_init_fs_handle_base_fields((void *)h, fs, &static_ops_fat);
    h->e = e;
    h->pos = 0;
+   h->lf = lf;
    h->curr_cluster = fat_get_first_cluster(e);
+   h->curr_off = 0;
+   h->curr_gen = d->chain_gen;
 
    if (d->mmap_support)
       h->spec_flags = VFS_SPFL_MMAP_SUPPORTED;
@@ -582,20 +683,21 @@ static vfs_inode_ptr_t fat_get_inode(fs_handle h)
 
 static int fat_retain_inode(struct fs *fs, vfs_inode_ptr_t inode)
 {
-   if (fs->flags & VFS_FS_RW)
-      NOT_IMPLEMENTED();
-
+   /* FAT entries are never freed: unlink and rmdir are not supported */
    return 1;
 }
 
 static int fat_release_inode(struct fs *fs, vfs_inode_ptr_t inode)
 {
-   if (fs->flags & VFS_FS_RW)
-      NOT_IMPLEMENTED();
-
+   /* FAT entries are never freed: unlink and rmdir are not supported */
    return 1;
 }
 
+static int fat_truncate(struct fs *fs, vfs_inode_ptr_t i, offt len)
+{
+   return fat_truncate_entry(fs, i, len);
+}
+
 static const struct fs_ops static_fsops_fat =
 {
    .get_inode = fat_get_inode,
@@ -604,9 +706,9 @@ static const struct fs_ops static_fsops_fat =
    .dup = fat_dup,
    .getdents = fat_getdents,
    .unlink = NULL,
-   .mkdir = NULL,
+   .mkdir = fat_mkdir,
    .rmdir = NULL,
-   .truncate = NULL,
+   .truncate = fat_truncate,
    .stat = fat_stat,
    .chmod = NULL,
    .get_entry = fat_get_entry,
@@ -626,9 +728,6 @@ struct fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags)
    struct fat_fs_device_data *d;
    struct fs *fs;
 
-   if (flags & VFS_FS_RW)
-      panic("fat_mount_ramdisk: r/w mode is NOT currently supported");
-
    d = kzmalloc(sizeof(struct fat_fs_device_data));
 
    if (!d)
@@ -653,11 +752,32 @@ struct fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags)
    if (!fat_ramdisk_prepare_for_mmap(d, rd_size))
       d->mmap_support = true;
 
+   if (flags & VFS_FS_RW) {
+
+      if (fat_rw_init(d, rd_size)) {
+         destory_fs_obj(fs);
+         kfree2(d, sizeof(struct fat_fs_device_data));
+         return NULL;
+      }
+
+      fat_ramdisk_set_rw(d, rd_size, true);
+   }
+
    return fs;
 }
 
 void fat_umount_ramdisk(struct fs *fs)
 {
-   kfree2(fs->device_data, sizeof(struct fat_fs_device_data));
+   struct fat_fs_device_data *d = fs->device_data;
+
+   if (fs->flags & VFS_FS_RW) {
+      fat_flush(fs);
+      fat_ramdisk_set_rw(d, d->rd_size, false);
+      rwlock_wp_destroy(&d->data_lock);
+      rwlock_wp_destroy(&d->rwlock);
+      fat_rw_destroy(d);
+   }
+
+   kfree2(d, sizeof(struct fat_fs_device_data));
    destory_fs_obj(fs);
 }
@@ -11,6 +11,8 @@
 #include <tilck/kernel/fs/vfs_base.h>
 #include <tilck/kernel/fs/fat32.h>
 
+#include <sys/mman.h>      // system header
+
 int fat_ramdisk_prepare_for_mmap(struct fat_fs_device_data *d, size_t rd_size)
 {
    struct fat_hdr *hdr = d->hdr;
@@ -93,6 +95,20 @@ int fat_ramdisk_prepare_for_mmap(struct fat_fs_device_data *d, size_t rd_size)
    return 0;
 }
 
+/*
+ * The ramdisk is mapped read-only in the kernel's address space: in r/w mode,
+ * we have to make its pages writable.
+ */
+void fat_ramdisk_set_rw(struct fat_fs_device_data *d, size_t rd_size, bool rw)
+{
+   pdir_t *const pdir = get_kernel_pdir();
+   char *const va_begin = (char *)d->hdr;
+   char *const va_end = va_begin + rd_size;
+
+   for (char *va = va_begin; va < va_end; va += PAGE_SIZE)
+      set_page_rw(pdir, va, rw);
+}
+
 int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
 {
    struct fatfs_handle *fh = um->h;
@@ -103,6 +119,14 @@ int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    size_t mapped_cnt;
    u32 clu;
 
+   /*
+    * Stores through a mapping would bypass fat_write(): no new clusters, no
+    * file size update, no dirty tracking. Even on r/w mounts, mmap is
+    * read-only.
+    */
+   if (um->prot & PROT_WRITE)
+      return -EACCES;
+
    if (!d->mmap_support)
       return -ENODEV; /* We do NOT support mmap for this "superblock" */
 
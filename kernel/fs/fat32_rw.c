@@ -0,0 +1,949 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/fs/fat32.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/datetime.h>
+
+/*
+ * Write support for FAT ramdisks.
+ *
+ * Everything happens in place, in the memory of the ramdisk: the only thing
+ * deferred is the propagation of the changes in the first FAT to the other
+ * FATs (and to FSInfo), which happens in fat_flush(). See the comments in
+ * struct fat_fs_device_data.
+ *
+ * Locking: the FAT table, the cluster chains and the file sizes are protected
+ * by `data_lock`. Operations changing the directory tree (creat, mkdir) are
+ * protected by the fs lock (held by the VFS) and take `data_lock` as well,
+ * always in that order.
+ *
+ * Limitations: unlink, rmdir and rename are not supported. Also, files can be
+ * created only using long names containing characters valid in short names,
+ * (see fat32_is_valid_filename_character()).
+ */
+
+#define FAT_MAX_FILE_SIZE \
+   ((offt)(sizeof(offt) > 4 ? 0xFFFFFFFFul : 0x7FFFFFFFul))
+#define FAT_ENTRY_AVAILABLE                             0xE5
+#define FAT_LONG_NAME_CHARS_PER_ENTRY                     13
+#define FAT_MAX_LONG_NAME_ENTRIES                         20   /* 255 chars */
+
+u32 fat_get_cluster_for_off(struct fatfs_handle *h, offt off);
+
+static inline u32 fat_get_eoc_value(enum fat_type ft)
+{
+   return ft == fat16_type ? 0xFFFF : 0x0FFFFFFF;
+}
+
+static void
+fat_mark_dirty_ptr(struct fat_fs_device_data *d, void *ptr)
+{
+   const u32 off = (u32)((char *)ptr - (char *)d->hdr);
+   const u32 bps = d->hdr->BPB_BytsPerSec;
+   const u32 data_off = fat_get_first_data_sector(d->hdr) * bps;
+   u32 clu;
+
+   if (off < data_off)
+      return; /* FAT16's root directory: not in a cluster */
+
+   clu = (off - data_off) / d->cluster_size + 2;
+
+   if (!bitmap_test(d->dirty_clusters, clu)) {
+      bitmap_set(d->dirty_clusters, clu);
+      d->dirty_clusters_cnt++;
+   }
+}
+
+static inline void
+fat_mark_cluster_dirty(struct fat_fs_device_data *d, u32 clu)
+{
+   fat_mark_dirty_ptr(d, fat_get_pointer_to_cluster_data(d->hdr, clu));
+}
+
+static void
+fat_set_fat_entry(struct fat_fs_device_data *d, u32 clu, u32 val)
+{
+   const u32 sec = (clu * d->type) / d->hdr->BPB_BytsPerSec;
+
+   fat_write_fat_entry(d->hdr, d->type, 0, clu, val);
+
+   if (!bitmap_test(d->dirty_fat_secs, sec)) {
+      bitmap_set(d->dirty_fat_secs, sec);
+      d->dirty_fat_secs_cnt++;
+   }
+}
+
+static void
+fat_get_curr_fat_datetime(u16 *date, u16 *time)
+{
+   struct datetime dt;
+
+   if (timestamp_to_datetime(get_timestamp(), &dt) || dt.year < 1980) {
+      *date = (1 << 5) | 1;      /* 1980-01-01 */
+      *time = 0;
+      return;
+   }
+
+   *date = (u16)((dt.year - 1980) << 9 | dt.month << 5 | dt.day);
+   *time = (u16)(dt.hour << 11 | dt.min << 5 | dt.sec / 2);
+}
+
+static void
+fat_touch_entry(struct fat_fs_device_data *d, struct fat_entry *e)
+{
+   u16 date, time;
+
+   fat_get_curr_fat_datetime(&date, &time);
+   e->DIR_WrtDate = e->DIR_LstAccDate = date;
+   e->DIR_WrtTime = time;
+   fat_mark_dirty_ptr(d, e);
+}
+
+/*
+ * Allocates a free cluster, marks it as end-of-chain and zeroes its content.
+ * Returns 0 if there are no free clusters.
+ */
+static u32
+fat_alloc_cluster(struct fat_fs_device_data *d)
+{
+   const u32 cnt = d->max_cluster >= 2 ? d->max_cluster - 1 : 0;
+   u32 clu = d->free_clu_hint;
+
+   for (u32 i = 0; i < cnt; i++, clu++) {
+
+      if (clu < 2 || clu > d->max_cluster)
+         clu = 2;
+
+      if (!fat_read_fat_entry(d->hdr, d->type, 0, clu)) {
+
+         fat_set_fat_entry(d, clu, fat_get_eoc_value(d->type));
+         bzero(fat_get_pointer_to_cluster_data(d->hdr, clu), d->cluster_size);
+         fat_mark_cluster_dirty(d, clu);
+         d->free_clu_hint = clu + 1;
+         return clu;
+      }
+   }
+
+   return 0;
+}
+
+static void
+fat_free_chain(struct fat_fs_device_data *d, u32 clu)
+{
+   while (clu) {
+
+      const u32 next = fat_read_fat_entry(d->hdr, d->type, 0, clu);
+
+      ASSERT(!fat_is_bad_cluster(d->type, next));
+      fat_set_fat_entry(d, clu, 0);
+
+      if (clu < d->free_clu_hint)
+         d->free_clu_hint = clu;
+
+      if (fat_is_end_of_clusterchain(d->type, next))
+         break;
+
+      clu = next;
+   }
+}
+
+/*
+ * Appends a new cluster to the chain of the file. Expects the handle's cursor
+ * to be on the last cluster of the chain (fat_get_cluster_for_off() leaves it
+ * there, when it returns 0).
+ */
+static u32
+fat_append_cluster(struct fatfs_handle *h)
+{
+   struct fat_fs_device_data *d = h->fs->device_data;
+   const u32 first_clu = fat_get_first_cluster(h->e);
+   u32 clu;
+
+   if (!(clu = fat_alloc_cluster(d)))
+      return 0;
+
+   if (!first_clu) {
+
+      fat_set_first_cluster(h->e, clu);
+      fat_mark_dirty_ptr(d, h->e);
+
+   } else {
+
+      ASSERT(h->curr_cluster != 0);
+      ASSERT(fat_is_end_of_clusterchain(
+         d->type, fat_read_fat_entry(d->hdr, d->type, 0, h->curr_cluster)
+      ));
+
+      fat_set_fat_entry(d, h->curr_cluster, clu);
+   }
+
+   return clu;
+}
+
+/*
+ * Writes `len` bytes at `pos`, extending the cluster chain if necessary,
+ * but without changing the file size. If `buf` is NULL, writes zeros.
+ * Returns the number of bytes written.
+ */
+static size_t
+fat_write_at(struct fatfs_handle *h, offt pos, const char *buf, size_t len)
+{
+   struct fat_fs_device_data *d = h->fs->device_data;
+   size_t written = 0;
+
+   while (written < len) {
+
+      const u32 clu = fat_get_cluster_for_off(h, pos);
+      size_t clu_off, to_write;
+      char *data;
+
+      if (!clu) {
+
+         if (!fat_append_cluster(h))
+            break; /* No space left */
+
+         continue;
+      }
+
+      clu_off = (size_t)(pos - h->curr_off);
+      to_write = MIN(d->cluster_size - clu_off, len - written);
+      data = (char *)fat_get_pointer_to_cluster_data(d->hdr, clu) + clu_off;
+
+      if (buf)
+         memcpy(data, buf + written, to_write);
+      else
+         bzero(data, to_write);
+
+      fat_mark_cluster_dirty(d, clu);
+      written += to_write;
+      pos += (offt)to_write;
+   }
+
+   return written;
+}
+
+/*
+ * Cuts the cluster chain of `e` after the last cluster needed for `len` bytes
+ * and zeros the data past `len` in that cluster. Does not change the file
+ * size: used by truncate and to drop the clusters appended by a failed write.
+ */
+static void
+fat_shrink_chain(struct fs *fs, struct fat_entry *e, offt len)
+{
+   struct fat_fs_device_data *d = fs->device_data;
+   const offt clu_size = (offt)d->cluster_size;
+
+   /* A temporary handle, used just as a cursor in the cluster chain */
+   struct fatfs_handle h = {
+      .fs = fs,
+      .e = e,
+      .curr_cluster = 0,
+      .curr_gen = d->chain_gen,
+   };
+
+   if (!len) {
+
+      fat_free_chain(d, fat_get_first_cluster(e));
+      fat_set_first_cluster(e, 0);
+      fat_mark_dirty_ptr(d, e);
+
+   } else {
+
+      /* Find the last cluster to keep and cut the chain after it */
+      const u32 last = fat_get_cluster_for_off(&h, len - 1);
+      const u32 next = fat_read_fat_entry(d->hdr, d->type, 0, last);
+      const offt tail_off = len - h.curr_off;
+      char *data = fat_get_pointer_to_cluster_data(d->hdr, last);
+
+      ASSERT(last != 0);
+
+      if (!fat_is_end_of_clusterchain(d->type, next)) {
+         fat_set_fat_entry(d, last, fat_get_eoc_value(d->type));
+         fat_free_chain(d, next);
+      }
+
+      /* Past-EOF data must read as zeros, if the file is extended again */
+      bzero(data + tail_off, (size_t)(clu_size - tail_off));
+      fat_mark_cluster_dirty(d, last);
+   }
+
+   /* Invalidate the cluster cursors of all the handles */
+   d->chain_gen++;
+}
+
+/*
+ * Writes `len` bytes at the offset `pos`, updating the file size. Does not
+ * change the handle's position.
+ */
+static ssize_t
+fat_write_nolock(struct fatfs_handle *h, char *buf, size_t len, offt pos)
+{
+   struct fat_fs_device_data *d = h->fs->device_data;
+   struct fat_entry *e = h->e;
+   const offt fsize = (offt)e->DIR_FileSize;
+   size_t written;
+
+   if (!len)
+      return 0;
+
+   if (pos >= FAT_MAX_FILE_SIZE)
+      return -EFBIG;
+
+   len = (size_t)MIN((offt)len, FAT_MAX_FILE_SIZE - pos);
+
+   if (pos > fsize) {
+
+      /* Writing past the end: fill the gap with zeros */
+      const size_t gap = (size_t)(pos - fsize);
+
+      if (fat_write_at(h, fsize, NULL, gap) != gap) {
+         fat_shrink_chain(h->fs, e, fsize); /* drop the clusters just added */
+         return -ENOSPC;
+      }
+   }
+
+   written = fat_write_at(h, pos, buf, len);
+
+   if (!written) {
+
+      if (pos > fsize)
+         fat_shrink_chain(h->fs, e, fsize); /* drop the gap's clusters */
+
+      return -ENOSPC;
+   }
+
+   pos += (offt)written;
+   h->written = true;
+
+   if (pos > fsize)
+      e->DIR_FileSize = (u32)pos;
+
+   fat_touch_entry(d, e);
+   return (ssize_t)written;
+}
+
+ssize_t fat_write(fs_handle handle, char *buf, size_t len)
+{
+   struct fatfs_handle *h = handle;
+   struct fat_fs_device_data *d = h->fs->device_data;
+   ssize_t rc;
+
+   if (!(h->fs->flags & VFS_FS_RW))
+      return -EBADF; /* read-only file system: can't write */
+
+   rwlock_wp_exlock(&d->data_lock);
+   {
+      if (h->fl_flags & O_APPEND)
+         h->pos = (offt)h->e->DIR_FileSize;
+
+      rc = fat_write_nolock(h, buf, len, h->pos);
+
+      if (rc > 0)
+         h->pos += rc;
+   }
+   rwlock_wp_exunlock(&d->data_lock);
+   return rc;
+}
+
+ssize_t fat_pwrite(fs_handle handle, char *buf, size_t len, offt pos)
+{
+   struct fatfs_handle *h = handle;
+   struct fat_fs_device_data *d = h->fs->device_data;
+   ssize_t rc;
+
+   if (!(h->fs->flags & VFS_FS_RW))
+      return -EBADF; /* read-only file system: can't write */
+
+   rwlock_wp_exlock(&d->data_lock);
+   {
+      /* Like Linux, with O_APPEND pwrite() appends, ignoring `pos` */
+      if (h->fl_flags & O_APPEND)
+         pos = (offt)h->e->DIR_FileSize;
+
+      rc = fat_write_nolock(h, buf, len, pos);
+   }
+   rwlock_wp_exunlock(&d->data_lock);
+   return rc;
+}
+
+static int
+fat_truncate_nolock(struct fs *fs, struct fat_entry *e, offt len)
+{
+   struct fat_fs_device_data *d = fs->device_data;
+   const offt fsize = (offt)e->DIR_FileSize;
+
+   /* A temporary handle, used just as a cursor in the cluster chain */
+   struct fatfs_handle h = {
+      .fs = fs,
+      .e = e,
+      .curr_cluster = 0,
+      .curr_gen = d->chain_gen,
+   };
+
+   if (len < 0)
+      return -EINVAL;
+
+   if (len > FAT_MAX_FILE_SIZE)
+      return -EFBIG;
+
+   if (len > fsize) {
+
+      const size_t gap = (size_t)(len - fsize);
+
+      if (fat_write_at(&h, fsize, NULL, gap) != gap) {
+         fat_shrink_chain(fs, e, fsize); /* drop the clusters just added */
+         return -ENOSPC;
+      }
+
+   } else if (len < fsize) {
+
+      fat_shrink_chain(fs, e, len);
+   }
+
+   e->DIR_FileSize = (u32)len;
+   fat_touch_entry(d, e);
+   return 0;
+}
+
+int fat_truncate_entry(struct fs *fs, struct fat_entry *e, offt len)
+{
+   struct fat_fs_device_data *d = fs->device_data;
+   int rc;
+
+   if (!(fs->flags & VFS_FS_RW))
+      return -EROFS;
+
+   if (e->directory || e->volume_id)
+      return -EISDIR;
+
+   rwlock_wp_exlock(&d->data_lock);
+   {
+      rc = fat_truncate_nolock(fs, e, len);
+   }
+   rwlock_wp_exunlock(&d->data_lock);
+   return rc;
+}
+
+/*
+ * Directory entries creation
+ * -----------------------------
+ */
+
+static inline bool
+fat_is_free_dir_entry(struct fat_entry *e)
+{
+   return !e->DIR_Name[0] || (u8)e->DIR_Name[0] == FAT_ENTRY_AVAILABLE;
+}
+
+static inline u32
+fat_get_dir_cluster(struct fat_fs_device_data *d, struct fat_entry *dir)
+{
+   /* NOTE: for FAT16's root directory, this returns 0 */
+   return dir == d->root_dir_entries
+      ? d->root_cluster
+      : fat_get_first_cluster(dir);
+}
+
+/*
+ * Finds `n` consecutive free entries in the directory, extending it if
+ * necessary. Note: in order to keep this simple, the entries are collected
+ * in the `slots` array, as they can span multiple clusters.
+ */
+static int
+fat_find_free_dir_slots(struct fat_fs_device_data *d,
+                        struct fat_entry *dir,
+                        u32 n,
+                        struct fat_entry **slots)
+{
+   const u32 epc = fat_get_dir_entries_per_cluster(d->hdr);
+   u32 clu = fat_get_dir_cluster(d, dir);
+   u32 found = 0;
+
+   if (!clu) {
+
+      /* FAT16's root directory: fixed number of entries, no cluster chain */
+      struct fat_entry *entries = fat_get_rootdir(d->hdr, d->type, &clu);
+
+      for (u32 i = 0; i < d->hdr->BPB_RootEntCnt && found < n; i++) {
+
+         if (fat_is_free_dir_entry(&entries[i]))
+            slots[found++] = &entries[i];
+         else
+            found = 0;
+      }
+
+      return found == n ? 0 : -ENOSPC;
+   }
+
+   while (true) {
+
+      struct fat_entry *entries = fat_get_pointer_to_cluster_data(d->hdr, clu);
+      u32 next;
+
+      for (u32 i = 0; i < epc && found < n; i++) {
+
+         if (fat_is_free_dir_entry(&entries[i]))
+            slots[found++] = &entries[i];
+         else
+            found = 0;
+      }
+
+      if (found == n)
+         return 0;
+
+      next = fat_read_fat_entry(d->hdr, d->type, 0, clu);
+
+      if (fat_is_end_of_clusterchain(d->type, next)) {
+
+         /* We need one more cluster for the directory */
+         if (!(next = fat_alloc_cluster(d)))
+            return -ENOSPC;
+
+         fat_set_fat_entry(d, clu, next);
+      }
+
+      ASSERT(!fat_is_bad_cluster(d->type, next));
+      clu = next;
+   }
+}
+
+struct fat_short_name_search_ctx {
+   const char *name;    /* 11 chars, NOT null-terminated */
+   bool found;
+};
+
+static int
+fat_short_name_search_cb(struct fat_hdr *hdr,
+                         enum fat_type ft,
+                         struct fat_entry *entry,
+                         const char *long_name,
+                         void *arg)
+{
+   struct fat_short_name_search_ctx *ctx = arg;
+
+   if (!strncmp(entry->DIR_Name, ctx->name, sizeof(entry->DIR_Name))) {
+      ctx->found = true;
+      return 1; /* stop the walk */
+   }
+
+   return 0;
+}
+
+static bool
+fat_short_name_exists(struct fat_fs_device_data *d,
+                      struct fat_entry *dir,
+                      const char *short_name)
+{
+   struct fat_short_name_search_ctx ctx = { .name = short_name };
+   struct fat_walk_static_params walk_params = {
+      .ctx = NULL,
+      .h = d->hdr,
+      .ft = d->type,
+      .cb = &fat_short_name_search_cb,
+      .arg = &ctx,
+   };
+
+   fat_walk(&walk_params, fat_get_dir_cluster(d, dir));
+   return ctx.found;
+}
+
+static char fat_short_name_char(char c)
+{
+   if (isalpha(c))
+      return (char)toupper(c);
+
+   if (c == '+' || c == ',' || c == ';' || c == '=' || c == '[' || c == ']')
+      return '_';
+
+   return c;
+}
+
+/*
+ * Generates an unique short name in the "BASE~N.EXT" form for the given long
+ * name. The short name is always generated in that form, even when the long
+ * name would fit in 8.3, because we always store the long name too.
+ */
+static int
+fat_gen_short_name(struct fat_fs_device_data *d,
+                   struct fat_entry *dir,
+                   const char *name,
+                   size_t name_len,
+                   char *dest)
+{
+   char base[8], ext[3], suffix[16];
+   size_t base_len = 0, ext_len = 0, dot;
+
+   for (dot = name_len; dot > 0; dot--)
+      if (name[dot - 1] == '.')
+         break;
+
+   dot = dot > 1 ? dot - 1 : name_len; /* Ignore the dot in ".name" */
+
+   for (size_t i = 0; i < dot && base_len < sizeof(base); i++)
+      if (name[i] != '.')
+         base[base_len++] = fat_short_name_char(name[i]);
+
+   for (size_t i = dot + 1; i < name_len && ext_len < sizeof(ext); i++)
+      ext[ext_len++] = fat_short_name_char(name[i]);
+
+   if (!base_len)
+      base[base_len++] = '_';
+
+   for (u32 n = 1; n < 100000; n++) {
+
+      size_t slen, blen;
+
+      suffix[0] = '~';
+      itoa32((s32)n, suffix + 1);
+      slen = strlen(suffix);
+      blen = MIN(base_len, 8 - slen);
+
+      memset(dest, ' ', 11);
+      memcpy(dest, base, blen);
+      memcpy(dest + blen, suffix, slen);
+      memcpy(dest + 8, ext, ext_len);
+
+      if (!fat_short_name_exists(d, dir, dest))
+         return 0;
+   }
+
+   return -EEXIST;
+}
+
+static void
+fat_fill_long_entry(struct fat_long_entry *le,
+                    const char *name,
+                    size_t name_len,
+                    u32 ord,
+                    bool last,
+                    u8 checksum)
+{
+   u8 *parts[3] = { le->LDIR_Name1, le->LDIR_Name2, le->LDIR_Name3 };
+   const u32 part_chars[3] = { 5, 6, 2 };
+   size_t ci = (ord - 1) * FAT_LONG_NAME_CHARS_PER_ENTRY;
+
+   bzero(le, sizeof(*le));
+   le->LDIR_Ord = (u8)(ord | (last ? 0x40 : 0));
+   le->LDIR_Attr = 0x0F; /* readonly | hidden | system | volume_id */
+   le->LDIR_Chksum = checksum;
+
+   for (u32 p = 0; p < 3; p++) {
+      for (u32 k = 0; k < part_chars[p]; k++, ci++) {
+
+         /* UCS-2 chars: the name, then a NUL terminator, then 0xFFFF */
+         u16 c = ci < name_len ? (u8)name[ci] : ci == name_len ? 0 : 0xFFFF;
+
+         parts[p][2 * k] = (u8)(c & 0xFF);
+         parts[p][2 * k + 1] = (u8)(c >> 8);
+      }
+   }
+}
+
+static void
+fat_init_dir_cluster(struct fat_fs_device_data *d,
+                     struct fat_entry *dir,
+                     struct fat_entry *e,
+                     u32 clu)
+{
+   struct fat_entry *entries = fat_get_pointer_to_cluster_data(d->hdr, clu);
+   u32 parent_clu = fat_get_dir_cluster(d, dir);
+
+   if (dir == d->root_dir_entries)
+      parent_clu = 0; /* ".." always points to cluster 0 for the root dir */
+
+   entries[0] = *e;
+   memcpy(entries[0].DIR_Name, FAT_DIR_DOT, 11);
+   fat_set_first_cluster(&entries[0], clu);
+
+   entries[1] = *e;
+   memcpy(entries[1].DIR_Name, FAT_DIR_DOT_DOT, 11);
+   fat_set_first_cluster(&entries[1], parent_clu);
+
+   fat_mark_cluster_dirty(d, clu);
+}
+
+static int
+fat_create_entry_nolock(struct fs *fs,
+                        struct fat_entry *dir,
+                        const char *name,
+                        size_t name_len,
+                        bool is_dir,
+                        struct fat_entry **out)
+{
+   struct fat_fs_device_data *d = fs->device_data;
+   struct fat_entry *slots[FAT_MAX_LONG_NAME_ENTRIES + 1];
+   struct fat_entry *e;
+   char short_name[11];
+   u32 lcnt, dir_clu = 0;
+   u16 date, time;
+   u8 checksum;
+   int rc;
+
+   lcnt = (u32)(name_len + FAT_LONG_NAME_CHARS_PER_ENTRY - 1);
+   lcnt /= FAT_LONG_NAME_CHARS_PER_ENTRY;
+
+   if ((rc = fat_gen_short_name(d, dir, name, name_len, short_name)))
+      return rc;
+
+   if ((rc = fat_find_free_dir_slots(d, dir, lcnt + 1, slots)))
+      return rc;
+
+   if (is_dir && !(dir_clu = fat_alloc_cluster(d)))
+      return -ENOSPC;
+
+   checksum = fat_get_short_name_checksum(short_name);
+
+   /* The long name entries are stored in reverse order */
+   for (u32 i = 0; i < lcnt; i++) {
+
+      const u32 ord = lcnt - i;
+
+      fat_fill_long_entry((void *)slots[i],
+                          name,
+                          name_len,
+                          ord,
+                          ord == lcnt,
+                          checksum);
+
+      fat_mark_dirty_ptr(d, slots[i]);
+   }
+
+   e = slots[lcnt];
+   bzero(e, sizeof(*e));
+   memcpy(e->DIR_Name, short_name, sizeof(short_name));
+
+   if (is_dir)
+      e->directory = 1;
+   else
+      e->archive = 1;
+
+   fat_get_curr_fat_datetime(&date, &time);
+   e->DIR_CrtDate = e->DIR_WrtDate = e->DIR_LstAccDate = date;
+   e->DIR_CrtTime = e->DIR_WrtTime = time;
+   fat_set_first_cluster(e, dir_clu);
+   fat_mark_dirty_ptr(d, e);
+
+   if (is_dir)
+      fat_init_dir_cluster(d, dir, e, dir_clu);
+
+   *out = e;
+   return 0;
+}
+
+/*
+ * Creates a new entry (file or directory) named `name` in the directory `dir`.
+ * Expects the caller to hold the fs exlock.
+ */
+int
+fat_create_entry(struct fs *fs,
+                 struct fat_entry *dir,
+                 const char *name,
+                 bool is_dir,
+                 struct fat_entry **out)
+{
+   struct fat_fs_device_data *d = fs->device_data;
+   size_t name_len = 0;
+   int rc;
+
+   if (!(fs->flags & VFS_FS_RW))
+      return -EROFS;
+
+   /* The last component might be followed by slashes (e.g. "a/b/") */
+   while (name[name_len] && name[name_len] != '/')
+      name_len++;
+
+   if (!name_len || is_dot_or_dotdot(name, (int)name_len))
+      return -EINVAL;
+
+   if (name_len > 255)
+      return -ENAMETOOLONG;
+
+   for (size_t i = 0; i < name_len; i++)
+      if (!fat32_is_valid_filename_character(name[i]))
+         return -EINVAL;
+
+   rwlock_wp_exlock(&d->data_lock);
+   {
+      rc = fat_create_entry_nolock(fs, dir, name, name_len, is_dir, out);
+   }
+   rwlock_wp_exunlock(&d->data_lock);
+   return rc;
+}
+
+int fat_mkdir(struct vfs_path *p, mode_t mode)
+{
+   struct fat_fs_path *fp = (struct fat_fs_path *)&p->fs_path;
+   struct fat_entry *e;
+
+   return fat_create_entry(p->fs, fp->parent_entry, p->last_comp, true, &e);
+}
+
+/*
+ * Write-back of the batched changes
+ * -----------------------------------
+ */
+
+#define FSI_LEAD_SIG                                    0x41615252
+#define FSI_STRUC_SIG                                   0x61417272
+#define FSI_STRUC_SIG_OFF                                      484
+#define FSI_FREE_COUNT_OFF                                     488
+#define FSI_NXT_FREE_OFF                                       492
+
+static void
+fat_flush_fsinfo(struct fat_fs_device_data *d)
+{
+   struct fat32_header2 *h32 = (struct fat32_header2 *)(d->hdr + 1);
+   const u32 bps = d->hdr->BPB_BytsPerSec;
+   u8 *fsi;
+
+   if (d->type != fat32_type)
+      return;
+
+   if (!h32->BPB_FSInfo || (h32->BPB_FSInfo + 1) * bps > d->rd_size)
+      return;
+
+   fsi = (u8 *)d->hdr + h32->BPB_FSInfo * bps;
+
+   if (*(u32 *)fsi != FSI_LEAD_SIG)
+      return;
+
+   if (*(u32 *)(fsi + FSI_STRUC_SIG_OFF) != FSI_STRUC_SIG)
+      return;
+
+   /*
+    * Counting the free clusters would require a scan of the whole FAT: just
+    * mark the free count as unknown, as the spec allows, and update the hint.
+    */
+   *(u32 *)(fsi + FSI_FREE_COUNT_OFF) = 0xFFFFFFFF;
+   *(u32 *)(fsi + FSI_NXT_FREE_OFF) = d->free_clu_hint;
+}
+
+static u32
+fat_flush_nolock(struct fat_fs_device_data *d)
+{
+   struct fat_hdr *hdr = d->hdr;
+   const u32 bps = hdr->BPB_BytsPerSec;
+   const u32 fat_sz = fat_get_FATSz(hdr);
+   const u32 words = BITMAP_WORDS(fat_sz);
+   char *const fat0 = (char *)hdr + hdr->BPB_RsvdSecCnt * bps;
+   u32 dirty_clusters;
+
+   if (d->dirty_fat_secs_cnt) {
+
+      for (u32 w = 0; w < words; w++) {
+
+         if (!d->dirty_fat_secs[w])
+            continue;
+
+         for (u32 b = 0; b < NBITS; b++) {
+
+            const u32 sec = w * NBITS + b;
+
+            if (!bitmap_test(d->dirty_fat_secs, sec))
+               continue;
+
+            for (u32 n = 1; n < hdr->BPB_NumFATs; n++)
+               memcpy(fat0 + (n * fat_sz + sec) * bps, fat0 + sec * bps, bps);
+         }
+
+         d->dirty_fat_secs[w] = 0;
+      }
+
+      d->dirty_fat_secs_cnt = 0;
+      fat_flush_fsinfo(d);
+   }
+
+   /*
+    * The data clusters live in the ramdisk itself, which is our backing store:
+    * there's nothing to write back, just forget about them.
+    */
+   dirty_clusters = d->dirty_clusters_cnt;
+
+   if (dirty_clusters) {
+      bzero(d->dirty_clusters,
+            BITMAP_WORDS(d->max_cluster + 1) * sizeof(ulong));
+      d->dirty_clusters_cnt = 0;
+   }
+
+   return dirty_clusters;
+}
+
+u32 fat_flush(struct fs *fs)
+{
+   struct fat_fs_device_data *d = fs->device_data;
+   u32 ret;
+
+   if (!(fs->flags & VFS_FS_RW))
+      return 0;
+
+   rwlock_wp_exlock(&d->data_lock);
+   {
+      ret = fat_flush_nolock(d);
+   }
+   rwlock_wp_exunlock(&d->data_lock);
+   return ret;
+}
+
+/*
+ * Setup and teardown of the r/w state
+ * -------------------------------------
+ */
+
+void fat_rw_destroy(struct fat_fs_device_data *d)
+{
+   if (d->dirty_clusters) {
+      kfree2(d->dirty_clusters,
+             BITMAP_WORDS(d->max_cluster + 1) * sizeof(ulong));
+      d->dirty_clusters = NULL;
+   }
+
+   if (d->dirty_fat_secs) {
+      kfree2(d->dirty_fat_secs,
+             BITMAP_WORDS(fat_get_FATSz(d->hdr)) * sizeof(ulong));
+      d->dirty_fat_secs = NULL;
+   }
+}
+
+int fat_rw_init(struct fat_fs_device_data *d, size_t rd_size)
+{
+   struct fat_hdr *hdr = d->hdr;
+   const u32 bps = hdr->BPB_BytsPerSec;
+   const u32 fds = fat_get_first_data_sector(hdr);
+   const u32 rd_secs = (u32)(rd_size / bps);
+   const u32 last_clu = fat_get_cluster_count(hdr) + 1;
+   u32 ff_off;
+
+   if (d->type != fat16_type && d->type != fat32_type)
+      return -EINVAL;
+
+   d->rd_size = rd_size;
+   d->max_cluster = 1; /* No usable clusters */
+
+   /* The last cluster which is entirely contained in the ramdisk */
+   if (rd_secs >= fds + hdr->BPB_SecPerClus)
+      d->max_cluster = MIN((rd_secs - fds) / hdr->BPB_SecPerClus + 1, last_clu);
+
+   ff_off = fat_get_first_free_cluster_off(hdr);
+   d->free_clu_hint = (ff_off / bps - 1 - fds) / hdr->BPB_SecPerClus + 2;
+
+   d->dirty_clusters =
+      kzmalloc(BITMAP_WORDS(d->max_cluster + 1) * sizeof(ulong));
+
+   d->dirty_fat_secs =
+      kzmalloc(BITMAP_WORDS(fat_get_FATSz(hdr)) * sizeof(ulong));
+
+   if (!d->dirty_clusters || !d->dirty_fat_secs) {
+      fat_rw_destroy(d);
+      return -ENOMEM;
+   }
+
+   rwlock_wp_init(&d->rwlock, false);
+   rwlock_wp_init(&d->data_lock, false);
+   return 0;
+}
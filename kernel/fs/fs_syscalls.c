@@ -172,7 +172,36 @@ int sys_mkdir(const char *u_path, mode_t mode)
    return vfs_mkdir(path, mode);
 }
 
-int sys_read(int fd, void *u_buf, size_t count)
+/*
+ * Account the I/O done by read-like and write-like syscalls, in the same way
+ * Linux does for the rchar/wchar counters in /proc/<pid>/io.
+ */
+static inline int io_acct_read(int rc)
+{
+   struct task *curr = get_curr_task();
+
+   curr->ru.syscr++;
+
+   if (rc > 0)
+      curr->ru.rchar += (u32)rc;
+
+   return rc;
+}
+
+static inline int io_acct_write(int rc)
+{
+   struct task *curr = get_curr_task();
+
+   curr->ru.syscw++;
+
+   if (rc > 0)
+      curr->ru.wchar += (u32)rc;
+
+   return rc;
+}
+
+static int
+do_read(int fd, void *u_buf, size_t count)
 {
    int ret;
    struct task *curr = get_curr_task();
@@ -210,7 +239,13 @@ int sys_read(int fd, void *u_buf, size_t count)
    return ret;
 }
 
-int sys_write(int fd, const void *u_buf, size_t count)
+int sys_read(int fd, void *u_buf, size_t count)
+{
+   return io_acct_read(do_read(fd, u_buf, count));
+}
+
+static int
+do_write(int fd, const void *u_buf, size_t count)
 {
    struct task *curr = get_curr_task();
    struct fs_handle_base *h;
@@ -229,6 +264,73 @@ int sys_write(int fd, const void *u_buf, size_t count)
    return (int)vfs_write(h, (char *)curr->io_copybuf, count);
 }
 
+int sys_write(int fd, const void *u_buf, size_t count)
+{
+   return io_acct_write(do_write(fd, u_buf, count));
+}
+
+static int
+do_pread64(int fd, void *u_buf, size_t count, s64 off)
+{
+   int ret;
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *h;
+
+   if (!(h = get_fs_handle(fd)))
+      return -EBADF;
+
+   if (off < 0)
+      return -EINVAL;
+
+   // NOTE: truncating the 64-bit offset to a pointer-size integer
+   if (h->spec_flags & VFS_SPFL_NO_USER_COPY)
+      return (int) vfs_pread(h, u_buf, count, (offt)off);
+
+   count = MIN(count, IO_COPYBUF_SIZE);
+   ret = (int) vfs_pread(h, curr->io_copybuf, count, (offt)off);
+
+   if (ret > 0) {
+      if (copy_to_user(u_buf, curr->io_copybuf, (size_t)ret) < 0)
+         ret = -EFAULT;
+   }
+
+   return ret;
+}
+
+int sys_pread64(int fd, void *u_buf, size_t count, s64 off)
+{
+   return io_acct_read(do_pread64(fd, u_buf, count, off));
+}
+
+static int
+do_pwrite64(int fd, const void *u_buf, size_t count, s64 off)
+{
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *h;
+
+   if (!(h = get_fs_handle(fd)))
+      return -EBADF;
+
+   if (off < 0)
+      return -EINVAL;
+
+   // NOTE: truncating the 64-bit offset to a pointer-size integer
+   if (h->spec_flags & VFS_SPFL_NO_USER_COPY)
+      return (int)vfs_pwrite(h, (void *)u_buf, count, (offt)off);
+
+   count = MIN(count, IO_COPYBUF_SIZE);
+
+   if (copy_from_user(curr->io_copybuf, u_buf, count))
+      return -EFAULT;
+
+   return (int)vfs_pwrite(h, (char *)curr->io_copybuf, count, (offt)off);
+}
+
+int sys_pwrite64(int fd, const void *u_buf, size_t count, s64 off)
+{
+   return io_acct_write(do_pwrite64(fd, u_buf, count, off));
+}
+
 int sys_ioctl(int fd, ulong request, void *argp)
 {
    fs_handle handle = get_fs_handle(fd);
@@ -254,7 +356,8 @@ static bool iov_len_overflow(const struct iovec *iov, int iovcnt)
    return false;
 }
 
-int sys_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
+static int
+do_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
 {
    struct task *curr = get_curr_task();
    struct iovec *iov = (void *)curr->args_copybuf;
@@ -279,7 +382,13 @@ int sys_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
    return (int)vfs_writev(handle, iov, u_iovcnt);
 }
 
-int sys_readv(int fd, const struct iovec *u_iov, int u_iovcnt)
+int sys_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
+{
+   return io_acct_write(do_writev(fd, u_iov, u_iovcnt));
+}
+
+static int
+do_readv(int fd, const struct iovec *u_iov, int u_iovcnt)
 {
    struct task *curr = get_curr_task();
    struct iovec *iov = (void *)curr->args_copybuf;
@@ -304,6 +413,147 @@ int sys_readv(int fd, const struct iovec *u_iov, int u_iovcnt)
    return (int)vfs_readv(handle, iov, u_iovcnt);
 }
 
+int sys_readv(int fd, const struct iovec *u_iov, int u_iovcnt)
+{
+   return io_acct_read(do_readv(fd, u_iov, u_iovcnt));
+}
+
+static int
+do_vfs_prwv(int fd,
+            const struct iovec *u_iov,
+            int u_iovcnt,
+            s64 off,
+            bool wr)
+{
+   struct task *curr = get_curr_task();
+   struct iovec *iov = (void *)curr->args_copybuf;
+   const u32 iovcnt = (u32) u_iovcnt;
+   fs_handle handle;
+
+   if (u_iovcnt <= 0)
+      return -EINVAL;
+
+   if (sizeof(struct iovec) * iovcnt > ARGS_COPYBUF_SIZE)
+      return -EINVAL;
+
+   if (copy_from_user(iov, u_iov, sizeof(struct iovec) * iovcnt))
+      return -EFAULT;
+
+   if (iov_len_overflow(iov, u_iovcnt))
+      return -EINVAL;
+
+   if (!(handle = get_fs_handle(fd)))
+      return -EBADF;
+
+   if (off == -1) {
+
+      /* preadv2() and pwritev2() only: use the current file position */
+      return wr
+         ? (int)vfs_writev(handle, iov, u_iovcnt)
+         : (int)vfs_readv(handle, iov, u_iovcnt);
+   }
+
+   if (off < 0)
+      return -EINVAL;
+
+   // NOTE: truncating the 64-bit offset to a pointer-size integer
+   return wr
+      ? (int)vfs_pwritev(handle, iov, u_iovcnt, (offt)off)
+      : (int)vfs_preadv(handle, iov, u_iovcnt, (offt)off);
+}
+
+static int
+call_vfs_prwv(int fd,
+              const struct iovec *u_iov,
+              int u_iovcnt,
+              s64 off,
+              bool wr)
+{
+   const int rc = do_vfs_prwv(fd, u_iov, u_iovcnt, off, wr);
+   return wr ? io_acct_write(rc) : io_acct_read(rc);
+}
+
+static inline s64 pos_from_low_high(ulong low, ulong high)
+{
+   return (s64)(((u64)high << 32) | low);
+}
+
+int sys_preadv(int fd, const struct iovec *u_iov, int u_iovcnt,
+               ulong pos_low, ulong pos_high)
+{
+   const s64 off = pos_from_low_high(pos_low, pos_high);
+
+   if (off < 0)
+      return -EINVAL;
+
+   return call_vfs_prwv(fd, u_iov, u_iovcnt, off, false);
+}
+
+int sys_pwritev(int fd, const struct iovec *u_iov, int u_iovcnt,
+                ulong pos_low, ulong pos_high)
+{
+   const s64 off = pos_from_low_high(pos_low, pos_high);
+
+   if (off < 0)
+      return -EINVAL;
+
+   return call_vfs_prwv(fd, u_iov, u_iovcnt, off, true);
+}
+
+int sys_preadv2(int fd, const struct iovec *u_iov, int u_iovcnt,
+                ulong pos_low, ulong pos_high, int flags)
+{
+   if (flags)
+      return -EOPNOTSUPP; /* RWF_* flags are not supported */
+
+   return call_vfs_prwv(fd, u_iov, u_iovcnt,
+                        pos_from_low_high(pos_low, pos_high), false);
+}
+
+int sys_pwritev2(int fd, const struct iovec *u_iov, int u_iovcnt,
+                 ulong pos_low, ulong pos_high, int flags)
+{
+   if (flags)
+      return -EOPNOTSUPP; /* RWF_* flags are not supported */
+
+   return call_vfs_prwv(fd, u_iov, u_iovcnt,
+                        pos_from_low_high(pos_low, pos_high), true);
+}
+
+int sys_fadvise64_64(int fd, s64 off, s64 len, int advice)
+{
+   struct fs_handle_base *h;
+
+   if (!(h = get_fs_handle(fd)))
+      return -EBADF;
+
+   // NOTE: truncating the 64-bit values to pointer-size integers
+   return vfs_fadvise(h, (offt)off, (offt)len, advice);
+}
+
+int sys_fadvise64(int fd, s64 off, size_t len, int advice)
+{
+   return sys_fadvise64_64(fd, off, (s64)len, advice);
+}
+
+int sys_readahead(int fd, s64 off, size_t count)
+{
+   struct fs_handle_base *h;
+   int rc;
+
+   if (!(h = get_fs_handle(fd)))
+      return -EBADF;
+
+   if ((h->fl_flags & O_WRONLY) && !(h->fl_flags & O_RDWR))
+      return -EBADF; /* file not opened for reading */
+
+   if (!count)
+      return 0;
+
+   rc = vfs_fadvise(h, (offt)off, (offt)count, POSIX_FADV_WILLNEED);
+   return rc == -ESPIPE ? -EINVAL : rc;
+}
+
 static int
 call_vfs_stat64(const char *u_path,
                 struct stat64 *u_statbuf,
@@ -359,6 +609,144 @@ int sys_fstat64(int fd, struct stat64 *u_statbuf)
    return rc;
 }
 
+#ifndef AT_EMPTY_PATH
+   #define AT_EMPTY_PATH                                             0x1000
+#endif
+
+#ifndef AT_NO_AUTOMOUNT
+   #define AT_NO_AUTOMOUNT                                            0x800
+#endif
+
+#define AT_STATX_SYNC_TYPE_MASK                                      0x6000
+
+static int
+call_vfs_fstatat64(int dirfd,
+                   const char *u_path,
+                   struct stat64 *statbuf,
+                   int flags)
+{
+   struct task *curr = get_curr_task();
+   char *path = curr->args_copybuf;
+   fs_handle dirh = NULL;
+   int rc;
+
+   rc = copy_str_from_user(path, u_path, MAX_PATH, NULL);
+
+   if (rc < 0)
+      return -EFAULT;
+
+   if (rc > 0)
+      return -ENAMETOOLONG;
+
+   if (!*path) {
+
+      if (!(flags & AT_EMPTY_PATH))
+         return -ENOENT;
+
+      if (dirfd == AT_FDCWD)
+         return vfs_stat64(".", statbuf, true);
+
+      if (!(dirh = get_fs_handle(dirfd)))
+         return -EBADF;
+
+      return vfs_fstat64(dirh, statbuf);
+   }
+
+   /* NOTE: the directory fd is not used at all with absolute paths */
+   if (dirfd != AT_FDCWD && *path != '/') {
+      if (!(dirh = get_fs_handle(dirfd)))
+         return -EBADF;
+   }
+
+   return vfs_fstatat64(dirh, path, statbuf, !(flags & AT_SYMLINK_NOFOLLOW));
+}
+
+int sys_fstatat64(int dirfd, const char *u_path, struct stat64 *u_st, int flags)
+{
+   struct stat64 statbuf;
+   int rc;
+
+   if (flags & ~(AT_SYMLINK_NOFOLLOW | AT_EMPTY_PATH | AT_NO_AUTOMOUNT))
+      return -EINVAL;
+
+   if ((rc = call_vfs_fstatat64(dirfd, u_path, &statbuf, flags)))
+      return rc;
+
+   if (copy_to_user(u_st, &statbuf, sizeof(struct stat64)))
+      rc = -EFAULT;
+
+   return rc;
+}
+
+static void
+stat64_to_statx(const struct stat64 *st, struct k_statx *stx)
+{
+   *stx = (struct k_statx) {
+      .stx_mask         = K_STATX_BASIC_STATS,
+      .stx_blksize      = (u32) st->st_blksize,
+      .stx_nlink        = (u32) st->st_nlink,
+      .stx_uid          = st->st_uid,
+      .stx_gid          = st->st_gid,
+      .stx_mode         = (u16) st->st_mode,
+      .stx_ino          = (u64) st->st_ino,
+      .stx_size         = (u64) st->st_size,
+      .stx_blocks       = (u64) st->st_blocks,
+      .stx_atime        = {
+         .tv_sec  = st->st_atim.tv_sec,
+         .tv_nsec = (u32) st->st_atim.tv_nsec,
+      },
+      .stx_ctime        = {
+         .tv_sec  = st->st_ctim.tv_sec,
+         .tv_nsec = (u32) st->st_ctim.tv_nsec,
+      },
+      .stx_mtime        = {
+         .tv_sec  = st->st_mtim.tv_sec,
+         .tv_nsec = (u32) st->st_mtim.tv_nsec,
+      },
+      .stx_rdev_major   = (u32)(st->st_rdev >> 8) & 0xff,   /* see devfs */
+      .stx_rdev_minor   = (u32)st->st_rdev & 0xff,
+      .stx_dev_major    = 0,
+      .stx_dev_minor    = (u32)st->st_dev,
+   };
+}
+
+/*
+ * NOTE: all the basic stats are always filled, no matter what's in `mask`,
+ * which is allowed by the interface. STATX_BTIME is not supported.
+ */
+int sys_statx(int dirfd,
+              const char *u_path,
+              int flags,
+              u32 mask,
+              struct k_statx *u_statxbuf)
+{
+   const int ok_flags = AT_SYMLINK_NOFOLLOW | AT_EMPTY_PATH |
+                        AT_NO_AUTOMOUNT | AT_STATX_SYNC_TYPE_MASK;
+
+   struct stat64 statbuf;
+   struct k_statx stx;
+   int rc;
+
+   if (flags & ~ok_flags)
+      return -EINVAL;
+
+   if ((flags & AT_STATX_SYNC_TYPE_MASK) == AT_STATX_SYNC_TYPE_MASK)
+      return -EINVAL;
+
+   if (mask & K_STATX__RESERVED)
+      return -EINVAL;
+
+   if ((rc = call_vfs_fstatat64(dirfd, u_path, &statbuf, flags)))
+      return rc;
+
+   stat64_to_statx(&statbuf, &stx);
+
+   if (copy_to_user(u_statxbuf, &stx, sizeof(stx)))
+      rc = -EFAULT;
+
+   return rc;
+}
+
 int sys_symlink(const char *u_target, const char *u_linkpath)
 {
    struct task *curr     = get_curr_task();
@@ -486,6 +874,16 @@ int sys_getdents64(int fd, struct linux_dirent64 *u_dirp, u32 buf_size)
    return vfs_getdents64(handle, u_dirp, buf_size);
 }
 
+int sys_tilck_getdents_stat(int fd, struct tilck_dirent_stat *u_dirp, u32 bs)
+{
+   fs_handle handle;
+
+   if (!(handle = get_fs_handle(fd)))
+      return -EBADF;
+
+   return vfs_getdents_stat(handle, u_dirp, bs);
+}
+
 int sys_access(const char *u_path, mode_t mode)
 {
    // TODO: check mode and file r/w flags.
@@ -0,0 +1,1231 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/fs/procfs.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/process_mm.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/kmalloc_debug.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/irq.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/tty.h>
+#include <tilck/kernel/elf_utils.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/errno.h>
+
+#include <sys/mman.h>      // system header
+
+/*
+ * procfs is a read-only pseudo file system, mounted at /proc, exposing
+ * per-process and system-wide counters in (a subset of) the text formats used
+ * by Linux, so that tools like ps, top and free can work on Tilck too.
+ *
+ * There are no inodes in memory: each entry is identified by an integer
+ * encoding its type and, for the per-process entries, the pid. The content
+ * of each file is rendered lazily, at the first read, in a buffer owned by
+ * the file handle. Subsequent reads return data from the same snapshot until
+ * the handle is closed or rewound with lseek(fd, 0, SEEK_SET): that's what
+ * pollers like `top` do to get fresh data, without re-opening the files.
+ */
+
+#define PROCFS_BUF_MIN_SIZE               PAGE_SIZE
+#define PROCFS_BUF_MAX_SIZE               (64 * KB)
+#define PROCFS_PIDS_BATCH                 32
+
+enum procfs_type {
+
+   PROCFS_NONE,
+
+   /* Directories */
+   PROCFS_ROOT,
+   PROCFS_PID_DIR,
+
+   /* System-wide files */
+   PROCFS_INTERRUPTS,
+   PROCFS_KMALLOC,
+   PROCFS_MEMINFO,
+   PROCFS_STAT,
+   PROCFS_UPTIME,
+
+   /* Per-process files */
+   PROCFS_PID_IO,
+   PROCFS_PID_MAPS,
+   PROCFS_PID_STAT,
+   PROCFS_PID_STATM,
+};
+
+#define PROCFS_ENTRY(type, pid)    TO_PTR(((ulong)(pid) << 8) | (type))
+#define PROCFS_TYPE(e)             ((enum procfs_type)((ulong)(e) & 0xff))
+#define PROCFS_PID(e)              ((int)((ulong)(e) >> 8))
+
+struct procfs_buf {
+
+   char *buf;
+   size_t size;
+   size_t used;
+};
+
+typedef int (*procfs_render_func)(struct procfs_buf *, int pid);
+
+struct procfs_file {
+
+   const char *name;
+   enum procfs_type type;
+   procfs_render_func render;
+};
+
+struct procfs_handle {
+
+   /* struct fs_handle_base */
+   FS_HANDLE_BASE_FIELDS
+
+   /* procfs-specific fields */
+   vfs_inode_ptr_t entry;
+
+   union {
+
+      int dpos;            /* dirs: index of the next entry to return */
+
+      struct {
+         char *buf;        /* files: rendered content, NULL if not yet */
+         size_t buf_size;
+         size_t buf_used;
+      };
+   };
+};
+
+static struct fs *procfs;
+
+static void
+procfs_printf(struct procfs_buf *b, const char *fmt, ...)
+{
+   const size_t rem = b->size - b->used;
+   va_list args;
+   int rc;
+
+   if (!rem)
+      return; /* the buffer is already full */
+
+   va_start(args, fmt);
+   rc = vsnprintk(b->buf + b->used, rem, fmt, args);
+   va_end(args);
+
+   /* vsnprintk() returns `rem` only when the output has been truncated */
+   b->used = (size_t)rc < rem ? b->used + (size_t)rc : b->size;
+}
+
+/* ------------------------- System-wide files ----------------------------- */
+
+static int
+procfs_render_meminfo(struct procfs_buf *b, int unused)
+{
+   struct debug_kmalloc_heap_info hi;
+   size_t tot_kb = 0, free_kb = 0;
+
+   for (int i = 0; i < KMALLOC_HEAPS_COUNT; i++) {
+
+      if (!debug_kmalloc_get_heap_info(i, &hi))
+         break;
+
+      tot_kb += hi.size / KB;
+      free_kb += (hi.size - hi.mem_allocated) / KB;
+   }
+
+   /*
+    * All the usable memory is managed by the kmalloc heaps: there is no page
+    * cache nor swap in Tilck.
+    */
+   procfs_printf(b, "MemTotal:     %8u kB\n", (u32)tot_kb);
+   procfs_printf(b, "MemFree:      %8u kB\n", (u32)free_kb);
+   procfs_printf(b, "MemAvailable: %8u kB\n", (u32)free_kb);
+   procfs_printf(b, "Buffers:      %8u kB\n", 0);
+   procfs_printf(b, "Cached:       %8u kB\n", 0);
+   procfs_printf(b, "SwapCached:   %8u kB\n", 0);
+   procfs_printf(b, "SwapTotal:    %8u kB\n", 0);
+   procfs_printf(b, "SwapFree:     %8u kB\n", 0);
+   procfs_printf(b, "Shmem:        %8u kB\n", 0);
+   return 0;
+}
+
+static int
+procfs_render_kmalloc(struct procfs_buf *b, int unused)
+{
+   struct debug_kmalloc_heap_info hi;
+   struct debug_kmalloc_stats stats;
+   struct debug_kmalloc_chunks_ctx ctx;
+   size_t size, count;
+   char region[8];
+
+   debug_kmalloc_get_stats(&stats);
+
+   procfs_printf(b, "small heaps:          %d (peak: %d)\n",
+                 stats.small_heaps.tot_count,
+                 stats.small_heaps.peak_count);
+
+   procfs_printf(b, "non-full small heaps: %d (peak: %d)\n",
+                 stats.small_heaps.not_full_count,
+                 stats.small_heaps.peak_not_full_count);
+
+   procfs_printf(b, "empty small heaps:    %d\n",
+                 stats.small_heaps.empty_count);
+
+   procfs_printf(b, "created small heaps:  %d\n\n",
+                 stats.small_heaps.lifetime_created_heaps_count);
+
+   procfs_printf(b, "heap region      vaddr    size_kb    used_kb  min_bs\n");
+
+   for (int i = 0; i < KMALLOC_HEAPS_COUNT; i++) {
+
+      if (!debug_kmalloc_get_heap_info(i, &hi))
+         break;
+
+      if (hi.region >= 0)
+         snprintk(region, sizeof(region), "%d", hi.region);
+      else
+         snprintk(region, sizeof(region), "--");
+
+      procfs_printf(b, "%4d %6s %p %10u %10u %7u\n",
+                    i, region, TO_PTR(hi.vaddr),
+                    (u32)(hi.size / KB),
+                    (u32)(hi.mem_allocated / KB),
+                    (u32)hi.min_block_size);
+   }
+
+   if (!stats.chunk_sizes_count)
+      return 0; /* KMALLOC_HEAVY_STATS is disabled */
+
+   procfs_printf(b, "\nchunk_size      count\n");
+   debug_kmalloc_chunks_stats_start_read(&ctx);
+
+   while (debug_kmalloc_chunks_stats_next(&ctx, &size, &count))
+      procfs_printf(b, "%10u %10u\n", (u32)size, (u32)count);
+
+   return 0;
+}
+
+static int
+procfs_render_interrupts(struct procfs_buf *b, int unused)
+{
+   u32 unhandled = 0;
+   irq_handler_t handler;
+   const char *name;
+   long off;
+   u32 sym_size;
+
+   procfs_printf(b, "           CPU0\n");
+
+   for (int i = 0; i < 16; i++) {
+
+      if (!(handler = irq_get_handler(i)) && !irq_count[i])
+         continue;
+
+      name = handler ? find_sym_at_addr_safe((ulong)handler, &off, &sym_size)
+                     : NULL;
+
+      procfs_printf(b, "%3d: %10u   XT-PIC  %s\n",
+                    i, irq_count[i], name ? name : "");
+   }
+
+   for (u32 i = 0; i < ARRAY_SIZE(unhandled_irq_count); i++)
+      unhandled += unhandled_irq_count[i];
+
+   procfs_printf(b, "SPU: %10u   Spurious interrupts\n", spur_irq_count);
+   procfs_printf(b, "ERR: %10u   Unhandled interrupts\n", unhandled);
+   return 0;
+}
+
+static inline u64
+ticks_to_user_hz(u64 ticks)
+{
+   return ticks * PROCFS_USER_HZ / TIMER_HZ;
+}
+
+static inline u64
+ns_to_user_hz(u64 ns)
+{
+   return ns / (TS_SCALE / PROCFS_USER_HZ);
+}
+
+static int
+procfs_render_stat(struct procfs_buf *b, int unused)
+{
+   struct sched_cpu_ticks t;
+   u64 intr = 0;
+
+   sched_get_cpu_ticks(&t);
+
+   for (int i = 0; i < 16; i++)
+      intr += irq_count[i];
+
+   for (int i = 0; i < 2; i++) {
+      procfs_printf(b, "%s %llu 0 %llu %llu 0 0 0 0 0 0\n",
+                    i ? "cpu0" : "cpu ",
+                    ticks_to_user_hz(t.user),
+                    ticks_to_user_hz(t.system),
+                    ticks_to_user_hz(t.idle));
+   }
+
+   procfs_printf(b, "intr %llu", intr);
+
+   for (int i = 0; i < 16; i++)
+      procfs_printf(b, " %u", irq_count[i]);
+
+   procfs_printf(b, "\nbtime %llu\n",
+                 (u64)get_timestamp() - get_ticks() / TIMER_HZ);
+   return 0;
+}
+
+static int
+procfs_render_uptime(struct procfs_buf *b, int unused)
+{
+   struct sched_cpu_ticks t;
+   const u64 up = ticks_to_user_hz(get_ticks());
+   u64 idle;
+
+   sched_get_cpu_ticks(&t);
+   idle = ticks_to_user_hz(t.idle);
+
+   procfs_printf(b, "%llu.%02llu %llu.%02llu\n",
+                 up / PROCFS_USER_HZ, up % PROCFS_USER_HZ,
+                 idle / PROCFS_USER_HZ, idle % PROCFS_USER_HZ);
+   return 0;
+}
+
+/* ------------------------- Per-process files ----------------------------- */
+
+struct procfs_pid_info {
+
+   struct process *pi;
+   struct task *main_ti;
+   int num_threads;
+   struct proc_rusage ru;
+   struct proc_rusage children_ru;
+};
+
+struct procfs_mem_info {
+
+   struct process *pi;
+   size_t size;
+   size_t resident;
+   size_t shared;
+   size_t text;
+};
+
+static int
+procfs_pid_info_cb(void *obj, void *arg)
+{
+   struct task *ti = obj;
+   struct procfs_pid_info *info = arg;
+
+   if (ti->pi == info->pi)
+      info->num_threads++;
+
+   return 0;
+}
+
+/*
+ * Gets the main thread of the user process `pid`, plus its aggregated
+ * counters. Must be called with preemption disabled.
+ */
+static bool
+procfs_get_pid_info(int pid, struct procfs_pid_info *info)
+{
+   struct task *ti;
+
+   ASSERT(!is_preemption_enabled());
+   bzero(info, sizeof(*info));
+
+   if (!(ti = get_task(pid)) || is_kernel_thread(ti) || ti->tid != ti->pi->pid)
+      return false;
+
+   info->pi = ti->pi;
+   info->main_ti = ti;
+   iterate_over_tasks(&procfs_pid_info_cb, info);
+   process_get_rusage(info->pi, &info->ru);
+   info->children_ru = info->pi->children_ru;
+   return true;
+}
+
+static bool
+procfs_has_user_mem(struct procfs_pid_info *info)
+{
+   /* Zombie processes have already released their memory */
+   return info->main_ti->state != TASK_STATE_ZOMBIE && info->pi->pdir;
+}
+
+static void
+procfs_mem_info_cb(struct user_page_info *pg, void *arg)
+{
+   struct procfs_mem_info *mi = arg;
+
+   mi->size++;
+
+   if (pg->zero)
+      return;
+
+   mi->resident++;
+
+   if (pg->shared || pg->ref_count > 1)
+      mi->shared++;
+
+   if (!pg->rw && pg->vaddr < (ulong)mi->pi->initial_brk)
+      mi->text++;
+}
+
+static void
+procfs_get_mem_info(struct procfs_pid_info *info, struct procfs_mem_info *mi)
+{
+   bzero(mi, sizeof(*mi));
+   mi->pi = info->pi;
+
+   if (procfs_has_user_mem(info))
+      pdir_for_each_user_page(info->pi->pdir, &procfs_mem_info_cb, mi);
+}
+
+static char
+procfs_get_state_char(struct task *ti)
+{
+   if (ti->stopped)
+      return 'T';
+
+   switch (ti->state) {
+
+      case TASK_STATE_RUNNABLE:
+      case TASK_STATE_RUNNING:
+         return 'R';
+
+      case TASK_STATE_SLEEPING:
+         return 'S';
+
+      case TASK_STATE_ZOMBIE:
+         return 'Z';
+
+      default:
+         return '?';
+   }
+}
+
+/* Writes in `buf` the basename of the first token in the process' cmdline */
+static void
+procfs_get_comm(struct process *pi, char *buf, size_t buf_size)
+{
+   const char *s = pi->debug_cmdline;
+   const char *base;
+   size_t n = 0;
+
+   if (!s || !*s) {
+      snprintk(buf, buf_size, "?");
+      return;
+   }
+
+   for (base = s; *s && *s != ' '; s++)
+      if (*s == '/')
+         base = s + 1;
+
+   while (base < s && n < buf_size - 1)
+      buf[n++] = *base++;
+
+   buf[n] = 0;
+}
+
+static int
+procfs_render_pid_stat(struct procfs_buf *b, int pid)
+{
+   struct procfs_pid_info info;
+   struct procfs_mem_info mi;
+   struct process *pi;
+   char comm[16];
+   int tty_nr = 0;
+
+   if (!procfs_get_pid_info(pid, &info))
+      return -ESRCH;
+
+   pi = info.pi;
+   procfs_get_comm(pi, comm, sizeof(comm));
+   procfs_get_mem_info(&info, &mi);
+
+   if (pi->proc_tty)
+      tty_nr = 4 << 8 | tty_get_num(pi->proc_tty);
+
+   /* Fields 1-13: pid, comm, state, ppid, pgrp, session, tty_nr, tpgid, ... */
+   procfs_printf(b, "%d (%s) %c %d %d %d %d -1 0 %u %u 0 0 ",
+                 pid,
+                 comm,
+                 procfs_get_state_char(info.main_ti),
+                 pi->parent_pid,
+                 pi->pgid,
+                 pi->sid,
+                 tty_nr,
+                 (u32)info.ru.minflt,
+                 (u32)info.children_ru.minflt);
+
+   /* Fields 14-24: utime, stime, cutime, cstime, ..., vsize, rss */
+   procfs_printf(b, "%llu %llu %llu %llu 20 0 %d 0 0 %u %u ",
+                 ns_to_user_hz(info.ru.utime),
+                 ns_to_user_hz(info.ru.stime),
+                 ns_to_user_hz(info.children_ru.utime),
+                 ns_to_user_hz(info.children_ru.stime),
+                 info.num_threads,
+                 (u32)(mi.size * PAGE_SIZE),
+                 (u32)mi.resident);
+
+   /* Fields 25-44: not supported, except exit_signal (SIGCHLD) */
+   procfs_printf(b, "0 0 0 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n");
+   return 0;
+}
+
+static int
+procfs_render_pid_io(struct procfs_buf *b, int pid)
+{
+   struct procfs_pid_info info;
+
+   if (!procfs_get_pid_info(pid, &info))
+      return -ESRCH;
+
+   /* Same format as Linux, plus syscalls and context switch counters */
+   procfs_printf(b, "rchar: %llu\n", info.ru.rchar);
+   procfs_printf(b, "wchar: %llu\n", info.ru.wchar);
+   procfs_printf(b, "syscr: %u\n", (u32)info.ru.syscr);
+   procfs_printf(b, "syscw: %u\n", (u32)info.ru.syscw);
+   procfs_printf(b, "read_bytes: 0\n");
+   procfs_printf(b, "write_bytes: 0\n");
+   procfs_printf(b, "cancelled_write_bytes: 0\n");
+   procfs_printf(b, "syscalls: %u\n", (u32)info.ru.syscalls);
+   procfs_printf(b, "voluntary_ctxt_switches: %u\n", (u32)info.ru.nvcsw);
+   procfs_printf(b, "nonvoluntary_ctxt_switches: %u\n", (u32)info.ru.nivcsw);
+   return 0;
+}
+
+static int
+procfs_render_pid_statm(struct procfs_buf *b, int pid)
+{
+   struct procfs_pid_info info;
+   struct procfs_mem_info mi;
+
+   if (!procfs_get_pid_info(pid, &info))
+      return -ESRCH;
+
+   procfs_get_mem_info(&info, &mi);
+
+   /* size resident shared text lib data dt, in pages */
+   procfs_printf(b, "%u %u %u %u 0 %u 0\n",
+                 (u32)mi.size,
+                 (u32)mi.resident,
+                 (u32)mi.shared,
+                 (u32)mi.text,
+                 (u32)(mi.size - mi.text));
+   return 0;
+}
+
+struct procfs_maps_ctx {
+
+   struct procfs_buf *b;
+   struct process *pi;
+
+   /* The current run of contiguous pages in the same area */
+   ulong start;
+   ulong end;
+   struct user_mapping *um;
+   const char *label;
+   bool rw;
+   bool shared;
+};
+
+static struct user_mapping *
+procfs_get_user_mapping_at(struct process *pi, ulong vaddr)
+{
+   struct user_mapping *um;
+
+   if (!pi->mi)
+      return NULL;
+
+   list_for_each_ro(um, &pi->mi->mappings, pi_node) {
+      if (um->vaddr <= vaddr && vaddr < um->vaddr + um->len)
+         return um;
+   }
+
+   return NULL;
+}
+
+static const char *
+procfs_get_area_label(struct process *pi, ulong vaddr, struct user_mapping *um)
+{
+   const ulong stack_start =
+      USERMODE_VADDR_END - USER_STACK_PAGES * PAGE_SIZE;
+
+   if (um)
+      return um->h ? ((struct fs_handle_base *)um->h)->fs->fs_type_name : "";
+
+   if ((ulong)pi->initial_brk <= vaddr && vaddr < (ulong)pi->brk)
+      return "[heap]";
+
+   if (stack_start <= vaddr && vaddr < USERMODE_VADDR_END)
+      return "[stack]";
+
+   return "";
+}
+
+static void
+procfs_maps_flush_run(struct procfs_maps_ctx *ctx)
+{
+   struct user_mapping *um = ctx->um;
+   const int prot = um ? um->prot : PROT_READ | PROT_EXEC;
+   const ulong off = um ? um->off + (ctx->start - um->vaddr) : 0;
+   const u32 dev = um && um->h ? ((struct fs_handle_base *)um->h)->fs->device_id
+                               : 0;
+
+   if (ctx->start == ctx->end)
+      return;
+
+   procfs_printf(ctx->b, "%08x-%08x %c%c%c%c %08x %02x:%02x 0 %s%s%s\n",
+                 (u32)ctx->start,
+                 (u32)ctx->end,
+                 (prot & PROT_READ) ? 'r' : '-',
+                 ctx->rw ? 'w' : '-',
+                 (prot & PROT_EXEC) ? 'x' : '-',
+                 ctx->shared ? 's' : 'p',
+                 (u32)off,
+                 dev >> 8, dev & 0xff,
+                 um && um->h ? "[" : "",
+                 ctx->label,
+                 um && um->h ? "]" : "");
+}
+
+static void
+procfs_maps_cb(struct user_page_info *pg, void *arg)
+{
+   struct procfs_maps_ctx *ctx = arg;
+   struct user_mapping *um = procfs_get_user_mapping_at(ctx->pi, pg->vaddr);
+   const char *label = procfs_get_area_label(ctx->pi, pg->vaddr, um);
+
+   if (pg->vaddr == ctx->end &&
+       um == ctx->um &&
+       label == ctx->label &&
+       pg->rw == ctx->rw &&
+       pg->shared == ctx->shared)
+   {
+      ctx->end += PAGE_SIZE;
+      return;
+   }
+
+   procfs_maps_flush_run(ctx);
+
+   ctx->start = pg->vaddr;
+   ctx->end = pg->vaddr + PAGE_SIZE;
+   ctx->um = um;
+   ctx->label = label;
+   ctx->rw = pg->rw;
+   ctx->shared = pg->shared;
+}
+
+static int
+procfs_render_pid_maps(struct procfs_buf *b, int pid)
+{
+   struct procfs_pid_info info;
+   struct procfs_maps_ctx ctx;
+
+   if (!procfs_get_pid_info(pid, &info))
+      return -ESRCH;
+
+   if (!procfs_has_user_mem(&info))
+      return 0;
+
+   ctx = (struct procfs_maps_ctx) {
+      .b = b,
+      .pi = info.pi,
+   };
+
+   pdir_for_each_user_page(info.pi->pdir, &procfs_maps_cb, &ctx);
+   procfs_maps_flush_run(&ctx);
+   return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const struct procfs_file root_files[] =
+{
+   { "interrupts",   PROCFS_INTERRUPTS,   &procfs_render_interrupts  },
+   { "kmalloc",      PROCFS_KMALLOC,      &procfs_render_kmalloc     },
+   { "meminfo",      PROCFS_MEMINFO,      &procfs_render_meminfo     },
+   { "stat",         PROCFS_STAT,         &procfs_render_stat        },
+   { "uptime",       PROCFS_UPTIME,       &procfs_render_uptime      },
+};
+
+static const struct procfs_file pid_files[] =
+{
+   { "io",           PROCFS_PID_IO,       &procfs_render_pid_io      },
+   { "maps",         PROCFS_PID_MAPS,     &procfs_render_pid_maps    },
+   { "stat",         PROCFS_PID_STAT,     &procfs_render_pid_stat    },
+   { "statm",        PROCFS_PID_STATM,    &procfs_render_pid_statm   },
+};
+
+static const struct procfs_file *
+procfs_get_file(enum procfs_type type)
+{
+   for (u32 i = 0; i < ARRAY_SIZE(root_files); i++)
+      if (root_files[i].type == type)
+         return &root_files[i];
+
+   for (u32 i = 0; i < ARRAY_SIZE(pid_files); i++)
+      if (pid_files[i].type == type)
+         return &pid_files[i];
+
+   return NULL;
+}
+
+static inline bool
+procfs_is_dir(vfs_inode_ptr_t e)
+{
+   return PROCFS_TYPE(e) == PROCFS_ROOT || PROCFS_TYPE(e) == PROCFS_PID_DIR;
+}
+
+static bool
+procfs_pid_exists(int pid)
+{
+   struct procfs_pid_info info;
+   bool ret;
+
+   disable_preemption();
+   {
+      ret = procfs_get_pid_info(pid, &info);
+   }
+   enable_preemption();
+   return ret;
+}
+
+/*
+ * Renders the content of the file in a buffer allocated on the heap, starting
+ * from PROCFS_BUF_MIN_SIZE bytes and doubling its size each time the output
+ * doesn't fit in it.
+ */
+static int
+procfs_render(struct procfs_handle *h)
+{
+   const struct procfs_file *f = procfs_get_file(PROCFS_TYPE(h->entry));
+   struct procfs_buf b = { .size = PROCFS_BUF_MIN_SIZE / 2 };
+   int rc;
+
+   ASSERT(f != NULL);
+   ASSERT(!h->buf);
+
+   do {
+
+      if (b.buf)
+         kfree2(b.buf, b.size);
+
+      b.size *= 2;
+      b.used = 0;
+
+      if (!(b.buf = kmalloc(b.size)))
+         return -ENOMEM;
+
+      disable_preemption();
+      {
+         rc = f->render(&b, PROCFS_PID(h->entry));
+      }
+      enable_preemption();
+
+   } while (!rc && b.used == b.size && b.size < PROCFS_BUF_MAX_SIZE);
+
+   if (rc) {
+      kfree2(b.buf, b.size);
+      return rc;
+   }
+
+   h->buf = b.buf;
+   h->buf_size = b.size;
+   h->buf_used = b.used;
+   return 0;
+}
+
+static void
+procfs_drop_rendered_data(struct procfs_handle *h)
+{
+   if (h->buf) {
+      kfree2(h->buf, h->buf_size);
+      h->buf = NULL;
+      h->buf_size = 0;
+      h->buf_used = 0;
+   }
+}
+
+static ssize_t
+procfs_read(fs_handle fsh, char *buf, size_t len)
+{
+   struct procfs_handle *h = fsh;
+   size_t n;
+   int rc;
+
+   if (!h->buf)
+      if ((rc = procfs_render(h)))
+         return rc;
+
+   if ((size_t)h->pos >= h->buf_used)
+      return 0;
+
+   n = MIN(len, h->buf_used - (size_t)h->pos);
+   memcpy(buf, h->buf + h->pos, n);
+   h->pos += (offt)n;
+   return (ssize_t)n;
+}
+
+static offt
+procfs_seek(fs_handle fsh, offt off, int whence)
+{
+   struct procfs_handle *h = fsh;
+   offt new_pos;
+   int rc;
+
+   switch (whence) {
+
+      case SEEK_SET:
+         new_pos = off;
+         break;
+
+      case SEEK_CUR:
+         new_pos = h->pos + off;
+         break;
+
+      case SEEK_END:
+
+         if (!h->buf)
+            if ((rc = procfs_render(h)))
+               return rc;
+
+         new_pos = (offt)h->buf_used + off;
+         break;
+
+      default:
+         return -EINVAL;
+   }
+
+   if (new_pos < 0)
+      return -EINVAL;
+
+   /* Rewinding the file means that the caller wants fresh data */
+   if (!new_pos && whence == SEEK_SET)
+      procfs_drop_rendered_data(h);
+
+   h->pos = new_pos;
+   return h->pos;
+}
+
+static offt
+procfs_dir_seek(fs_handle fsh, offt off, int whence)
+{
+   struct procfs_handle *h = fsh;
+
+   /* Only rewinddir() is supported */
+   if (off != 0 || whence != SEEK_SET)
+      return -EINVAL;
+
+   h->dpos = 0;
+   h->pos = 0;
+   return 0;
+}
+
+static const struct file_ops static_ops_procfs_file =
+{
+   .read = procfs_read,
+   .seek = procfs_seek,
+};
+
+static const struct file_ops static_ops_procfs_dir =
+{
+   .seek = procfs_dir_seek,
+};
+
+static int
+procfs_open(struct vfs_path *p, fs_handle *out, int fl, mode_t mod)
+{
+   vfs_inode_ptr_t e = p->fs_path.inode;
+   struct procfs_handle *h;
+
+   if (!e)
+      return (fl & O_CREAT) ? -EROFS : -ENOENT;
+
+   if ((fl & O_CREAT) && (fl & O_EXCL))
+      return -EEXIST;
+
+   if (fl & (O_WRONLY | O_RDWR))
+      return procfs_is_dir(e) ? -EISDIR : -EROFS;
+
+   if (!(h = kzmalloc(sizeof(struct procfs_handle))))
+      return -ENOMEM;
+
+   vfs_init_fs_handle_base_fields((void *)h,
+                                  p->fs,
+                                  procfs_is_dir(e)
+                                    ? &static_ops_procfs_dir
+                                    : &static_ops_procfs_file);
+   h->entry = e;
+   *out = h;
+   return 0;
+}
+
+static void
+procfs_close(fs_handle fsh)
+{
+   struct procfs_handle *h = fsh;
+
+   if (!procfs_is_dir(h->entry))
+      procfs_drop_rendered_data(h);
+
+   kfree2(h, sizeof(struct procfs_handle));
+}
+
+static int
+procfs_dup(fs_handle fsh, fs_handle *dup_h)
+{
+   struct procfs_handle *h = fsh;
+   struct procfs_handle *h2;
+
+   if (!(h2 = kmalloc(sizeof(struct procfs_handle))))
+      return -ENOMEM;
+
+   memcpy(h2, h, sizeof(struct procfs_handle));
+
+   if (!procfs_is_dir(h->entry) && h->buf) {
+
+      if (!(h2->buf = kmalloc(h->buf_size))) {
+         kfree2(h2, sizeof(struct procfs_handle));
+         return -ENOMEM;
+      }
+
+      memcpy(h2->buf, h->buf, h->buf_used);
+   }
+
+   *dup_h = h2;
+   return 0;
+}
+
+struct procfs_pids_batch {
+
+   int first;
+   int count;
+   int pids[PROCFS_PIDS_BATCH];
+};
+
+static int
+procfs_get_pids_batch_cb(void *obj, void *arg)
+{
+   struct task *ti = obj;
+   struct procfs_pids_batch *batch = arg;
+
+   if (is_kernel_thread(ti) || ti->tid != ti->pi->pid)
+      return 0;
+
+   if (ti->tid < batch->first)
+      return 0;
+
+   batch->pids[batch->count++] = ti->tid;
+   return batch->count == PROCFS_PIDS_BATCH; /* stop when the batch is full */
+}
+
+static int
+procfs_getdents_files(struct procfs_handle *h,
+                      const struct procfs_file *files,
+                      int files_count,
+                      int pid,
+                      get_dents_func_cb vfs_cb,
+                      void *arg)
+{
+   struct vfs_dent64 dent;
+   int rc;
+
+   for (; h->dpos < files_count; h->dpos++) {
+
+      const struct procfs_file *f = &files[h->dpos];
+
+      dent = (struct vfs_dent64) {
+         .ino  = (tilck_ino_t)(ulong)PROCFS_ENTRY(f->type, pid),
+         .type = VFS_FILE,
+         .name_len = (u8) strlen(f->name) + 1,
+         .name = f->name,
+         .inode = PROCFS_ENTRY(f->type, pid),
+      };
+
+      if ((rc = vfs_cb(&dent, arg)))
+         return rc;
+   }
+
+   return 0;
+}
+
+/*
+ * After the regular files, the root directory contains one directory for each
+ * user process. Since processes come and go, `dpos` just contains the minimum
+ * pid of the next directory to return (plus the number of regular files).
+ */
+static int
+procfs_getdents_pids(struct procfs_handle *h, get_dents_func_cb vfs_cb,
+                     void *arg)
+{
+   const int nf = ARRAY_SIZE(root_files);
+   struct procfs_pids_batch batch;
+   struct vfs_dent64 dent;
+   char name[16];
+   int rc;
+
+   do {
+
+      batch.first = h->dpos - nf;
+      batch.count = 0;
+
+      disable_preemption();
+      {
+         iterate_over_tasks(&procfs_get_pids_batch_cb, &batch);
+      }
+      enable_preemption();
+
+      for (int i = 0; i < batch.count; i++) {
+
+         snprintk(name, sizeof(name), "%d", batch.pids[i]);
+
+         dent = (struct vfs_dent64) {
+            .ino  = (tilck_ino_t)(ulong)PROCFS_ENTRY(PROCFS_PID_DIR,
+                                                     batch.pids[i]),
+            .type = VFS_DIR,
+            .name_len = (u8) strlen(name) + 1,
+            .name = name,
+            .inode = PROCFS_ENTRY(PROCFS_PID_DIR, batch.pids[i]),
+         };
+
+         if ((rc = vfs_cb(&dent, arg)))
+            return rc;
+
+         h->dpos = nf + batch.pids[i] + 1;
+      }
+
+   } while (batch.count == PROCFS_PIDS_BATCH);
+
+   return 0;
+}
+
+static int
+procfs_getdents(fs_handle fsh, get_dents_func_cb vfs_cb, void *arg)
+{
+   struct procfs_handle *h = fsh;
+   int rc;
+
+   if (!procfs_is_dir(h->entry))
+      return -ENOTDIR;
+
+   if (PROCFS_TYPE(h->entry) == PROCFS_PID_DIR) {
+      return procfs_getdents_files(h,
+                                   pid_files,
+                                   ARRAY_SIZE(pid_files),
+                                   PROCFS_PID(h->entry),
+                                   vfs_cb,
+                                   arg);
+   }
+
+   rc = procfs_getdents_files(h,
+                              root_files,
+                              ARRAY_SIZE(root_files),
+                              0,
+                              vfs_cb,
+                              arg);
+   if (rc)
+      return rc;
+
+   return procfs_getdents_pids(h, vfs_cb, arg);
+}
+
+static int
+procfs_stat(struct fs *fs, vfs_inode_ptr_t e, struct stat64 *statbuf)
+{
+   bzero(statbuf, sizeof(struct stat64));
+
+   statbuf->st_dev = fs->device_id;
+   statbuf->st_ino = (tilck_ino_t)(ulong)e;
+
+   if (procfs_is_dir(e)) {
+      statbuf->st_mode = 0555 | S_IFDIR;
+      statbuf->st_nlink = 2;
+   } else {
+      statbuf->st_mode = 0444 | S_IFREG;
+      statbuf->st_nlink = 1;
+   }
+
+   statbuf->st_uid = 0; /* root */
+   statbuf->st_gid = 0; /* root */
+
+   /* Like on Linux, the size is unknown until the files are read */
+   statbuf->st_size = 0;
+   statbuf->st_blksize = PAGE_SIZE;
+   statbuf->st_blocks = 0;
+
+   statbuf->st_ctim.tv_sec = (time_t)get_timestamp();
+   statbuf->st_mtim = statbuf->st_ctim;
+   statbuf->st_atim = statbuf->st_mtim;
+   return 0;
+}
+
+static bool
+procfs_name_eq(const char *s, const char *name, ssize_t nl)
+{
+   return !strncmp(s, name, (size_t)nl) && !s[nl];
+}
+
+static int
+procfs_parse_pid(const char *name, ssize_t nl)
+{
+   int pid = 0;
+
+   if (nl <= 0 || nl > 5 || name[0] == '0')
+      return -1;
+
+   for (ssize_t i = 0; i < nl; i++) {
+
+      if (!isdigit(name[i]))
+         return -1;
+
+      pid = pid * 10 + (name[i] - '0');
+   }
+
+   return pid;
+}
+
+static void
+procfs_get_entry(struct fs *fs,
+                 void *dir_inode,
+                 const char *name,
+                 ssize_t nl,
+                 struct fs_path *fs_path)
+{
+   vfs_inode_ptr_t root = PROCFS_ENTRY(PROCFS_ROOT, 0);
+   vfs_inode_ptr_t e = NULL;
+   int pid;
+
+   bzero(fs_path, sizeof(*fs_path));
+
+   if (!dir_inode && !name) {
+
+      *fs_path = (struct fs_path) {
+         .inode      = root,
+         .dir_inode  = root,
+         .dir_entry  = NULL,
+         .type       = VFS_DIR,
+      };
+
+      return;
+   }
+
+   if (is_dot_or_dotdot(name, (int)nl)) {
+
+      /* ".." in a pid dir is the root, in all the other cases it's "." */
+      e = (nl == 2) ? root : dir_inode;
+
+   } else if (PROCFS_TYPE(dir_inode) == PROCFS_ROOT) {
+
+      for (u32 i = 0; i < ARRAY_SIZE(root_files); i++) {
+         if (procfs_name_eq(root_files[i].name, name, nl)) {
+            e = PROCFS_ENTRY(root_files[i].type, 0);
+            break;
+         }
+      }
+
+      if (!e && (pid = procfs_parse_pid(name, nl)) > 0)
+         if (procfs_pid_exists(pid))
+            e = PROCFS_ENTRY(PROCFS_PID_DIR, pid);
+
+   } else if (PROCFS_TYPE(dir_inode) == PROCFS_PID_DIR) {
+
+      pid = PROCFS_PID(dir_inode);
+
+      for (u32 i = 0; i < ARRAY_SIZE(pid_files); i++) {
+         if (procfs_name_eq(pid_files[i].name, name, nl)) {
+            e = PROCFS_ENTRY(pid_files[i].type, pid);
+            break;
+         }
+      }
+   }
+
+   if (!e)
+      return;
+
+   *fs_path = (struct fs_path) {
+      .inode      = e,
+      .dir_inode  = dir_inode,
+      .dir_entry  = e,
+      .type       = procfs_is_dir(e) ? VFS_DIR : VFS_FILE,
+   };
+}
+
+static vfs_inode_ptr_t
+procfs_get_inode(fs_handle fsh)
+{
+   return ((struct procfs_handle *)fsh)->entry;
+}
+
+static int
+procfs_retain_inode(struct fs *fs, vfs_inode_ptr_t inode)
+{
+   /* procfs has no inodes in memory */
+   return 1;
+}
+
+static int
+procfs_release_inode(struct fs *fs, vfs_inode_ptr_t inode)
+{
+   /* procfs has no inodes in memory */
+   return 1;
+}
+
+static void procfs_no_lock(struct fs *fs) { }
+
+static const struct fs_ops static_fsops_procfs =
+{
+   .get_inode = procfs_get_inode,
+   .open = procfs_open,
+   .close = procfs_close,
+   .dup = procfs_dup,
+   .getdents = procfs_getdents,
+   .stat = procfs_stat,
+   .get_entry = procfs_get_entry,
+   .retain_inode = procfs_retain_inode,
+   .release_inode = procfs_release_inode,
+
+   /* The structure of procfs is immutable: no need for locking */
+   .fs_exlock = procfs_no_lock,
+   .fs_exunlock = procfs_no_lock,
+   .fs_shlock = procfs_no_lock,
+   .fs_shunlock = procfs_no_lock,
+};
+
+struct fs *create_procfs(void)
+{
+   struct fs *fs;
+
+   /* Disallow multiple instances of procfs */
+   ASSERT(procfs == NULL);
+
+   if (!(fs = create_fs_obj("procfs")))
+      return NULL;
+
+   fs->device_id = vfs_get_new_device_id();
+   fs->flags = 0; /* read-only */
+   fs->device_data = NULL;
+   fs->fsops = &static_fsops_procfs;
+
+   return fs;
+}
+
+void init_procfs(void)
+{
+   int rc;
+   procfs = create_procfs();
+
+   if (!procfs)
+      panic("Unable to create procfs");
+
+   if ((rc = mp_add(procfs, "/proc/")))
+      panic("mp_add() failed with error: %d", rc);
+}
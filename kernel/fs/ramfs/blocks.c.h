@@ -35,23 +35,63 @@ static void ramfs_destroy_block(struct ramfs_block *b)
    kfree2(b, sizeof(struct ramfs_block));
 }
 
+/*
+ * Holes in memory-mapped files are mapped read-only to the zero page (see
+ * ramfs_fault_around()). When a block is created for one of them, the stale
+ * zero-page mappings have to go away: the next access will fault and map the
+ * actual block.
+ */
+static void
+ramfs_unmap_zero_pages(struct ramfs_inode *inode, struct ramfs_block *block)
+{
+   const size_t off = (size_t)block->offset;
+   struct user_mapping *um;
+   ulong va, pa;
+
+   ASSERT(!is_preemption_enabled());
+
+   list_for_each_ro(um, &inode->mappings_list, inode_node) {
+
+      if (off < um->off || off >= um->off + um->len)
+         continue;
+
+      va = um->vaddr + (off - um->off);
+
+      if (get_mapping2(um->pi->pdir, (void *)va, &pa) < 0)
+         continue; /* not mapped */
+
+      if (pa != KERNEL_VA_TO_PA(zero_page))
+         continue;
+
+      unmap_page_permissive(um->pi->pdir, (void *)va, false);
+      invalidate_page(va);
+   }
+}
+
 static void
 ramfs_append_new_block(struct ramfs_inode *inode, struct ramfs_block *block)
 {
-   DEBUG_ONLY_UNSAFE(bool success =)
-      bintree_insert_ptr(&inode->blocks_tree_root,
-                         block,
-                         struct ramfs_block,
-                         node,
-                         offset);
-
-   ASSERT(success);
-   inode->blocks_count++;
+   disable_preemption();
+   {
+      DEBUG_ONLY_UNSAFE(bool success =)
+         bintree_insert_ptr(&inode->blocks_tree_root,
+                            block,
+                            struct ramfs_block,
+                            node,
+                            offset);
+
+      ASSERT(success);
+      inode->blocks_count++;
+
+      if (!list_is_empty(&inode->mappings_list))
+         ramfs_unmap_zero_pages(inode, block);
+   }
+   enable_preemption();
 }
 
 static int ramfs_inode_extend(struct ramfs_inode *i, offt new_len)
 {
-   ASSERT(rwlock_wp_holding_exlock(&i->rwlock));
+   ASSERT(rwlock_rb_holding_exlock(&i->rwlock));
    ASSERT(new_len > i->fsize);
 
    i->fsize = new_len;
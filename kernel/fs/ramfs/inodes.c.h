@@ -9,7 +9,7 @@ static struct ramfs_inode *ramfs_new_inode(struct ramfs_data *d)
    if (!i)
       return NULL;
 
-   rwlock_wp_init(&i->rwlock, true);
+   rwlock_rb_init(&i->rwlock, true);
    list_init(&i->mappings_list);
 
    i->type = VFS_NONE;
@@ -114,7 +114,7 @@ static int ramfs_destroy_inode(struct ramfs_data *d, struct ramfs_inode *i)
          NOT_IMPLEMENTED();
    }
 
-   rwlock_wp_destroy(&i->rwlock);
+   rwlock_rb_destroy(&i->rwlock);
    kfree2(i, sizeof(struct ramfs_inode));
    return 0;
 }
@@ -30,7 +30,7 @@ static int ramfs_rmdir(struct vfs_path *p)
    struct ramfs_data *d = p->fs->device_data;
    struct ramfs_inode *i = rp->inode;
 
-   ASSERT(rwlock_wp_holding_exlock(&d->rwlock));
+   ASSERT(rwlock_rb_holding_exlock(&d->rwlock));
 
    if (rp->type != VFS_DIR)
       return -ENOTDIR;
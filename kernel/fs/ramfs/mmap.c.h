@@ -74,6 +74,115 @@ register_mapping:
    return 0;
 }
 
+/*
+ * Maps the pages of `um` in the file range [off, end), skipping the ones
+ * already mapped. Existing blocks are mapped directly, while holes are mapped
+ * read-only to the zero page: writing to them will cause a fault, handled by
+ * ramfs_handle_fault_int(). Returns the number of pages mapped.
+ */
+static size_t
+ramfs_map_range(struct process *pi, struct user_mapping *um, offt off, offt end)
+{
+   struct ramfs_inode *i = ((struct ramfs_handle *)um->h)->inode;
+   const u32 rw_fl = (um->prot & PROT_WRITE) ? PAGING_FL_RW : 0;
+   struct ramfs_block *b;
+   size_t cnt = 0;
+   void *va;
+   ulong pa;
+   u32 pg_flags;
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(IS_PAGE_ALIGNED(off));
+
+   for (; off < end; off += PAGE_SIZE) {
+
+      va = (void *)(um->vaddr + ((size_t)off - um->off));
+
+      if (is_mapped(pi->pdir, va))
+         continue;
+
+      b = bintree_find_ptr(i->blocks_tree_root,
+                           off,
+                           struct ramfs_block,
+                           node,
+                           offset);
+
+      pa = KERNEL_VA_TO_PA(b ? b->vaddr : zero_page);
+      pg_flags = PAGING_FL_US | PAGING_FL_SHARED | (b ? rw_fl : 0);
+
+      if (map_page(pi->pdir, va, pa, pg_flags))
+         break; /* Out of memory: that's fine, just stop here */
+
+      cnt++;
+   }
+
+   return cnt;
+}
+
+/*
+ * Returns the number of pages to map on a fault at `off`. Faults happening
+ * exactly where the previous fault-around window ended are considered
+ * sequential and make the window grow; any other fault resets it.
+ */
+static u32 ramfs_fault_around_pages(struct ramfs_handle *rh, offt off)
+{
+   switch (rh->advice) {
+
+      case POSIX_FADV_RANDOM:
+         return 1;
+
+      case POSIX_FADV_SEQUENTIAL:
+         return RAMFS_RA_MAX_PAGES;
+
+      default:
+
+         if (rh->ra_pages && off == rh->ra_next)
+            return MIN(rh->ra_pages * 2, (u32)RAMFS_RA_MAX_PAGES);
+
+         return RAMFS_RA_MIN_PAGES;
+   }
+}
+
+static void
+ramfs_fault_around(struct process *pi,
+                   struct ramfs_handle *rh,
+                   struct user_mapping *um,
+                   offt off)
+{
+   struct ramfs_inode *i = rh->inode;
+   const u32 pages = ramfs_fault_around_pages(rh, off);
+   const offt um_end = (offt)(um->off + um->len);
+   const offt f_end = (offt)pow2_round_up_at((ulong)i->fsize, PAGE_SIZE);
+   const offt end = MIN3(off + (offt)(pages * PAGE_SIZE), um_end, f_end);
+
+   ramfs_map_range(pi, um, off + (offt)PAGE_SIZE, end);
+   rh->ra_pages = pages;
+   rh->ra_next = end;
+}
+
+static struct ramfs_block *
+ramfs_get_or_create_block(struct ramfs_inode *i, offt page)
+{
+   struct ramfs_block *b;
+
+   b = bintree_find_ptr(i->blocks_tree_root,
+                        page,
+                        struct ramfs_block,
+                        node,
+                        offset);
+
+   if (!b) {
+
+      /* Create on-the-fly a struct ramfs_block */
+      if (!(b = ramfs_new_block(page)))
+         panic("Out-of-memory: unable to alloc a ramfs_block. No OOM killer");
+
+      ramfs_append_new_block(i, b);
+   }
+
+   return b;
+}
+
 static bool
 ramfs_handle_fault_int(struct process *pi,
                        struct ramfs_handle *rh,
@@ -82,8 +191,11 @@ ramfs_handle_fault_int(struct process *pi,
                        bool rw)
 {
    ulong vaddr = (ulong) vaddrp;
-   ulong abs_off;
+   void *page_va = (void *)(vaddr & PAGE_MASK);
+   struct ramfs_inode *i = rh->inode;
    struct ramfs_block *block;
+   offt page;
+   ulong pa;
    int rc;
    struct user_mapping *um = process_get_user_mapping(vaddrp);
 
@@ -91,42 +203,68 @@ ramfs_handle_fault_int(struct process *pi,
       return false; /* Weird, but it's OK */
 
    ASSERT(um->h == rh);
+   page = (offt)(um->off + (vaddr - um->vaddr)) & (offt)PAGE_MASK;
 
    if (p) {
 
       /*
-       * The page is present, just is read-only and the user code tried to
-       * write: there's nothing we can do.
+       * The page is present, but it's read-only and the user code tried to
+       * write. The only case we can handle is a writable mapping of a hole,
+       * currently mapped to the zero page.
        */
 
       ASSERT(rw);
-      ASSERT((um->prot & PROT_WRITE) == 0);
-      return false;
+
+      if (!(um->prot & PROT_WRITE))
+         return false;
+
+      if (get_mapping2(pi->pdir, page_va, &pa) < 0)
+         return false;
+
+      if (pa != KERNEL_VA_TO_PA(zero_page))
+         return false;
+
+      /* NOTE: creating the block unmaps the zero page from all the mappings */
+      block = ramfs_get_or_create_block(i, page);
+
+      if (is_mapped(pi->pdir, page_va))
+         unmap_page_permissive(pi->pdir, page_va, false);
+
+      rc = map_page(pi->pdir,
+                    page_va,
+                    KERNEL_VA_TO_PA(block->vaddr),
+                    PAGING_FL_US | PAGING_FL_RW | PAGING_FL_SHARED);
+
+      if (rc)
+         panic("Out-of-memory: unable to map a ramfs_block. No OOM killer");
+
+      invalidate_page(vaddr);
+      return true;
    }
 
    /* The page is *not* present */
-   abs_off = um->off + (vaddr - um->vaddr);
-
-   if (abs_off >= (ulong)rh->inode->fsize)
+   if (page >= i->fsize)
       return false; /* Read/write past EOF */
 
    if (rw) {
-      /* Create and map on-the-fly a struct ramfs_block */
-      if (!(block = ramfs_new_block((offt)(abs_off & PAGE_MASK))))
-         panic("Out-of-memory: unable to alloc a ramfs_block. No OOM killer");
 
-      ramfs_append_new_block(rh->inode, block);
-   }
+      block = ramfs_get_or_create_block(i, page);
+
+      rc = map_page(pi->pdir,
+                    page_va,
+                    KERNEL_VA_TO_PA(block->vaddr),
+                    PAGING_FL_US | PAGING_FL_RW | PAGING_FL_SHARED);
 
-   rc = map_page(pi->pdir,
-                 (void *)(vaddr & PAGE_MASK),
-                 KERNEL_VA_TO_PA(rw ? block->vaddr : &zero_page),
-                 PAGING_FL_US | PAGING_FL_RW | PAGING_FL_SHARED);
+   } else {
+
+      rc = ramfs_map_range(pi, um, page, page + (offt)PAGE_SIZE) ? 0 : -ENOMEM;
+   }
 
    if (rc)
       panic("Out-of-memory: unable to map a ramfs_block. No OOM killer");
 
    invalidate_page(vaddr);
+   ramfs_fault_around(pi, rh, um, page);
    return true;
 }
 
@@ -144,3 +282,71 @@ ramfs_handle_fault(fs_handle h, void *vaddrp, bool p, bool rw)
    enable_preemption();
    return ret;
 }
+
+/*
+ * POSIX_FADV_WILLNEED: all the data is already in memory, but we can still
+ * save the page faults by pre-populating the current process' mappings of the
+ * given range.
+ */
+static void
+ramfs_willneed(struct process *pi, struct ramfs_inode *i, offt off, offt len)
+{
+   const offt f_end = (offt)pow2_round_up_at((ulong)i->fsize, PAGE_SIZE);
+   const offt end = len > 0 && len < f_end - off ? off + len : f_end;
+   struct user_mapping *um;
+   offt s, e;
+
+   list_for_each_ro(um, &i->mappings_list, inode_node) {
+
+      if (um->pi != pi)
+         continue;
+
+      s = MAX(off & (offt)PAGE_MASK, (offt)um->off);
+      e = MIN(end, (offt)(um->off + um->len));
+
+      if (s < e)
+         ramfs_map_range(pi, um, s, e);
+   }
+}
+
+static int ramfs_fadvise(fs_handle h, offt off, offt len, int advice)
+{
+   struct ramfs_handle *rh = h;
+   struct ramfs_inode *i = rh->inode;
+
+   if (i->type != VFS_FILE)
+      return 0;
+
+   switch (advice) {
+
+      case POSIX_FADV_NORMAL:
+      case POSIX_FADV_RANDOM:
+      case POSIX_FADV_SEQUENTIAL:
+         ramfs_file_shlock(h);
+         disable_preemption();
+         {
+            /* The page faults use these fields with preemption disabled */
+            rh->advice = advice;
+            rh->ra_pages = 0;
+         }
+         enable_preemption();
+         ramfs_file_shunlock(h);
+         break;
+
+      case POSIX_FADV_WILLNEED:
+         ramfs_file_shlock(h);
+         disable_preemption();
+         {
+            ramfs_willneed(get_curr_proc(), i, off, len);
+         }
+         enable_preemption();
+         ramfs_file_shunlock(h);
+         break;
+
+      default:
+         /* DONTNEED, NOREUSE: there's no other copy of the data to drop */
+         break;
+   }
+
+   return 0;
+}
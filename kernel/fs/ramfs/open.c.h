@@ -6,11 +6,14 @@ static const struct file_ops static_ops_ramfs =
    .write = ramfs_write,
    .readv = ramfs_readv,
    .writev = ramfs_writev,
+   .pread = ramfs_pread,
+   .pwrite = ramfs_pwrite,
    .seek = ramfs_seek,
    .ioctl = ramfs_ioctl,
    .mmap = ramfs_mmap,
    .munmap = ramfs_munmap,
    .handle_fault = ramfs_handle_fault,
+   .fadvise = ramfs_fadvise,
 };
 
 static int
@@ -9,6 +9,7 @@
 #include <tilck/kernel/fs/flock.h>
 
 #include <sys/mman.h>      // system header
+#include <fcntl.h>         // system header
 
 #include "ramfs_int.h"
 #include "getdents.c.h"
@@ -29,7 +30,7 @@ static int ramfs_unlink(struct vfs_path *p)
    struct ramfs_inode *i = rp->inode;
    struct ramfs_inode *idir = rp->dir_inode;
 
-   ASSERT(rwlock_wp_holding_exlock(&d->rwlock));
+   ASSERT(rwlock_rb_holding_exlock(&d->rwlock));
 
    if (i->type == VFS_DIR)
       return -EISDIR;
@@ -123,7 +124,7 @@ static void ramfs_err_case_destroy(struct fs *fs)
          ramfs_destroy_inode(d, d->root);
       }
 
-      rwlock_wp_destroy(&d->rwlock);
+      rwlock_rb_destroy(&d->rwlock);
       kfree2(d, sizeof(struct ramfs_data));
    }
 
@@ -218,7 +219,7 @@ static int ramfs_chmod(struct fs *fs, vfs_inode_ptr_t inode, mode_t mode)
    struct ramfs_inode *i = inode;
    int rc;
 
-   rwlock_wp_exlock(&i->rwlock);
+   rwlock_rb_exlock(&i->rwlock);
    {
       const mode_t special_bits = mode & (mode_t)~0777;
       const mode_t curr_spec_bits = i->mode & (mode_t)~0777;
@@ -234,7 +235,7 @@ static int ramfs_chmod(struct fs *fs, vfs_inode_ptr_t inode, mode_t mode)
          rc = -EPERM;
       }
    }
-   rwlock_wp_exunlock(&i->rwlock);
+   rwlock_rb_exunlock(&i->rwlock);
    return rc;
 }
 
@@ -246,7 +247,7 @@ ramfs_rename(struct fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
    int rc;
 
    DEBUG_ONLY_UNSAFE(struct ramfs_data *d = fs->device_data);
-   ASSERT(rwlock_wp_holding_exlock(&d->rwlock));
+   ASSERT(rwlock_rb_holding_exlock(&d->rwlock));
 
    if (newp->inode != NULL) {
 
@@ -362,7 +363,7 @@ struct fs *ramfs_create(void)
    }
 
    fs->device_data = d;
-   rwlock_wp_init(&d->rwlock, false);
+   rwlock_rb_init(&d->rwlock, false);
    d->next_inode_num = 1;
    d->root = ramfs_create_inode_dir(d, 0777, NULL);
 
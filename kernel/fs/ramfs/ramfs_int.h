@@ -63,7 +63,7 @@ struct ramfs_inode {
 
    tilck_ino_t ino;
    enum vfs_entry_type type;
-   struct rwlock_wp rwlock;
+   struct rwlock_rb rwlock;
    nlink_t nlink;
    mode_t mode;
    size_t blocks_count;                /* count of page-size blocks */
@@ -111,11 +111,30 @@ struct ramfs_handle {
       struct list_node node;        /* node in inode->handles_list */
       struct ramfs_entry *dpos;     /* current entry position */
    };
+
+   /*
+    * Valid only if inode->type == VFS_FILE (see ramfs_fault_around()).
+    * Accessed only with preemption disabled.
+    */
+   struct {
+      int advice;                   /* last POSIX_FADV_* access pattern */
+      offt ra_next;                 /* where a sequential fault would be */
+      u32 ra_pages;                 /* current fault-around window */
+   };
 };
 
+/*
+ * Fault-around windows, in pages. With the default advice, the window starts
+ * at RAMFS_RA_MIN_PAGES and doubles on each sequential fault, up to
+ * RAMFS_RA_MAX_PAGES. POSIX_FADV_SEQUENTIAL jumps directly to the max, while
+ * POSIX_FADV_RANDOM disables the fault-around logic.
+ */
+#define RAMFS_RA_MIN_PAGES           4
+#define RAMFS_RA_MAX_PAGES          32
+
 struct ramfs_data {
 
-   struct rwlock_wp rwlock;
+   struct rwlock_rb rwlock;
 
    tilck_ino_t next_inode_num;
    struct ramfs_inode *root;
@@ -175,7 +175,7 @@ static void ramfs_unmap_past_eof_mappings(struct ramfs_inode *i, size_t len)
 
 static int ramfs_inode_truncate(struct ramfs_inode *i, offt len)
 {
-   ASSERT(rwlock_wp_holding_exlock(&i->rwlock));
+   ASSERT(rwlock_rb_holding_exlock(&i->rwlock));
 
    if (len < 0 || len >= i->fsize)
       return -EINVAL;
@@ -224,7 +224,7 @@ static int
 ramfs_inode_truncate_safe(struct ramfs_inode *i, offt len, bool no_perm_check)
 {
    int rc;
-   rwlock_wp_exlock(&i->rwlock);
+   rwlock_rb_exlock(&i->rwlock);
    {
       if ((i->mode & 0200) || no_perm_check) { /* write permission */
 
@@ -239,7 +239,7 @@ ramfs_inode_truncate_safe(struct ramfs_inode *i, offt len, bool no_perm_check)
          rc = -EACCES;
       }
    }
-   rwlock_wp_exunlock(&i->rwlock);
+   rwlock_rb_exunlock(&i->rwlock);
    return rc;
 }
 
@@ -248,10 +248,14 @@ static int ramfs_truncate(struct fs *fs, vfs_inode_ptr_t i, offt len)
    return ramfs_inode_truncate_safe(i, len, false);
 }
 
+/*
+ * Reads up to `len` bytes at the offset `pos`. Does not touch the handle's
+ * position: that allows ramfs_pread() to run concurrently with other readers
+ * sharing the same handle.
+ */
 static ssize_t
-ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len)
+ramfs_read_at_nolock(struct ramfs_inode *inode, char *buf, size_t len, offt pos)
 {
-   struct ramfs_inode *inode = rh->inode;
    offt tot_read = 0;
    offt buf_rem = (offt) len;
    ASSERT(inode->type == VFS_FILE);
@@ -262,13 +266,13 @@ ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len)
    while (buf_rem > 0) {
 
       struct ramfs_block *block;
-      const offt page     = rh->pos & (offt)PAGE_MASK;
-      const offt page_off = rh->pos & (offt)OFFSET_IN_PAGE_MASK;
+      const offt page     = pos & (offt)PAGE_MASK;
+      const offt page_off = pos & (offt)OFFSET_IN_PAGE_MASK;
       const offt page_rem = (offt)PAGE_SIZE - page_off;
-      const offt file_rem = inode->fsize - rh->pos;
+      const offt file_rem = inode->fsize - pos;
       const offt to_read  = MIN3(page_rem, buf_rem, file_rem);
 
-      if (rh->pos >= inode->fsize)
+      if (pos >= inode->fsize)
          break;
 
       ASSERT(to_read >= 0);
@@ -291,13 +295,24 @@ ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len)
       }
 
       tot_read += to_read;
-      rh->pos  += to_read;
+      pos      += to_read;
       buf_rem  -= to_read;
    }
 
    return (ssize_t) tot_read;
 }
 
+static ssize_t
+ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len)
+{
+   ssize_t rc = ramfs_read_at_nolock(rh->inode, buf, len, rh->pos);
+
+   if (rc > 0)
+      rh->pos += rc;
+
+   return rc;
+}
+
 static ssize_t ramfs_read(fs_handle h, char *buf, size_t len)
 {
    struct ramfs_handle *rh = h;
@@ -311,24 +326,40 @@ static ssize_t ramfs_read(fs_handle h, char *buf, size_t len)
    return ret;
 }
 
+static ssize_t ramfs_pread(fs_handle h, char *buf, size_t len, offt pos)
+{
+   struct ramfs_handle *rh = h;
+   ssize_t ret;
+
+   ramfs_file_shlock(h);
+   {
+      ret = ramfs_read_at_nolock(rh->inode, buf, len, pos);
+   }
+   ramfs_file_shunlock(h);
+   return ret;
+}
+
+/*
+ * Writes `len` bytes at the offset `pos`, without touching the handle's
+ * position. Returns the number of bytes written.
+ */
 static ssize_t
-ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len)
+ramfs_write_at_nolock(struct ramfs_inode *inode,
+                      char *buf,
+                      size_t len,
+                      offt pos)
 {
-   struct ramfs_inode *inode = rh->inode;
    offt tot_written = 0;
    offt buf_rem = (offt)len;
 
    /* We can be sure it's a file because dirs cannot be open for writing */
    ASSERT(inode->type == VFS_FILE);
 
-   if (rh->fl_flags & O_APPEND)
-      rh->pos = inode->fsize;
-
    while (buf_rem > 0) {
 
       struct ramfs_block *block;
-      const offt page     = rh->pos & (offt)PAGE_MASK;
-      const offt page_off = rh->pos & (offt)OFFSET_IN_PAGE_MASK;
+      const offt page     = pos & (offt)PAGE_MASK;
+      const offt page_off = pos & (offt)OFFSET_IN_PAGE_MASK;
       const offt page_rem = (offt)PAGE_SIZE - page_off;
       const offt to_write = MIN(page_rem, buf_rem);
 
@@ -340,9 +371,6 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len)
                                node,
                                offset);
 
-      /* Assert that if page_off > 0, the block is present */
-      ASSERT(!page_off || block);
-
       if (!block) {
 
          if (!(block = ramfs_new_block(page)))
@@ -354,10 +382,10 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len)
       memcpy(block->vaddr + page_off, buf + tot_written, (size_t)to_write);
       tot_written += to_write;
       buf_rem     -= to_write;
-      rh->pos     += to_write;
+      pos         += to_write;
 
-      if (rh->pos > inode->fsize)
-         inode->fsize = rh->pos;
+      if (pos > inode->fsize)
+         inode->fsize = pos;
    }
 
    if (len > 0 && !tot_written)
@@ -366,6 +394,22 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len)
    return (ssize_t)tot_written;
 }
 
+static ssize_t
+ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len)
+{
+   ssize_t rc;
+
+   if (rh->fl_flags & O_APPEND)
+      rh->pos = rh->inode->fsize;
+
+   rc = ramfs_write_at_nolock(rh->inode, buf, len, rh->pos);
+
+   if (rc > 0)
+      rh->pos += rc;
+
+   return rc;
+}
+
 static ssize_t ramfs_write(fs_handle h, char *buf, size_t len)
 {
    struct ramfs_handle *rh = h;
@@ -379,6 +423,23 @@ static ssize_t ramfs_write(fs_handle h, char *buf, size_t len)
    return ret;
 }
 
+static ssize_t ramfs_pwrite(fs_handle h, char *buf, size_t len, offt pos)
+{
+   struct ramfs_handle *rh = h;
+   ssize_t ret;
+
+   ramfs_file_exlock(h);
+   {
+      /* Like Linux, with O_APPEND pwrite() appends, ignoring `pos` */
+      if (rh->fl_flags & O_APPEND)
+         pos = rh->inode->fsize;
+
+      ret = ramfs_write_at_nolock(rh->inode, buf, len, pos);
+   }
+   ramfs_file_exunlock(h);
+   return ret;
+}
+
 static ssize_t
 ramfs_readv_nolock(struct ramfs_handle *rh, const struct iovec *iov, int iovcnt)
 {
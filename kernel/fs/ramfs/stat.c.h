@@ -59,10 +59,10 @@ ramfs_stat(struct fs *fs, vfs_inode_ptr_t i, struct stat64 *statbuf)
    if (!inode)
       return -ENOENT;
 
-   rwlock_wp_shlock(&inode->rwlock);
+   rwlock_rb_shlock(&inode->rwlock);
    {
       rc = ramfs_stat_nolock(fs, inode, statbuf);
    }
-   rwlock_wp_shunlock(&inode->rwlock);
+   rwlock_rb_shunlock(&inode->rwlock);
    return rc;
 }
@@ -1,9 +1,12 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/syscalls.h>
+#include <tilck/common/utils.h>
 
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/fs/flock.h>
+#include <tilck/kernel/rwlock.h>
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/process.h>
@@ -12,6 +15,7 @@
 #include <tilck/kernel/debug_utils.h>
 
 #include <dirent.h> // system header
+#include <fcntl.h>  // system header
 
 #include "../fs_int.h"
 #include "vfs_mp.c.h"
@@ -188,7 +192,8 @@ int vfs_fstat64(fs_handle h, struct stat64 *statbuf)
 typedef int (*vfs_func_impl)(struct fs*, struct vfs_path*, ulong, ulong, ulong);
 
 static ALWAYS_INLINE int
-__vfs_path_funcs_wrapper(const char *path,
+__vfs_path_funcs_wrapper(fs_handle dirh,
+                         const char *path,
                          bool exlock,
                          bool res_last_sl,
                          vfs_func_impl func,
@@ -199,7 +204,7 @@ __vfs_path_funcs_wrapper(const char *path,
 
    NO_TEST_ASSERT(is_preemption_enabled());
 
-   if ((rc = vfs_resolve(path, &p, exlock, res_last_sl)) < 0)
+   if ((rc = vfs_resolve_at(dirh, path, &p, exlock, res_last_sl)) < 0)
       return rc;
 
    ASSERT(p.fs != NULL);
@@ -210,13 +215,17 @@ __vfs_path_funcs_wrapper(const char *path,
    return rc;
 }
 
-#define vfs_path_funcs_wrapper(path, exlock, rsl, func, a1, a2, a3)           \
-   __vfs_path_funcs_wrapper(path,                                             \
+#define vfs_path_funcs_wrapper_at(dh, path, exlock, rsl, func, a1, a2, a3)    \
+   __vfs_path_funcs_wrapper(dh,                                               \
+                            path,                                             \
                             exlock,                                           \
                             rsl,                                              \
                             (vfs_func_impl)(void *)func,                      \
                             (ulong)a1, (ulong)a2, (ulong)a3)
 
+#define vfs_path_funcs_wrapper(path, exlock, rsl, func, a1, a2, a3)           \
+   vfs_path_funcs_wrapper_at(NULL, path, exlock, rsl, func, a1, a2, a3)
+
 static ALWAYS_INLINE int
 vfs_open_impl(struct fs *fs, struct vfs_path *p,
               fs_handle *out, int flags, mode_t mode)
@@ -291,6 +300,42 @@ int vfs_stat64(const char *path, struct stat64 *statbuf, bool res_last_sl)
    );
 }
 
+/*
+ * Like vfs_stat64(), but relative paths are resolved starting from the
+ * directory `dirh`, instead of from the current working directory. That saves
+ * the resolution of the whole path, when the caller has already an open handle
+ * to the parent directory (e.g. `ls -l` or `find` walking a tree).
+ */
+int vfs_fstatat64(fs_handle dirh,
+                  const char *path,
+                  struct stat64 *statbuf,
+                  bool res_last_sl)
+{
+   struct fs_handle_base *hb = dirh;
+   struct stat64 dir_st;
+   int rc;
+
+   if (hb && *path != '/') {
+
+      if ((rc = vfs_fstat64(dirh, &dir_st)))
+         return rc;
+
+      if (!S_ISDIR(dir_st.st_mode))
+         return -ENOTDIR;
+   }
+
+   return vfs_path_funcs_wrapper_at(
+      dirh,
+      path,
+      false,               /* exlock */
+      res_last_sl,         /* res_last_sl */
+      &vfs_stat64_impl,
+      statbuf,
+      res_last_sl,
+      0
+   );
+}
+
 static ALWAYS_INLINE int
 vfs_mkdir_impl(struct fs *fs, struct vfs_path *p, mode_t mode, ulong x, ulong y)
 {
@@ -712,6 +757,26 @@ int vfs_futimens(fs_handle h, const struct k_timespec64 times[2])
    return fsops->futimens(hb->fs, fsops->get_inode(h), times);
 }
 
+int vfs_fadvise(fs_handle h, offt off, offt len, int advice)
+{
+   struct fs_handle_base *hb = h;
+   const struct file_ops *fops = hb->fops;
+
+   if (!fops->seek)
+      return -ESPIPE;
+
+   if (off < 0 || len < 0)
+      return -EINVAL;
+
+   if (advice < POSIX_FADV_NORMAL || advice > POSIX_FADV_NOREUSE)
+      return -EINVAL;
+
+   if (!fops->fadvise)
+      return 0;
+
+   return fops->fadvise(h, off, len, advice);
+}
+
 ssize_t vfs_readv(fs_handle h, const struct iovec *iov, int iovcnt)
 {
    struct fs_handle_base *hb = h;
@@ -807,6 +872,147 @@ ssize_t vfs_writev(fs_handle h, const struct iovec *iov, int iovcnt)
    return ret;
 }
 
+/*
+ * Generic positional I/O, for the file systems not implementing pread/pwrite.
+ * It's emulated by moving the handle's position back and forth, which is NOT
+ * atomic: a thread sharing the same handle might observe the temporary change
+ * of position. There's nothing better we can do at this level.
+ */
+static ssize_t
+vfs_prw_generic(fs_handle h, void *buf, size_t buf_size, offt off, bool wr)
+{
+   struct fs_handle_base *hb = h;
+   offt saved_pos, rc2;
+   ssize_t rc;
+
+   if ((saved_pos = hb->fops->seek(h, 0, SEEK_CUR)) < 0)
+      return saved_pos;
+
+   if ((rc2 = hb->fops->seek(h, off, SEEK_SET)) < 0)
+      return rc2;
+
+   if (wr)
+      rc = hb->fops->write(h, buf, buf_size);
+   else
+      rc = hb->fops->read(h, buf, buf_size);
+
+   hb->fops->seek(h, saved_pos, SEEK_SET);
+   return rc;
+}
+
+ssize_t vfs_pread(fs_handle h, void *buf, size_t buf_size, offt off)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   struct fs_handle_base *hb = (struct fs_handle_base *) h;
+
+   if (!hb->fops->read)
+      return -EBADF;
+
+   if ((hb->fl_flags & O_WRONLY) && !(hb->fl_flags & O_RDWR))
+      return -EBADF; /* file not opened for reading */
+
+   if (!hb->fops->seek)
+      return -ESPIPE;
+
+   if (off < 0)
+      return -EINVAL;
+
+   if (hb->fops->pread)
+      return hb->fops->pread(h, buf, buf_size, off);
+
+   return vfs_prw_generic(h, buf, buf_size, off, false);
+}
+
+ssize_t vfs_pwrite(fs_handle h, void *buf, size_t buf_size, offt off)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   struct fs_handle_base *hb = (struct fs_handle_base *) h;
+
+   if (!hb->fops->write)
+      return -EBADF;
+
+   if (!(hb->fl_flags & (O_WRONLY | O_RDWR)))
+      return -EBADF; /* file not opened for writing */
+
+   if (!hb->fops->seek)
+      return -ESPIPE;
+
+   if (off < 0)
+      return -EINVAL;
+
+   if (hb->fops->pwrite)
+      return hb->fops->pwrite(h, buf, buf_size, off);
+
+   return vfs_prw_generic(h, buf, buf_size, off, true);
+}
+
+ssize_t
+vfs_preadv(fs_handle h, const struct iovec *iov, int iovcnt, offt off)
+{
+   struct task *curr = get_curr_task();
+   ssize_t ret = 0;
+   ssize_t rc;
+   size_t len;
+
+   /* NOTE: like in vfs_readv(), this is not atomic across the iovecs */
+   for (int i = 0; i < iovcnt; i++) {
+
+      len = MIN(iov[i].iov_len, IO_COPYBUF_SIZE);
+      rc = vfs_pread(h, curr->io_copybuf, len, off + (offt)ret);
+
+      if (rc < 0) {
+         ret = ret ? ret : rc;
+         break;
+      }
+
+      if (copy_to_user(iov[i].iov_base, curr->io_copybuf, (size_t)rc))
+         return -EFAULT;
+
+      ret += rc;
+
+      if (rc < (ssize_t)iov[i].iov_len)
+         break; // Not enough data to fill all the user buffers.
+   }
+
+   return ret;
+}
+
+ssize_t
+vfs_pwritev(fs_handle h, const struct iovec *iov, int iovcnt, offt off)
+{
+   struct task *curr = get_curr_task();
+   ssize_t ret = 0;
+   ssize_t rc;
+   size_t len;
+
+   /* NOTE: like in vfs_writev(), this is not atomic across the iovecs */
+   for (int i = 0; i < iovcnt; i++) {
+
+      len = MIN(iov[i].iov_len, IO_COPYBUF_SIZE);
+
+      if (copy_from_user(curr->io_copybuf, iov[i].iov_base, len))
+         return -EFAULT;
+
+      rc = vfs_pwrite(h, curr->io_copybuf, len, off + (offt)ret);
+
+      if (rc < 0) {
+         ret = ret ? ret : rc;
+         break;
+      }
+
+      ret += rc;
+
+      if (rc < (ssize_t)iov[i].iov_len)
+         break;
+   }
+
+   return ret;
+}
+
 u32 vfs_get_new_device_id(void)
 {
    return next_device_id++;
@@ -3,12 +3,16 @@
 struct vfs_getdents_ctx {
 
    struct fs_handle_base *h;
-   struct linux_dirent64 *user_dirp;
+   void *user_dirp;
    u32 buf_size;
    u32 offset;
    u32 fs_flags;
    offt off;
-   struct linux_dirent64 ent;
+
+   union {
+      struct linux_dirent64 ent;          /* used by vfs_getdents64()    */
+      struct tilck_dirent_stat sent;      /* used by vfs_getdents_stat() */
+   };
 };
 
 static inline unsigned char
@@ -29,12 +33,9 @@ vfs_type_to_linux_dirent_type(enum vfs_entry_type t)
    return table[t];
 }
 
-static int vfs_getdents_cb(struct vfs_dent64 *vde, void *arg)
+/* Returns true if the dentry has to be skipped (see the comment below) */
+static bool vfs_getdents_skip_dent(struct vfs_getdents_ctx *ctx)
 {
-   const u16 entry_size = sizeof(struct linux_dirent64) + vde->name_len;
-   struct linux_dirent64 *user_ent;
-   struct vfs_getdents_ctx *ctx = arg;
-
    if (ctx->fs_flags & VFS_FS_RQ_DE_SKIP) {
 
       /*
@@ -51,26 +52,42 @@ static int vfs_getdents_cb(struct vfs_dent64 *vde, void *arg)
 
       if (ctx->off < ctx->h->pos) {
          ctx->off++;
-         return 0; /* skip the dentry */
+         return true;
       }
    }
 
-   if (ctx->offset + entry_size > ctx->buf_size) {
-
-      if (!ctx->offset) {
+   return false;
+}
 
-         /*
-          * We haven't "returned" any entries yet and the buffer is too small
-          * for our first entry.
-          */
+/* To be called when the user buffer does not have room for the next entry */
+static int vfs_getdents_no_space(struct vfs_getdents_ctx *ctx)
+{
+   if (!ctx->offset) {
 
-         return -EINVAL;
-      }
+      /*
+       * We haven't "returned" any entries yet and the buffer is too small
+       * for our first entry.
+       */
 
-      /* We "returned" at least one entry */
-      return (int) ctx->offset;
+      return -EINVAL;
    }
 
+   /* We "returned" at least one entry */
+   return (int) ctx->offset;
+}
+
+static int vfs_getdents_cb(struct vfs_dent64 *vde, void *arg)
+{
+   const u16 entry_size = sizeof(struct linux_dirent64) + vde->name_len;
+   struct linux_dirent64 *user_ent;
+   struct vfs_getdents_ctx *ctx = arg;
+
+   if (vfs_getdents_skip_dent(ctx))
+      return 0;
+
+   if (ctx->offset + entry_size > ctx->buf_size)
+      return vfs_getdents_no_space(ctx);
+
    ctx->ent.d_ino    = vde->ino;
    ctx->ent.d_off    = (u64) ctx->off + 1; /* "offset" (=ID) of the next dent */
    ctx->ent.d_reclen = entry_size;
@@ -90,7 +107,106 @@ static int vfs_getdents_cb(struct vfs_dent64 *vde, void *arg)
    return 0;
 }
 
-int vfs_getdents64(fs_handle h, struct linux_dirent64 *user_dirp, u32 buf_size)
+/*
+ * Gets the attributes of the entry `vde` in the directory `dir_inode`. When
+ * the fs provides the entry's inode, as ramfs does, there's no lookup at all.
+ */
+static int
+vfs_getdents_stat_dent(struct fs *fs,
+                       vfs_inode_ptr_t dir_inode,
+                       struct vfs_dent64 *vde,
+                       struct stat64 *st)
+{
+   vfs_inode_ptr_t inode = vde->inode;
+   struct fs *target_fs;
+   struct fs_path fsp;
+   int rc;
+
+   if (!inode) {
+
+      vfs_get_entry(fs, dir_inode, vde->name, vde->name_len - 1, &fsp);
+
+      if (!(inode = fsp.inode))
+         return -ENOENT;
+   }
+
+   if ((target_fs = mp_get_retained_at(fs, inode))) {
+
+      /* The entry is a mount-point: like lstat(), use the root of target fs */
+      vfs_fs_shlock(target_fs);
+      {
+         vfs_get_root_entry(target_fs, &fsp);
+         rc = target_fs->fsops->stat(target_fs, fsp.inode, st);
+      }
+      vfs_fs_shunlock(target_fs);
+      release_obj(target_fs);
+      return rc;
+   }
+
+   return fs->fsops->stat(fs, inode, st);
+}
+
+static int vfs_getdents_stat_cb(struct vfs_dent64 *vde, void *arg)
+{
+   const u16 entry_size = (u16)
+      pow2_round_up_at(sizeof(struct tilck_dirent_stat) + vde->name_len, 8);
+
+   struct vfs_getdents_ctx *ctx = arg;
+   struct fs *fs = ctx->h->fs;
+   struct tilck_dirent_stat *user_ent;
+   struct stat64 st;
+   int rc;
+
+   if (vfs_getdents_skip_dent(ctx))
+      return 0;
+
+   if (ctx->offset + entry_size > ctx->buf_size)
+      return vfs_getdents_no_space(ctx);
+
+   rc = vfs_getdents_stat_dent(fs, fs->fsops->get_inode(ctx->h), vde, &st);
+
+   if (rc)
+      return rc;
+
+   ctx->sent = (struct tilck_dirent_stat) {
+      .d_ino      = vde->ino,
+      .d_off      = (u64) ctx->off + 1,
+      .size       = (u64) st.st_size,
+      .blocks     = (u64) st.st_blocks,
+      .mtime      = st.st_mtim.tv_sec,
+      .ctime      = st.st_ctim.tv_sec,
+      .mtime_nsec = (u32) st.st_mtim.tv_nsec,
+      .ctime_nsec = (u32) st.st_ctim.tv_nsec,
+      .dev        = (u32) st.st_dev,
+      .rdev       = (u32) st.st_rdev,
+      .mode       = st.st_mode,
+      .nlink      = st.st_nlink,
+      .uid        = st.st_uid,
+      .gid        = st.st_gid,
+      .blksize    = (u32) st.st_blksize,
+      .d_reclen   = entry_size,
+      .d_type     = vfs_type_to_linux_dirent_type(vde->type),
+   };
+
+   user_ent = (void *)((char *)ctx->user_dirp + ctx->offset);
+
+   if (copy_to_user(user_ent, &ctx->sent, sizeof(ctx->sent)) < 0)
+      return -EFAULT;
+
+   if (copy_to_user(user_ent->d_name, vde->name, vde->name_len) < 0)
+      return -EFAULT;
+
+   ctx->offset += entry_size;
+   ctx->off++;
+   ctx->h->pos++;
+   return 0;
+}
+
+static int
+vfs_getdents_int(fs_handle h,
+                 void *user_dirp,
+                 u32 buf_size,
+                 get_dents_func_cb cb)
 {
    NO_TEST_ASSERT(is_preemption_enabled());
    struct fs_handle_base *hb = (struct fs_handle_base *) h;
@@ -106,13 +222,13 @@ int vfs_getdents64(fs_handle h, struct linux_dirent64 *user_dirp, u32 buf_size)
       .offset        = 0,
       .fs_flags      = hb->fs->flags,
       .off           = hb->fs->flags & VFS_FS_RQ_DE_SKIP ? 0 : ctx.h->pos,
-      .ent           = { 0 },
+      .sent          = { 0 },
    };
 
    /* See the comment in vfs.h about the "fs-locks" */
    vfs_fs_shlock(hb->fs);
    {
-      rc = hb->fs->fsops->getdents(hb, &vfs_getdents_cb, &ctx);
+      rc = hb->fs->fsops->getdents(hb, cb, &ctx);
 
       if (!rc)
          rc = (int) ctx.offset;
@@ -120,3 +236,19 @@ int vfs_getdents64(fs_handle h, struct linux_dirent64 *user_dirp, u32 buf_size)
    vfs_fs_shunlock(hb->fs);
    return rc;
 }
+
+int vfs_getdents64(fs_handle h, struct linux_dirent64 *user_dirp, u32 buf_size)
+{
+   return vfs_getdents_int(h, user_dirp, buf_size, &vfs_getdents_cb);
+}
+
+/*
+ * Like vfs_getdents64(), but each entry comes with its attributes too, which
+ * are gathered during the same walk of the directory. That saves a stat()
+ * per entry, each one with a full path resolution, to programs like `ls -l`.
+ */
+int
+vfs_getdents_stat(fs_handle h, struct tilck_dirent_stat *user_dirp, u32 bs)
+{
+   return vfs_getdents_int(h, user_dirp, bs, &vfs_getdents_stat_cb);
+}
@@ -1,6 +1,10 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
-static struct kmutex mp_mutex = STATIC_KMUTEX_INIT(mp_mutex, 0);
+/*
+ * Mountpoints get looked up on every path resolution, while they change only
+ * on mount: use a reader-biased rwlock.
+ */
+static struct rwlock_rb mp_lock = STATIC_RWLOCK_RB_INIT(mp_lock, false);
 static struct mountpoint mps2[MAX_MOUNTPOINTS];
 static struct fs *mp_root;
 
@@ -26,7 +30,8 @@ struct fs *mp_get_root(void)
 
 struct fs *mp_get_at_nolock(struct fs *host_fs, vfs_inode_ptr_t inode)
 {
-   ASSERT(kmutex_is_curr_task_holding_lock(&mp_mutex));
+   ASSERT(rwlock_rb_is_shlocked(&mp_lock) ||
+          rwlock_rb_holding_exlock(&mp_lock));
 
    for (u32 i = 0; i < ARRAY_SIZE(mps2); i++)
       if (mps2[i].host_fs_inode == inode && mps2[i].host_fs == host_fs)
@@ -38,12 +43,12 @@ struct fs *mp_get_at_nolock(struct fs *host_fs, vfs_inode_ptr_t inode)
 struct fs *mp_get_retained_at(struct fs *host_fs, vfs_inode_ptr_t inode)
 {
    struct fs *ret;
-   kmutex_lock(&mp_mutex);
+   rwlock_rb_shlock(&mp_lock);
    {
       if ((ret = mp_get_at_nolock(host_fs, inode)))
          retain_obj(ret);
    }
-   kmutex_unlock(&mp_mutex);
+   rwlock_rb_shunlock(&mp_lock);
    return ret;
 }
 
@@ -52,7 +57,7 @@ struct mountpoint *mp_get_retained_mp_of(struct fs *target_fs)
    ulong i;
    struct mountpoint *res = NULL;
 
-   kmutex_lock(&mp_mutex);
+   rwlock_rb_shlock(&mp_lock);
    {
       for (i = 0; i < ARRAY_SIZE(mps2); i++)
          if (mps2[i].target_fs == target_fs)
@@ -63,7 +68,7 @@ struct mountpoint *mp_get_retained_mp_of(struct fs *target_fs)
          retain_obj(res);
       }
    }
-   kmutex_unlock(&mp_mutex);
+   rwlock_rb_shunlock(&mp_lock);
    return res;
 }
 
@@ -95,21 +100,21 @@ int mp_add(struct fs *target_fs, const char *target_path)
     * `target_fs`.
     */
    vfs_fs_shunlock(p.fs);
-   kmutex_lock(&mp_mutex);
+   rwlock_rb_exlock(&mp_lock);
 
    /* we need to have the root struct fs set */
    ASSERT(mp_root != NULL);
 
    if (mp_get_at_nolock(p.fs, p.fs_path.inode)) {
       vfs_release_inode_at(&p);
-      kmutex_unlock(&mp_mutex);
+      rwlock_rb_exunlock(&mp_lock);
       return -EBUSY; /* the target path is already a mount-point */
    }
 
    for (i = 0; i < ARRAY_SIZE(mps2); i++) {
       if (mps2[i].target_fs == target_fs) {
          vfs_release_inode_at(&p);
-         kmutex_unlock(&mp_mutex);
+         rwlock_rb_exunlock(&mp_lock);
          return -EPERM; /* mounting multiple times a FS is NOT permitted */
       }
    }
@@ -142,7 +147,7 @@ int mp_add(struct fs *target_fs, const char *target_path)
       release_obj(p.fs);
    }
 
-   kmutex_unlock(&mp_mutex);
+   rwlock_rb_exunlock(&mp_lock);
    return rc;
 }
 
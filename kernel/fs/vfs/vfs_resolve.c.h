@@ -264,6 +264,15 @@ vfs_resolve_get_entry(struct vfs_resolve_int_ctx *ctx,
    if (lc == path)
       return 0;
 
+   /*
+    * Looking up an entry in something that's not a directory, as in
+    * "/proc/1/cmdline/x": that's ENOTDIR, not ENOENT. The filesystems' own
+    * get_entry() funcs cannot tell the difference, because they have no way
+    * to return an error.
+    */
+   if (rp->fs_path.type != VFS_DIR)
+      return -ENOTDIR;
+
    __vfs_resolve_get_entry(rp->fs_path.inode,
                            lc,
                            path,
@@ -359,10 +368,28 @@ get_locked_retained_cwd(struct vfs_path *rp, bool exlock)
    vfs_smart_fs_lock(rp->fs, exlock);
 }
 
+static void
+get_locked_retained_dir(struct vfs_path *rp, fs_handle dirh, bool exlock)
+{
+   struct fs_handle_base *hb = dirh;
+
+   rp->fs = hb->fs;
+   rp->fs_path = (struct fs_path) {
+      .inode = hb->fs->fsops->get_inode(dirh),
+      .type = VFS_DIR,
+   };
+
+   retain_obj(rp->fs);
+   vfs_smart_fs_lock(rp->fs, exlock);
+}
+
 /*
  * Resolves the path, locking the last struct fs with an exclusive or a shared
  * lock depending on `exlock`. The last component of the path, if a symlink, is
- * resolved only with `res_last_sl` is true.
+ * resolved only with `res_last_sl` is true. Relative paths are resolved
+ * starting from the directory `dirh` or from the current working directory,
+ * when `dirh` is NULL. It's up to the caller to check that `dirh` is a handle
+ * to a directory.
  *
  * NOTE: when the function succeedes (-> return 0), the struct fs is returned
  * as `rp->fs` RETAINED and LOCKED. The caller is supposed to first release the
@@ -370,10 +397,11 @@ get_locked_retained_cwd(struct vfs_path *rp, bool exlock)
  * FS with release_obj().
  */
 int
-vfs_resolve(const char *path,
-            struct vfs_path *rp,
-            bool exlock,
-            bool res_last_sl)
+vfs_resolve_at(fs_handle dirh,
+               const char *path,
+               struct vfs_path *rp,
+               bool exlock,
+               bool res_last_sl)
 {
    int rc;
 
@@ -397,6 +425,8 @@ vfs_resolve(const char *path,
 
    if (*path == '/')
       get_locked_retained_root(rp, exlock);
+   else if (dirh)
+      get_locked_retained_dir(rp, dirh, exlock);
    else
       get_locked_retained_cwd(rp, exlock);
 
@@ -435,3 +465,12 @@ vfs_resolve(const char *path,
 
    return rc;
 }
+
+int
+vfs_resolve(const char *path,
+            struct vfs_path *rp,
+            bool exlock,
+            bool res_last_sl)
+{
+   return vfs_resolve_at(NULL, path, rp, exlock, res_last_sl);
+}
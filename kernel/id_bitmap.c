@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/id_bitmap.h>
+
+static ALWAYS_INLINE int lowest_zero_bit(ulong w)
+{
+   ASSERT(w != ~0ul);
+   return __builtin_ctzl(~w);
+}
+
+void
+id_bitmap_init(struct id_bitmap *b, ulong *bits, ulong *full, int max_id)
+{
+   const int words = ID_BITMAP_WORDS(max_id);
+
+   ASSERT(max_id >= 0);
+
+   *b = (struct id_bitmap) {
+      .bits = bits,
+      .full = full,
+      .max_id = max_id,
+      .last = -1,
+   };
+
+   bzero(bits, sizeof(ulong) * (size_t)words);
+   bzero(full, sizeof(ulong) * (size_t)ID_BITMAP_FULL_WORDS(max_id));
+
+   /* The bits after max_id in the last word are never free */
+   for (int i = max_id + 1; i < words * NBITS; i++)
+      bitmap_set(bits, (ulong)i);
+
+   if (bits[words - 1] == ~0ul)
+      bitmap_set(full, (ulong)(words - 1));
+}
+
+void id_bitmap_set(struct id_bitmap *b, int id)
+{
+   const ulong w = (ulong)id / NBITS;
+
+   ASSERT(0 <= id && id <= b->max_id);
+   bitmap_set(b->bits, (ulong)id);
+
+   if (b->bits[w] == ~0ul)
+      bitmap_set(b->full, w);
+}
+
+void id_bitmap_clear(struct id_bitmap *b, int id)
+{
+   ASSERT(0 <= id && id <= b->max_id);
+   bitmap_clear(b->bits, (ulong)id);
+   bitmap_clear(b->full, (ulong)id / NBITS);
+}
+
+bool id_bitmap_test(struct id_bitmap *b, int id)
+{
+   ASSERT(0 <= id && id <= b->max_id);
+   return bitmap_test(b->bits, (ulong)id);
+}
+
+int id_bitmap_find_free(struct id_bitmap *b, int from)
+{
+   const int words = ID_BITMAP_WORDS(b->max_id);
+   const int full_words = ID_BITMAP_FULL_WORDS(b->max_id);
+   ulong w, fw;
+   int i, fi;
+
+   if (from < 0)
+      from = 0;
+
+   if (from > b->max_id)
+      return -1;
+
+   /* First, the word containing `from`, ignoring the bits before it */
+   i = from / NBITS;
+   w = b->bits[i] | ((1ul << (from % NBITS)) - 1);
+
+   if (w != ~0ul)
+      return i * NBITS + lowest_zero_bit(w);
+
+   /* Then, use the `full` bitmap to find the next word with a free ID */
+   i++;
+   fi = i / NBITS;
+
+   if (fi >= full_words)
+      return -1;
+
+   fw = b->full[fi] | ((1ul << (i % NBITS)) - 1);
+
+   while (fw == ~0ul) {
+
+      if (++fi >= full_words)
+         return -1;
+
+      fw = b->full[fi];
+   }
+
+   i = fi * NBITS + lowest_zero_bit(fw);
+
+   if (i >= words)
+      return -1;   /* the bits in `full` after the last word are zero */
+
+   return i * NBITS + lowest_zero_bit(b->bits[i]);
+}
+
+int id_bitmap_next_free(struct id_bitmap *b)
+{
+   int r = id_bitmap_find_free(b, b->last + 1);
+
+   if (r < 0)
+      r = id_bitmap_find_free(b, 0);
+
+   if (r >= 0)
+      b->last = r;
+
+   return r;
+}
@@ -13,6 +13,8 @@ void handle_syscall(regs_t *);
 void handle_fault(regs_t *);
 void arch_irq_handling(regs_t *r);
 
+regs_t *__curr_irq_regs;
+
 #if KRN_TRACK_NESTED_INTERR
 
 static int nested_interrupts_count;
@@ -214,6 +216,8 @@ static void irq_resched(regs_t *r)
 
 void irq_entry(regs_t *r)
 {
+   regs_t *prev_irq_regs;
+
    DEBUG_VALIDATE_STACK_PTR();
    ASSERT(get_curr_task() != NULL);
    DEBUG_check_not_same_interrupt_nested(regs_intnum(r));
@@ -224,8 +228,15 @@ void irq_entry(regs_t *r)
    /* Disable the preemption */
    disable_preemption();
 
-   /* Call the arch-dependent IRQ handling logic */
+   /*
+    * Call the arch-dependent IRQ handling logic, making `r` reachable by the
+    * handlers through get_curr_irq_regs(). Nested IRQs will save and restore
+    * the previous value as well.
+    */
+   prev_irq_regs = __curr_irq_regs;
+   __curr_irq_regs = r;
    arch_irq_handling(r);
+   __curr_irq_regs = prev_irq_regs;
 
    /* Check that arch_irq_handling restored the interrupts state to disabled */
    ASSERT(!are_interrupts_enabled());
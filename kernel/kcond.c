@@ -22,7 +22,7 @@ bool kcond_is_anyone_waiting(struct kcond *c)
    return ret;
 }
 
-bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks)
+bool kcond_wait_key(struct kcond *c, struct kmutex *m, u32 timeout, u8 keys)
 {
    DEBUG_ONLY(check_not_in_irq_handler());
    ASSERT(!m || kmutex_is_curr_task_holding_lock(m));
@@ -30,10 +30,15 @@ bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks)
 
    disable_preemption();
    {
-      task_set_wait_obj(curr, WOBJ_KCOND, c, NO_EXTRA, &c->wait_list);
+      task_set_wait_obj_keys(curr,
+                             WOBJ_KCOND,
+                             c,
+                             NO_EXTRA,
+                             &c->wait_list,
+                             keys);
 
-      if (timeout_ticks != KCOND_WAIT_FOREVER)
-         task_set_wakeup_timer(curr, timeout_ticks);
+      if (timeout != KCOND_WAIT_FOREVER)
+         task_set_wakeup_timer(curr, timeout);
 
       if (m) {
          kmutex_unlock(m);
@@ -56,7 +61,12 @@ bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks)
    return !wait_obj_reset(&curr->wobj);
 }
 
-static void
+/*
+ * Returns true if the waiter has been actually woken up. Waiters whose task is
+ * not sleeping anymore (timeout, signal) don't count: with an exclusive wake-up
+ * we have to go on and try with the next one, otherwise the event is lost.
+ */
+static bool
 kcond_signal_single(struct kcond *c, struct wait_obj *wo)
 {
    ASSERT(!is_preemption_enabled());
@@ -74,10 +84,9 @@ kcond_signal_single(struct kcond *c, struct wait_obj *wo)
       if (wo->type == WOBJ_MWO_ELEM)
          wait_obj_reset(wo);
 
-      return;
+      return false;
    }
 
-
    if (wo->type != WOBJ_MWO_ELEM) {
       ASSERT(wo->type == WOBJ_KCOND);
       task_cancel_wakeup_timer(ti);
@@ -87,20 +96,30 @@ kcond_signal_single(struct kcond *c, struct wait_obj *wo)
 
    wait_obj_reset(wo);
    task_reset_wait_obj(ti);
+   return true;
 }
 
-void kcond_signal_int(struct kcond *c, bool all)
+void kcond_signal_int(struct kcond *c, u8 key, bool all)
 {
    struct wait_obj *wo_pos, *temp;
+   bool excl;
+
    disable_preemption();
    {
       DEBUG_ONLY(check_not_in_irq_handler());
 
       list_for_each(wo_pos, temp, &c->wait_list, wait_list_node) {
 
-         kcond_signal_single(c, wo_pos);
+         if (!(wo_pos->keys & key))
+            continue; /* the waiter is not interested in this event */
+
+         excl = !(wo_pos->flags & WOBJ_FL_NON_EXCL);
 
-         if (!all) /* the non-broadcast signal() just signals the first task */
+         /*
+          * The non-broadcast signal() wakes up all the non-exclusive waiters,
+          * which are at the head of the list, plus the first exclusive one.
+          */
+         if (kcond_signal_single(c, wo_pos) && excl && !all)
             break;
       }
    }
@@ -123,6 +123,8 @@ void *general_kmalloc(size_t *size, u32 flags)
       if (KMALLOC_HEAVY_STATS && res != NULL)
          if (!(flags & KMALLOC_FL_DONT_ACCOUNT))
             kmalloc_account_alloc(orig_size);
+
+      trace_kmalloc(orig_size, res, flags);
    }
    enable_preemption();
    return res;
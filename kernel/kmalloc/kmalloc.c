@@ -13,6 +13,7 @@
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/sort.h>
+#include <tilck/mods/tracepoints.h>
 
 #include "kmalloc_debug.h"
 #include "kmalloc_heap_struct.h"
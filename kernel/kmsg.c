@@ -0,0 +1,505 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/atomics.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/utils.h>
+#include <tilck/common/color_defs.h>
+
+#include <tilck/kernel/kmsg.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/signal.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/devfs.h>
+
+#include <fcntl.h>      // system header
+
+/*
+ * Kernel log buffer
+ * -------------------
+ *
+ * It works like the trace ring (see tracing_ring.c): records have a variable
+ * size, never wrap around the end of the buffer (a KMSG_REC_PAD record fills
+ * the rest of it instead) and get committed by atomically writing their header
+ * with the KMSG_REC_COMMITTED flag set. Readers stop at the first record not
+ * committed yet.
+ *
+ * The differences are that readers don't consume the records, as every one of
+ * them (the console flusher, each open /dev/kmsg) has its own position, and
+ * that when the buffer is full the producers overwrite the oldest records,
+ * instead of dropping the new ones. Because of that, `tail` is moved by the
+ * producers and the reservation, which also assigns the sequence number, runs
+ * with the interrupts disabled. That's just a few instructions: the text is
+ * copied with the interrupts enabled, so producers never wait for each other
+ * or for the console. Readers copy a record with the interrupts disabled,
+ * which guarantees that it won't be overwritten in the meanwhile.
+ *
+ * `head` and `tail` are free-running counters, like in the trace ring.
+ */
+
+#define KMSG_REC_ALIGN                                  8
+#define KMSG_REC_COMMITTED                       (1 << 6)
+#define KMSG_REC_PAD                             (1 << 7)
+
+STATIC_ASSERT((KMSG_BUF_SIZE & (KMSG_BUF_SIZE - 1)) == 0);
+
+struct kmsg_rec_hdr {
+
+   u16 size;               /* full size of the record, padding included */
+   u8 flags;               /* KMSG_FL_* and KMSG_REC_* flags */
+   u8 color;
+};
+
+struct kmsg_rec {
+
+   union {
+      struct kmsg_rec_hdr h;
+      ATOMIC(u32) __hdr;   /* written last, in order to commit the record */
+   };
+
+   u16 len;                /* length of `text` */
+   u16 unused;
+   u32 seq;
+   u64 sys_time;
+   char text[];
+};
+
+union kmsg_rec_hdr_raw {
+   struct kmsg_rec_hdr h;
+   u32 raw;
+};
+
+STATIC_ASSERT(sizeof(struct kmsg_rec_hdr) == sizeof(u32));
+STATIC_ASSERT(sizeof(struct kmsg_rec) + KMSG_REC_MAX_TEXT <= 0xffff);
+
+struct kmsg_buf {
+
+   u32 head;               /* where the next record will be reserved */
+   u32 tail;               /* oldest record in the buffer */
+   u32 tail_seq;           /* sequence number of the oldest record */
+   u32 next_seq;           /* sequence number of the next record */
+   ATOMIC(u32) lost;       /* records dropped by the producers */
+};
+
+static char kmsg_data[KMSG_BUF_SIZE] ALIGNED_AT(KMSG_REC_ALIGN);
+static struct kmsg_buf kmsg = { .tail_seq = 1, .next_seq = 1 };
+static struct kmutex kmsg_read_lock;
+static struct kcond kmsg_cond;
+static bool kmsg_dev_initialized;
+
+static ALWAYS_INLINE struct kmsg_rec *
+kmsg_rec_at(u32 pos)
+{
+   return (void *)(kmsg_data + (pos & (KMSG_BUF_SIZE - 1)));
+}
+
+static ALWAYS_INLINE union kmsg_rec_hdr_raw
+kmsg_rec_load_hdr(struct kmsg_rec *rec)
+{
+   return (union kmsg_rec_hdr_raw) {
+      .raw = atomic_load_explicit(&rec->__hdr, mo_acquire)
+   };
+}
+
+static ALWAYS_INLINE void
+kmsg_rec_commit(struct kmsg_rec *rec, u32 size, u8 flags, u8 color)
+{
+   union kmsg_rec_hdr_raw hdr = {
+      .h = {
+         .size = (u16)size,
+         .flags = flags | KMSG_REC_COMMITTED,
+         .color = color,
+      }
+   };
+
+   atomic_store_explicit(&rec->__hdr, hdr.raw, mo_release);
+}
+
+/*
+ * Drops the oldest record, in order to make room for a new one. Fails only if
+ * that record has not been committed yet: that can happen only if the buffer
+ * is so small that nested producers wrap around it in one go.
+ */
+static bool
+kmsg_drop_oldest(void)
+{
+   union kmsg_rec_hdr_raw hdr = kmsg_rec_load_hdr(kmsg_rec_at(kmsg.tail));
+
+   ASSERT(kmsg.tail != kmsg.head);
+
+   if (!(hdr.h.flags & KMSG_REC_COMMITTED))
+      return false;
+
+   kmsg.tail += hdr.h.size;
+
+   if (!(hdr.h.flags & KMSG_REC_PAD))
+      kmsg.tail_seq++;
+
+   return true;
+}
+
+static struct kmsg_rec *
+kmsg_reserve(u32 size)
+{
+   struct kmsg_rec *rec = NULL;
+   u32 off, pad, new_head;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      off = kmsg.head & (KMSG_BUF_SIZE - 1);
+      pad = off + size > KMSG_BUF_SIZE ? KMSG_BUF_SIZE - off : 0;
+      new_head = kmsg.head + pad + size;
+
+      while (new_head - kmsg.tail > KMSG_BUF_SIZE) {
+         if (!kmsg_drop_oldest()) {
+            atomic_fetch_add_explicit(&kmsg.lost, 1, mo_relaxed);
+            goto out;
+         }
+      }
+
+      if (pad) {
+         kmsg_rec_commit(kmsg_rec_at(kmsg.head), pad, KMSG_REC_PAD, 0);
+         kmsg.head += pad;
+      }
+
+      /* The space might contain an old record: un-commit it first */
+      rec = kmsg_rec_at(kmsg.head);
+      atomic_store_explicit(&rec->__hdr, 0, mo_relaxed);
+      rec->seq = kmsg.next_seq++;
+      kmsg.head = new_head;
+   }
+
+out:
+   enable_interrupts(&var);
+   return rec;
+}
+
+/*
+ * Appends a record to the kernel log. Safe to call from any context, even from
+ * IRQ handlers. Returns false only if the record had to be dropped.
+ */
+bool kmsg_write(const char *buf, u32 len, u8 color, u8 flags)
+{
+   struct kmsg_rec *rec;
+   u32 size;
+
+   len = MIN(len, (u32)KMSG_REC_MAX_TEXT);
+   size = (u32)pow2_round_up_at(sizeof(struct kmsg_rec) + len, KMSG_REC_ALIGN);
+
+   if (!(rec = kmsg_reserve(size)))
+      return false;
+
+   rec->len = (u16)len;
+   rec->unused = 0;
+   rec->sys_time = get_sys_time();
+   memcpy(rec->text, buf, len);
+
+   flags &= (u8)~(KMSG_REC_COMMITTED | KMSG_REC_PAD);
+   kmsg_rec_commit(rec, size, flags, color);
+   return true;
+}
+
+/*
+ * Reads the next record after the reader's position. Returns the length of
+ * its text, 0 if there are no committed records to read or -EINVAL if `size`
+ * is too small for its text (in that case, it's not read).
+ */
+int kmsg_read(struct kmsg_reader *r,
+              char *buf,
+              u32 size,
+              struct kmsg_rec_info *info)
+{
+   union kmsg_rec_hdr_raw hdr;
+   struct kmsg_rec *rec;
+   int rc = 0;
+   ulong var;
+
+   info->lost = 0;
+   disable_interrupts(&var);
+   {
+      if (!r->seq || (s32)(r->pos - kmsg.tail) < 0) {
+
+         /* New reader or the records at its position have been overwritten */
+         if (r->seq)
+            info->lost = kmsg.tail_seq - r->seq;
+
+         r->pos = kmsg.tail;
+         r->seq = kmsg.tail_seq;
+      }
+
+      while (r->pos != kmsg.head) {
+
+         rec = kmsg_rec_at(r->pos);
+         hdr = kmsg_rec_load_hdr(rec);
+
+         if (!(hdr.h.flags & KMSG_REC_COMMITTED))
+            break;  /* a producer is still writing this record */
+
+         if (hdr.h.flags & KMSG_REC_PAD) {
+            r->pos += hdr.h.size;
+            continue;
+         }
+
+         if (rec->len > size) {
+            rc = -EINVAL;
+            break;
+         }
+
+         ASSERT(rec->seq == r->seq);
+         memcpy(buf, rec->text, rec->len);
+
+         info->sys_time = rec->sys_time;
+         info->seq = rec->seq;
+         info->color = hdr.h.color;
+         info->flags = hdr.h.flags & (u8)~KMSG_REC_COMMITTED;
+
+         r->pos += hdr.h.size;
+         r->seq++;
+         rc = rec->len;
+         break;
+      }
+   }
+   enable_interrupts(&var);
+   return rc;
+}
+
+bool kmsg_can_read(struct kmsg_reader *r)
+{
+   union kmsg_rec_hdr_raw hdr;
+   u32 pos = r->pos;
+   bool ret = false;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      if (!r->seq || (s32)(pos - kmsg.tail) < 0)
+         pos = kmsg.tail;
+
+      while (pos != kmsg.head) {
+
+         hdr = kmsg_rec_load_hdr(kmsg_rec_at(pos));
+
+         if (!(hdr.h.flags & KMSG_REC_COMMITTED))
+            break;
+
+         if (!(hdr.h.flags & KMSG_REC_PAD)) {
+            ret = true;
+            break;
+         }
+
+         pos += hdr.h.size;
+      }
+   }
+   enable_interrupts(&var);
+   return ret;
+}
+
+/*
+ * Reads the next record, skipping the ones having any of `skip_flags` set, and
+ * writes it in `buf` the way it appears on the console: with the timestamp
+ * prefix and preceded by a note about the records lost by this reader, if any.
+ * `size` must be at least KMSG_TEXT_BUF_SIZE. Returns the number of bytes
+ * written in `buf` or 0 if there are no records to read.
+ */
+int kmsg_read_text(struct kmsg_reader *r,
+                   char *buf,
+                   u32 size,
+                   u8 skip_flags,
+                   u8 *color)
+{
+   /* Read the text at the end of `buf`, then move it after the prefix */
+   char *text = buf + size - KMSG_REC_MAX_TEXT;
+   struct kmsg_rec_info info;
+   u32 lost = 0;
+   int rc, n = 0;
+
+   ASSERT(size >= KMSG_TEXT_BUF_SIZE);
+
+   do {
+      rc = kmsg_read(r, text, KMSG_REC_MAX_TEXT, &info);
+      lost += info.lost;
+   } while (rc > 0 && (info.flags & skip_flags));
+
+   if (lost)
+      n = snprintk(buf, (size_t)(text - buf),
+                   "{_DROPPED_ %u messages_}\n", lost);
+
+   if (rc <= 0) {
+
+      if (n && color)
+         *color = COLOR_MAGENTA;
+
+      return n;
+   }
+
+   if (!(info.flags & KMSG_FL_NO_PREFIX)) {
+      n += snprintk(buf + n, (size_t)(text - buf - n), "[%5u.%03u] ",
+                    (u32)(info.sys_time / TS_SCALE),
+                    (u32)((info.sys_time % TS_SCALE) / (TS_SCALE / 1000)));
+   }
+
+   memmove(buf + n, text, (size_t)rc);
+
+   if (color)
+      *color = info.color;
+
+   return n + rc;
+}
+
+u32 kmsg_get_lost_count(void)
+{
+   return atomic_load_explicit(&kmsg.lost, mo_relaxed);
+}
+
+/*
+ * Called by the printk flusher thread. Producers cannot do that themselves, as
+ * they might run in IRQ context: readers waiting for records have a timeout in
+ * order to cover the case of no flusher thread.
+ */
+void kmsg_wakeup_readers(void)
+{
+   if (!kmsg_dev_initialized)
+      return;
+
+   if (kcond_is_anyone_waiting(&kmsg_cond))
+      kcond_signal_all(&kmsg_cond);
+}
+
+/*
+ * /dev/kmsg: each read() returns as many whole messages as fit in the buffer,
+ * in the same format used on the console. Every open file starts from the
+ * oldest message in the log and read() blocks when there are no new messages,
+ * unless the file has been opened with O_NONBLOCK.
+ */
+
+/*
+ * A char device's handle doesn't use `read_pos` and /dev/kmsg is read-only:
+ * keep the reader's position there and its sequence number in `write_pos`.
+ */
+static ALWAYS_INLINE struct kmsg_reader
+kmsg_dev_get_reader(fs_handle h)
+{
+   struct devfs_handle *dh = h;
+
+   return (struct kmsg_reader) {
+      .pos = (u32)dh->read_pos,
+      .seq = (u32)dh->write_pos,
+   };
+}
+
+static ALWAYS_INLINE void
+kmsg_dev_set_reader(fs_handle h, struct kmsg_reader *r)
+{
+   struct devfs_handle *dh = h;
+
+   dh->read_pos = (offt)r->pos;
+   dh->write_pos = (offt)r->seq;
+}
+
+static ssize_t kmsg_dev_read(fs_handle h, char *buf, size_t size)
+{
+   struct fs_handle_base *hb = h;
+   struct kmsg_reader r, saved;
+   char text[KMSG_TEXT_BUF_SIZE];
+   ssize_t tot = 0;
+   int rc = 0;
+
+   kmutex_lock(&kmsg_read_lock);
+   {
+      r = kmsg_dev_get_reader(h);
+
+      while (!kmsg_can_read(&r)) {
+
+         if (hb->fl_flags & O_NONBLOCK) {
+            rc = -EAGAIN;
+            break;
+         }
+
+         kcond_wait(&kmsg_cond, &kmsg_read_lock, TIMER_HZ / 10);
+
+         if (pending_signals()) {
+            rc = -EINTR;
+            break;
+         }
+      }
+
+      while (!rc) {
+
+         saved = r;
+
+         if (!(rc = kmsg_read_text(&r, text, sizeof(text), 0, NULL)))
+            break;
+
+         if ((size_t)tot + (size_t)rc > size) {
+            r = saved;            /* it doesn't fit: read it the next time */
+            rc = tot ? 0 : -EINVAL;
+            break;
+         }
+
+         memcpy(buf + tot, text, (size_t)rc);
+         tot += rc;
+         rc = 0;
+      }
+
+      kmsg_dev_set_reader(h, &r);
+   }
+   kmutex_unlock(&kmsg_read_lock);
+   return tot ? tot : rc;
+}
+
+static int kmsg_dev_read_ready(fs_handle h)
+{
+   struct kmsg_reader r = kmsg_dev_get_reader(h);
+   return kmsg_can_read(&r);
+}
+
+static struct kcond *kmsg_dev_get_rready_cond(fs_handle h)
+{
+   return &kmsg_cond;
+}
+
+static int
+create_kmsg_dev_file(int minor,
+                     const struct file_ops **fops_ref,
+                     enum vfs_entry_type *t,
+                     int *spec_flags_ref)
+{
+   static const struct file_ops static_ops_kmsg = {
+      .read = kmsg_dev_read,
+      .read_ready = kmsg_dev_read_ready,
+      .get_rready_cond = kmsg_dev_get_rready_cond,
+   };
+
+   *t = VFS_CHAR_DEV;
+   *fops_ref = &static_ops_kmsg;
+   return 0;
+}
+
+void init_kmsg_dev(void)
+{
+   struct driver_info *di;
+   int major, rc;
+
+   kmutex_init(&kmsg_read_lock, 0);
+   kcond_init(&kmsg_cond);
+
+   if (!(di = kzmalloc(sizeof(struct driver_info))))
+      panic("Unable to allocate the driver info for /dev/kmsg");
+
+   di->name = "kmsg";
+   di->create_dev_file = create_kmsg_dev_file;
+   major = register_driver(di, -1);
+
+   if ((rc = create_dev_file("kmsg", (u16)major, 0 /* minor */)))
+      panic("Unable to create /dev/kmsg (error: %d)", rc);
+
+   kmsg_dev_initialized = true;
+}
@@ -44,21 +44,104 @@ kmutex_lock_enable_preemption_wrapper(struct kmutex *m)
 #endif
 }
 
+/*
+ * Make `ti` the owner of `m`. Called with preemption disabled.
+ */
+static void kmutex_set_owner(struct kmutex *m, struct task *ti)
+{
+   ASSERT(!m->owner_task);
+   m->owner_task = ti;
+   ti->kmutexes_held++;
+
+   ASSERT(ti->kmutexes_held > 0);
+
+   if (m->flags & KMUTEX_FL_RECURSIVE) {
+      ASSERT(m->lock_count == 0);
+      m->lock_count++;
+   }
+}
+
+/*
+ * Priority inheritance: boost the owner of `m` to `prio` and, in case the
+ * owner is waiting in turn on another kmutex, boost that one's owner too,
+ * following the chain. The boost is dropped only when the task releases its
+ * last kmutex: that's simpler and cheaper than tracking the waiters of every
+ * held mutex, while still correct for the typical nested locking.
+ */
+static void kmutex_pi_boost(struct kmutex *m, u8 prio)
+{
+   struct task *owner;
+   ASSERT(!is_preemption_enabled());
+
+   for (int i = 0; i < KMUTEX_PI_MAX_DEPTH; i++) {
+
+      owner = m->owner_task;
+
+      if (!owner || owner->prio <= prio)
+         break;
+
+      owner->prio = prio;
+
+      if (owner->wobj.type != WOBJ_KMUTEX)
+         break;
+
+      m = wait_obj_get_ptr(&owner->wobj);
+   }
+}
+
+/*
+ * Adaptive locking. On SMP systems, an adaptive mutex spins as long as the
+ * owner is running on another CPU, because it will likely release the lock
+ * soon. On Tilck, which is UP, the owner cannot be running while we are: but,
+ * if it's runnable, it's been just preempted in the middle of its critical
+ * section. In that case, we hand the CPU over directly to the owner, hoping
+ * that it will release the lock before we get the CPU back. That's much
+ * cheaper than the sleep/wake-up round trip through the wait list. If the
+ * owner is sleeping instead, there's no point in waiting: just go to sleep.
+ *
+ * Called and returns with preemption disabled. Returns true if the lock has
+ * been acquired.
+ */
+static bool kmutex_lock_adaptive(struct kmutex *m)
+{
+   struct task *curr = get_curr_task();
+   struct task *owner;
+
+   if (get_preempt_disable_count() != 1)
+      return false; /* we cannot yield here */
+
+   for (int i = 0; i < KMUTEX_ADAPTIVE_YIELDS; i++) {
+
+      owner = m->owner_task;
+
+      if (owner->state != TASK_STATE_RUNNABLE || owner->stopped)
+         break;
+
+      sched_yield_to_hint(owner);
+      enable_preemption_nosched();
+      kernel_yield();
+      disable_preemption();
+
+      if (!m->owner_task) {
+         kmutex_set_owner(m, curr);
+         return true;
+      }
+   }
+
+   return false;
+}
+
 void kmutex_lock(struct kmutex *m)
 {
+   struct task *curr = get_curr_task();
+
    disable_preemption();
    DEBUG_ONLY(check_not_in_irq_handler());
 
    if (!m->owner_task) {
 
       /* Nobody owns this mutex, just make this task own it */
-      m->owner_task = get_curr_task();
-
-      if (m->flags & KMUTEX_FL_RECURSIVE) {
-         ASSERT(m->lock_count == 0);
-         m->lock_count++;
-      }
-
+      kmutex_set_owner(m, curr);
       kmutex_lock_enable_preemption_wrapper(m);
       return;
    }
@@ -77,12 +160,21 @@ void kmutex_lock(struct kmutex *m)
       ASSERT(!kmutex_is_curr_task_holding_lock(m));
    }
 
+   if (m->flags & KMUTEX_FL_ADAPTIVE) {
+
+      if (kmutex_lock_adaptive(m)) {
+         kmutex_lock_enable_preemption_wrapper(m);
+         return;
+      }
+   }
+
 #if KMUTEX_STATS_ENABLED
    m->num_waiters++;
    m->max_num_waiters = MAX(m->num_waiters, m->max_num_waiters);
 #endif
 
-   task_set_wait_obj(get_curr_task(), WOBJ_KMUTEX, m, NO_EXTRA, &m->wait_list);
+   kmutex_pi_boost(m, curr->prio);
+   task_set_wait_obj(curr, WOBJ_KMUTEX, m, NO_EXTRA, &m->wait_list);
    kmutex_lock_enable_preemption_wrapper(m);
 
    /*
@@ -119,12 +211,9 @@ bool kmutex_trylock(struct kmutex *m)
    if (!m->owner_task) {
 
       /* Nobody owns this mutex, just make this task own it */
-      m->owner_task = get_curr_task();
+      kmutex_set_owner(m, get_curr_task());
       success = true;
 
-      if (m->flags & KMUTEX_FL_RECURSIVE)
-         m->lock_count++;
-
    } else {
 
       /*
@@ -145,8 +234,43 @@ bool kmutex_trylock(struct kmutex *m)
    return success;
 }
 
+/*
+ * Pick the waiter with the highest priority. In case of ties, the first one
+ * in the list wins, preserving the FIFO order.
+ */
+static struct task *kmutex_pick_waiter(struct kmutex *m, u8 *next_prio)
+{
+   struct task *ti, *sel = NULL;
+   struct wait_obj *wo;
+
+   *next_prio = MAX_PRIO;
+
+   list_for_each_ro(wo, &m->wait_list, wait_list_node) {
+
+      ti = CONTAINER_OF(wo, struct task, wobj);
+
+      if (!sel || ti->prio < sel->prio) {
+
+         if (sel)
+            *next_prio = MIN(*next_prio, sel->prio);
+
+         sel = ti;
+
+      } else {
+
+         *next_prio = MIN(*next_prio, ti->prio);
+      }
+   }
+
+   return sel;
+}
+
 void kmutex_unlock(struct kmutex *m)
 {
+   struct task *curr = get_curr_task();
+   struct task *ti;
+   u8 next_prio;
+
    disable_preemption();
 
    DEBUG_ONLY(check_not_in_irq_handler());
@@ -165,23 +289,24 @@ void kmutex_unlock(struct kmutex *m)
    }
 
    m->owner_task = NULL;
+   ASSERT(curr->kmutexes_held > 0);
+
+   /* Drop the priority inheritance boost, if any, with the last kmutex */
+   if (--curr->kmutexes_held == 0)
+      curr->prio = task_normal_prio(curr);
 
    /* Unlock one task waiting to acquire the mutex 'm' (if any) */
    if (!list_is_empty(&m->wait_list)) {
 
-      struct wait_obj *task_wo =
-         list_first_obj(&m->wait_list, struct wait_obj, wait_list_node);
-
-      struct task *ti = CONTAINER_OF(task_wo, struct task, wobj);
-
-      m->owner_task = ti;
-
-      if (m->flags & KMUTEX_FL_RECURSIVE)
-         m->lock_count++;
+      ti = kmutex_pick_waiter(m, &next_prio);
+      kmutex_set_owner(m, ti);
 
       ASSERT(ti->state == TASK_STATE_SLEEPING);
       task_reset_wait_obj(ti);
 
+      /* The new owner inherits the priority of the remaining waiters */
+      kmutex_pi_boost(m, next_prio);
+
    } // if (!list_is_empty(&m->wait_list))
 
    enable_preemption();
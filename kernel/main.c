@@ -17,8 +17,11 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/elf_loader.h>
 #include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/softirq.h>
 #include <tilck/kernel/fs/fat32.h>
 #include <tilck/kernel/fs/devfs.h>
+#include <tilck/kernel/fs/procfs.h>
+#include <tilck/kernel/kmsg.h>
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/syscalls.h>
 #include <tilck/kernel/system_mmap.h>
@@ -214,6 +217,9 @@ static void mount_initrd(void)
    if ((rc = vfs_mkdir("/tmp", 0777)))
       panic("vfs_mkdir(\"/tmp\") failed with error: %d", rc);
 
+   if ((rc = vfs_mkdir("/proc", 0777)))
+      panic("vfs_mkdir(\"/proc\") failed with error: %d", rc);
+
    /* Set kernel's process `cwd` to the root folder */
    {
       struct vfs_path tp;
@@ -227,7 +233,9 @@ static void mount_initrd(void)
 
    if (LIKELY(ramdisk != NULL)) {
 
-      if (!(initrd = fat_mount_ramdisk(ramdisk, ramdisk_size, 0)))
+      const u32 fl = kopt_rw_initrd ? VFS_FS_RW : 0;
+
+      if (!(initrd = fat_mount_ramdisk(ramdisk, ramdisk_size, fl)))
          panic("Unable to mount the initrd fat32 RAMDISK");
 
       if ((rc = vfs_mkdir("/initrd", 0777)))
@@ -270,6 +278,8 @@ static void do_async_init()
 {
    mount_initrd();
    init_devfs();
+   init_kmsg_dev();
+   init_procfs();
    init_modules();
    init_extra_debug_features();
 
@@ -308,6 +318,8 @@ void kmain(u32 multiboot_magic, u32 mbi_addr)
    init_sched();
    init_syscall_interfaces();
    init_worker_threads();
+   init_softirqs();
+   init_printk_flusher();
    init_timer();
    init_system_time();
    init_kernelfs();
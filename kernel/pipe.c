@@ -19,9 +19,14 @@ struct pipe {
    char *buf;
    struct ringbuf rb;
    struct kmutex mutex;
-   struct kcond rcond;
-   struct kcond wcond;
-   struct kcond errcond;
+
+   /*
+    * Readers, writers and pollers all wait on the same condition, each one
+    * with the keys it is interested in: KCOND_KEY_READ for data,
+    * KCOND_KEY_WRITE for free space and KCOND_KEY_HUP for the other end
+    * being closed.
+    */
+   struct kcond cond;
 
    ATOMIC(int) read_handles;
    ATOMIC(int) write_handles;
@@ -54,26 +59,32 @@ static ssize_t pipe_read(fs_handle h, char *buf, size_t size)
             goto end;
          }
 
-         /* Wake-up all the writers waiting on the readers cond */
-         kcond_signal_all(&p->rcond);
+         /* Wait for some data or for the last writer to go away */
+         kcond_wait_key(&p->cond,
+                        &p->mutex,
+                        KCOND_WAIT_FOREVER,
+                        KCOND_KEY_READ | KCOND_KEY_HUP);
+
+         if (pending_signals()) {
 
-         /* Wait on the writers cond */
-         kcond_wait(&p->wcond, &p->mutex, KCOND_WAIT_FOREVER);
+            /* We might have got the wake-up: don't lose it */
+            if (!ringbuf_is_empty(&p->rb))
+               kcond_signal_key_one(&p->cond, KCOND_KEY_READ);
 
-         if (pending_signals())
             goto end;
+         }
 
          goto again;
       }
 
       if (!ringbuf_is_empty(&p->rb)) {
-         /* Notify other readers that's possible to read from the pipe */
-         kcond_signal_all(&p->rcond);
+         /* There's still data: pass the wake-up to the next reader, if any */
+         kcond_signal_key_one(&p->cond, KCOND_KEY_READ);
       }
 
       if (was_buffer_full) {
-         /* Notify all writers that now is possible to write to the pipe */
-         kcond_signal_all(&p->wcond);
+         /* Now it's possible to write again: wake up a single writer */
+         kcond_signal_key_one(&p->cond, KCOND_KEY_WRITE);
       }
 
    end:;
@@ -119,26 +130,32 @@ static ssize_t pipe_write(fs_handle h, char *buf, size_t size)
             goto end;
          }
 
-         /* Wake-up all the readers waiting on the writers cond */
-         kcond_signal_all(&p->wcond);
+         /* Wait for some free space or for the last reader to go away */
+         kcond_wait_key(&p->cond,
+                        &p->mutex,
+                        KCOND_WAIT_FOREVER,
+                        KCOND_KEY_WRITE | KCOND_KEY_HUP);
+
+         if (pending_signals()) {
 
-         /* Wait on the readers cond */
-         kcond_wait(&p->rcond, &p->mutex, KCOND_WAIT_FOREVER);
+            /* We might have got the wake-up: don't lose it */
+            if (!ringbuf_is_full(&p->rb))
+               kcond_signal_key_one(&p->cond, KCOND_KEY_WRITE);
 
-         if (pending_signals())
             goto end;
+         }
 
          goto again;
       }
 
       if (!ringbuf_is_full(&p->rb)) {
-         /* Notify other writers that now it possible to write on the pipe */
-         kcond_signal_all(&p->wcond);
+         /* There's still space: pass the wake-up to the next writer, if any */
+         kcond_signal_key_one(&p->cond, KCOND_KEY_WRITE);
       }
 
       if (was_buffer_empty) {
-         /* Notify all readers that now is possible to read from the pipe */
-         kcond_signal_all(&p->rcond);
+         /* Now it's possible to read: wake up a single reader */
+         kcond_signal_key_one(&p->cond, KCOND_KEY_READ);
       }
 
    end:;
@@ -166,11 +183,11 @@ static int pipe_read_ready(fs_handle h)
    return ret;
 }
 
-static struct kcond *pipe_get_rready_cond(fs_handle h)
+static struct kcond *pipe_get_cond(fs_handle h)
 {
    struct kfs_handle *kh = h;
    struct pipe *p = (void *)kh->kobj;
-   return &p->rcond;
+   return &p->cond;
 }
 
 static int pipe_write_ready(fs_handle h)
@@ -206,27 +223,13 @@ static int pipe_except_ready(fs_handle h)
    return ret;
 }
 
-static struct kcond *pipe_get_wready_cond(fs_handle h)
-{
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
-   return &p->wcond;
-}
-
-static struct kcond *pipe_get_except_cond(fs_handle h)
-{
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
-   return &p->errcond;
-}
-
 static const struct file_ops static_ops_pipe_read_end =
 {
    .read = pipe_read,
    .read_ready = pipe_read_ready,
    .except_ready = pipe_except_ready,
-   .get_rready_cond = pipe_get_rready_cond,
-   .get_except_cond = pipe_get_except_cond,
+   .get_rready_cond = pipe_get_cond,
+   .get_except_cond = pipe_get_cond,
 };
 
 static const struct file_ops static_ops_pipe_write_end =
@@ -234,15 +237,13 @@ static const struct file_ops static_ops_pipe_write_end =
    .write = pipe_write,
    .except_ready = pipe_except_ready,
    .write_ready = pipe_write_ready,
-   .get_wready_cond = pipe_get_wready_cond,
-   .get_except_cond = pipe_get_except_cond,
+   .get_wready_cond = pipe_get_cond,
+   .get_except_cond = pipe_get_cond,
 };
 
 void destroy_pipe(struct pipe *p)
 {
-   kcond_destory(&p->errcond);
-   kcond_destory(&p->wcond);
-   kcond_destory(&p->rcond);
+   kcond_destory(&p->cond);
    kmutex_destroy(&p->mutex);
    ringbuf_destory(&p->rb);
    kfree2(p->buf, PIPE_BUF_SIZE);
@@ -264,9 +265,8 @@ static void pipe_on_handle_close(fs_handle h)
    ASSERT(old > 0);
 
    if (old == 1) {
-      kcond_signal_all(&p->rcond);
-      kcond_signal_all(&p->wcond);
-      kcond_signal_all(&p->errcond);
+      /* Wake up everybody blocked on the other end: they'll get EOF/EPIPE */
+      kcond_signal_key_all(&p->cond, KCOND_KEY_HUP);
    }
 }
 
@@ -298,10 +298,8 @@ struct pipe *create_pipe(void)
    p->on_handle_dup = &pipe_on_handle_dup;
    p->destory_obj = (void *)&destroy_pipe;
    ringbuf_init(&p->rb, PIPE_BUF_SIZE, 1, p->buf);
-   kmutex_init(&p->mutex, 0);
-   kcond_init(&p->rcond);
-   kcond_init(&p->wcond);
-   kcond_init(&p->errcond);
+   kmutex_init(&p->mutex, KMUTEX_FL_ADAPTIVE);
+   kcond_init(&p->cond);
    return p;
 }
 
@@ -74,7 +74,7 @@ poll_set_conds(struct multi_obj_waiter *w,
          if (c != NULL) {
 
             ASSERT(idx < cond_cnt);
-            mobj_waiter_set(w, idx++, WOBJ_KCOND, c, &c->wait_list);
+            mobj_waiter_set_key(w, idx++, c, &c->wait_list, VFS_RREADY_KEYS);
          }
       }
 
@@ -85,7 +85,7 @@ poll_set_conds(struct multi_obj_waiter *w,
          if (c != NULL) {
 
             ASSERT(idx < cond_cnt);
-            mobj_waiter_set(w, idx++, WOBJ_KCOND, c, &c->wait_list);
+            mobj_waiter_set_key(w, idx++, c, &c->wait_list, VFS_WREADY_KEYS);
          }
       }
 
@@ -101,7 +101,7 @@ poll_set_conds(struct multi_obj_waiter *w,
          if (c != NULL) {
 
             ASSERT(idx < cond_cnt);
-            mobj_waiter_set(w, idx++, WOBJ_KCOND, c, &c->wait_list);
+            mobj_waiter_set_key(w, idx++, c, &c->wait_list, VFS_EXCEPT_KEYS);
          }
       }
 
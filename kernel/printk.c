@@ -11,12 +11,16 @@
 #include <tilck/kernel/term.h>
 #include <tilck/kernel/tty.h>
 #include <tilck/kernel/datetime.h>
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/kmsg.h>
 
 #define PRINTK_COLOR                          COLOR_GREEN
 #define PRINTK_RINGBUF_FLUSH_COLOR            COLOR_CYAN
-#define PRINTK_NOSPACE_IN_RBUF_FLUSH_COLOR    COLOR_MAGENTA
 #define PRINTK_PANIC_COLOR                    COLOR_GREEN
 
+#define PRINTK_FLUSHER_PRIO                   10
+#define PRINTK_FLUSHER_QUEUE_SIZE             4
+
 static bool
 write_in_buf_str(char **buf_ref, char *buf_end, const char *s)
 {
@@ -261,34 +265,12 @@ int snprintk(char *buf, size_t size, const char *fmt, ...)
    return written;
 }
 
-struct ringbuf_stat {
-
-   union {
-
-      struct {
-         u32 used : 10;
-         u32 read_pos : 10;
-         u32 write_pos : 10;
-         u32 in_printk : 1;
-         u32 unused : 1;
-      };
-
-      ATOMIC(u32) raw;
-      u32 __raw;
-   };
-};
-
-static char printk_rbuf[1024];
-static volatile struct ringbuf_stat printk_rbuf_stat;
 bool __in_printk;
 
-/*
- * NOTE: the ring buf cannot be larger than 1024 elems because the fields
- * 'used', 'read_pos' and 'write_pos' are 10 bits long and we CANNOT extend
- * them in 32 bits. Such approach is convenient because with everything packed
- * in 32 bits, we can do atomic operations.
- */
-STATIC_ASSERT(sizeof(printk_rbuf) <= 1024);
+static ATOMIC(bool) printk_flushing;
+static struct wth_work printk_flush_work;
+static struct kmsg_reader printk_console_reader;
+static int printk_wth = -1;
 
 static void printk_direct_flush_no_tty(const char *buf, size_t size, u8 color)
 {
@@ -327,117 +309,121 @@ static void printk_direct_flush(const char *buf, size_t size, u8 color)
    return;
 }
 
+/*
+ * Writes on the console all the messages in the kernel log not written there
+ * yet. Only one context at a time does that: the others just return, because
+ * the messages they've added will be written by the one already doing that.
+ * The only exception is panic: we cannot wait for anybody there.
+ */
 void printk_flush_ringbuf(void)
 {
-   struct ringbuf_stat cs, ns;
-
-   char minibuf[80];
-   u32 to_read = 0;
+   char buf[KMSG_TEXT_BUF_SIZE];
+   bool exp;
+   u8 color;
+   int rc;
 
-   while (true) {
+   do {
 
-      do {
-         cs = printk_rbuf_stat;
-         ns = printk_rbuf_stat;
+      exp = false;
 
-         /* We at most 'sizeof(minibuf)' bytes at a time */
-         to_read = UNSAFE_MIN(sizeof(minibuf), ns.used);
+      if (!atomic_cas_strong(&printk_flushing, &exp, true,
+                             mo_relaxed, mo_relaxed))
+      {
+         if (!in_panic())
+            return;
+      }
 
-         /* And copy them to our minibuf */
-         for (u32 i = 0; i < to_read; i++)
-            minibuf[i] = printk_rbuf[(cs.read_pos + i) % sizeof(printk_rbuf)];
+      while ((rc = kmsg_read_text(&printk_console_reader, buf, sizeof(buf),
+                                  KMSG_FL_NO_CONSOLE, &color)) > 0)
+      {
+         printk_direct_flush(buf, (size_t)rc, color);
+      }
 
-         /* Increase read_pos and decrease used */
-         ns.read_pos = (ns.read_pos + to_read) % sizeof(printk_rbuf);
-         ns.used -= to_read;
+      atomic_store_explicit(&printk_flushing, false, mo_relaxed);
 
-         if (!to_read)
-            ns.in_printk = 0;
+      /*
+       * A nested printk() might have added a message after our last read, but
+       * before we cleared `printk_flushing`: in that case, it didn't flush it.
+       */
 
-         /* Repeat that until we were able to do that atomically */
+   } while (kmsg_can_read(&printk_console_reader));
+}
 
-      } while (!atomic_cas_weak(&printk_rbuf_stat.raw,
-                                &cs.__raw,
-                                ns.__raw,
-                                mo_relaxed,
-                                mo_relaxed));
+static void printk_flush_job(void *arg)
+{
+   printk_flush_ringbuf();
+   kmsg_wakeup_readers();
+}
 
-      /* Note: we check that in_printk in cs (current state) is unset! */
-      if (!to_read)
-         break;
+/*
+ * Once the flusher thread exists, printk() never writes on the console by
+ * itself: it just appends the message to the kernel log and wakes up the
+ * flusher. Therefore, IRQ handlers and syscalls don't pay for the rendering.
+ */
+static void printk_wakeup_flusher(void)
+{
+   if (printk_wth < 0) {
+      printk_flush_ringbuf();
+      return;
+   }
 
-      printk_direct_flush(minibuf, to_read, PRINTK_RINGBUF_FLUSH_COLOR);
+   if (get_curr_task() == wth_get_task(printk_wth) && !get_curr_irq_regs()) {
+      /* printk() called by the flusher itself: it will flush that as well */
+      return;
    }
+
+   /*
+    * If the flush is already pending, this does nothing: the messages just
+    * added will be flushed as well. Also, this never fails: no message can
+    * be left in the log waiting for the next printk() to be flushed.
+    */
+   wth_queue_work(printk_wth, &printk_flush_work);
 }
 
-static void printk_append_to_ringbuf(const char *buf, size_t size)
+static void
+printk_on_curr_proc_tty(const char *buf, size_t size, u8 flags)
 {
-   static const char err_msg[] = "{_DROPPED_}\n";
+   char prefix[32];
+   int rc;
 
-   struct ringbuf_stat cs, ns;
-
-   do {
-      cs = printk_rbuf_stat;
-      ns = printk_rbuf_stat;
+   __in_printk = true;
+   {
+      if (!(flags & KMSG_FL_NO_PREFIX)) {
 
-      if (cs.used + size >= sizeof(printk_rbuf)) {
+         const u64 systime = get_sys_time();
 
-         if (term_is_initialized()) {
-            printk_direct_flush(buf, size, PRINTK_NOSPACE_IN_RBUF_FLUSH_COLOR);
-            return;
-         }
+         rc = snprintk(
+            prefix, sizeof(prefix), "[%5u.%03u] ",
+            (u32)(systime / TS_SCALE),
+            (u32)((systime % TS_SCALE) / (TS_SCALE / 1000))
+         );
 
-         if (buf != err_msg && cs.used < sizeof(printk_rbuf) - 1) {
-            size = MIN(sizeof(printk_rbuf) - cs.used - 1, sizeof(err_msg));
-            printk_append_to_ringbuf(err_msg, size);
-         }
-
-         return;
+         tty_curr_proc_write(prefix, (size_t)rc);
       }
 
-      ns.used += size;
-      ns.write_pos = (ns.write_pos + size) % sizeof(printk_rbuf);
-
-   } while (!atomic_cas_weak(&printk_rbuf_stat.raw,
-                             &cs.__raw,
-                             ns.__raw,
-                             mo_relaxed,
-                             mo_relaxed));
-
-   // Now we have some allocated space in the ringbuf
-
-   for (u32 i = 0; i < size; i++)
-      printk_rbuf[(cs.write_pos + i) % sizeof(printk_rbuf)] = buf[i];
+      tty_curr_proc_write(buf, size);
+   }
+   __in_printk = false;
 }
 
 void vprintk(const char *fmt, va_list args)
 {
    static const char truncated_str[] = "[...]";
 
-   char buf[256];
+   char buf[KMSG_REC_MAX_TEXT];
    int written = 0;
-   bool prefix = in_panic() ? false : true;
+   u8 flags = 0;
+   bool on_proc_tty;
 
    if (*fmt == PRINTK_CTRL_CHAR) {
       u32 cmd = *(u32 *)fmt;
       fmt += 4;
 
       if (cmd == *(u32 *)NO_PREFIX)
-         prefix = false;
+         flags |= KMSG_FL_NO_PREFIX;
    }
 
-   if (prefix) {
-
-      const u64 systime = get_sys_time();
-
-      written = snprintk(
-         buf, sizeof(buf), "[%5u.%03u] ",
-         (u32)(systime / TS_SCALE),
-         (u32)((systime % TS_SCALE) / (TS_SCALE / 1000))
-      );
-   }
-
-   written += vsnprintk(buf + written, sizeof(buf) - (u32)written, fmt, args);
+   written = vsnprintk(buf, sizeof(buf), fmt, args);
 
    if (written == sizeof(buf)) {
 
@@ -454,42 +440,37 @@ void vprintk(const char *fmt, va_list args)
    }
 
    if (!term_is_initialized()) {
-      printk_append_to_ringbuf(buf, (size_t) written);
+
+      /* It will be flushed by init_console() */
+      kmsg_write(buf, (u32)written, PRINTK_RINGBUF_FLUSH_COLOR, flags);
       return;
    }
 
    if (in_panic()) {
+      printk_flush_ringbuf();
       printk_direct_flush(buf, (size_t) written, PRINTK_PANIC_COLOR);
       return;
    }
 
-   disable_preemption();
-   {
-      struct ringbuf_stat cs, ns;
+   on_proc_tty = !KRN_PRINTK_ON_CURR_TTY &&
+                 get_curr_tty() != NULL &&
+                 get_curr_process_tty() != NULL;
 
-      do {
-         cs = printk_rbuf_stat;
-         ns = printk_rbuf_stat;
-         ns.in_printk = 1;
-      } while (!atomic_cas_weak(&printk_rbuf_stat.raw,
-                                &cs.__raw,
-                                ns.__raw,
-                                mo_relaxed,
-                                mo_relaxed));
+   if (on_proc_tty) {
 
-      if (!cs.in_printk) {
+      /* Keep it in the log as well, but the console must skip it */
+      kmsg_write(buf, (u32)written, PRINTK_COLOR, flags | KMSG_FL_NO_CONSOLE);
 
-         printk_direct_flush(buf, (size_t) written, PRINTK_COLOR);
-         printk_flush_ringbuf();
-
-      } else {
-
-         /* in_printk was already 1 */
-         printk_append_to_ringbuf(buf, (size_t) written);
+      disable_preemption();
+      {
+         printk_on_curr_proc_tty(buf, (size_t) written, flags);
       }
-
+      enable_preemption();
+      return;
    }
-   enable_preemption();
+
+   kmsg_write(buf, (u32)written, PRINTK_COLOR, flags);
+   printk_wakeup_flusher();
 }
 
 void printk(const char *fmt, ...)
@@ -499,3 +480,21 @@ void printk(const char *fmt, ...)
    vprintk(fmt, args);
    va_end(args);
 }
+
+void init_printk_flusher(void)
+{
+   int wth;
+
+   disable_preemption();
+   {
+      /* The lowest priority among the worker threads */
+      wth = wth_create_thread(PRINTK_FLUSHER_PRIO, PRINTK_FLUSHER_QUEUE_SIZE);
+   }
+   enable_preemption();
+
+   if (wth < 0)
+      panic("Unable to create the printk flusher thread");
+
+   wth_work_init(&printk_flush_work, &printk_flush_job, NULL);
+   printk_wth = wth;
+}
@@ -4,6 +4,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
+#include <tilck/common/string_util.h>
 
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/process_mm.h>
@@ -14,11 +15,96 @@
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/datetime.h>
 
 #include <sys/prctl.h>        // system header
 
 #define ISOLATED_STACK_HI_VMEM_SPACE   (KERNEL_STACK_SIZE + (2 * PAGE_SIZE))
 
+/*
+ * Small LIFO caches of the big allocations each task needs: kernel stacks
+ * (already mapped in hi-vmem, with KERNEL_STACK_ISOLATION), copy buffers and
+ * task + process blocks. When a task dies, its allocations go back to these
+ * caches, as long as they're not full: that way, a fork + exit cycle usually
+ * touches neither the heap nor the page tables.
+ *
+ * The cached objects are never zeroed, as nobody relies on that. In debug
+ * builds, they're poisoned instead and the poison is checked on reuse, in
+ * order to catch writes after free.
+ */
+struct task_alloc_cache {
+
+   size_t obj_size;
+   int count;
+   void *objs[TASK_ALLOC_CACHE_SIZE];
+};
+
+static struct task_alloc_cache kstacks_cache = {
+   .obj_size = KERNEL_STACK_SIZE,
+};
+
+static struct task_alloc_cache bufs_cache = {
+   .obj_size = IO_COPYBUF_SIZE + ARGS_COPYBUF_SIZE,
+};
+
+static struct task_alloc_cache blocks_cache = {
+   .obj_size = TOT_PROC_AND_TASK_SIZE,
+};
+
+#ifdef DEBUG
+
+static void
+task_alloc_cache_check_poison(struct task_alloc_cache *c, void *obj)
+{
+   const u32 *p = obj;
+
+   for (size_t i = 0; i < c->obj_size / 4; i++) {
+      if (p[i] != TASK_ALLOC_CACHE_POISON_VAL)
+         panic("Write after free in cached obj %p, offset %u",
+               obj, (u32)(i * 4));
+   }
+}
+
+#endif
+
+static void *task_alloc_cache_get(struct task_alloc_cache *c)
+{
+   void *obj = NULL;
+
+   disable_preemption();
+   {
+      if (c->count > 0)
+         obj = c->objs[--c->count];
+   }
+   enable_preemption();
+
+#ifdef DEBUG
+   if (obj)
+      task_alloc_cache_check_poison(c, obj);
+#endif
+
+   return obj;
+}
+
+static bool task_alloc_cache_put(struct task_alloc_cache *c, void *obj)
+{
+   bool ok = false;
+
+#ifdef DEBUG
+   memset32(obj, TASK_ALLOC_CACHE_POISON_VAL, c->obj_size / 4);
+#endif
+
+   disable_preemption();
+   {
+      if (c->count < TASK_ALLOC_CACHE_SIZE) {
+         c->objs[c->count++] = obj;
+         ok = true;
+      }
+   }
+   enable_preemption();
+   return ok;
+}
+
 static void *alloc_kernel_isolated_stack(struct process *pi)
 {
    void *vaddr_in_block;
@@ -29,7 +115,7 @@ static void *alloc_kernel_isolated_stack(struct process *pi)
 
    ASSERT(pi->pdir != NULL);
 
-   direct_va = kzmalloc(KERNEL_STACK_SIZE);
+   direct_va = kmalloc(KERNEL_STACK_SIZE);
 
    if (!direct_va)
       return NULL;
@@ -86,22 +172,72 @@ STATIC_ASSERT(
 
 #undef TOT_IOBUF_AND_ARGS_BUF_PG
 
-static bool do_common_task_allocs(struct task *ti, bool alloc_bufs)
+static void *alloc_kernel_stack(struct process *pi)
 {
-   if (KERNEL_STACK_ISOLATION) {
-      ti->kernel_stack = alloc_kernel_isolated_stack(ti->pi);
-   } else {
-      ti->kernel_stack = kzmalloc(KERNEL_STACK_SIZE);
-   }
+   void *stack;
+
+   if ((stack = task_alloc_cache_get(&kstacks_cache)))
+      return stack;
+
+   if (KERNEL_STACK_ISOLATION)
+      return alloc_kernel_isolated_stack(pi);
+
+   return kmalloc(KERNEL_STACK_SIZE);
+}
+
+static void free_kernel_stack(struct process *pi, void *stack)
+{
+   if (task_alloc_cache_put(&kstacks_cache, stack))
+      return;
+
+   if (KERNEL_STACK_ISOLATION)
+      free_kernel_isolated_stack(pi, stack);
+   else
+      kfree2(stack, KERNEL_STACK_SIZE);
+}
+
+static void *alloc_copybufs(void)
+{
+   void *buf;
+
+   if ((buf = task_alloc_cache_get(&bufs_cache)))
+      return buf;
+
+   return kmalloc(IO_COPYBUF_SIZE + ARGS_COPYBUF_SIZE);
+}
+
+static void free_copybufs(void *buf)
+{
+   if (!task_alloc_cache_put(&bufs_cache, buf))
+      kfree2(buf, IO_COPYBUF_SIZE + ARGS_COPYBUF_SIZE);
+}
+
+static struct task *alloc_task_block(void)
+{
+   struct task *ti;
 
-   if (!ti->kernel_stack)
+   if ((ti = task_alloc_cache_get(&blocks_cache)))
+      return ti;
+
+   return kmalloc(TOT_PROC_AND_TASK_SIZE);
+}
+
+static void free_task_block(struct task *ti)
+{
+   if (!task_alloc_cache_put(&blocks_cache, ti))
+      kfree2(ti, TOT_PROC_AND_TASK_SIZE);
+}
+
+static bool do_common_task_allocs(struct task *ti, bool alloc_bufs)
+{
+   if (!(ti->kernel_stack = alloc_kernel_stack(ti->pi)))
       return false;
 
    if (alloc_bufs) {
-      ti->io_copybuf = kmalloc(IO_COPYBUF_SIZE + ARGS_COPYBUF_SIZE);
 
-      if (!ti->io_copybuf) {
-         kfree2(ti->kernel_stack, KERNEL_STACK_SIZE);
+      if (!(ti->io_copybuf = alloc_copybufs())) {
+         free_kernel_stack(ti->pi, ti->kernel_stack);
+         ti->kernel_stack = NULL;
          return false;
       }
 
@@ -128,13 +264,11 @@ void free_common_task_allocs(struct task *ti)
    struct process *pi = ti->pi;
    process_free_mappings_info(pi);
 
-   if (KERNEL_STACK_ISOLATION) {
-      free_kernel_isolated_stack(pi, ti->kernel_stack);
-   } else {
-      kfree2(ti->kernel_stack, KERNEL_STACK_SIZE);
-   }
+   if (ti->kernel_stack)
+      free_kernel_stack(pi, ti->kernel_stack);
 
-   kfree2(ti->io_copybuf, IO_COPYBUF_SIZE + ARGS_COPYBUF_SIZE);
+   if (ti->io_copybuf)
+      free_copybufs(ti->io_copybuf);
 
    ti->io_copybuf = NULL;
    ti->args_copybuf = NULL;
@@ -175,6 +309,7 @@ void init_task_lists(struct task *ti)
 void init_process_lists(struct process *pi)
 {
    list_init(&pi->children);
+   list_node_init(&pi->pgrp_node);
    kmutex_init(&pi->fslock, KMUTEX_FL_RECURSIVE);
 }
 
@@ -186,7 +321,7 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    bool common_allocs = false;
    bool arch_fields = false;
 
-   if (UNLIKELY(!(ti = kmalloc(TOT_PROC_AND_TASK_SIZE))))
+   if (UNLIKELY(!(ti = alloc_task_block())))
       goto oom_case;
 
    pi = (struct process *)(ti + 1);
@@ -214,6 +349,15 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    pi->ref_count = 1;
    pi->pid = pid;
    pi->did_call_execve = false;
+   pi->faults_cnt = 0;
+   bzero(&pi->children_ru, sizeof(pi->children_ru));
+   bzero(&ti->ru, sizeof(ti->ru));
+
+   /* The CPU time starts from 0, but keep the parent's vruntime and prio */
+   ti->ticks.timeslice = 0;
+   ti->ticks.total = 0;
+   ti->prio = task_normal_prio(ti);
+   ti->kmutexes_held = 0;
    pi->cwd.fs = NULL;
 
    if (new_pdir != parent_pi->pdir) {
@@ -272,7 +416,7 @@ oom_case:
       if (MOD_debugpanel && pi->debug_cmdline)
          kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
 
-      kfree2(ti, TOT_PROC_AND_TASK_SIZE);
+      free_task_block(ti);
    }
 
    return NULL;
@@ -295,6 +439,10 @@ struct task *allocate_new_thread(struct process *pi, int tid, bool alloc_bufs)
 
    ti->tid = tid;
    ti->is_main_thread = false;
+   ti->static_prio = process_task->static_prio;
+   ti->policy = process_task->policy;
+   ti->rt_priority = process_task->rt_priority;
+   ti->prio = task_normal_prio(ti);
 
    init_task_lists(ti);
    arch_specific_new_task_setup(ti, process_task);
@@ -305,15 +453,6 @@ static void free_process_int(struct process *pi)
 {
    ASSERT(get_ref_count(pi) > 0);
 
-   if (release_obj(pi) == 0) {
-
-      arch_specific_free_proc(pi);
-      kfree2(get_process_task(pi), TOT_PROC_AND_TASK_SIZE);
-
-      if (MOD_debugpanel)
-         kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
-   }
-
    if (LIKELY(pi->cwd.fs != NULL)) {
 
       /*
@@ -325,6 +464,17 @@ static void free_process_int(struct process *pi)
 
       vfs_release_inode_at(&pi->cwd);
       release_obj(pi->cwd.fs);
+      pi->cwd.fs = NULL;
+   }
+
+   if (release_obj(pi) == 0) {
+
+      arch_specific_free_proc(pi);
+
+      if (MOD_debugpanel)
+         kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
+
+      free_task_block(get_process_task(pi));
    }
 }
 
@@ -516,10 +666,11 @@ int sys_setsid(void)
    disable_preemption();
 
    if (!sched_count_proc_in_group(pi->pid)) {
-      pi->pgid = pi->pid;
-      pi->sid = pi->pid;
-      pi->proc_tty = NULL;
-      rc = pi->sid;
+
+      if (!(rc = sched_new_session(pi))) {
+         pi->proc_tty = NULL;
+         rc = pi->sid;
+      }
    }
 
    enable_preemption();
@@ -583,12 +734,12 @@ int sys_setpgid(int pid, int pgid)
       }
 
       /* Set process' pgid to `pgid` */
-      pi->pgid = pgid;
+      rc = sched_set_pgrp(pi, pgid);
 
    } else {
 
       /* pgid is 0: make the process a group leader */
-      pi->pgid = pi->pid;
+      rc = sched_set_pgrp(pi, pi->pid);
    }
 
 out:
@@ -618,6 +769,180 @@ int sys_getpgrp(void)
    return get_curr_proc()->pgid;
 }
 
+int sys_getpriority(int which, int who)
+{
+   int nice, rc;
+
+   if ((rc = sched_get_nice(which, who, &nice)))
+      return rc;
+
+   /* Like Linux, return 20 - nice, in order to avoid negative values */
+   return 20 - nice;
+}
+
+int sys_setpriority(int which, int who, int prio)
+{
+   return sched_set_nice(which, who, prio);
+}
+
+int sys_nice(int inc)
+{
+   const int nice = PRIO_TO_NICE(get_curr_task()->static_prio);
+   return sched_set_nice(0 /* PRIO_PROCESS */, 0, nice + CLAMP(inc, -40, 40));
+}
+
+int sys_sched_setparam(int pid, const struct k_sched_param *param)
+{
+   struct k_sched_param p;
+
+   if (!param)
+      return -EINVAL;
+
+   if (copy_from_user(&p, param, sizeof(p)) < 0)
+      return -EFAULT;
+
+   return sched_set_policy(pid, -1, p.sched_priority);
+}
+
+int sys_sched_getparam(int pid, struct k_sched_param *param)
+{
+   struct k_sched_param p;
+   int rc, policy;
+
+   if (!param)
+      return -EINVAL;
+
+   if ((rc = sched_get_policy(pid, &policy, &p.sched_priority)))
+      return rc;
+
+   if (copy_to_user(param, &p, sizeof(p)) < 0)
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_sched_setscheduler(int pid,
+                           int policy,
+                           const struct k_sched_param *param)
+{
+   struct k_sched_param p;
+
+   if (!param || policy < 0)
+      return -EINVAL;
+
+   if (copy_from_user(&p, param, sizeof(p)) < 0)
+      return -EFAULT;
+
+   return sched_set_policy(pid, policy, p.sched_priority);
+}
+
+int sys_sched_getscheduler(int pid)
+{
+   int rc, policy, rt_priority;
+
+   if ((rc = sched_get_policy(pid, &policy, &rt_priority)))
+      return rc;
+
+   return policy;
+}
+
+int sys_sched_get_priority_max(int policy)
+{
+   switch (policy) {
+
+      case SCHED_FIFO:
+      case SCHED_RR:
+         return MAX_RT_PRIORITY;
+
+      case SCHED_OTHER:
+      case SCHED_BATCH:
+      case SCHED_IDLE:
+         return 0;
+
+      default:
+         return -EINVAL;
+   }
+}
+
+int sys_sched_get_priority_min(int policy)
+{
+   switch (policy) {
+
+      case SCHED_FIFO:
+      case SCHED_RR:
+         return MIN_RT_PRIORITY;
+
+      case SCHED_OTHER:
+      case SCHED_BATCH:
+      case SCHED_IDLE:
+         return 0;
+
+      default:
+         return -EINVAL;
+   }
+}
+
+/*
+ * Gets the time slice of the task, as a timespec. SCHED_FIFO tasks have no
+ * time slice, while the regular ones have a fixed one on Tilck.
+ */
+static int sched_rr_get_interval(int pid, struct k_timespec64 *tp)
+{
+   int rc, policy, rt_priority;
+   u32 ticks;
+
+   if ((rc = sched_get_policy(pid, &policy, &rt_priority)))
+      return rc;
+
+   if (policy == SCHED_FIFO)
+      ticks = 0;
+   else if (policy == SCHED_RR)
+      ticks = SCHED_RR_TIMESLICE_TICKS;
+   else
+      ticks = TIME_SLICE_TICKS;
+
+   *tp = (struct k_timespec64) {
+      .tv_sec = ticks / TIMER_HZ,
+      .tv_nsec = (long)(ticks % TIMER_HZ) * (TS_SCALE / TIMER_HZ),
+   };
+
+   return 0;
+}
+
+int sys_sched_rr_get_interval_time32(int pid, struct k_timespec32 *user_tp)
+{
+   struct k_timespec64 tp64;
+   struct k_timespec32 tp32;
+   int rc;
+
+   if ((rc = sched_rr_get_interval(pid, &tp64)))
+      return rc;
+
+   tp32 = (struct k_timespec32) {
+      .tv_sec = (s32) tp64.tv_sec,
+      .tv_nsec = tp64.tv_nsec,
+   };
+
+   if (copy_to_user(user_tp, &tp32, sizeof(tp32)) < 0)
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_sched_rr_get_interval(int pid, struct k_timespec64 *user_tp)
+{
+   struct k_timespec64 tp;
+   int rc;
+
+   if ((rc = sched_rr_get_interval(pid, &tp)))
+      return rc;
+
+   if (copy_to_user(user_tp, &tp, sizeof(tp)) < 0)
+      return -EFAULT;
+
+   return 0;
+}
+
 int sys_prctl(int option, ulong a2, ulong a3, ulong a4, ulong a5)
 {
    // TODO: actually implement sys_prctl()
@@ -0,0 +1,326 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/prof.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/interrupts.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/paging_hw.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/elf_utils.h>
+#include <tilck/kernel/errno.h>
+
+/*
+ * Timer-driven sampling profiler.
+ *
+ * At each timer tick, while the profiler is running, the IRQ handler records
+ * the interrupted instruction pointer and, optionally, the return addresses
+ * found by walking the frame pointers. Samples are stored in a buffer
+ * allocated when the profiler is started: when it gets full, new samples are
+ * just counted as lost. The buffer can be read only after stopping the
+ * profiler, so the sampling code never needs to synchronize with readers.
+ * The control commands, instead, are serialized by `prof_mutex`.
+ */
+
+volatile bool __prof_running;
+
+static struct kmutex prof_mutex = STATIC_KMUTEX_INIT(prof_mutex, 0);
+static struct tilck_prof_sample *prof_buf;
+static u32 prof_max_samples;
+static u32 prof_samples;
+static u32 prof_lost;
+static u32 prof_flags;
+
+static u32
+prof_walk_kernel_stack(ulong *frames, u32 max_frames, ulong bp)
+{
+   const ulong stack = (ulong)get_curr_task()->kernel_stack;
+   const ulong stack_end = stack + KERNEL_STACK_SIZE - 2 * sizeof(ulong);
+   u32 n = 0;
+
+   if (!stack)
+      return 0;
+
+   /*
+    * Follow the frame pointers only while they stay inside the current task's
+    * kernel stack: that way, a corrupted or a non-frame-pointer value cannot
+    * make us fault inside the IRQ handler. Also, the frames must go strictly
+    * upwards: callers' frames are always at higher addresses.
+    */
+
+   while (n < max_frames && stack <= bp && bp <= stack_end) {
+
+      const ulong *fp = (const ulong *)bp;
+
+      if (!fp[1])
+         break;
+
+      frames[n++] = fp[1];
+
+      if (fp[0] <= bp)
+         break;
+
+      bp = fp[0];
+   }
+
+   return n;
+}
+
+static u32
+prof_walk_user_stack(ulong *frames, u32 max_frames, ulong bp)
+{
+   pdir_t *pdir = get_curr_pdir();
+   ulong fp[2];
+   u32 n = 0;
+
+   /*
+    * The user stack cannot be trusted: read it through virtual_read() which
+    * just fails on unmapped pages, instead of triggering a page fault.
+    */
+
+   while (n < max_frames && bp && bp < USERMODE_VADDR_END - sizeof(fp)) {
+
+      if (virtual_read(pdir, (void *)bp, fp, sizeof(fp)) < 0)
+         break;
+
+      if (!fp[1])
+         break;
+
+      frames[n++] = fp[1];
+
+      if (fp[0] <= bp)
+         break;
+
+      bp = fp[0];
+   }
+
+   return n;
+}
+
+void prof_take_sample(void)
+{
+   regs_t *r = get_curr_irq_regs();
+   struct tilck_prof_sample *s;
+   ulong var;
+
+   if (!r)
+      return;
+
+   disable_interrupts(&var);
+
+   if (!__prof_running)
+      goto out;
+
+   if (prof_samples == prof_max_samples) {
+      prof_lost++;
+      goto out;
+   }
+
+   s = &prof_buf[prof_samples++];
+   s->tid = (u32)get_curr_tid();
+   s->ip = regs_get_ip(r);
+   s->flags = 0;
+   s->n_frames = 0;
+
+   if (regs_in_user_mode(r)) {
+
+      s->flags |= TILCK_PROF_SAMPLE_USER;
+
+      if (prof_flags & TILCK_PROF_FL_STACKS) {
+         s->n_frames = (u16)prof_walk_user_stack(s->frames,
+                                                 TILCK_PROF_MAX_FRAMES,
+                                                 regs_get_frame_ptr(r));
+      }
+
+   } else if (prof_flags & TILCK_PROF_FL_STACKS) {
+
+      s->n_frames = (u16)prof_walk_kernel_stack(s->frames,
+                                                TILCK_PROF_MAX_FRAMES,
+                                                regs_get_frame_ptr(r));
+   }
+
+out:
+   enable_interrupts(&var);
+}
+
+static void prof_free_buf(void)
+{
+   if (prof_buf) {
+      kfree2(prof_buf, prof_max_samples * sizeof(prof_buf[0]));
+      prof_buf = NULL;
+      prof_max_samples = 0;
+   }
+
+   prof_samples = 0;
+   prof_lost = 0;
+}
+
+static int prof_start(u32 flags, u32 max_samples)
+{
+   struct tilck_prof_sample *buf;
+   ulong var;
+
+   if (flags & ~TILCK_PROF_FL_STACKS)
+      return -EINVAL;
+
+   if (!max_samples)
+      max_samples = TILCK_PROF_DEFAULT_SAMPLES;
+
+   if (max_samples > TILCK_PROF_MAX_SAMPLES)
+      return -EINVAL;
+
+   if (__prof_running)
+      return -EBUSY;
+
+   /* Always start from an empty buffer, re-using the old one if possible */
+   if (prof_max_samples != max_samples) {
+
+      prof_free_buf();
+
+      if (!(buf = kmalloc(max_samples * sizeof(buf[0]))))
+         return -ENOMEM;
+
+      prof_buf = buf;
+      prof_max_samples = max_samples;
+   }
+
+   disable_interrupts(&var);
+   {
+      prof_samples = 0;
+      prof_lost = 0;
+      prof_flags = flags;
+      __prof_running = true;
+   }
+   enable_interrupts(&var);
+   return 0;
+}
+
+static int prof_stop(void)
+{
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      __prof_running = false;
+   }
+   enable_interrupts(&var);
+   return (int)prof_samples;
+}
+
+static int prof_get_info(struct tilck_prof_info *user_info)
+{
+   struct tilck_prof_info info;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      info = (struct tilck_prof_info) {
+         .running = __prof_running,
+         .flags = prof_flags,
+         .samples = prof_samples,
+         .max_samples = prof_max_samples,
+         .lost = prof_lost,
+         .hz = TIMER_HZ,
+      };
+   }
+   enable_interrupts(&var);
+
+   if (copy_to_user(user_info, &info, sizeof(info)))
+      return -EFAULT;
+
+   return 0;
+}
+
+static int prof_read(u32 first, struct tilck_prof_sample *user_buf, u32 count)
+{
+   if (__prof_running)
+      return -EBUSY;
+
+   if (first >= prof_samples)
+      return 0;
+
+   count = MIN(count, prof_samples - first);
+
+   if (copy_to_user(user_buf, prof_buf + first, count * sizeof(prof_buf[0])))
+      return -EFAULT;
+
+   return (int)count;
+}
+
+/*
+ * Resolves a kernel address into a symbol name, copied in `user_buf`.
+ * Returns the offset of `addr` from the beginning of the symbol.
+ */
+static int prof_get_sym(ulong addr, char *user_buf, u32 buf_size)
+{
+   const char *name;
+   long off;
+   u32 sym_size;
+   size_t len;
+
+   if (!(name = find_sym_at_addr_safe(addr, &off, &sym_size)))
+      return -ENOENT;
+
+   len = strlen(name) + 1;
+
+   if (len > buf_size)
+      return -ENAMETOOLONG;
+
+   if (copy_to_user(user_buf, name, len))
+      return -EFAULT;
+
+   return (int)off;
+}
+
+static int prof_reset(void)
+{
+   if (__prof_running)
+      return -EBUSY;
+
+   prof_free_buf();
+   return 0;
+}
+
+int sys_tilck_prof(ulong op, ulong a1, ulong a2, ulong a3)
+{
+   int rc;
+   kmutex_lock(&prof_mutex);
+
+   switch (op) {
+
+      case TILCK_PROF_START:
+         rc = prof_start((u32)a1, (u32)a2);
+         break;
+
+      case TILCK_PROF_STOP:
+         rc = prof_stop();
+         break;
+
+      case TILCK_PROF_GET_INFO:
+         rc = prof_get_info((void *)a1);
+         break;
+
+      case TILCK_PROF_READ:
+         rc = prof_read((u32)a1, (void *)a2, (u32)a3);
+         break;
+
+      case TILCK_PROF_GET_SYM:
+         rc = prof_get_sym(a1, (void *)a2, (u32)a3);
+         break;
+
+      case TILCK_PROF_RESET:
+         rc = prof_reset();
+         break;
+
+      default:
+         rc = -EINVAL;
+   }
+
+   kmutex_unlock(&prof_mutex);
+   return rc;
+}
@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/datetime.h>
+
+#include <sys/resource.h>     // system header
+
+#ifndef RUSAGE_THREAD
+   #define RUSAGE_THREAD                                                  1
+#endif
+
+static void
+task_get_rusage(struct task *ti, struct proc_rusage *ru)
+{
+   task_get_cpu_times(ti, &ru->utime, &ru->stime);
+
+   disable_preemption();
+   {
+      ru->minflt = ti->pi->faults_cnt;
+      ru->nvcsw = ti->ru.nvcsw;
+      ru->nivcsw = ti->ru.nivcsw;
+      ru->syscalls = ti->ru.syscalls;
+      ru->syscr = ti->ru.syscr;
+      ru->syscw = ti->ru.syscw;
+      ru->rchar = ti->ru.rchar;
+      ru->wchar = ti->ru.wchar;
+   }
+   enable_preemption();
+}
+
+void process_get_rusage(struct process *pi, struct proc_rusage *ru)
+{
+   // TODO (threads): sum the counters of all the threads of the process
+   task_get_rusage(get_process_task(pi), ru);
+}
+
+void proc_rusage_add(struct proc_rusage *dst, const struct proc_rusage *src)
+{
+   dst->utime += src->utime;
+   dst->stime += src->stime;
+   dst->minflt += src->minflt;
+   dst->nvcsw += src->nvcsw;
+   dst->nivcsw += src->nivcsw;
+   dst->syscalls += src->syscalls;
+   dst->syscr += src->syscr;
+   dst->syscw += src->syscw;
+   dst->rchar += src->rchar;
+   dst->wchar += src->wchar;
+}
+
+static struct timeval
+ns_to_timeval(u64 ns)
+{
+   return (struct timeval) {
+      .tv_sec = (time_t)(ns / TS_SCALE),
+      .tv_usec = (suseconds_t)((ns % TS_SCALE) / 1000),
+   };
+}
+
+void proc_rusage_to_k_rusage(const struct proc_rusage *ru, struct k_rusage *kr)
+{
+   bzero(kr, sizeof(*kr));
+
+   kr->ru_utime = ns_to_timeval(ru->utime);
+   kr->ru_stime = ns_to_timeval(ru->stime);
+   kr->ru_minflt = (long)ru->minflt;
+   kr->ru_nvcsw = (long)ru->nvcsw;
+   kr->ru_nivcsw = (long)ru->nivcsw;
+}
+
+int sys_getrusage(int who, struct k_rusage *user_buf)
+{
+   struct process *pi = get_curr_proc();
+   struct proc_rusage ru;
+   struct k_rusage kr;
+
+   switch (who) {
+
+      case RUSAGE_SELF:
+      case RUSAGE_THREAD:
+         process_get_rusage(pi, &ru);
+         break;
+
+      case RUSAGE_CHILDREN:
+
+         disable_preemption();
+         {
+            ru = pi->children_ru;
+         }
+         enable_preemption();
+         break;
+
+      default:
+         return -EINVAL;
+   }
+
+   proc_rusage_to_k_rusage(&ru, &kr);
+
+   if (copy_to_user(user_buf, &kr, sizeof(kr)))
+      return -EFAULT;
+
+   return 0;
+}
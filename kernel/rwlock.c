@@ -5,7 +5,7 @@
 
 void rwlock_rp_init(struct rwlock_rp *r)
 {
-   kmutex_init(&r->readers_lock, 0);
+   kmutex_init(&r->readers_lock, KMUTEX_FL_ADAPTIVE);
    ksem_init(&r->writers_sem);
    r->readers_count = 0;
    DEBUG_ONLY(r->ex_owner = NULL);
@@ -59,7 +59,7 @@ void rwlock_rp_exunlock(struct rwlock_rp *r)
 
 void rwlock_wp_init(struct rwlock_wp *rw, bool recursive)
 {
-   kmutex_init(&rw->m, 0);
+   kmutex_init(&rw->m, KMUTEX_FL_ADAPTIVE);
    kcond_init(&rw->c);
    rw->ex_owner = NULL;
    rw->r = 0;
@@ -197,3 +197,115 @@ void rwlock_wp_exunlock(struct rwlock_wp *rw)
    }
    kmutex_unlock(&rw->m);
 }
+
+/* ---------------------------------------------- */
+
+/*
+ * The RWLOCK_RB_WRITER bit is set and cleared only while holding `m`, while
+ * the readers count is updated locklessly. Keys used on the kcond:
+ *
+ *    KCOND_KEY_READ:   the writer left (waited by readers and other writers)
+ *    KCOND_KEY_WRITE:  the last reader left (waited by the pending writer)
+ */
+
+void rwlock_rb_init(struct rwlock_rb *rw, bool recursive)
+{
+   atomic_store_explicit(&rw->cnt, 0, mo_relaxed);
+   kmutex_init(&rw->m, KMUTEX_FL_ADAPTIVE);
+   kcond_init(&rw->c);
+   rw->ex_owner = NULL;
+   rw->rec = recursive;
+   rw->rc = 0;
+}
+
+void rwlock_rb_destroy(struct rwlock_rb *rw)
+{
+   ASSERT(atomic_load_explicit(&rw->cnt, mo_relaxed) == 0);
+   rw->ex_owner = NULL;
+   kcond_destory(&rw->c);
+   kmutex_destroy(&rw->m);
+}
+
+static int rwlock_rb_readers(struct rwlock_rb *rw)
+{
+   return atomic_load_explicit(&rw->cnt, mo_relaxed) & ~RWLOCK_RB_WRITER;
+}
+
+void rwlock_rb_shlock_slow(struct rwlock_rb *rw)
+{
+   int old;
+
+   kmutex_lock(&rw->m);
+   {
+      /* Take back our optimistic increment: a writer is pending */
+      old = atomic_fetch_sub_explicit(&rw->cnt, 1, mo_relaxed);
+
+      if (old == (RWLOCK_RB_WRITER | 1))
+         kcond_signal_key_one(&rw->c, KCOND_KEY_WRITE);
+
+      /* The writer bit cannot change under us, since we're holding `m` */
+      while (atomic_load_explicit(&rw->cnt, mo_relaxed) & RWLOCK_RB_WRITER)
+         kcond_wait_key(&rw->c, &rw->m, KCOND_WAIT_FOREVER, KCOND_KEY_READ);
+
+      atomic_fetch_add_explicit(&rw->cnt, 1, mo_acquire);
+   }
+   kmutex_unlock(&rw->m);
+}
+
+void rwlock_rb_shunlock_slow(struct rwlock_rb *rw)
+{
+   /*
+    * Taking `m` guarantees that the writer is either still checking the
+    * readers count or already sleeping on the kcond: the wake-up can't be lost.
+    */
+   kmutex_lock(&rw->m);
+   {
+      kcond_signal_key_one(&rw->c, KCOND_KEY_WRITE);
+   }
+   kmutex_unlock(&rw->m);
+}
+
+void rwlock_rb_exlock(struct rwlock_rb *rw)
+{
+   kmutex_lock(&rw->m);
+
+   if (rw->rec && rw->ex_owner == get_curr_task()) {
+      ASSERT(rw->rc >= 1);
+      rw->rc++;
+      kmutex_unlock(&rw->m);
+      return;
+   }
+
+   /* Wait for the current writer, if any, to leave */
+   while (atomic_load_explicit(&rw->cnt, mo_relaxed) & RWLOCK_RB_WRITER)
+      kcond_wait_key(&rw->c, &rw->m, KCOND_WAIT_FOREVER, KCOND_KEY_READ);
+
+   /* From now on, new readers will take the slow path and wait for us */
+   atomic_fetch_add_explicit(&rw->cnt, RWLOCK_RB_WRITER, mo_relaxed);
+
+   /* Wait for the readers still holding the lock to leave */
+   while (rwlock_rb_readers(rw) > 0)
+      kcond_wait_key(&rw->c, &rw->m, KCOND_WAIT_FOREVER, KCOND_KEY_WRITE);
+
+   ASSERT(rw->ex_owner == NULL);
+   rw->ex_owner = get_curr_task();
+   rw->rc = 1;
+
+   kmutex_unlock(&rw->m);
+}
+
+void rwlock_rb_exunlock(struct rwlock_rb *rw)
+{
+   kmutex_lock(&rw->m);
+   {
+      ASSERT(rw->ex_owner == get_curr_task());
+      ASSERT(rw->rc > 0);
+
+      if (--rw->rc == 0) {
+         rw->ex_owner = NULL;
+         atomic_fetch_sub_explicit(&rw->cnt, RWLOCK_RB_WRITER, mo_release);
+         kcond_signal_key_all(&rw->c, KCOND_KEY_READ);
+      }
+   }
+   kmutex_unlock(&rw->m);
+}
@@ -9,7 +9,9 @@
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
 #include <tilck/kernel/errno.h>
+#include <tilck/kernel/id_bitmap.h>
 
 /* Shared global variables */
 struct task *__current;
@@ -27,9 +29,35 @@ struct list zombie_tasks_list;
 static struct task *tree_by_tid_root;
 static u64 idle_ticks;
 static int runnable_tasks_count;
-static int current_max_pid = -1;
-static int current_max_kernel_tid = -1;
 static struct task *idle_task;
+static struct sched_cpu_ticks cpu_ticks;
+static u64 tsc_ref;                       /* RDTSC() value at the 1st tick */
+static u64 sys_time_ref;                  /* get_sys_time() at the 1st tick */
+static struct task *yield_to_task;        /* see sched_yield_to_hint() */
+static bool curr_yielded;                 /* see sched_yield_curr() */
+
+/* Real-time throttling, see sched_account_rt_ticks() */
+static u32 rt_period_ticks;
+static u32 rt_runtime_ticks;
+static bool rt_throttled;
+
+STATIC_ASSERT(SCHED_RR_TIMESLICE_TICKS > 0);
+STATIC_ASSERT(SCHED_RT_RUNTIME_TICKS <= SCHED_RT_PERIOD_TICKS);
+
+/*
+ * Weight of each nice value, from -20 to 19, as in Linux: each step is about
+ * 1.25x, so that a task gets ~10% more CPU than a task with nice + 1.
+ */
+static const u32 nice_to_weight[40] = {
+   88761, 71755, 56483, 46273, 36291,
+   29154, 23254, 18705, 14949, 11916,
+    9548,  7620,  6100,  4904,  3906,
+    3121,  2501,  1991,  1586,  1277,
+    1024,   820,   655,   526,   423,
+     335,   272,   215,   172,   137,
+     110,    87,    70,    56,    45,
+      36,    29,    23,    18,    15,
+};
 
 void enable_preemption(void)
 {
@@ -68,25 +96,221 @@ get_traced_tasks_count(void)
    return count;
 }
 
+int get_curr_tid(void)
+{
+   struct task *c = get_curr_task();
+   return c ? c->tid : 0;
+}
+
+int get_curr_pid(void)
+{
+   struct task *c = get_curr_task();
+   return c ? c->pi->pid : 0;
+}
+
+/*
+ * A pid is in use if there's a process with that pid OR if it's still the pgid
+ * or the sid of some process, even after its group/session leader died: a new
+ * process must never become by accident the leader of an existing group or
+ * session. Therefore, we keep a reference count per pid: one for the process
+ * itself, one for its process group and one for its session, if any. A bit is
+ * set in `pid_bm` as long as its count is > 0.
+ */
+static u8 pid_refs[MAX_PID + 1];
+static ulong pid_bits[ID_BITMAP_WORDS(MAX_PID)];
+static ulong pid_full[ID_BITMAP_FULL_WORDS(MAX_PID)];
+static struct id_bitmap pid_bm;
+
+static ulong ktid_bits[ID_BITMAP_WORDS(KERNEL_MAX_TID)];
+static ulong ktid_full[ID_BITMAP_FULL_WORDS(KERNEL_MAX_TID)];
+static struct id_bitmap ktid_bm;
+
+static void pid_ref(int id)
+{
+   ASSERT(0 <= id && id <= MAX_PID);
+
+   if (!pid_refs[id]++)
+      id_bitmap_set(&pid_bm, id);
+}
+
+static void pid_unref(int id)
+{
+   ASSERT(0 <= id && id <= MAX_PID);
+   ASSERT(pid_refs[id] > 0);
+
+   if (!--pid_refs[id])
+      id_bitmap_clear(&pid_bm, id);
+}
+
+static void init_id_bitmaps(void)
+{
+   bzero(pid_refs, sizeof(pid_refs));
+   id_bitmap_init(&pid_bm, pid_bits, pid_full, MAX_PID);
+   id_bitmap_init(&ktid_bm, ktid_bits, ktid_full, KERNEL_MAX_TID);
+}
+
+/*
+ * NOTE: the new ID is NOT marked as used until add_task() is called. That's
+ * fine because the caller keeps the preemption disabled in between.
+ */
+int create_new_pid(void)
+{
+   ASSERT(!is_preemption_enabled());
+   return id_bitmap_next_free(&pid_bm);
+}
+
+int create_new_kernel_tid(void)
+{
+   int r;
+   ASSERT(!is_preemption_enabled());
+
+   if ((r = id_bitmap_next_free(&ktid_bm)) < 0)
+      return -1;
+
+   return r + KERNEL_TID_START;
+}
+
+/*
+ * Process groups and sessions. Each process belongs to a process group and
+ * each group to a session: the groups are kept in a tree by pgid and contain
+ * the list of their member processes, while sessions are kept in a tree by sid
+ * and contain the list of their groups. That way, job control operations like
+ * sending a signal to a group, touch only the processes involved.
+ *
+ * Like for the tree of tasks, all of that is protected by disabling the
+ * preemption. A process leaves its group only when it's removed, after being
+ * reaped by its parent: zombie processes still count as members.
+ */
+
+static struct process_group *pgrp_by_pgid_root;
+static struct session *session_by_sid_root;
+static struct process_group kernel_pgrp;
+static struct session kernel_session;
+
+static struct process_group *get_pgrp(int pgid)
+{
+   long lpgid = pgid;
+   ASSERT(!is_preemption_enabled());
+
+   return bintree_find_ptr(pgrp_by_pgid_root,
+                           lpgid,
+                           struct process_group,
+                           node,
+                           pgid);
+}
+
+static struct session *get_session(int sid)
+{
+   long lsid = sid;
+   ASSERT(!is_preemption_enabled());
+
+   return bintree_find_ptr(session_by_sid_root,
+                           lsid,
+                           struct session,
+                           node,
+                           sid);
+}
+
+static void init_session(struct session *s, int sid)
+{
+   s->sid = sid;
+   bintree_node_init(&s->node);
+   list_init(&s->groups);
+
+   bintree_insert_ptr(&session_by_sid_root, s, struct session, node, sid);
+   pid_ref(sid);
+}
+
+static void init_pgrp(struct process_group *g, int pgid, struct session *s)
+{
+   g->pgid = pgid;
+   g->count = 0;
+   g->s = s;
+   bintree_node_init(&g->node);
+   list_node_init(&g->s_node);
+   list_init(&g->members);
+
+   list_add_tail(&s->groups, &g->s_node);
+   bintree_insert_ptr(&pgrp_by_pgid_root, g, struct process_group, node, pgid);
+   pid_ref(pgid);
+}
+
+static void destroy_session(struct session *s)
+{
+   ASSERT(list_is_empty(&s->groups));
+   ASSERT(s != &kernel_session);
+
+   bintree_remove_ptr(&session_by_sid_root, s, struct session, node, sid);
+   pid_unref(s->sid);
+   kfree2(s, sizeof(*s));
+}
+
+static void destroy_pgrp(struct process_group *g)
+{
+   struct session *s = g->s;
+
+   ASSERT(g->count == 0);
+   ASSERT(g != &kernel_pgrp);
+
+   list_remove(&g->s_node);
+   bintree_remove_ptr(&pgrp_by_pgid_root, g, struct process_group, node, pgid);
+   pid_unref(g->pgid);
+   kfree2(g, sizeof(*g));
+
+   if (list_is_empty(&s->groups))
+      destroy_session(s);
+}
+
+static struct process_group *create_pgrp(int pgid, struct session *s)
+{
+   struct process_group *g;
+
+   if (!(g = kzmalloc(sizeof(*g))))
+      return NULL;
+
+   init_pgrp(g, pgid, s);
+   return g;
+}
+
+static void pgrp_add_process(struct process_group *g, struct process *pi)
+{
+   list_add_tail(&g->members, &pi->pgrp_node);
+   g->count++;
+
+   pi->pgid = g->pgid;
+   pi->sid = g->s->sid;
+}
+
+static void pgrp_remove_process(struct process *pi)
+{
+   struct process_group *g = get_pgrp(pi->pgid);
+
+   ASSERT(g != NULL);
+   list_remove(&pi->pgrp_node);
+   list_node_init(&pi->pgrp_node);
+
+   if (!--g->count)
+      destroy_pgrp(g);
+}
+
+static void init_kernel_pgrp(void)
+{
+   pgrp_by_pgid_root = NULL;
+   session_by_sid_root = NULL;
+
+   init_session(&kernel_session, 0);
+   init_pgrp(&kernel_pgrp, 0, &kernel_session);
+}
+
 int sched_count_proc_in_group(int pgid)
 {
-   struct bintree_walk_ctx ctx;
-   struct task *ti;
-   int count = 0;
+   struct process_group *g;
+   int count;
 
    disable_preemption();
    {
-      bintree_in_order_visit_start(&ctx,
-                                   tree_by_tid_root,
-                                   struct task,
-                                   tree_by_tid_node,
-                                   false);
-
-      while ((ti = bintree_in_order_visit_next(&ctx))) {
-
-         if (ti->pi->pgid == pgid)
-            count++;
-      }
+      g = get_pgrp(pgid);
+      count = g ? g->count : 0;
    }
    enable_preemption();
    return count;
@@ -94,238 +318,300 @@ int sched_count_proc_in_group(int pgid)
 
 int sched_get_session_of_group(int pgid)
 {
-   struct bintree_walk_ctx ctx;
-   struct task *ti;
-   int sid = -ESRCH;
+   struct process_group *g;
+   int sid;
 
    disable_preemption();
    {
-      bintree_in_order_visit_start(&ctx,
-                                   tree_by_tid_root,
-                                   struct task,
-                                   tree_by_tid_node,
-                                   false);
-
-      while ((ti = bintree_in_order_visit_next(&ctx))) {
-
-         if (ti->pi->pgid == pgid) {
-            sid = ti->pi->sid;
-            break;
-         }
-      }
+      g = get_pgrp(pgid);
+      sid = g ? g->s->sid : -ESRCH;
    }
    enable_preemption();
    return sid;
 }
 
-int get_curr_tid(void)
+/*
+ * Move `pi` to the process group `pgid`, creating it in the session of `pi`,
+ * if it does not exist. It's up to the caller to check that an existing group
+ * belongs to the same session.
+ */
+int sched_set_pgrp(struct process *pi, int pgid)
 {
-   struct task *c = get_curr_task();
-   return c ? c->tid : 0;
+   struct process_group *g;
+   struct session *s;
+   ASSERT(!is_preemption_enabled());
+
+   if (pi->pgid == pgid)
+      return 0;
+
+   s = get_pgrp(pi->pgid)->s;
+
+   if (!(g = get_pgrp(pgid))) {
+      if (!(g = create_pgrp(pgid, s)))
+         return -ENOMEM;
+   }
+
+   ASSERT(g->s == s);
+   pgrp_remove_process(pi);
+   pgrp_add_process(g, pi);
+   return 0;
 }
 
-int get_curr_pid(void)
+/* Move `pi` to a new process group, in a new session, both with ID = pid */
+int sched_new_session(struct process *pi)
 {
-   struct task *c = get_curr_task();
-   return c ? c->pi->pid : 0;
+   struct session *s;
+   struct process_group *g;
+   ASSERT(!is_preemption_enabled());
+   ASSERT(!get_pgrp(pi->pid));
+
+   if (!(s = kzmalloc(sizeof(*s))))
+      return -ENOMEM;
+
+   init_session(s, pi->pid);
+
+   if (!(g = create_pgrp(pi->pid, s))) {
+      destroy_session(s);
+      return -ENOMEM;
+   }
+
+   pgrp_remove_process(pi);
+   pgrp_add_process(g, pi);
+   return 0;
 }
 
-struct create_pid_visit_ctx {
+/* `which` values for getpriority() and setpriority() */
+#define PRIO_PROCESS       0
+#define PRIO_PGRP          1
+#define PRIO_USER          2
 
-   bool kernel_tid;
-   bool lowest_avail_invalid;
-   int id_off;
-   int lowest_available;
-   int lowest_after_current_max;
+struct nice_visit_ctx {
+   int nice;
+   int count;
+   bool set;
 };
 
-static inline int inc_candicate_if_matches(int *cand, int id, int val)
+static int nice_visit_cb(void *obj, void *arg)
 {
-   if (*cand != val)
-      return 0; /* Everything is OK */
+   struct task *ti = obj;
+   struct nice_visit_ctx *ctx = arg;
 
-   /* The lowest_<something> candicate cannot be > id */
-   ASSERT(*cand <= val);
+   if (is_kernel_thread(ti))
+      return 0;
 
-   /*
-    * We've found a case where the candicate is equal to current task's pgid/sid
-    * and that might be a problem.
-    *
-    * Two cases:
-    *
-    *    1) Candidate == id. This means: candidate == pgid/sid == id.
-    *       That's fine: we just hit a group/session leader. By default we'll
-    *       skip this candiate (see the impl. below).
-    *
-    *    2) Candidate < id. This means that the pgid/sid is < id and we didn't
-    *       hit it before (note: we're doing an in-order visit). For example:
-    *
-    *    pid | sid | what
-    *    ----+-----+-----------
-    *     1  |  1  | init
-    *     2  |  1  | ash
-    *     8  |  3  | prog1
-    *
-    *    lowest_available = 3   [our candidate]
-    *
-    *    We don't want this to happen because 3 is the ID of a session, with
-    *    a dead leader. In order to handle this case, we have to increment
-    *    lowest_available and restart the whole iteration. We must end up with
-    *    lowest_available = 4. Actually, if lowest_after_current_max is a good
-    *    value, we're going to use it without restarting the iteration.
-    */
-
-   if (*cand == id)
-      return 0; /* We just hit a group/session leader. That's fine */
+   if (ctx->set)
+      sched_set_task_prio(ti, NICE_TO_PRIO(ctx->nice));
+   else
+      ctx->nice = MIN(ctx->nice, PRIO_TO_NICE(ti->static_prio));
 
-   (*cand)++;
-   return 1;
+   ctx->count++;
+   return 0;
 }
 
-static int create_new_pid_visit_cb(void *obj, void *arg)
+/*
+ * Visits all the user tasks matching `which` and `who`, as getpriority() and
+ * setpriority() do. Since all the processes in Tilck belong to root, for
+ * PRIO_USER the only user ID having any process is 0.
+ */
+static int nice_visit(int which, int who, struct nice_visit_ctx *ctx)
 {
-   struct task *ti = obj;
-   struct create_pid_visit_ctx *ctx = arg;
-   const int tid = ti->tid - ctx->id_off;
+   struct process_group *g;
+   struct process *pi;
+   struct task *ti;
 
-   if (ctx->kernel_tid) {
+   ASSERT(!is_preemption_enabled());
 
-      if (!is_kernel_thread(ti))
-         return 0; /* skip non-kernel tasks */
+   if (who < 0)
+      return -ESRCH;
 
-      ASSERT(tid >= 0);
+   switch (which) {
 
+      case PRIO_PROCESS:
 
-   } else {
+         if (!(ti = who ? get_task(who) : get_curr_task()))
+            return -ESRCH;
 
-      if (!is_main_thread(ti))
-         return 0; /* skip threads */
+         nice_visit_cb(ti, ctx);
+         break;
 
-      ASSERT(tid >= 0);
+      case PRIO_PGRP:
 
-      if (tid < ctx->lowest_available)
-         return 0;
+         if (!(g = get_pgrp(who ? who : get_curr_proc()->pgid)))
+            return -ESRCH;
 
-      /*
-       * Both ctx->lowest_available and ctx->lowest_after_current_max are
-       * candidates for the next tid. If one of them gets equal to a sid
-       * without a session leader process or to a pgid without a group leader,
-       * the new process could accidentally become leader of a group/session:
-       * we have to ensure that could never happen.
-       */
+         list_for_each_ro(pi, &g->members, pgrp_node)
+            nice_visit_cb(get_process_task(pi), ctx);
 
-      const int pgid = ti->pi->pgid;
-      const int sid = ti->pi->sid;
-      const int should_restart =
-         inc_candicate_if_matches(&ctx->lowest_available, tid, pgid) +
-         inc_candicate_if_matches(&ctx->lowest_available, tid, sid) +
-         inc_candicate_if_matches(&ctx->lowest_after_current_max, tid, pgid) +
-         inc_candicate_if_matches(&ctx->lowest_after_current_max, tid, sid);
+         break;
 
-      if (should_restart) {
-         ctx->lowest_avail_invalid = true;
-      }
-   }
+      case PRIO_USER:
 
+         if (!who)
+            iterate_over_tasks(&nice_visit_cb, ctx);
 
-   /*
-    * Algorithm: we start with lowest_available (L) == 0. When we hit
-    * tid == L, that means L is not really the lowest, therefore, we guess
-    * the right value of L is L + 1. The first time tid skips one, for example
-    * jumping from 3 to 5, the value of L set by the iteration with tid == 3,
-    * will stuck. That value will be clearly 4.
-    */
+         break;
 
-   if (ctx->lowest_available == tid)
-      ctx->lowest_available++;
+      default:
+         return -EINVAL;
+   }
 
-   /*
-    * For lowest_after_current_max (A) the logic is similar.
-    * We start with A = current_max_pid + 1. The first time A is == tid, will
-    * be when tid is current_max_pid + 1. We continue to update A, until the
-    * first hole is found. In case tid never reaches current_max_pid + 1, `A`
-    * will be just be current_max_pid + 1, as expected.
-    */
+   return ctx->count > 0 ? 0 : -ESRCH;
+}
 
-   if (ctx->lowest_after_current_max == tid)
-      ctx->lowest_after_current_max++;
+/* Gets the lowest nice value (= highest priority) among the matching tasks */
+int sched_get_nice(int which, int who, int *nice)
+{
+   struct nice_visit_ctx ctx = { .nice = MAX_NICE, .set = false };
+   int rc;
 
-   return 0;
+   disable_preemption();
+   {
+      rc = nice_visit(which, who, &ctx);
+   }
+   enable_preemption();
+
+   *nice = ctx.nice;
+   return rc;
 }
 
-static int
-create_id_common(struct create_pid_visit_ctx *ctx, int max_id)
+int sched_set_nice(int which, int who, int nice)
 {
-   int r;
+   struct nice_visit_ctx ctx = { .set = true };
+   int rc;
 
-   do {
+   ctx.nice = CLAMP(nice, MIN_NICE, MAX_NICE);
 
-      ctx->lowest_avail_invalid = false;
-      iterate_over_tasks(&create_new_pid_visit_cb, ctx);
-
-      r = ctx->lowest_after_current_max <= max_id
-            ? ctx->lowest_after_current_max
-            : ctx->lowest_available <= max_id
-               ? ctx->lowest_available
-               : -1;
+   disable_preemption();
+   {
+      rc = nice_visit(which, who, &ctx);
+   }
+   enable_preemption();
+   return rc;
+}
 
-      /*
-       * Typically, ctx->lowest_avail_invalid is not a problem because the new
-       * id will be ctx->lowest_after_current_max. But, in the case we've
-       * finished the IDs, we have to pick the absolutely lowest ID available,
-       * which might be invalid we it matched with a process' pgid/sid. This
-       * can happen only in case of orphaned sessions/process groups.
-       *
-       * NOTE: in case we're going to repeat the loop, lowest_avail_invalid is
-       * reset, but all the rest of the context is unchanged: that's because
-       * ctx->lowest_available has actually a meaningful value: the lowest ID
-       * after pgid/sid we hit. It doesn't mean we can use this value, but it
-       * means we cannot pick consider IDs smaller than it.
-       */
+/*
+ * Updates `prio` after a change of the normal priority of the task. Keep the
+ * priority inheritance boost, if any: it will be dropped by kmutex_unlock(),
+ * when the task releases its last kmutex.
+ */
+static void sched_update_prio(struct task *ti, u8 old_normal_prio)
+{
+   ASSERT(!is_preemption_enabled());
 
-   } while (r == ctx->lowest_available && ctx->lowest_avail_invalid);
+   if (ti->prio < old_normal_prio)
+      ti->prio = MIN(ti->prio, task_normal_prio(ti));
+   else
+      ti->prio = task_normal_prio(ti);
+}
 
-   return r;
+void sched_set_task_prio(struct task *ti, u8 static_prio)
+{
+   disable_preemption();
+   {
+      const u8 old_normal_prio = task_normal_prio(ti);
+      ti->static_prio = static_prio;
+      sched_update_prio(ti, old_normal_prio);
+   }
+   enable_preemption();
 }
 
-int create_new_pid(void)
+int sched_set_task_policy(struct task *ti, int policy, int rt_priority)
 {
-   ASSERT(!is_preemption_enabled());
+   switch (policy) {
+
+      case SCHED_FIFO:
+      case SCHED_RR:
+
+         if (rt_priority < MIN_RT_PRIORITY || rt_priority > MAX_RT_PRIORITY)
+            return -EINVAL;
+
+         break;
 
-   struct create_pid_visit_ctx ctx = {
-      .kernel_tid = false,
-      .id_off = 0,
-      .lowest_available = 0,
-      .lowest_after_current_max = current_max_pid + 1,
-   };
+      case SCHED_OTHER:
+      case SCHED_BATCH:
+      case SCHED_IDLE:
 
-   int r = create_id_common(&ctx, MAX_PID);
+         /* No special treatment for batch and idle tasks on Tilck */
+         if (rt_priority != 0)
+            return -EINVAL;
+
+         break;
+
+      default:
+         return -EINVAL;
+   }
 
-   if (r >= 0)
-      current_max_pid = r;
+   disable_preemption();
+   {
+      const u8 old_normal_prio = task_normal_prio(ti);
+      ti->policy = (u8)policy;
+      ti->rt_priority = (u8)rt_priority;
+      sched_update_prio(ti, old_normal_prio);
 
-   return r;
+      /* The current task might not be the one to run anymore */
+      sched_set_need_resched();
+   }
+   enable_preemption();
+   return 0;
 }
 
-int create_new_kernel_tid(void)
+/*
+ * Gets the user task having the given tid, or the current one if tid == 0.
+ * Like nice values, scheduling policies are not exposed for kernel threads.
+ */
+static struct task *sched_get_user_task(int tid)
 {
+   struct task *ti;
    ASSERT(!is_preemption_enabled());
 
-   struct create_pid_visit_ctx ctx = {
-      .kernel_tid = true,
-      .id_off = KERNEL_TID_START,
-      .lowest_available = 0,
-      .lowest_after_current_max = current_max_kernel_tid + 1,
-   };
+   if (tid < 0)
+      return NULL;
+
+   ti = tid ? get_task(tid) : get_curr_task();
+   return ti && !is_kernel_thread(ti) ? ti : NULL;
+}
+
+/* A negative `policy` means: keep the current one (see sched_setparam(2)) */
+int sched_set_policy(int tid, int policy, int rt_priority)
+{
+   struct task *ti;
+   int rc = -ESRCH;
+
+   if (tid < 0)
+      return -EINVAL;
+
+   disable_preemption();
+   {
+      if ((ti = sched_get_user_task(tid))) {
 
-   int r = create_id_common(&ctx, KERNEL_MAX_TID);
+         if (policy < 0)
+            policy = ti->policy;
 
-   if (r >= 0) {
-      current_max_kernel_tid = r;
-      return r + KERNEL_TID_START;
+         rc = sched_set_task_policy(ti, policy, rt_priority);
+      }
    }
+   enable_preemption();
+   return rc;
+}
 
-   return -1;
+int sched_get_policy(int tid, int *policy, int *rt_priority)
+{
+   struct task *ti;
+   int rc = -ESRCH;
+
+   if (tid < 0)
+      return -EINVAL;
+
+   disable_preemption();
+   {
+      if ((ti = sched_get_user_task(tid))) {
+         *policy = ti->policy;
+         *rt_priority = ti->rt_priority;
+         rc = 0;
+      }
+   }
+   enable_preemption();
+   return rc;
 }
 
 int iterate_over_tasks(bintree_visit_cb func, void *arg)
@@ -365,6 +651,7 @@ void create_kernel_process(void)
    list_init(&runnable_tasks_list);
    list_init(&sleeping_tasks_list);
    list_init(&zombie_tasks_list);
+   init_id_bitmaps();
 
 #ifndef UNIT_TEST_ENVIRONMENT
    if (!in_panic()) {
@@ -383,6 +670,8 @@ void create_kernel_process(void)
 
    s_kernel_ti->is_main_thread = true;
    s_kernel_ti->running_in_kernel = true;
+   s_kernel_ti->static_prio = DEFAULT_PRIO;
+   s_kernel_ti->prio = DEFAULT_PRIO;
    memcpy(s_kernel_pi->str_cwd, "/", 2);
 
    s_kernel_ti->state = TASK_STATE_SLEEPING;
@@ -394,6 +683,7 @@ void create_kernel_process(void)
    if (!in_panic()) {
       bzero(s_kernel_ti->arch_fields, sizeof(s_kernel_ti->arch_fields));
       bzero(s_kernel_pi->arch_fields, sizeof(s_kernel_pi->arch_fields));
+      init_kernel_pgrp();
       add_task(kernel_process);
    }
 #endif
@@ -433,6 +723,44 @@ void set_current_task_in_kernel(void)
    get_curr_task()->running_in_kernel = true;
 }
 
+/*
+ * Real-time tasks and tasks boosted by priority inheritance (holding a kmutex
+ * that a higher priority task is waiting for) are "urgent": they go before any
+ * task with a lower priority, no matter the runtime. Real-time tasks having
+ * the same priority keep their order in `runnable_tasks_list`. Otherwise,
+ * tasks are picked in a fair way, by their nice-weighted runtime, preferring
+ * the ones just woken up by a timer.
+ *
+ * While throttled (see sched_account_rt_ticks()), the real-time tasks are
+ * scheduled like the regular ones.
+ */
+static ALWAYS_INLINE bool sched_is_boosted(struct task *ti)
+{
+   return ti->prio < task_normal_prio(ti);
+}
+
+static ALWAYS_INLINE bool sched_is_urgent(struct task *ti)
+{
+   return (is_rt_task(ti) && !rt_throttled) || sched_is_boosted(ti);
+}
+
+static ALWAYS_INLINE bool sched_is_task_before(struct task *a, struct task *b)
+{
+   if (sched_is_urgent(a) || sched_is_urgent(b)) {
+
+      if (a->prio != b->prio)
+         return a->prio < b->prio;
+
+      if (a->prio < MAX_RT_PRIO)
+         return false;
+   }
+
+   if (a->timer_ready != b->timer_ready)
+      return a->timer_ready;
+
+   return a->ticks.vruntime < b->ticks.vruntime;
+}
+
 static void task_add_to_state_list(struct task *ti)
 {
    if (is_worker_thread(ti))
@@ -505,6 +833,15 @@ void task_change_state(struct task *ti, enum task_state new_state)
       task_add_to_state_list(ti);
    }
    enable_interrupts(&var);
+
+   /* Wake-up preemption: don't wait for the next tick to run urgent tasks */
+   if (new_state == TASK_STATE_RUNNABLE &&
+       ti != get_curr_task() &&
+       sched_is_urgent(ti) &&
+       ti->prio < get_curr_task()->prio)
+   {
+      sched_set_need_resched();
+   }
 }
 
 void add_task(struct task *ti)
@@ -513,6 +850,14 @@ void add_task(struct task *ti)
    {
       task_add_to_state_list(ti);
 
+      if (is_kernel_thread(ti))
+         id_bitmap_set(&ktid_bm, ti->tid - KERNEL_TID_START);
+
+      if (is_main_thread(ti)) {
+         pid_ref(ti->pi->pid);
+         pgrp_add_process(get_pgrp(ti->pi->pgid), ti->pi);
+      }
+
       bintree_insert_ptr(&tree_by_tid_root,
                          ti,
                          struct task,
@@ -536,11 +881,59 @@ void remove_task(struct task *ti)
                          tree_by_tid_node,
                          tid);
 
+      if (is_kernel_thread(ti))
+         id_bitmap_clear(&ktid_bm, ti->tid - KERNEL_TID_START);
+
+      if (is_main_thread(ti)) {
+         pgrp_remove_process(ti->pi);
+         pid_unref(ti->pi->pid);
+      }
+
       free_task(ti);
    }
    enable_preemption();
 }
 
+/*
+ * Real-time throttling: in each period of SCHED_RT_PERIOD_TICKS, real-time
+ * tasks can run for at most SCHED_RT_RUNTIME_TICKS, in order to leave some CPU
+ * time to the regular tasks, no matter what. Once the runtime is exhausted,
+ * they're scheduled like the regular tasks until the end of the period. Tasks
+ * boosted by priority inheritance are not affected.
+ *
+ * Returns true if the throttling state changed.
+ */
+static bool sched_account_rt_ticks(struct task *curr)
+{
+   bool changed = false;
+
+   if (is_rt_task(curr) && ++rt_runtime_ticks == SCHED_RT_RUNTIME_TICKS) {
+      rt_throttled = true;
+      changed = true;
+   }
+
+   if (++rt_period_ticks == SCHED_RT_PERIOD_TICKS) {
+      changed |= rt_throttled;
+      rt_throttled = false;
+      rt_period_ticks = 0;
+      rt_runtime_ticks = 0;
+   }
+
+   return changed;
+}
+
+/*
+ * SCHED_FIFO tasks run until they block, yield or get preempted by a task with
+ * a higher priority: they have no time slice.
+ */
+static u32 sched_get_timeslice(struct task *ti)
+{
+   if (!is_rt_task(ti) || rt_throttled)
+      return TIME_SLICE_TICKS;
+
+   return ti->policy == SCHED_RR ? SCHED_RR_TIMESLICE_TICKS : UINT32_MAX;
+}
+
 void sched_account_ticks(void)
 {
    struct task *curr = get_curr_task();
@@ -554,28 +947,201 @@ void sched_account_ticks(void)
    t->timeslice++;
    t->total++;
 
+   /* vruntime grows by 1024 per tick with nice 0, faster with nice > 0 */
+   t->vruntime +=
+      (1024 * 1024) / nice_to_weight[curr->static_prio - MAX_RT_PRIO];
+
    if (curr->running_in_kernel)
-      t->total_kernel++;
+      curr->ru.kernel_ticks++;
+
+   if (UNLIKELY(!tsc_ref)) {
+      tsc_ref = RDTSC();
+      sys_time_ref = get_sys_time();
+   }
+
+   if (curr == idle_task)
+      cpu_ticks.idle++;
+   else if (curr->running_in_kernel)
+      cpu_ticks.system++;
+   else
+      cpu_ticks.user++;
+
+   if (sched_account_rt_ticks(curr))
+      sched_set_need_resched();
 
    if (curr->stopped                                 ||
        state != TASK_STATE_RUNNING                   ||
-         (!runner && t->timeslice >= TIME_SLICE_TICKS)
+         (!runner && t->timeslice >= sched_get_timeslice(curr))
        )
    {
       sched_set_need_resched();
    }
 }
 
+void sched_get_cpu_ticks(struct sched_cpu_ticks *out)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      *out = cpu_ticks;
+   }
+   enable_interrupts(&var);
+}
+
+void sched_account_switch(struct task *prev, struct task *next)
+{
+   const u64 now = RDTSC();
+
+   ASSERT(!is_preemption_enabled());
+
+   prev->ru.runtime += now - prev->ru.last_switch;
+   next->ru.last_switch = now;
+
+   /*
+    * If the task has been preempted, schedule() changed its state from
+    * RUNNING to RUNNABLE. In all the other cases (sleeping, dying) the task
+    * gave up the CPU voluntarily.
+    */
+   if (prev->state == TASK_STATE_RUNNABLE)
+      prev->ru.nivcsw++;
+   else
+      prev->ru.nvcsw++;
+}
+
+/*
+ * Converts TSC cycles to nanoseconds, using the TSC frequency measured
+ * against the system clock since the first timer tick. Returns 0 if not
+ * enough time has passed to get a meaningful measurement.
+ */
+static u64 tsc_cycles_to_ns(u64 cycles)
+{
+   const u64 ms = (get_sys_time() - sys_time_ref) / (TS_SCALE / 1000);
+   u64 khz, secs;
+
+   if (!tsc_ref || ms < 100)
+      return 0;
+
+   if (!(khz = (RDTSC() - tsc_ref) / ms))
+      return 0;
+
+   secs = cycles / (khz * 1000);
+   cycles -= secs * khz * 1000;
+   return secs * TS_SCALE + cycles * 1000000 / khz;
+}
+
+/*
+ * Gets the user and system time of the given task. Like Linux does, the total
+ * runtime is measured precisely at each context switch, while its split
+ * between user and kernel mode is estimated by sampling at each timer tick.
+ */
+void task_get_cpu_times(struct task *ti, u64 *utime_ns, u64 *stime_ns)
+{
+   const u64 tick_ns = TS_SCALE / TIMER_HZ;
+   u64 rt, ut, kt;
+
+   disable_preemption();
+   {
+      rt = ti->ru.runtime;
+      kt = ti->ru.kernel_ticks;
+      ut = ti->ticks.total - kt;
+
+      if (ti == get_curr_task())
+         rt += RDTSC() - ti->ru.last_switch;
+   }
+   enable_preemption();
+
+   if (!(rt = tsc_cycles_to_ns(rt))) {
+
+      /* Fall back to the tick-based accounting */
+      *utime_ns = ut * tick_ns;
+      *stime_ns = kt * tick_ns;
+      return;
+   }
+
+   if (!(ut + kt)) {
+
+      /* Never sampled by the timer: account everything as user time */
+      *utime_ns = rt;
+      *stime_ns = 0;
+      return;
+   }
+
+   /* Split `rt` proportionally, avoiding overflows in (rt * kt) */
+   *stime_ns = rt / (ut + kt) * kt + rt % (ut + kt) * kt / (ut + kt);
+   *utime_ns = rt - *stime_ns;
+}
+
+/*
+ * Asks the next call of schedule() to pick `ti`, if it's runnable. Used by
+ * the adaptive kmutexes to hand the CPU over to a preempted lock owner. The
+ * caller must yield right after this call.
+ */
+void sched_yield_to_hint(struct task *ti)
+{
+   ASSERT(!is_preemption_enabled());
+   yield_to_task = ti;
+}
+
+/*
+ * Implements sched_yield(): unlike a plain kernel_yield(), the current task
+ * gives up the CPU also to the real-time tasks having its same priority.
+ */
+void sched_yield_curr(void)
+{
+   disable_preemption();
+   {
+      curr_yielded = true;
+   }
+   enable_preemption_nosched();
+   kernel_yield();
+}
+
+/*
+ * A preempted real-time task keeps its place in front of the tasks with the
+ * same priority, unless it yielded or its SCHED_RR time slice expired.
+ */
+static bool sched_rt_keeps_place(struct task *curr, bool yielded)
+{
+   if (yielded || !is_rt_task(curr) || rt_throttled)
+      return false;
+
+   return curr->policy != SCHED_RR ||
+          curr->ticks.timeslice < SCHED_RR_TIMESLICE_TICKS;
+}
+
+/*
+ * Returns true if the current task, just preempted, should keep running
+ * instead of `sel`, the best among the other runnable tasks.
+ */
+static bool
+sched_should_keep_curr(struct task *curr, struct task *sel, bool yielded)
+{
+   if (!sched_is_urgent(curr))
+      return false;
+
+   if (curr->prio != sel->prio)
+      return curr->prio < sel->prio;
+
+   if (curr->prio >= MAX_RT_PRIO)
+      return curr->ticks.vruntime < sel->ticks.vruntime;
+
+   return sched_rt_keeps_place(curr, yielded);
+}
+
 void schedule(void)
 {
    enum task_state curr_state = get_curr_task_state();
+   struct task *curr = get_curr_task();
+   const bool yielded = curr_yielded;
    struct task *selected = NULL;
    struct task *pos;
+   ulong var;
 
    ASSERT(!is_preemption_enabled());
 
    /* Essential: clear the `__need_resched` flag */
    sched_clear_need_resched();
+   curr_yielded = false;
 
    if (UNLIKELY(get_curr_task()->timer_ready)) {
 
@@ -613,37 +1179,70 @@ void schedule(void)
 
    /* If we preempted the process, it is still `running` */
    if (curr_state == TASK_STATE_RUNNING) {
-      task_change_state(get_curr_task(), TASK_STATE_RUNNABLE);
+
+      task_change_state(curr, TASK_STATE_RUNNABLE);
+
+      if (sched_rt_keeps_place(curr, yielded)) {
+         disable_interrupts(&var);
+         {
+            list_remove(&curr->runnable_node);
+            list_add_head(&runnable_tasks_list, &curr->runnable_node);
+         }
+         enable_interrupts(&var);
+      }
    }
 
    if (selected)
       switch_to_task(selected);
 
+   if (UNLIKELY(yield_to_task != NULL)) {
+
+      selected = yield_to_task;
+      yield_to_task = NULL;
+
+      if (selected != get_curr_task() &&
+          selected->state == TASK_STATE_RUNNABLE &&
+          !selected->stopped)
+      {
+         switch_to_task(selected);
+      }
+
+      selected = NULL;
+   }
+
    list_for_each_ro(pos, &runnable_tasks_list, runnable_node) {
 
       ASSERT(pos->state == TASK_STATE_RUNNABLE);
 
-      if (pos->stopped || pos == idle_task)
+      if (pos->stopped || pos == idle_task || pos == curr)
          continue;
 
-      if (pos->timer_ready) {
+      if (!selected || sched_is_task_before(pos, selected))
          selected = pos;
-         break;
-      }
-
-      if (pos == get_curr_task())
-         continue;
+   }
 
-      if (!selected || pos->ticks.total < selected->ticks.total)
-         selected = pos;
+   if (selected &&
+       get_curr_task_state() == TASK_STATE_RUNNABLE &&
+       sched_should_keep_curr(curr, selected, yielded))
+   {
+      /* The current task is urgent (see above): just keep running it */
+      selected = NULL;
    }
 
    if (!selected) {
 
       if (get_curr_task_state() == TASK_STATE_RUNNABLE) {
-         selected = get_curr_task();
+
+         selected = curr;
          task_change_state(selected, TASK_STATE_RUNNING);
-         selected->ticks.timeslice = 0;
+
+         /* A SCHED_RR task keeps its time slice, until it expires */
+         if (selected->policy != SCHED_RR ||
+             !sched_rt_keeps_place(selected, false))
+         {
+            selected->ticks.timeslice = 0;
+         }
+
          return;
       }
 
@@ -687,36 +1286,43 @@ bool in_currently_dying_task(void)
    return get_curr_task_state() == TASK_STATE_ZOMBIE;
 }
 
-int send_signal_to_group(int pgid, int sig)
+static int
+pgrp_send_signal(struct process_group *g,
+                 int leader_id,
+                 int sig,
+                 struct process **leader)
 {
    struct process *curr_pi = get_curr_proc();
-   struct process *leader = NULL;
-   struct bintree_walk_ctx ctx;
-   struct task *ti;
+   struct process *pi;
    int count = 0;
 
-   disable_preemption();
+   list_for_each_ro(pi, &g->members, pgrp_node) {
 
-   bintree_in_order_visit_start(&ctx,
-                                tree_by_tid_root,
-                                struct task,
-                                tree_by_tid_node,
-                                false);
+      if (pi == curr_pi || pi->pid == 1)
+         continue;
 
-   while ((ti = bintree_in_order_visit_next(&ctx))) {
+      if (pi->pid != leader_id)
+         send_signal(pi->pid, sig, true);
+      else
+         *leader = pi;
 
-      struct process *pi = ti->pi;
+      count++;
+   }
 
-      if (pi->pgid == pgid && pi != curr_pi && pi->pid != 1) {
+   return count;
+}
 
-         if (pi->pid != pgid)
-            send_signal(pi->pid, sig, true);
-         else
-            leader = pi;
+int send_signal_to_group(int pgid, int sig)
+{
+   struct process *curr_pi = get_curr_proc();
+   struct process *leader = NULL;
+   struct process_group *g;
+   int count = 0;
 
-         count++;
-      }
-   }
+   disable_preemption();
+
+   if ((g = get_pgrp(pgid)))
+      count = pgrp_send_signal(g, pgid, sig, &leader);
 
    if (leader)
       send_signal(leader->pid, sig, true); /* kill the leader last */
@@ -737,31 +1343,15 @@ int send_signal_to_session(int sid, int sig)
 {
    struct process *curr_pi = get_curr_proc();
    struct process *leader = NULL;
-   struct bintree_walk_ctx ctx;
-   struct task *ti;
+   struct process_group *g;
+   struct session *s;
    int count = 0;
 
    disable_preemption();
 
-   bintree_in_order_visit_start(&ctx,
-                                tree_by_tid_root,
-                                struct task,
-                                tree_by_tid_node,
-                                false);
-
-   while ((ti = bintree_in_order_visit_next(&ctx))) {
-
-      struct process *pi = ti->pi;
-
-      if (pi->pgid == sid && pi != curr_pi && pi->pid != 1) {
-
-         if (pi->pid != sid)
-            send_signal(pi->pid, sig, true);
-         else
-            leader = pi;
-
-         count++;
-      }
+   if ((s = get_session(sid))) {
+      list_for_each_ro(g, &s->groups, s_node)
+         count += pgrp_send_signal(g, sid, sig, &leader);
    }
 
    if (leader)
@@ -770,7 +1360,7 @@ int send_signal_to_session(int sid, int sig)
    enable_preemption();
 
    /* kill the current process, as _very_ last */
-   if (curr_pi->pgid == sid) {
+   if (curr_pi->sid == sid) {
       send_signal(curr_pi->pid, sig, true);
       count++;
    }
@@ -23,6 +23,12 @@ static const func_get_rwe_cond gcf[3] = {
    &vfs_get_except_cond
 };
 
+static const u8 gck[3] = {
+   VFS_RREADY_KEYS,
+   VFS_WREADY_KEYS,
+   VFS_EXCEPT_KEYS,
+};
+
 static const func_rwe_ready grf[3] = {
    &vfs_read_ready,
    &vfs_write_ready,
@@ -59,7 +65,8 @@ select_set_kcond(int nfds,
                  struct multi_obj_waiter *w,
                  u32 *idx,
                  fd_set *set,
-                 func_get_rwe_cond get_cond)
+                 func_get_rwe_cond get_cond,
+                 u8 keys)
 {
    fs_handle h;
    struct kcond *c;
@@ -79,7 +86,7 @@ select_set_kcond(int nfds,
 
       if (c) {
          ASSERT((*idx) < w->count);
-         mobj_waiter_set(w, (*idx)++, WOBJ_KCOND, c, &c->wait_list);
+         mobj_waiter_set_key(w, (*idx)++, c, &c->wait_list, keys);
       }
    }
 
@@ -157,7 +164,10 @@ select_wait_on_cond(struct select_ctx *c)
       return -ENOMEM;
 
    for (int i = 0; i < 3; i++) {
-      if ((rc = select_set_kcond(c->nfds, waiter, &idx, c->sets[i], gcf[i])))
+
+      rc = select_set_kcond(c->nfds, waiter, &idx, c->sets[i], gcf[i], gck[i]);
+
+      if (rc)
          goto out;
    }
 
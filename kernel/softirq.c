@@ -0,0 +1,251 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/softirq.h>
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/interrupts.h>
+#include <tilck/kernel/debug_utils.h>
+
+STATIC_ASSERT(SOFTIRQ_MAX_COUNT <= 32);
+
+struct softirq {
+
+   const char *name;
+   softirq_func_t func;
+   void *ctx;
+   u32 budget;
+   struct softirq_stats stats;
+};
+
+static struct softirq softirqs[SOFTIRQ_MAX_COUNT];
+static int softirq_wth = -1;
+
+/* Both accessed only with the interrupts disabled */
+static u32 softirq_pending;
+static bool softirq_run_queued;
+
+int softirq_register(const char *name,
+                     softirq_func_t func,
+                     void *ctx,
+                     u32 budget)
+{
+   ulong var;
+   int nr = -ENOSPC;
+
+   ASSERT(func != NULL);
+   ASSERT(budget > 0);
+   DEBUG_ONLY(check_not_in_irq_handler());
+
+   disable_interrupts(&var);
+   {
+      for (int i = 0; i < SOFTIRQ_MAX_COUNT; i++) {
+
+         if (!softirqs[i].func) {
+
+            softirqs[i] = (struct softirq) {
+               .name = name,
+               .func = func,
+               .ctx = ctx,
+               .budget = budget,
+            };
+
+            nr = i;
+            break;
+         }
+      }
+   }
+   enable_interrupts(&var);
+   return nr;
+}
+
+void softirq_unregister(int nr)
+{
+   ulong var;
+
+   ASSERT(0 <= nr && nr < SOFTIRQ_MAX_COUNT);
+   DEBUG_ONLY(check_not_in_irq_handler());
+
+   /*
+    * The runner calls the handlers with preemption disabled: it cannot be in
+    * the middle of one, while we're here.
+    */
+   disable_interrupts(&var);
+   {
+      softirq_pending &= ~(1u << nr);
+      bzero(&softirqs[nr], sizeof(softirqs[nr]));
+   }
+   enable_interrupts(&var);
+}
+
+const char *softirq_get_name(int nr)
+{
+   ASSERT(0 <= nr && nr < SOFTIRQ_MAX_COUNT);
+   return softirqs[nr].func ? softirqs[nr].name : NULL;
+}
+
+bool softirq_get_stats(int nr, struct softirq_stats *stats)
+{
+   ulong var;
+   bool ret;
+
+   ASSERT(0 <= nr && nr < SOFTIRQ_MAX_COUNT);
+
+   disable_interrupts(&var);
+   {
+      if ((ret = softirqs[nr].func != NULL))
+         *stats = softirqs[nr].stats;
+   }
+   enable_interrupts(&var);
+   return ret;
+}
+
+static bool softirq_run_one(int nr)
+{
+   struct softirq *s = &softirqs[nr];
+   bool more = false;
+
+   disable_preemption();
+   {
+      if (s->func) {
+
+         s->stats.runs++;
+
+         if ((more = s->func(s->ctx, s->budget)))
+            s->stats.over_budget++;
+      }
+   }
+   enable_preemption();
+   return more;
+}
+
+static void softirq_enqueue_run(void);
+
+static void softirq_run(void *unused)
+{
+   u32 pending, again;
+   ulong var;
+
+   for (int round = 0; ; round++) {
+
+      if (round == SOFTIRQ_MAX_RESTART) {
+
+         /*
+          * A flood of soft IRQs must not hold this thread forever: let the
+          * other jobs and work items run and continue later. Because
+          * `softirq_run_queued` is still true, nobody else enqueued a run.
+          */
+         softirq_enqueue_run();
+         break;
+      }
+
+      disable_interrupts(&var);
+      {
+         pending = softirq_pending;
+         softirq_pending = 0;
+
+         if (!pending)
+            softirq_run_queued = false;
+      }
+      enable_interrupts(&var);
+
+      if (!pending)
+         break;
+
+      again = 0;
+
+      for (int nr = 0; pending; nr++, pending >>= 1) {
+         if ((pending & 1) && softirq_run_one(nr))
+            again |= (1u << nr);
+      }
+
+      if (again) {
+
+         /*
+          * Some handlers hit their budget: the next round will run them again,
+          * along with the soft IRQs raised in the meanwhile.
+          */
+         disable_interrupts(&var);
+         {
+            softirq_pending |= again;
+         }
+         enable_interrupts(&var);
+      }
+   }
+}
+
+static void softirq_enqueue_run(void)
+{
+   /* There's never more than one job in the queue: this cannot fail */
+   if (!wth_enqueue_job(softirq_wth, &softirq_run, NULL))
+      panic("softirq: unable to enqueue the run job");
+}
+
+void softirq_raise(int nr)
+{
+   struct softirq *s = &softirqs[nr];
+   const u32 bit = 1u << nr;
+   bool enqueue = false;
+   ulong var;
+
+   ASSERT(0 <= nr && nr < SOFTIRQ_MAX_COUNT);
+
+   disable_interrupts(&var);
+   {
+      s->stats.raised++;
+
+      if (softirq_pending & bit)
+         s->stats.coalesced++;
+
+      softirq_pending |= bit;
+
+      if (!softirq_run_queued && softirq_wth >= 0) {
+         softirq_run_queued = true;
+         enqueue = true;
+      }
+   }
+   enable_interrupts(&var);
+
+   if (enqueue)
+      softirq_enqueue_run();
+}
+
+bool softirq_queue_work(struct wth_work *w)
+{
+   ASSERT(softirq_wth >= 0);
+   return wth_queue_work(softirq_wth, w);
+}
+
+void init_softirqs(void)
+{
+   bool enqueue;
+   ulong var;
+   int wth;
+
+   disable_preemption();
+   {
+      wth = wth_create_thread(1 /* priority */, WTH_SOFTIRQ_QUEUE_SIZE);
+
+      if (wth < 0)
+         panic("softirq: unable to create the worker thread");
+   }
+   enable_preemption();
+
+   /* Soft IRQs raised before this point didn't get a run enqueued */
+   disable_interrupts(&var);
+   {
+      softirq_wth = wth;
+      enqueue = softirq_pending && !softirq_run_queued;
+
+      if (enqueue)
+         softirq_run_queued = true;
+   }
+   enable_interrupts(&var);
+
+   if (enqueue)
+      softirq_enqueue_run();
+}
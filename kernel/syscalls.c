@@ -10,6 +10,7 @@
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/signal.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
 #include <tilck/kernel/fs/vfs.h>
 
 #define LINUX_REBOOT_MAGIC1         0xfee1dead
@@ -21,6 +22,10 @@
 #define LINUX_REBOOT_CMD_RESTART     0x1234567
 #define LINUX_REBOOT_CMD_RESTART2   0xa1b2c3d4
 
+#define CSIGNAL                     0x000000ff
+#define CLONE_VM                    0x00000100
+#define CLONE_VFORK                 0x00004000
+
 int sys_madvise(void *addr, size_t len, int advice)
 {
    // TODO (future): consider implementing at least part of sys_madvice().
@@ -161,27 +166,32 @@ int sys_kill(int pid, int sig)
    return send_signal(pid, sig, true);
 }
 
+static inline clock_t ns_to_clock_t(u64 ns)
+{
+   return (clock_t)(ns / (TS_SCALE / TIMER_HZ));
+}
+
 ulong sys_times(struct tms *user_buf)
 {
-   struct task *curr = get_curr_task();
+   struct process *pi = get_curr_proc();
+   struct proc_rusage ru, ch_ru;
    struct tms buf;
 
-   // TODO (threads): when threads are supported, update sys_times()
-   // TODO: consider supporting tms_cutime and tms_cstime in sys_times()
+   process_get_rusage(pi, &ru);
 
    disable_preemption();
    {
-
-      buf = (struct tms) {
-         .tms_utime = (clock_t) curr->ticks.total,
-         .tms_stime = (clock_t) curr->ticks.total_kernel,
-         .tms_cutime = 0,
-         .tms_cstime = 0,
-      };
-
+      ch_ru = pi->children_ru;
    }
    enable_preemption();
 
+   buf = (struct tms) {
+      .tms_utime = ns_to_clock_t(ru.utime),
+      .tms_stime = ns_to_clock_t(ru.stime),
+      .tms_cutime = ns_to_clock_t(ch_ru.utime),
+      .tms_cstime = ns_to_clock_t(ch_ru.stime),
+   };
+
    if (copy_to_user(user_buf, &buf, sizeof(buf)) != 0)
       return (ulong) -EBADF;
 
@@ -190,12 +200,37 @@ ulong sys_times(struct tms *user_buf)
 
 int sys_fork(void)
 {
-   return do_fork(false);
+   return do_fork(false, NULL);
 }
 
 int sys_vfork(void)
 {
-   return do_fork(true);
+   return do_fork(true, NULL);
+}
+
+/*
+ * Only the flavors of clone() equivalent to fork() and vfork() are supported,
+ * optionally with a new stack for the child. The vfork() one, with the flags
+ * CLONE_VM | CLONE_VFORK, is what libc's posix_spawn() uses: the parent is
+ * suspended until the child calls execve() or exits, like with vfork(), and
+ * the address space is never copied. Threads are not supported.
+ */
+int sys_clone(ulong flags, void *child_stack, int *ptid, void *tls, int *ctid)
+{
+   if ((flags & CSIGNAL) != SIGCHLD)
+      return -ENOSYS;
+
+   switch (flags & ~CSIGNAL) {
+
+      case 0:
+         return do_fork(false, child_stack);
+
+      case CLONE_VM | CLONE_VFORK:
+         return do_fork(true, child_stack);
+
+      default:
+         return -ENOSYS;
+   }
 }
 
 int sys_reboot(u32 magic, u32 magic2, u32 cmd, void *arg)
@@ -223,7 +258,7 @@ int sys_reboot(u32 magic, u32 magic2, u32 cmd, void *arg)
 
 int sys_sched_yield(void)
 {
-   kernel_yield();
+   sched_yield_curr();
    return 0;
 }
 
@@ -9,9 +9,12 @@
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/gcov.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/prof.h>
 
 typedef int (*tilck_cmd_func)();
 static int sys_tilck_run_selftest(const char *user_selftest);
+static int tilck_get_faults_cnt(void);
 
 static void *tilck_cmds[] = {
 
@@ -22,6 +25,9 @@ static void *tilck_cmds[] = {
    [TILCK_CMD_QEMU_POWEROFF] = debug_qemu_turn_off_machine,
    [TILCK_CMD_SET_SAT_ENABLED] = set_sched_alive_thread_enabled,
    [TILCK_CMD_DEBUG_PANEL] = NULL,
+   [TILCK_CMD_GET_FAULTS_CNT] = tilck_get_faults_cnt,
+   [TILCK_CMD_GETDENTS_STAT] = sys_tilck_getdents_stat,
+   [TILCK_CMD_PROF] = sys_tilck_prof,
 };
 
 void register_tilck_cmd(int cmd_n, void *func)
@@ -62,6 +68,15 @@ static int sys_tilck_run_selftest(const char *user_selftest)
    return 0;
 }
 
+/*
+ * Returns the number of user page faults resolved so far for the current
+ * process: CoW faults and faults on memory-mapped files.
+ */
+static int tilck_get_faults_cnt(void)
+{
+   return (int)get_curr_proc()->faults_cnt;
+}
+
 int sys_tilck_cmd(int cmd_n, ulong a1, ulong a2, ulong a3, ulong a4)
 {
    tilck_cmd_func func;
@@ -9,7 +9,9 @@
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/softirq.h>
 #include <tilck/kernel/datetime.h>
+#include <tilck/kernel/prof.h>
 
 
 static u64 __ticks;        /* ticks since the timer started */
@@ -25,6 +27,14 @@ u32 slow_timer_irq_handler_count;
 
 static struct list timer_wakeup_list = make_list(timer_wakeup_list);
 
+/*
+ * Ticks not yet processed by the timer soft IRQ. The wake-up timers are
+ * relative to the last processed tick, so the arming and the cancellation
+ * of a timer must take them into account. Accessed with interrupts disabled.
+ */
+static u32 timer_pending_ticks;
+static int timer_softirq = -1;
+
 u64 get_ticks(void)
 {
    u64 curr_ticks;
@@ -38,6 +48,18 @@ u64 get_ticks(void)
    return curr_ticks;
 }
 
+/*
+ * Converts a number of ticks from now into a counter relative to the last
+ * tick processed by the timer soft IRQ. Interrupts must be disabled.
+ */
+u32 timer_add_pending_ticks(u32 ticks)
+{
+   NO_TEST_ASSERT(!are_interrupts_enabled());
+   return ticks <= UINT32_MAX - timer_pending_ticks
+      ? ticks + timer_pending_ticks
+      : UINT32_MAX;
+}
+
 void task_set_wakeup_timer(struct task *ti, u32 ticks)
 {
    ulong var;
@@ -52,7 +74,7 @@ void task_set_wakeup_timer(struct task *ti, u32 ticks)
          ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
       }
 
-      ti->ticks_before_wake_up = ticks;
+      ti->ticks_before_wake_up = timer_add_pending_ticks(ticks);
    }
    enable_interrupts(&var);
 }
@@ -66,7 +88,7 @@ void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks)
    {
       if (ti->ticks_before_wake_up > 0) {
          ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
-         ti->ticks_before_wake_up = new_ticks;
+         ti->ticks_before_wake_up = timer_add_pending_ticks(new_ticks);
       }
    }
    enable_interrupts(&var);
@@ -84,6 +106,7 @@ u32 task_cancel_wakeup_timer(struct task *ti)
          ti->timer_ready = false;
          ti->ticks_before_wake_up = 0;
          list_remove(&ti->wakeup_timer_node);
+         old = old > timer_pending_ticks ? old - timer_pending_ticks : 0;
       }
    }
    enable_interrupts(&var);
@@ -95,6 +118,7 @@ static void tick_all_timers(void)
    struct task *pos, *temp;
    bool any_woken_up_task = false;
    ulong var;
+   u32 n;
 
    /*
     * This is *NOT* the best we can do. In particular, it's terrible to keep
@@ -121,29 +145,71 @@ static void tick_all_timers(void)
     */
    disable_interrupts(&var);
 
+   /* Process all the ticks elapsed since the last run at once */
+   n = timer_pending_ticks;
+   timer_pending_ticks = 0;
+
    list_for_each(pos, temp, &timer_wakeup_list, wakeup_timer_node) {
 
       /* If task is part of this list, it's counter must be > 0 */
       ASSERT(pos->ticks_before_wake_up > 0);
 
-      if (UNLIKELY(--pos->ticks_before_wake_up == 0)) {
+      if (pos->ticks_before_wake_up > n) {
+         pos->ticks_before_wake_up -= n;
+         continue;
+      }
 
-         pos->timer_ready = true;
-         list_remove(&pos->wakeup_timer_node);
+      pos->ticks_before_wake_up = 0;
+      pos->timer_ready = true;
+      list_remove(&pos->wakeup_timer_node);
 
-         if (pos->state == TASK_STATE_SLEEPING) {
-            task_change_state(pos, TASK_STATE_RUNNABLE);
-            any_woken_up_task = true;
-         }
+      if (pos->state == TASK_STATE_SLEEPING) {
+         task_change_state(pos, TASK_STATE_RUNNABLE);
+         any_woken_up_task = true;
       }
    }
 
+   wth_tick_delayed_works(n);
    enable_interrupts(&var);
 
    if (any_woken_up_task)
       sched_set_need_resched();
 }
 
+static bool timer_softirq_handler(void *ctx, u32 budget)
+{
+   tick_all_timers();
+   wth_check_long_jobs();
+   return false;
+}
+
+/*
+ * Sleep until our wake-up timer fires or until we get a signal. Any other
+ * wake-up is spurious for us: just go back to sleep for the remaining ticks
+ * instead of returning early. Also, never leave an armed timer behind us: it
+ * would wake up this task later, while sleeping on something else (e.g. a
+ * kcond), causing a spurious wake-up there. Returns false in case of signals.
+ */
+static bool kernel_sleep_int(u32 ticks)
+{
+   struct task *curr = get_curr_task();
+   task_set_wakeup_timer(curr, ticks);
+
+   do {
+
+      task_change_state(curr, TASK_STATE_SLEEPING);
+      kernel_yield();
+
+      if (pending_signals()) {
+         task_cancel_wakeup_timer(curr);
+         return false;
+      }
+
+   } while (curr->ticks_before_wake_up > 0);
+
+   return true;
+}
+
 void kernel_sleep(u64 ticks)
 {
    DEBUG_ONLY(check_not_in_irq_handler());
@@ -193,30 +259,18 @@ void kernel_sleep(u64 ticks)
    const u32 q = ticks >> 32;
 
    for (u32 i = 0; i < q; i++) {
-      task_set_wakeup_timer(get_curr_task(), 0xffffffff);
-      task_change_state(get_curr_task(), TASK_STATE_SLEEPING);
-      kernel_yield();
-
-      if (pending_signals())
+      if (!kernel_sleep_int(0xffffffff))
          return;
    }
 
    if (q) {
-      task_set_wakeup_timer(get_curr_task(), q);
-      task_change_state(get_curr_task(), TASK_STATE_SLEEPING);
-
-      if (rem) {
-         /* Yield only if we're going to sleep again because rem > 0 */
-         kernel_yield();
-
-         if (pending_signals())
-            return;
-      }
+      if (!kernel_sleep_int(q))
+         return;
    }
 
    if (rem) {
-      task_set_wakeup_timer(get_curr_task(), rem);
-      task_change_state(get_curr_task(), TASK_STATE_SLEEPING);
+      kernel_sleep_int(rem);
+      return;
    }
 
    /* We must yield at least once, even if ticks == 0 */
@@ -246,6 +300,7 @@ static ALWAYS_INLINE bool timer_nested_irq(void)
 
 enum irq_action timer_irq_handler(void *ctx)
 {
+   bool raise;
    u32 ns_delta;
    ASSERT(are_interrupts_enabled());
 
@@ -281,18 +336,42 @@ enum irq_action timer_irq_handler(void *ctx)
        */
       __ticks++;
       __time_ns += ns_delta;
+
+      if (!list_is_empty(&timer_wakeup_list) || wth_any_delayed_work())
+         timer_pending_ticks++;
+      else
+         timer_pending_ticks = 0;   /* no timers to tick: nothing to defer */
+
+      /* Also, periodically look for long jobs in the worker threads */
+      raise = timer_pending_ticks > 0 ||
+              !((u32)__ticks % WTH_LONG_JOB_TICKS);
    }
    enable_interrupts_forced();
 
+   prof_timer_tick();
    sched_account_ticks();
-   tick_all_timers();
-   return IRQ_FULLY_HANDLED;
+
+   /*
+    * Walking the whole wake-up list here, in the IRQ handler, would be too
+    * expensive: defer it. If the soft IRQ gets delayed, the ticks elapsed in
+    * the meanwhile will be processed by a single run.
+    */
+   if (!raise)
+      return IRQ_FULLY_HANDLED;
+
+   softirq_raise(timer_softirq);
+   return IRQ_REQUIRES_BH;
 }
 
 DEFINE_IRQ_HANDLER_NODE(timer, timer_irq_handler, NULL);
 
 void init_timer(void)
 {
+   timer_softirq = softirq_register("timer", &timer_softirq_handler, NULL, 1);
+
+   if (timer_softirq < 0)
+      panic("Timer: unable to register the soft IRQ");
+
    __tick_duration = hw_timer_setup(TS_SCALE / TIMER_HZ);
    irq_install_handler(X86_PC_TIMER_IRQ, &timer);
 }
@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#include <tilck/common/printk.h>
+
 #include <tilck/kernel/term.h>
 #include <tilck/kernel/term_aux.h>
 
@@ -10,7 +12,6 @@ term_handle_full_ringbuf(term *t,
                          bool *was_empty,
                          exec_action_func exec)
 {
-   extern bool __in_printk; /* defined in printk.c */
    bool written;
 
    /* We got here because the ringbuf was full in the first place */
@@ -136,7 +136,9 @@ static inline u8 tty_inbuf_read_elem(struct tty *t)
    {
       ASSERT(!tty_inbuf_is_empty(t));
       DEBUG_CHECKED_SUCCESS(ringbuf_read_elem1(&t->input_ringbuf, &ret));
-      kcond_signal_all(&t->output_cond);
+
+      /* We freed a single slot: wake up just one producer, if any */
+      kcond_signal_one(&t->output_cond);
    }
    enable_preemption();
    return ret;
@@ -182,8 +184,11 @@ tty_inbuf_write_elem(struct tty *t, u8 c, bool block)
          break;
       }
 
-      /* OK, signal all consumers waiting for input (tty_read()) */
-      kcond_signal_all(&t->input_cond);
+      /*
+       * OK, signal a consumer waiting for input (tty_read()). Tasks polling
+       * the tty are always woken up, as they're non-exclusive waiters.
+       */
+      kcond_signal_one(&t->input_cond);
 
       /* Now, block on the `output_cond` waiting for a consumer to signal us */
       kcond_wait(&t->output_cond, NULL, TIME_SLICE_TICKS);
@@ -461,6 +466,20 @@ bool tty_read_ready_int(struct tty *t, struct devfs_handle *h)
    return ringbuf_get_elems(&t->input_ringbuf) >= t->c_term.c_cc[VMIN];
 }
 
+/*
+ * Readers are exclusive waiters of `input_cond`: a signal wakes up just one of
+ * them. Therefore, a reader leaving some ready input in the buffer has to pass
+ * the wake-up to the next one, if any.
+ */
+static void tty_pass_input_wakeup(struct tty *t)
+{
+   if (tty_inbuf_is_empty(t))
+      return;
+
+   if (!(t->c_term.c_lflag & ICANON) || t->end_line_delim_count > 0)
+      kcond_signal_one(&t->input_cond);
+}
+
 ssize_t
 tty_read_int(struct tty *t, struct devfs_handle *h, char *buf, size_t size)
 {
@@ -536,8 +555,10 @@ tty_read_int(struct tty *t, struct devfs_handle *h, char *buf, size_t size)
 
          kcond_wait(&t->input_cond, NULL, KCOND_WAIT_FOREVER);
 
-         if (pending_signals())
+         if (pending_signals()) {
+            tty_pass_input_wakeup(t);
             return -EINTR;
+         }
       }
 
       delim_break = false;
@@ -572,6 +593,7 @@ tty_read_int(struct tty *t, struct devfs_handle *h, char *buf, size_t size)
          h->read_allowed_to_return = true;
    }
 
+   tty_pass_input_wakeup(t);
    return (ssize_t) read_count;
 }
 
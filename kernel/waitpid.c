@@ -157,7 +157,27 @@ void wake_up_tasks_waiting_on(struct task *ti, enum wakeup_reason r)
  * ***************************************************************
  */
 
-int sys_waitpid(int tid, int *user_wstatus, int options)
+/*
+ * Collects the resource usage of `child`, including the one of its own waited
+ * children. When the child is being reaped, its usage is also accumulated in
+ * the parent's `children_ru`, like getrusage(RUSAGE_CHILDREN) requires.
+ */
+static void
+waitpid_collect_rusage(struct process *parent,
+                       struct task *child,
+                       struct proc_rusage *ru)
+{
+   ASSERT(!is_preemption_enabled());
+
+   process_get_rusage(child->pi, ru);
+   proc_rusage_add(ru, &child->pi->children_ru);
+
+   if (child->state == TASK_STATE_ZOMBIE)
+      proc_rusage_add(&parent->children_ru, ru);
+}
+
+static int
+do_waitpid(int tid, int *user_wstatus, int options, struct proc_rusage *ru)
 {
    struct task *curr = get_curr_task();
    struct task *chtask = NULL;
@@ -241,6 +261,8 @@ int sys_waitpid(int tid, int *user_wstatus, int options)
          chtask_tid = -EFAULT;
    }
 
+   waitpid_collect_rusage(curr->pi, chtask, ru);
+
    if (chtask->state == TASK_STATE_ZOMBIE)
       remove_task(chtask);
 
@@ -248,15 +270,27 @@ int sys_waitpid(int tid, int *user_wstatus, int options)
    return chtask_tid;
 }
 
+int sys_waitpid(int tid, int *user_wstatus, int options)
+{
+   struct proc_rusage ru;
+   return do_waitpid(tid, user_wstatus, options, &ru);
+}
+
 int sys_wait4(int tid, int *user_wstatus, int options, void *user_rusage)
 {
-   struct k_rusage ru = {0};
+   struct proc_rusage ru = {0};
+   struct k_rusage kr;
+   int rc;
+
+   rc = do_waitpid(tid, user_wstatus, options, &ru);
+
+   if (rc > 0 && user_rusage) {
+
+      proc_rusage_to_k_rusage(&ru, &kr);
 
-   if (user_rusage) {
-      // TODO: update when rusage is actually supported
-      if (copy_to_user(user_rusage, &ru, sizeof(ru)) < 0)
+      if (copy_to_user(user_rusage, &kr, sizeof(kr)) < 0)
          return -EFAULT;
    }
 
-   return sys_waitpid(tid, user_wstatus, options);
+   return rc;
 }
@@ -7,10 +7,12 @@
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
 
-void wait_obj_set(struct wait_obj *wo,
-                  enum wo_type type,
-                  void *ptr,
-                  struct list *wait_list)
+void wait_obj_set_ex(struct wait_obj *wo,
+                     enum wo_type type,
+                     void *ptr,
+                     struct list *wait_list,
+                     u8 flags,
+                     u8 keys)
 {
    atomic_store_explicit(&wo->__ptr, ptr, mo_relaxed);
 
@@ -20,14 +22,34 @@ void wait_obj_set(struct wait_obj *wo,
              list_node_is_empty(&wo->wait_list_node));
 
       wo->type = type;
+      wo->flags = flags;
+      wo->keys = keys;
       list_node_init(&wo->wait_list_node);
 
-      if (wait_list)
-         list_add_tail(wait_list, &wo->wait_list_node);
+      if (wait_list) {
+
+         /*
+          * Keep the non-exclusive waiters at the head of the list: this way,
+          * kcond_signal_int() can stop at the first exclusive waiter it wakes
+          * up. Exclusive waiters are added at the tail, to preserve FIFO.
+          */
+         if (flags & WOBJ_FL_NON_EXCL)
+            list_add_head(wait_list, &wo->wait_list_node);
+         else
+            list_add_tail(wait_list, &wo->wait_list_node);
+      }
    }
    enable_preemption();
 }
 
+void wait_obj_set(struct wait_obj *wo,
+                  enum wo_type type,
+                  void *ptr,
+                  struct list *wait_list)
+{
+   wait_obj_set_ex(wo, type, ptr, wait_list, 0, KCOND_KEY_ANY);
+}
+
 void *wait_obj_reset(struct wait_obj *wo)
 {
    void *oldp = atomic_exchange_explicit(&wo->__ptr, (void*)NULL, mo_relaxed);
@@ -50,10 +72,24 @@ void task_set_wait_obj(struct task *ti,
                        void *ptr,
                        u16 extra,
                        struct list *wait_list)
+{
+   task_set_wait_obj_keys(ti, type, ptr, extra, wait_list, KCOND_KEY_ANY);
+}
+
+/*
+ * Like task_set_wait_obj(), but the task waits only for the given keys. They
+ * must be set before the wait obj gets in the wait list, where it's visible.
+ */
+void task_set_wait_obj_keys(struct task *ti,
+                            enum wo_type type,
+                            void *ptr,
+                            u16 extra,
+                            struct list *wait_list,
+                            u8 keys)
 {
    disable_preemption();
    {
-      wait_obj_set(&ti->wobj, type, ptr, wait_list);
+      wait_obj_set_ex(&ti->wobj, type, ptr, wait_list, 0, keys);
       ti->wobj.extra = extra;
       ASSERT(ti->state != TASK_STATE_SLEEPING);
       task_change_state(ti, TASK_STATE_SLEEPING);
@@ -103,12 +139,13 @@ void free_mobj_waiter(struct multi_obj_waiter *w)
    task_temp_kernel_free(w);
 }
 
-void
-mobj_waiter_set(struct multi_obj_waiter *w,
-                u32 index,
-                enum wo_type type,
-                void *ptr,
-                struct list *wait_list)
+static void
+mobj_waiter_set_int(struct multi_obj_waiter *w,
+                    u32 index,
+                    enum wo_type type,
+                    void *ptr,
+                    struct list *wait_list,
+                    u8 keys)
 {
    /*
     * No chaining is allowed: the waited object pointed by `ptr` is expected to
@@ -117,11 +154,43 @@ mobj_waiter_set(struct multi_obj_waiter *w,
    ASSERT(type != WOBJ_MWO_WAITER && type != WOBJ_MWO_ELEM);
 
    struct mwobj_elem *e = &w->elems[index];
-   wait_obj_set(&e->wobj, WOBJ_MWO_ELEM, ptr, wait_list);
+
+   /*
+    * A task waiting on multiple objects is just interested in knowing which
+    * ones are ready: it does not consume anything by itself. Therefore, it
+    * must never "steal" the wake-up of an exclusive waiter.
+    */
+   wait_obj_set_ex(&e->wobj,
+                   WOBJ_MWO_ELEM,
+                   ptr,
+                   wait_list,
+                   WOBJ_FL_NON_EXCL,
+                   keys);
+
    e->ti = get_curr_task();
    e->type = type;
 }
 
+void
+mobj_waiter_set(struct multi_obj_waiter *w,
+                u32 index,
+                enum wo_type type,
+                void *ptr,
+                struct list *wait_list)
+{
+   mobj_waiter_set_int(w, index, type, ptr, wait_list, KCOND_KEY_ANY);
+}
+
+void
+mobj_waiter_set_key(struct multi_obj_waiter *w,
+                    u32 index,
+                    void *ptr,
+                    struct list *wait_list,
+                    u8 keys)
+{
+   mobj_waiter_set_int(w, index, WOBJ_KCOND, ptr, wait_list, keys);
+}
+
 void mobj_waiter_reset(struct mwobj_elem *e)
 {
    wait_obj_reset(&e->wobj);
@@ -13,10 +13,25 @@
 #include <tilck/kernel/interrupts.h>
 #include <tilck/kernel/debug_utils.h>
 
+#include <tilck/mods/tracepoints.h>
+
 #include "wth_int.h"
 
+/*
+ * The helper thread runs the work items queued behind a long job, in place of
+ * their own thread. Its queue for regular jobs is never used.
+ */
+#define WTH_HELPER_PRIO                        5
+#define WTH_HELPER_QUEUE_SIZE                  4
+
+STATIC_ASSERT(WTH_LONG_JOB_TICKS > 0);
+
 STATIC u32 worker_threads_cnt;
 struct worker_thread *worker_threads[WTH_MAX_THREADS];
+int wth_helper = -1;
+
+/* Delayed work items, ticked by the timer soft IRQ */
+static struct list delayed_works = make_list(delayed_works);
 
 u32 wth_get_queue_size(int wth)
 {
@@ -76,9 +91,27 @@ bool wth_enqueue_job(int wth, void (*func)(void *), void *arg)
    }
 
    enable_preemption();
+   trace_wth_job(wth, func, arg, success);
    return success;
 }
 
+static void
+wth_run_func(struct worker_thread *t, void (*func)(void *), void *arg)
+{
+   t->job_start = (u32)get_ticks();
+   t->in_job = true;
+   {
+      func(arg);
+   }
+   t->in_job = false;
+}
+
+static ALWAYS_INLINE bool
+wth_is_in_long_job(struct worker_thread *t, u32 now)
+{
+   return t->in_job && now - t->job_start >= WTH_LONG_JOB_TICKS;
+}
+
 bool wth_process_single_job(int wth)
 {
    bool success;
@@ -90,12 +123,39 @@ bool wth_process_single_job(int wth)
 
    if (success) {
       /* Run the job with preemption enabled */
-      job_to_run.func(job_to_run.arg);
+      wth_run_func(t, job_to_run.func, job_to_run.arg);
    }
 
    return success;
 }
 
+/*
+ * Work items are non-reentrant: an item queued again while running must not
+ * run in another thread (i.e. the helper) until its first instance returns.
+ * NOTE: it must be called with interrupts disabled.
+ */
+static bool wth_is_work_running(struct wth_work *w)
+{
+   for (u32 i = 0; i < worker_threads_cnt; i++)
+      if (worker_threads[i]->running_work == w)
+         return true;
+
+   return false;
+}
+
+/* NOTE: it must be called with interrupts disabled */
+static struct wth_work *wth_first_runnable_work(struct worker_thread *t)
+{
+   struct wth_work *pos;
+
+   list_for_each_ro(pos, &t->works, node) {
+      if (!wth_is_work_running(pos))
+         return pos;
+   }
+
+   return NULL;
+}
+
 void wth_run(void *arg)
 {
    struct worker_thread *t = arg;
@@ -111,13 +171,15 @@ void wth_run(void *arg)
 
       do {
 
+         /* Alternate jobs and work items: neither can starve the other */
          job_run = wth_process_single_job(t->thread_index);
+         job_run |= wth_process_single_work(t->thread_index);
 
       } while (job_run);
 
       disable_interrupts_forced();
       {
-         if (safe_ringbuf_is_empty(&t->rb)) {
+         if (safe_ringbuf_is_empty(&t->rb) && !wth_first_runnable_work(t)) {
             t->task->state = TASK_STATE_SLEEPING;
             t->waiting_for_jobs = true;
          }
@@ -129,15 +191,234 @@ void wth_run(void *arg)
    }
 }
 
+/* -------------------------------------------------- */
+/*                    Work items                      */
+/* -------------------------------------------------- */
+
+void wth_work_init(struct wth_work *w, void (*func)(void *), void *arg)
+{
+   *w = (struct wth_work) {
+      .func = func,
+      .arg = arg,
+      .wth = -1,
+      .state = WTH_WORK_IDLE,
+   };
+
+   list_node_init(&w->node);
+}
+
+/* NOTE: it must be called with interrupts disabled */
+static void wth_queue_work_int(struct worker_thread *t, struct wth_work *w)
+{
+   w->state = WTH_WORK_QUEUED;
+   list_add_tail(&t->works, &w->node);
+
+   if (t->waiting_for_jobs)
+      wth_wakeup(t);
+}
+
+bool wth_queue_work(int wth, struct wth_work *w)
+{
+   struct worker_thread *t = worker_threads[wth];
+   bool queued = false;
+   ulong var;
+
+   ASSERT(t != NULL);
+
+   disable_interrupts(&var);
+   {
+      if (w->state == WTH_WORK_IDLE) {
+         w->wth = (s16)wth;
+         wth_queue_work_int(t, w);
+         queued = true;
+      }
+   }
+   enable_interrupts(&var);
+   return queued;
+}
+
+bool wth_queue_delayed_work(int wth, struct wth_work *w, u32 ticks)
+{
+   bool queued = false;
+   ulong var;
+
+   ASSERT(worker_threads[wth] != NULL);
+
+   if (!ticks)
+      return wth_queue_work(wth, w);
+
+   disable_interrupts(&var);
+   {
+      if (w->state == WTH_WORK_IDLE) {
+         w->wth = (s16)wth;
+         w->state = WTH_WORK_DELAYED;
+         w->delay = timer_add_pending_ticks(ticks);
+         list_add_tail(&delayed_works, &w->node);
+         queued = true;
+      }
+   }
+   enable_interrupts(&var);
+   return queued;
+}
+
+/*
+ * Removes a pending work item from its queue. Returns false if it wasn't
+ * pending: note that its function might be running right now.
+ */
+bool wth_cancel_work(struct wth_work *w)
+{
+   bool pending;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      if ((pending = w->state != WTH_WORK_IDLE)) {
+         list_remove(&w->node);
+         w->state = WTH_WORK_IDLE;
+      }
+   }
+   enable_interrupts(&var);
+   return pending;
+}
+
+bool wth_is_work_pending(struct wth_work *w)
+{
+   return w->state != WTH_WORK_IDLE;
+}
+
+bool wth_any_delayed_work(void)
+{
+   NO_TEST_ASSERT(!are_interrupts_enabled());
+   return !list_is_empty(&delayed_works);
+}
+
+void wth_tick_delayed_works(u32 ticks)
+{
+   struct wth_work *pos, *temp;
+   NO_TEST_ASSERT(!are_interrupts_enabled());
+
+   list_for_each(pos, temp, &delayed_works, node) {
+
+      if (pos->delay > ticks) {
+         pos->delay -= ticks;
+         continue;
+      }
+
+      list_remove(&pos->node);
+      wth_queue_work_int(worker_threads[pos->wth], pos);
+   }
+}
+
+bool wth_process_single_work(int wth)
+{
+   struct worker_thread *t = worker_threads[wth];
+   struct wth_work *w = NULL;
+   void (*func)(void *) = NULL;
+   void *arg = NULL;
+   ulong var;
+
+   ASSERT(t != NULL);
+
+   disable_interrupts(&var);
+   {
+      if ((w = wth_first_runnable_work(t))) {
+
+         list_remove(&w->node);
+
+         /* From now on, the work item can be queued again */
+         w->state = WTH_WORK_IDLE;
+         func = w->func;
+         arg = w->arg;
+         t->running_work = w;
+      }
+   }
+   enable_interrupts(&var);
+
+   if (!w)
+      return false;
+
+   wth_run_func(t, func, arg);
+
+   /*
+    * NOTE: `w` might have been freed by its func: from now on, it's used only
+    * to wake up the threads skipping it because it was running.
+    */
+   disable_interrupts(&var);
+   {
+      t->running_work = NULL;
+
+      for (u32 i = 0; i < worker_threads_cnt; i++) {
+
+         struct worker_thread *o = worker_threads[i];
+
+         if (o->waiting_for_jobs && !list_is_empty(&o->works))
+            wth_wakeup(o);
+      }
+   }
+   enable_interrupts(&var);
+   return true;
+}
+
+/*
+ * Called periodically by the timer soft IRQ. The work items queued behind a
+ * long job would have to wait for it to complete: migrate them to the helper
+ * thread, which is free to run them. The exception is the work item running
+ * the long job itself, in case it queued itself again: it stays here.
+ */
+void wth_check_long_jobs(void)
+{
+   const u32 now = (u32)get_ticks();
+   struct wth_work *pos, *temp;
+   struct worker_thread *h, *t;
+   ulong var;
+
+   if (wth_helper < 0)
+      return;
+
+   h = worker_threads[wth_helper];
+
+   disable_interrupts(&var);
+   {
+      for (u32 i = 0; i < worker_threads_cnt; i++) {
+
+         t = worker_threads[i];
+
+         if (t == h || !wth_is_in_long_job(t, now))
+            continue;
+
+         list_for_each(pos, temp, &t->works, node) {
+
+            if (pos == t->running_work)
+               continue;
+
+            list_remove(&pos->node);
+            list_add_tail(&h->works, &pos->node);
+         }
+      }
+
+      if (!list_is_empty(&h->works) && h->waiting_for_jobs)
+         wth_wakeup(h);
+   }
+   enable_interrupts(&var);
+}
+
 struct task *wth_get_runnable_thread(void)
 {
    ASSERT(!is_preemption_enabled());
    struct worker_thread *selected = NULL;
+   const u32 now = (u32)get_ticks();
 
    for (u32 i = 0; i < worker_threads_cnt; i++) {
 
       struct worker_thread *t = worker_threads[i];
 
+      /*
+       * A thread stuck in a long job loses its precedence over the regular
+       * tasks: it will be scheduled like any other kernel thread.
+       */
+      if (wth_is_in_long_job(t, now))
+         continue;
+
       if (t->task->state == TASK_STATE_RUNNABLE)
          if (!selected || t->priority < selected->priority)
             selected = t;
@@ -164,6 +445,7 @@ int wth_create_thread(int priority, u16 queue_size)
 
    t->thread_index = (int)worker_threads_cnt;
    t->priority = priority;
+   list_init(&t->works);
    t->jobs = kzmalloc(sizeof(struct wjob) * queue_size);
 
    if (!t->jobs) {
@@ -201,4 +483,8 @@ void init_worker_threads(void)
       panic("init_worker_threads() failed");
 
    ASSERT(wth == 0);
+   wth_helper = wth_create_thread(WTH_HELPER_PRIO, WTH_HELPER_QUEUE_SIZE);
+
+   if (wth_helper < 0)
+      panic("init_worker_threads() failed");
 }
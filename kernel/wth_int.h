@@ -12,15 +12,21 @@ struct worker_thread {
 
    struct wjob *jobs;
    struct safe_ringbuf rb;
+   struct list works;         /* queued work items (struct wth_work) */
+   struct wth_work *running_work;   /* compared, never dereferenced */
    struct task *task;
    int thread_index;          /* index of this obj in worker_threads */
    int priority;              /* 0 is the max priority */
+   u32 job_start;             /* ticks when the running job started */
+   bool in_job;               /* running a job or a work item */
    bool waiting_for_jobs;
 };
 
 extern struct worker_thread *worker_threads[WTH_MAX_THREADS];
+extern int wth_helper;
 
 void wth_run(void *arg);
 void wth_wakeup(struct worker_thread *t);
 bool wth_process_single_job(int wth);
+bool wth_process_single_work(int wth);
 int wth_create_thread_for(struct worker_thread *t);
@@ -51,6 +51,27 @@ void reset_console_data(struct tty *t)
    cd->filter_ctx.cd = cd;
 }
 
+static u32 tty_filter_plain_run(const u8 *buf, u32 len, void *ctx_arg)
+{
+   struct twfilter_ctx *const ctx = ctx_arg;
+   struct console_data *const cd = ctx->cd;
+   const s16 *const table = cd->c_sets_tables[cd->c_set];
+   u32 i;
+
+   if (ctx->non_default_state)
+      return 0;
+
+   /*
+    * In the default state, printable chars translated as themselves are just
+    * written by tty_state_default(), without side effects.
+    */
+   for (i = 0; i < len; i++)
+      if (!IN_RANGE_INC(buf[i], 0x20, 0x7e) || table[buf[i]] != buf[i])
+         break;
+
+   return i;
+}
+
 void tty_reset_filter_ctx(struct tty *t)
 {
    struct console_data *cd = t->console_data;
@@ -63,6 +84,9 @@ void tty_reset_filter_ctx(struct tty *t)
    ctx->t = t;
    ctx->cd = cd;
    tty_set_state(ctx, &tty_state_default);
+
+   if (t->tintf->get_type() == term_type_video)
+      vterm_set_filter_plain_run(t->tstate, &tty_filter_plain_run);
 }
 
 static void
@@ -12,13 +12,31 @@
 #define VIDEO_COLS 80
 #define VIDEO_ROWS 25
 
+/*
+ * The VGA text mode memory window (0xB8000 - 0xBFFFF) is 32 KB, while a 80x25
+ * screen uses just 4000 bytes of it. We use the rest for "hardware" scrolling:
+ * scrolling by one line just moves the CRTC start address forward by one row
+ * and only when the visible area reaches the end of the window, we copy it back
+ * to the beginning. All the rows passed to the functions below are relative to
+ * the current start row.
+ */
+#define VIDEO_MEM_SIZE (32 * KB)
+#define VIDEO_MEM_ROWS (VIDEO_MEM_SIZE / 2 / VIDEO_COLS)
+
+static u32 start_row;      /* first row of VIDEO_ADDR currently displayed */
+static u16 cursor_row = VIDEO_ROWS;
+static u16 cursor_col = VIDEO_COLS;
+
+static ALWAYS_INLINE u16 *textmode_row(u16 row)
+{
+   return VIDEO_ADDR + (start_row + row) * VIDEO_COLS;
+}
+
 static void textmode_clear_row(u16 row_num, u8 color)
 {
    ASSERT(row_num < VIDEO_ROWS);
 
-   memset16(VIDEO_ADDR + VIDEO_COLS * row_num,
-            make_vgaentry(' ', color),
-            VIDEO_COLS);
+   memset16(textmode_row(row_num), make_vgaentry(' ', color), VIDEO_COLS);
 }
 
 static void textmode_set_char_at(u16 row, u16 col, u16 entry)
@@ -26,15 +44,15 @@ static void textmode_set_char_at(u16 row, u16 col, u16 entry)
    ASSERT(row < VIDEO_ROWS);
    ASSERT(col < VIDEO_COLS);
 
-   volatile u16 *video = (volatile u16 *)VIDEO_ADDR;
-   video[row * VIDEO_COLS + col] = entry;
+   volatile u16 *video = (volatile u16 *)textmode_row(row);
+   video[col] = entry;
 }
 
 static void textmode_set_row(u16 row, u16 *data, bool flush)
 {
    ASSERT(row < VIDEO_ROWS);
 
-   void *dest_addr = VIDEO_ADDR + row * VIDEO_COLS;
+   void *dest_addr = textmode_row(row);
    void *src_addr = data;
 
   /*
@@ -61,17 +79,6 @@ static void textmode_set_row(u16 row, u16 *data, bool flush)
    memcpy32(dest_addr, src_addr, VIDEO_COLS >> 1);
 }
 
-/*
- * This function works, but in practice is 2x slower than just using term's
- * generic scroll and re-draw the whole screen.
- */
-static void textmode_scroll_one_line_up(void)
-{
-   memcpy32(VIDEO_ADDR,
-            VIDEO_ADDR + VIDEO_COLS,
-            ((VIDEO_ROWS - 1) * VIDEO_COLS) >> 1);
-}
-
 /*
  * -------- cursor management functions -----------
  *
@@ -81,7 +88,10 @@ static void textmode_scroll_one_line_up(void)
 
 static void textmode_move_cursor(u16 row, u16 col, int color /* ignored */)
 {
-   u16 position = (row * VIDEO_COLS) + col;
+   u16 position = (u16)((start_row + row) * VIDEO_COLS + col);
+
+   cursor_row = row;
+   cursor_col = col;
 
    // cursor LOW port to vga INDEX register
    outb(0x3D4, 0x0F);
@@ -124,6 +134,43 @@ static void textmode_disable_cursor(void)
    // outb(0x3D5, inb(0x3D5) | 0x20);
 }
 
+/* -------- hardware scrolling ----------- */
+
+static void textmode_set_start_row(u32 row)
+{
+   const u16 addr = (u16)(row * VIDEO_COLS);
+
+   start_row = row;
+
+   // start address HIGH and LOW registers
+   outb(0x3D4, 0x0C);
+   outb(0x3D5, LO_BITS(addr >> 8, 8, u8));
+   outb(0x3D4, 0x0D);
+   outb(0x3D5, LO_BITS(addr, 8, u8));
+
+   /* The cursor position is absolute as well: keep it on the same cell */
+   textmode_move_cursor(cursor_row, cursor_col, 0);
+}
+
+static void textmode_scroll_one_line_up(void)
+{
+   if (start_row + VIDEO_ROWS < VIDEO_MEM_ROWS) {
+      textmode_set_start_row(start_row + 1);
+      return;
+   }
+
+   /*
+    * We reached the end of the video memory: copy the rows that will remain
+    * visible at its beginning and restart from there. The new last row will
+    * be cleared by the caller, as always.
+    */
+   memcpy32(VIDEO_ADDR,
+            textmode_row(1),
+            ((VIDEO_ROWS - 1) * VIDEO_COLS) >> 1);
+
+   textmode_set_start_row(0);
+}
+
 static const struct video_interface ega_text_mode_i =
 {
    textmode_set_char_at,
@@ -132,7 +179,7 @@ static const struct video_interface ega_text_mode_i =
    textmode_move_cursor,
    textmode_enable_cursor,
    textmode_disable_cursor,
-   NULL, /* textmode_scroll_one_line_up (see the comment) */
+   textmode_scroll_one_line_up,
    NULL, /* flush_buffers */
    NULL, /* redraw_static_elements */
    NULL, /* disable_static_elems_refresh */
@@ -143,15 +190,21 @@ void init_textmode_console(void)
 {
    pdir_t *pdir = get_curr_pdir();
 
-   if (pdir != NULL && !is_mapped(pdir, VIDEO_ADDR)) {
-      int rc = map_page(pdir,
-                        VIDEO_ADDR,
-                        KERNEL_VA_TO_PA(VIDEO_ADDR),
-                        PAGING_FL_RW);
+   for (u32 off = 0; pdir != NULL && off < VIDEO_MEM_SIZE; off += PAGE_SIZE) {
 
-      if (rc < 0)
-         panic("textmode_console: unable to map VIDEO_ADDR in the virt space");
+      void *va = (char *)VIDEO_ADDR + off;
+
+      if (!is_mapped(pdir, va)) {
+
+         int rc = map_page(pdir, va, KERNEL_VA_TO_PA(va), PAGING_FL_RW);
+
+         if (rc < 0)
+            panic("textmode_console: unable to map the video memory");
+      }
    }
 
+   /* The bootloader might have left the start address somewhere else */
+   textmode_set_start_row(0);
+
    init_first_video_term(&ega_text_mode_i, VIDEO_ROWS, VIDEO_COLS, -1);
 }
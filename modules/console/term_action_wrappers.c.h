@@ -135,6 +135,11 @@ vterm_set_filter(term *_t, term_filter func, void *ctx)
    t->filter_ctx = ctx;
 }
 
+void vterm_set_filter_plain_run(struct vterm *t, term_filter_plain_run func)
+{
+   t->filter_plain_run = func;
+}
+
 static bool
 vterm_is_initialized(term *_t)
 {
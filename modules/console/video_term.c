@@ -64,6 +64,7 @@ struct vterm {
 
    term_filter filter;
    void *filter_ctx;
+   term_filter_plain_run filter_plain_run;
 };
 
 static struct vterm first_instance;
@@ -457,6 +458,65 @@ static void term_internal_write_printable_char(term *_t, u8 c, u8 color)
    t->c++;
 }
 
+static void
+term_internal_write_plain_run(term *_t, const char *buf, u32 len, u8 color)
+{
+   struct vterm *const t = _t;
+   u16 *row;
+   u32 n;
+
+   while (len > 0) {
+
+      if (t->c == t->cols) {
+         t->c = 0;
+         term_internal_incr_row(t, color);
+      }
+
+      n = MIN(len, (u32)(t->cols - t->c));
+      row = get_buf_row(t, t->r) + t->c;
+
+      for (u32 i = 0; i < n; i++)
+         row[i] = make_vgaentry((u8)buf[i], color);
+
+      if (n >= t->cols / 4u) {
+
+         /* Long enough run: re-draw the whole row at once */
+         fpu_context_begin();
+         {
+            t->vi->set_row(t->r, get_buf_row(t, t->r), true);
+         }
+         fpu_context_end();
+
+      } else {
+
+         for (u32 i = 0; i < n; i++)
+            t->vi->set_char_at(t->r, (u16)(t->c + i), row[i]);
+      }
+
+      t->c = (u16)(t->c + n);
+      buf += n;
+      len -= n;
+   }
+}
+
+static u32 term_get_plain_run(term *_t, const char *buf, u32 len)
+{
+   struct vterm *const t = _t;
+   u32 i;
+
+   if (t->filter)
+      return t->filter_plain_run
+         ? t->filter_plain_run((const u8 *)buf, len, t->filter_ctx)
+         : 0;
+
+   /* No filter: early term use by printk() */
+   for (i = 0; i < len; i++)
+      if (!IN_RANGE_INC(buf[i], 0x20, 0x7e))
+         break;
+
+   return i;
+}
+
 static void term_internal_write_tab(term *_t, u8 color)
 {
    struct vterm *const t = _t;
@@ -575,6 +635,14 @@ static void term_action_write(term *_t, char *buf, u32 len, u8 color)
 
    for (u32 i = 0; i < len; i++) {
 
+      const u32 run = term_get_plain_run(t, buf + i, len - i);
+
+      if (run > 0) {
+         term_internal_write_plain_run(t, buf + i, run, color);
+         i += run - 1;
+         continue;
+      }
+
       if (UNLIKELY(t->filter == NULL)) {
          /* Early term use by printk(), before tty has been initialized */
          term_internal_write_char2(t, buf[i], color);
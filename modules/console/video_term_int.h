@@ -93,6 +93,15 @@ STATIC_ASSERT(sizeof(struct term_action) == (2 * sizeof(ulong)));
 u16 vterm_get_curr_row(struct vterm *t);
 u16 vterm_get_curr_col(struct vterm *t);
 
+/*
+ * Optional companion of the filter func: it returns how many bytes at the
+ * beginning of `buf` the filter, in its current state, would just write as
+ * they are (same char, same color, no actions). Runs of such bytes are written
+ * in bulk by the term, without calling the filter for each one of them.
+ */
+typedef u32 (*term_filter_plain_run)(const u8 *buf, u32 len, void *ctx);
+void vterm_set_filter_plain_run(struct vterm *t, term_filter_plain_run func);
+
 static ALWAYS_INLINE void
 term_make_action_write(struct term_action *a,
                        const char *buf,
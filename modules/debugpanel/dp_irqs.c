@@ -4,6 +4,7 @@
 #include <tilck/common/string_util.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/irq.h>
+#include <tilck/kernel/softirq.h>
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/kb.h>
 
@@ -59,6 +60,24 @@ static void debug_dump_unhandled_irq_count(void)
    row++;
 }
 
+static void debug_dump_softirq_stats(void)
+{
+   struct softirq_stats st;
+
+   row++;
+   dp_write(row++, 0, "Soft IRQs: raised, coalesced, runs, over budget");
+
+   for (int i = 0; i < SOFTIRQ_MAX_COUNT; i++) {
+
+      if (!softirq_get_stats(i, &st))
+         continue;
+
+      dp_write(row++, 0, "   %-8s %8u %8u %8u %8u",
+               softirq_get_name(i), st.raised, st.coalesced,
+               st.runs, st.over_budget);
+   }
+}
+
 static void dp_show_irq_stats(void)
 {
    row = dp_screen_start_row;
@@ -67,6 +86,7 @@ static void dp_show_irq_stats(void)
    debug_dump_slow_irq_handler_count();
    debug_dump_spur_irq_count();
    debug_dump_unhandled_irq_count();
+   debug_dump_softirq_stats();
 }
 
 static struct dp_screen dp_irqs_screen =
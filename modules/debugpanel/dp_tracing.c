@@ -10,6 +10,7 @@
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/elf_utils.h>
 
 #include <tilck/mods/tracing.h>
 
@@ -59,6 +60,13 @@ tracing_ui_show_help(void)
       RESET_ATTRS
    );
 
+   dp_write_raw(
+      E_COLOR_YELLOW "  "
+      E_COLOR_YELLOW "t" RESET_ATTRS "     : Edit tracepoints wildcard expr "
+      E_COLOR_RED "[1]" RESET_ATTRS "\r\n"
+      RESET_ATTRS
+   );
+
    dp_write_raw(
       E_COLOR_YELLOW "  "
       E_COLOR_YELLOW "l" RESET_ATTRS "     : List traced syscalls\r\n"
@@ -131,6 +139,24 @@ tracing_ui_msg(void)
       " Trace expr: " E_COLOR_YELLOW "%s" RESET_ATTRS "\r\n", line_buf
    );
 
+   get_enabled_tracepoints_str(line_buf, TRACED_SYSCALLS_STR_LEN);
+
+   dp_write_raw(
+      TERM_VLINE
+      " Tracepoints (" E_COLOR_BR_BLUE "%d" RESET_ATTRS "): "
+      E_COLOR_YELLOW "%s" RESET_ATTRS "\r\n",
+      get_enabled_tracepoints_count(),
+      line_buf
+   );
+
+   if (tracing_get_lost_events_count()) {
+      dp_write_raw(
+         TERM_VLINE
+         " Events lost (buffer full): " E_COLOR_BR_RED "%u" RESET_ATTRS "\r\n",
+         tracing_get_lost_events_count()
+      );
+   }
+
    dp_write_raw("\r\n");
    dp_write_raw(E_COLOR_YELLOW "> " RESET_ATTRS);
 }
@@ -348,6 +374,83 @@ dp_dump_syscall_event(struct trace_event *e,
    dp_write_raw("\r\n");
 }
 
+static const char *
+dp_get_task_state_str(ulong state)
+{
+   switch (state) {
+      case TASK_STATE_RUNNABLE:  return "runnable";
+      case TASK_STATE_RUNNING:   return "running";
+      case TASK_STATE_SLEEPING:  return "sleeping";
+      case TASK_STATE_ZOMBIE:    return "zombie";
+      default:                   return "?";
+   }
+}
+
+static void
+dp_dump_tracepoint_event(struct trace_event *e)
+{
+   const ulong *a = e->args;
+   const char *sym;
+   long off;
+   u32 sym_size;
+
+   switch (e->type) {
+
+      case te_sched_switch:
+         dp_write_raw(
+            E_COLOR_MAGENTA "SWITCH" RESET_ATTRS " -> [%04d] (%s)\r\n",
+            (int)a[1], dp_get_task_state_str(a[2])
+         );
+         break;
+
+      case te_page_fault:
+         dp_write_raw(
+            E_COLOR_MAGENTA "PF" RESET_ATTRS " %p eip: %p err: %#lx\r\n",
+            TO_PTR(a[0]), TO_PTR(a[1]), a[2]
+         );
+         break;
+
+      case te_cow:
+         dp_write_raw(
+            E_COLOR_MAGENTA "COW" RESET_ATTRS " %p (%s)\r\n",
+            TO_PTR(a[0]), a[1] ? "copied" : "not shared"
+         );
+         break;
+
+      case te_irq:
+         dp_write_raw(
+            E_COLOR_MAGENTA "IRQ" RESET_ATTRS " #%lu %s%s" RESET_ATTRS
+            " cycles: %lu\r\n",
+            a[0],
+            a[1] ? "" : E_COLOR_BR_RED,
+            a[1] ? "handled" : "unhandled",
+            a[2]
+         );
+         break;
+
+      case te_wth_job:
+         sym = find_sym_at_addr_safe(a[1], &off, &sym_size);
+         dp_write_raw(
+            E_COLOR_MAGENTA "WTH_JOB" RESET_ATTRS " %p %s(%p) -> %s\r\n",
+            TO_PTR(a[0]),
+            sym ? sym : "?",
+            TO_PTR(a[2]),
+            a[3] ? "ok" : E_COLOR_BR_RED "FULL" RESET_ATTRS
+         );
+         break;
+
+      case te_kmalloc:
+         dp_write_raw(
+            E_COLOR_MAGENTA "KMALLOC" RESET_ATTRS " %lu -> %p\r\n",
+            a[0], TO_PTR(a[1])
+         );
+         break;
+
+      default:
+         dp_write_raw(E_COLOR_BR_RED "<unknown event>\r\n" RESET_ATTRS);
+   }
+}
+
 static void
 dp_dump_tracing_event(struct trace_event *e)
 {
@@ -369,6 +472,10 @@ dp_dump_tracing_event(struct trace_event *e)
       si = tracing_get_syscall_info(e->sys);
       dp_dump_syscall_event(e, sys_name, si);
 
+   } else if (e->type >= TE_FIRST_TP) {
+
+      dp_dump_tracepoint_event(e);
+
    } else {
 
       dp_write_raw(E_COLOR_BR_RED "<unknown event>\r\n" RESET_ATTRS);
@@ -421,6 +528,19 @@ dp_exit_trace_syscall_str(void)
       dp_write_raw(E_COLOR_RED "Invalid input\r\n" RESET_ATTRS);
 }
 
+static void
+dp_edit_tracepoints_str(void)
+{
+   dp_move_left(2);
+   dp_write_raw(E_COLOR_YELLOW "tp expr> " RESET_ATTRS);
+   dp_set_input_blocking(true);
+   dp_read_line(line_buf, TRACED_SYSCALLS_STR_LEN);
+   dp_set_input_blocking(false);
+
+   if (set_enabled_tracepoints(line_buf) < 0)
+      dp_write_raw(E_COLOR_RED "Invalid input\r\n" RESET_ATTRS);
+}
+
 static void
 dp_list_traced_syscalls(void)
 {
@@ -554,6 +674,10 @@ dp_tracing_screen(void)
             dp_exit_trace_syscall_str();
             break;
 
+         case 't':
+            dp_edit_tracepoints_str();
+            break;
+
          case 'l':
             dp_list_traced_syscalls();
             break;
@@ -14,6 +14,7 @@
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/tty.h>
+#include <tilck/kernel/interrupts.h>
 
 #include "fb_int.h"
 
@@ -35,6 +36,36 @@ static struct task *blink_thread_ti;
 static const u32 blink_half_period = (TIMER_HZ * 45)/100;
 static u32 cursor_color;
 
+/*
+ * Shadow buffer
+ * ---------------
+ *
+ * When there's enough memory, the term does NOT draw directly on the
+ * framebuffer: all the video_interface funcs just update a system-RAM copy of
+ * the screen (one u16 vga entry per cell) and mark the touched rows as dirty.
+ * The shadow rows are indexed through a ring offset (shadow_top), so that
+ * scrolling the whole screen by one line costs just an increment, instead of
+ * moving megabytes of VRAM. Dirty rows are flushed to the framebuffer by a
+ * dedicated kernel thread, at most once every `fb_flush_ticks`. Because
+ * `onscreen_buf` tracks what is actually in VRAM, only the spans of cells that
+ * really changed get redrawn.
+ */
+static u16 *shadow_buf;             /* rows x cols, ring-indexed (shadow_top) */
+static u16 *onscreen_buf;           /* what's in VRAM, indexed by screen row */
+static volatile bool *shadow_dirty; /* per screen row */
+static u32 shadow_top;
+static bool shadow_paused;
+static bool shadow_force_redraw;
+static bool shadow_flushing;
+static volatile bool flush_requested;
+static bool flush_thread_running;
+static struct task *flush_thread_ti;
+static const u32 fb_flush_ticks = TIMER_HZ >= 50 ? TIMER_HZ / 50 : 1;
+static bool shadow_cursor_drawn;
+static u16 shadow_cursor_row;
+static u16 shadow_cursor_col;
+static u32 shadow_flushes;
+
 static struct video_interface framebuffer_vi;
 
 static void fb_save_under_cursor_buf(void)
@@ -176,10 +207,14 @@ static void fb_set_row_failsafe(u16 row, u16 *data, bool flush)
 
 static void fb_set_row_optimized(u16 row, u16 *data, bool flush)
 {
-   fb_draw_char_optimized_row(fb_offset_y + row * font_h,
+   fb_draw_char_optimized_row(0,
+                              fb_offset_y + row * font_h,
                               data,
                               fb_term_cols);
 
+   if (row == cursor_row)
+      fb_save_under_cursor_buf();
+
    fb_reset_blink_timer();
 }
 
@@ -198,6 +233,334 @@ static void fb_enable_banner_refresh(void)
 
 // ---------------------------------------------
 
+/* Shadow buffer funcs */
+
+static ALWAYS_INLINE u16 *fb_shadow_row(u16 row)
+{
+   u32 r = shadow_top + row;
+
+   if (r >= fb_term_rows)
+      r -= fb_term_rows;
+
+   return &shadow_buf[r * fb_term_cols];
+}
+
+static void fb_shadow_flush_row(u16 row, bool opt, bool force, int force_col)
+{
+   u16 *const src = fb_shadow_row(row);
+   u16 *const dst = &onscreen_buf[row * fb_term_cols];
+   const u32 y = fb_offset_y + row * font_h;
+   int first = -1, last = -1;
+
+   if (!opt) {
+
+      /* The failsafe funcs are slow: draw just the cells that changed */
+      for (int c = 0; c < (int)fb_term_cols; c++) {
+
+         if (src[c] != dst[c] || force || c == force_col) {
+            dst[c] = src[c];
+            fb_draw_char_failsafe((u32)c * font_w, y, dst[c]);
+         }
+      }
+
+      return;
+   }
+
+   for (int c = 0; c < (int)fb_term_cols; c++) {
+
+      if (src[c] != dst[c] || force || c == force_col) {
+
+         if (first < 0)
+            first = c;
+
+         last = c;
+      }
+   }
+
+   if (first < 0)
+      return;
+
+   /*
+    * Take a snapshot of the span in `onscreen_buf` first and draw from there:
+    * the shadow row might change under our feet (e.g. printk() in IRQ
+    * context), but in that case the row will be marked as dirty again.
+    */
+   memcpy(dst + first, src + first, sizeof(u16) * (u32)(last - first + 1));
+
+   fb_draw_char_optimized_row((u32)first * font_w,
+                              y,
+                              dst + first,
+                              (u32)(last - first + 1));
+}
+
+static void fb_shadow_flush(bool draw_cursor)
+{
+   const bool opt = use_optimized;
+   bool force;
+   int force_col;
+
+   disable_preemption();
+
+   if (shadow_paused || (shadow_flushing && !in_panic())) {
+
+      /* Nested call (IRQ context): leave the work to the outer flush */
+      flush_requested = true;
+      enable_preemption();
+      return;
+   }
+
+   shadow_flushing = true;
+   flush_requested = false;
+   force = shadow_force_redraw;
+   shadow_force_redraw = false;
+
+   if (opt)
+      fpu_context_begin();
+
+   for (u16 r = 0; r < fb_term_rows; r++) {
+
+      const bool had_cursor = shadow_cursor_drawn && r == shadow_cursor_row;
+
+      if (!shadow_dirty[r] && !force && !had_cursor)
+         continue;
+
+      shadow_dirty[r] = false;
+      asmVolatile("" ::: "memory");
+      force_col = had_cursor ? shadow_cursor_col : -1;
+      fb_shadow_flush_row(r, opt, force, force_col);
+   }
+
+   shadow_cursor_drawn = false;
+
+   if (draw_cursor && cursor_enabled && cursor_visible) {
+
+      if (cursor_row < fb_term_rows && cursor_col < fb_term_cols) {
+
+         fb_draw_cursor_raw(cursor_col * font_w,
+                            fb_offset_y + cursor_row * font_h,
+                            cursor_color);
+
+         shadow_cursor_drawn = true;
+         shadow_cursor_row = cursor_row;
+         shadow_cursor_col = cursor_col;
+      }
+   }
+
+   if (opt)
+      fpu_context_end();
+
+   shadow_flushes++;
+   shadow_flushing = false;
+   enable_preemption();
+}
+
+static void fb_shadow_flush_buffers(void)
+{
+   if (shadow_paused)
+      return;
+
+   if (!flush_thread_running || in_panic()) {
+
+      /*
+       * Early boot (the flush thread didn't have a chance to run yet) or
+       * panic: there's nobody else who could flush the buffers for us. Just,
+       * don't do that in IRQ context outside of panic: the interrupted code
+       * might be in the middle of a FPU context.
+       */
+      if (get_curr_irq_regs() && !in_panic()) {
+         flush_requested = true;
+         return;
+      }
+
+      fb_shadow_flush(true);
+      return;
+   }
+
+   if (!flush_requested) {
+      flush_requested = true;
+      task_update_wakeup_timer_if_any(flush_thread_ti, fb_flush_ticks);
+   }
+}
+
+static void fb_shadow_mark_dirty(u16 row)
+{
+   /*
+    * The row MUST be marked as dirty *after* its contents have been updated,
+    * because fb_shadow_flush() clears the flag before reading the row.
+    */
+   asmVolatile("" : : : "memory");
+   shadow_dirty[row] = true;
+}
+
+static void fb_shadow_set_char_at(u16 row, u16 col, u16 entry)
+{
+   fb_shadow_row(row)[col] = entry;
+   fb_shadow_mark_dirty(row);
+}
+
+static void fb_shadow_set_row(u16 row, u16 *data, bool flush)
+{
+   memcpy(fb_shadow_row(row), data, sizeof(u16) * fb_term_cols);
+   fb_shadow_mark_dirty(row);
+}
+
+static void fb_shadow_clear_row(u16 row, u8 color)
+{
+   memset16(fb_shadow_row(row), make_vgaentry(' ', color), fb_term_cols);
+   fb_shadow_mark_dirty(row);
+}
+
+static void fb_shadow_scroll_one_line_up(void)
+{
+   shadow_top = (shadow_top + 1) % fb_term_rows;
+
+   for (u16 r = 0; r < fb_term_rows; r++)
+      fb_shadow_mark_dirty(r);
+}
+
+static void fb_shadow_move_cursor(u16 row, u16 col, int cursor_vga_color)
+{
+   if (row != cursor_row || col != cursor_col)
+      cursor_visible = true;
+
+   cursor_row = row;
+   cursor_col = col;
+
+   if (cursor_vga_color >= 0)
+      cursor_color = vga_rgb_colors[cursor_vga_color];
+
+   if (cursor_enabled && cursor_visible)
+      fb_reset_blink_timer();
+
+   fb_shadow_flush_buffers();
+}
+
+static void fb_shadow_enable_cursor(void)
+{
+   cursor_enabled = true;
+   fb_shadow_flush_buffers();
+}
+
+static void fb_shadow_disable_cursor(void)
+{
+   cursor_enabled = false;
+   fb_shadow_flush_buffers();
+}
+
+static void fb_shadow_pause(void)
+{
+   banner_refresh_disabled = true;
+
+   if (shadow_paused)
+      return;
+
+   /*
+    * Someone else (e.g. an user app mapping the framebuffer) is going to
+    * own the screen: flush what's left, without the cursor, and stop.
+    */
+   fb_shadow_flush(false);
+   shadow_paused = true;
+}
+
+static void fb_shadow_resume(void)
+{
+   banner_refresh_disabled = false;
+   fb_draw_banner();
+
+   /* We cannot make any assumption about what's in VRAM now */
+   shadow_paused = false;
+   shadow_force_redraw = true;
+   shadow_cursor_drawn = false;
+   fb_shadow_flush(true);
+}
+
+static void fb_flush_thread()
+{
+   struct task *curr = get_curr_task();
+   ulong var;
+
+   flush_thread_running = true;
+
+   while (true) {
+
+      /*
+       * Like kernel_sleep(), but checking `flush_requested` with interrupts
+       * disabled: fb_shadow_flush_buffers() can shorten our timer only once
+       * it has been set.
+       */
+      disable_interrupts(&var);
+      {
+         task_set_wakeup_timer(curr, flush_requested ? fb_flush_ticks
+                                                     : TIMER_HZ);
+         task_change_state(curr, TASK_STATE_SLEEPING);
+      }
+      enable_interrupts(&var);
+      kernel_yield();
+
+      if (flush_requested)
+         fb_shadow_flush(true);
+   }
+}
+
+static bool fb_alloc_shadow_buffer(void)
+{
+   const u32 cells = fb_term_rows * fb_term_cols;
+
+   shadow_buf = kmalloc(sizeof(u16) * cells);
+   onscreen_buf = kmalloc(sizeof(u16) * cells);
+   shadow_dirty = kzmalloc(sizeof(bool) * fb_term_rows);
+
+   if (!shadow_buf || !onscreen_buf || !shadow_dirty) {
+
+      if (shadow_buf)
+         kfree2(shadow_buf, sizeof(u16) * cells);
+
+      if (onscreen_buf)
+         kfree2(onscreen_buf, sizeof(u16) * cells);
+
+      if (shadow_dirty)
+         kfree2((void *)shadow_dirty, sizeof(bool) * fb_term_rows);
+
+      shadow_buf = onscreen_buf = NULL;
+      shadow_dirty = NULL;
+      return false;
+   }
+
+   memset16(shadow_buf, make_vgaentry(' ', DEFAULT_COLOR16), cells);
+   shadow_force_redraw = true;
+
+   framebuffer_vi.set_char_at = fb_shadow_set_char_at;
+   framebuffer_vi.set_row = fb_shadow_set_row;
+   framebuffer_vi.clear_row = fb_shadow_clear_row;
+   framebuffer_vi.move_cursor = fb_shadow_move_cursor;
+   framebuffer_vi.enable_cursor = fb_shadow_enable_cursor;
+   framebuffer_vi.disable_cursor = fb_shadow_disable_cursor;
+   framebuffer_vi.scroll_one_line_up = fb_shadow_scroll_one_line_up;
+   framebuffer_vi.flush_buffers = fb_shadow_flush_buffers;
+   framebuffer_vi.disable_static_elems_refresh = fb_shadow_pause;
+   framebuffer_vi.enable_static_elems_refresh = fb_shadow_resume;
+   return true;
+}
+
+static void fb_create_flush_thread(void)
+{
+   int tid = kthread_create(fb_flush_thread, 0, NULL);
+
+   if (tid < 0) {
+      printk("WARNING: unable to create the fb_flush_thread\n");
+      return;
+   }
+
+   disable_preemption();
+   {
+      flush_thread_ti = get_task(tid);
+      ASSERT(flush_thread_ti != NULL);
+   }
+   enable_preemption();
+}
+
+// ---------------------------------------------
+
 static struct video_interface framebuffer_vi =
 {
    fb_set_char_at_failsafe,
@@ -206,8 +569,8 @@ static struct video_interface framebuffer_vi =
    fb_move_cursor,
    fb_enable_cursor,
    fb_disable_cursor,
-   NULL,  /* scroll_one_line_up: used only when running in a VM */
-   NULL,  /* flush_buffers: never used by fb_console */
+   NULL,  /* scroll_one_line_up: shadow buffer or VM only */
+   NULL,  /* flush_buffers: used only with the shadow buffer */
    fb_draw_banner,
    fb_disable_banner_refresh,
    fb_enable_banner_refresh,
@@ -220,7 +583,7 @@ static void fb_blink_thread()
 
       if (cursor_enabled) {
          cursor_visible = !cursor_visible;
-         fb_move_cursor(cursor_row, cursor_col, -1);
+         framebuffer_vi.move_cursor(cursor_row, cursor_col, -1);
       }
 
       kernel_sleep(blink_half_period);
@@ -362,15 +725,18 @@ static void async_pre_render_scanlines()
    disable_interrupts_forced();
    {
       use_optimized = true;
-      framebuffer_vi.set_char_at = fb_set_char_at_optimized;
-      framebuffer_vi.set_row = fb_set_row_optimized;
+
+      if (!shadow_buf) {
+         framebuffer_vi.set_char_at = fb_set_char_at_optimized;
+         framebuffer_vi.set_row = fb_set_row_optimized;
+      }
    }
    enable_interrupts_forced();
 }
 
 static void fb_use_optimized_funcs_if_possible(void)
 {
-   if (in_hypervisor())
+   if (in_hypervisor() && !shadow_buf)
       framebuffer_vi.scroll_one_line_up = fb_scroll_one_line_up;
 
    if (in_panic())
@@ -442,7 +808,9 @@ void init_fb_console(void)
    fb_term_rows = (fb_get_height() - fb_offset_y) / font_h;
    fb_term_cols = fb_get_width() / font_w;
 
-   if (!in_panic()) {
+   if (!in_panic() && !fb_alloc_shadow_buffer()) {
+
+      printk("WARNING: fb_console: unable to allocate the shadow buffer\n");
       under_cursor_buf = kmalloc(sizeof(u32) * font_w * font_h);
 
       if (!under_cursor_buf)
@@ -466,6 +834,9 @@ void init_fb_console(void)
    if (in_panic())
       return;
 
+   if (shadow_buf)
+      fb_create_flush_thread();
+
    if (FB_CONSOLE_CURSOR_BLINK)
       fb_create_cursor_blinking_thread();
 
@@ -475,6 +846,50 @@ void init_fb_console(void)
    }
 }
 
+static void internal_selftest_fb_scroll_perf(void)
+{
+   const int lines = 1000;
+   const u32 flushes_before = shadow_flushes;
+   char buf[80];
+   u64 start, duration, redraw = 0;
+   int rc;
+
+   if (shadow_buf) {
+
+      /* What the direct path used to pay for *each* scrolled line */
+      start = RDTSC();
+
+      for (int i = 0; i < 10; i++) {
+         shadow_force_redraw = true;
+         fb_shadow_flush(true);
+      }
+
+      redraw = (RDTSC() - start) / 10;
+   }
+
+   start = RDTSC();
+
+   for (int i = 0; i < lines; i++) {
+      rc = snprintk(buf, sizeof(buf), "fb scroll perf: line %d of %d\n",
+                    i + 1, lines);
+      term_write(buf, (size_t)rc, DEFAULT_COLOR16);
+   }
+
+   if (shadow_buf)
+      fb_shadow_flush(true);
+
+   duration = RDTSC() - start;
+
+   printk("shadow buffer: %d\n", shadow_buf != NULL);
+   printk("cycles per scrolled line: %llu\n", duration / lines);
+
+   if (shadow_buf) {
+      printk("cycles per full redraw: %llu\n", redraw);
+      printk("flushes for %d lines: %u\n",
+             lines, shadow_flushes - flushes_before);
+   }
+}
+
 void internal_selftest_fb_perf(bool use_fpu)
 {
    if (!__use_framebuffer)
@@ -500,6 +915,7 @@ void internal_selftest_fb_perf(bool use_fpu)
    printk("use_fpu: %d\n", use_fpu);
 
    fb_draw_banner();
+   internal_selftest_fb_scroll_perf();
 }
 
 void selftest_fb_perf(void)
@@ -518,9 +518,9 @@ void fb_draw_char_optimized(u32 x, u32 y, u16 e)
       }
 }
 
-void fb_draw_char_optimized_row(u32 y, u16 *entries, u32 count)
+void fb_draw_char_optimized_row(u32 x, u32 y, u16 *entries, u32 count)
 {
-   const ulong vaddr_base = fb_vaddr + (fb_pitch * y);
+   const ulong vaddr_base = fb_vaddr + (fb_pitch * y) + (x << 2);
 
    // ASSUMPTION: SL_SIZE is 8
    const u32 width_bytes = font_w >> 3;
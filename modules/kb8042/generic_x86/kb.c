@@ -4,7 +4,7 @@
 #include <tilck/common/printk.h>
 
 #include <tilck/kernel/modules.h>
-#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/softirq.h>
 #include <tilck/kernel/list.h>
 #include <tilck/kernel/kb.h>
 #include <tilck/kernel/errno.h>
@@ -26,7 +26,7 @@ enum kb_state {
    KB_READ_FIRST_SCANCODE_AFTER_E1_STATE,
 };
 
-int kb_worker_thread = -1;
+static int kb_softirq = -1;
 static enum kb_state kb_curr_state;
 static bool key_pressed_state[2][128];
 static bool numLock;
@@ -206,23 +206,24 @@ static void kb_process_scancode(u8 scancode)
    }
 }
 
-static void kb_irq_bottom_half(void *arg)
+static bool kb_softirq_handler(void *ctx, u32 budget)
 {
    u8 scancode;
-   disable_preemption();
-   {
-      /*
-       * While it is absolutely NOT necessary to disable the preemption here,
-       * the reason to do that is purely performance-related: it's bad to be
-       * preempted by a just woke-up task after a single scancode has been
-       * processed while there might be other scancodes to process here.
-       * Just process everything first, as fast as possible.
-       */
-      while (safe_ringbuf_read_1(&kb_input_rb, &scancode)) {
-         kb_process_scancode(scancode);
-      }
+
+   /*
+    * Soft IRQs run with preemption disabled: we won't be preempted by a just
+    * woken-up task after a single scancode has been processed, while there
+    * might be other scancodes to process here.
+    */
+   for (u32 i = 0; i < budget; i++) {
+
+      if (!safe_ringbuf_read_1(&kb_input_rb, &scancode))
+         return false;
+
+      kb_process_scancode(scancode);
    }
-   enable_preemption();
+
+   return !safe_ringbuf_is_empty(&kb_input_rb);
 }
 
 static enum irq_action keyboard_irq_handler(void *ctx)
@@ -247,10 +248,7 @@ static enum irq_action keyboard_irq_handler(void *ctx)
    }
 
    if (count > 0) {
-
-      if (!wth_enqueue_job(kb_worker_thread, &kb_irq_bottom_half, NULL))
-         panic("KB: unable to enqueue job");
-
+      softirq_raise(kb_softirq);
       return IRQ_REQUIRES_BH;
    }
 
@@ -267,7 +265,7 @@ static u8 kb_translate_to_mediumraw(struct key_event ke)
    return mediumraw_e0_keys[key & 0xff] | (u8)(!ke.pressed << 7);
 }
 
-static void create_kb_worker_thread(void)
+static void init_kb_bottom_half(void)
 {
    u8 *kb_input_buf = kmalloc(512);
 
@@ -276,11 +274,11 @@ static void create_kb_worker_thread(void)
 
    safe_ringbuf_init(&kb_input_rb, 512, 1, kb_input_buf);
 
-   kb_worker_thread =
-      wth_create_thread(1 /* priority */, WTH_KB_QUEUE_SIZE);
+   kb_softirq = softirq_register("kb", &kb_softirq_handler,
+                                 NULL, SOFTIRQ_INPUT_BUDGET);
 
-   if (kb_worker_thread < 0)
-      panic("KB: Unable to create a worker thread for IRQs");
+   if (kb_softirq < 0)
+      panic("KB: Unable to register a soft IRQ");
 }
 
 static struct kb_dev ps2_keyboard = {
@@ -309,7 +307,7 @@ void init_kb(void)
 
          if (!kb_ctrl_reset()) {
             printk("Unable to initialize the PS/2 controller");
-            create_kb_worker_thread();
+            init_kb_bottom_half();
             return;
          }
 
@@ -333,7 +331,7 @@ void init_kb(void)
    kb_led_update();
    kb_set_typematic_byte(0);
 
-   create_kb_worker_thread();
+   init_kb_bottom_half();
    irq_install_handler(X86_PC_KEYBOARD_IRQ, &keyboard);
 
    register_keyboard_device(&ps2_keyboard);
@@ -96,6 +96,13 @@
 #define MSR_RI                     0b01000000 /* Ring Indicator */
 #define MSR_CD                     0b10000000 /* Carrier Detect */
 
+/* Interrupt Identification Register (IIR) */
+#define IIR_NO_INTR_PENDING        0b00000001
+#define IIR_FIFO_MASK              0b11000000
+#define IIR_FIFO_ENABLED           0b11000000 /* 16550A and later */
+
+#define UART_16550A_FIFO_SIZE      16
+
 /* Set DLAB [Divisor Latch Access Bit] to `value` */
 static void uart_set_dlab(u16 port, bool value)
 {
@@ -129,6 +136,42 @@ void init_serial_port(u16 port)
    outb(port + UART_IER, IER_RCV_AVAIL_INTR);
 }
 
+bool serial_is_present(u16 port)
+{
+   /*
+    * Write a couple of patterns to the scratch register and read them back.
+    * On missing ports, inb() just returns 0xff.
+    */
+   outb(port + UART_SR, 0x5a);
+
+   if (inb(port + UART_SR) != 0x5a)
+      return false;
+
+   outb(port + UART_SR, 0xa5);
+   return inb(port + UART_SR) == 0xa5;
+}
+
+u32 serial_get_tx_fifo_size(u16 port)
+{
+   /* init_serial_port() already tried to enable the FIFOs */
+   if ((inb(port + UART_IIR) & IIR_FIFO_MASK) == IIR_FIFO_ENABLED)
+      return UART_16550A_FIFO_SIZE;
+
+   return 1;
+}
+
+void serial_enable_tx_intr(u16 port, bool enable)
+{
+   u8 ier = inb(port + UART_IER);
+
+   if (enable)
+      ier |= IER_TR_EMPTY_INTR;
+   else
+      ier &= (u8)~IER_TR_EMPTY_INTR;
+
+   outb(port + UART_IER, ier);
+}
+
 bool serial_read_ready(u16 port)
 {
    return !!(inb(port + UART_LSR) & LSR_DATA_READY);
@@ -160,3 +203,8 @@ void serial_write(u16 port, char c)
    serial_wait_for_write(port);
    outb(port, (u8)c);
 }
+
+void serial_write_nowait(u16 port, char c)
+{
+   outb(port + UART_THR, (u8)c);
+}
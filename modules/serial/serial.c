@@ -2,29 +2,56 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
-#include <tilck/common/atomics.h>
 
 #include <tilck/kernel/modules.h>
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/irq.h>
-#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/softirq.h>
 #include <tilck/kernel/cmdline.h>
 #include <tilck/kernel/tty.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/ringbuf.h>
+#include <tilck/kernel/worker_thread.h>
 
 #include <tilck/mods/serial.h>
 
 /* NOTE: hw-specific stuff in generic code. TODO: fix that. */
 
+#define SERIAL_RX_WTH_PRIO                     1
+#define SERIAL_RX_WTH_QUEUE_SIZE               4
+
 struct serial_device {
 
    const char *name;
    u16 ioport;
    struct tty *tty;
-   ATOMIC(int) jobs_cnt;
-   int worker_thread_id;
+   int softirq;                  /* RX bottom half */
+
+   /*
+    * RX side: the soft IRQ moves the bytes from the UART to `rx_rb`, while
+    * `rx_work` delivers them to the tty. That blocks when the tty's input
+    * buffer is full, so it runs in a dedicated worker thread: neither the
+    * soft IRQ, nor any work item in its thread can wait for other threads.
+    */
+   struct ringbuf rx_rb;
+   struct wth_work rx_work;
+   u8 rx_buf[SERIAL_RX_BUF_SIZE];
+
+   /*
+    * TX side: bytes are queued in `tx_rb` and moved to the UART's FIFO by the
+    * THRE (transmitter holding register empty) interrupt. Until the module is
+    * initialized, in panic, or for missing ports, we just poll.
+    */
+   bool tx_intr;                 /* TX is interrupt-driven */
+   bool tx_active;               /* THRE interrupt enabled */
+   u32 tx_fifo_size;
+   struct ringbuf tx_rb;
 };
 
+/* Runs `rx_work` for all the ports */
+static int ser_rx_wth = -1;
+
 struct serial_device legacy_serial_ports[] =
 {
    {
@@ -45,38 +72,207 @@ struct serial_device legacy_serial_ports[] =
    },
 };
 
-static void ser_bh_handler(void *ctx)
+static struct serial_device *get_serial_device(u16 port)
+{
+   for (u32 i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++)
+      if (legacy_serial_ports[i].ioport == port)
+         return &legacy_serial_ports[i];
+
+   return NULL;
+}
+
+/* NOTE: it must be called with interrupts disabled */
+static void serial_tx_kick(struct serial_device *dev)
+{
+   const u16 p = dev->ioport;
+   u8 c;
+
+   if (serial_write_ready(p)) {
+
+      /* The TX FIFO is empty: we can write up to `tx_fifo_size` bytes */
+      for (u32 i = 0; i < dev->tx_fifo_size; i++) {
+
+         if (!ringbuf_read_elem1(&dev->tx_rb, &c))
+            break;
+
+         serial_write_nowait(p, (char)c);
+      }
+   }
+
+   if (ringbuf_is_empty(&dev->tx_rb)) {
+
+      if (dev->tx_active) {
+         serial_enable_tx_intr(p, false);
+         dev->tx_active = false;
+      }
+
+   } else if (!dev->tx_active) {
+
+      serial_enable_tx_intr(p, true);
+      dev->tx_active = true;
+   }
+}
+
+static void serial_tx_drain_polling(struct serial_device *dev)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      while (!ringbuf_is_empty(&dev->tx_rb)) {
+         serial_wait_for_write(dev->ioport);
+         serial_tx_kick(dev);
+      }
+   }
+   enable_interrupts(&var);
+}
+
+static void serial_tx_wait(struct serial_device *dev)
+{
+   ulong var;
+
+   /*
+    * NOTE: sleep only when the caller could be preempted anyway. That
+    * excludes IRQ handlers, soft IRQ handlers and everything else running
+    * with preemption or interrupts disabled. Also, don't sleep in printk():
+    * other tasks might fill the term's action ringbuf in the meanwhile and
+    * that is fatal while `__in_printk` is set.
+    */
+   if (is_preemption_enabled() && are_interrupts_enabled() && !__in_printk) {
+
+      /*
+       * The ring buffer is full: at 115200 baud, one tick (10 ms with the
+       * default TIMER_HZ) is enough to transmit ~115 bytes. Sleeping here
+       * is way better than burning the CPU.
+       */
+      kernel_sleep(1);
+      return;
+   }
+
+   /* We cannot sleep: make room by polling */
+   disable_interrupts(&var);
+   {
+      serial_wait_for_write(dev->ioport);
+      serial_tx_kick(dev);
+   }
+   enable_interrupts(&var);
+}
+
+void serial_write_buf(u16 port, const char *buf, size_t len)
+{
+   struct serial_device *dev = get_serial_device(port);
+   size_t n;
+   ulong var;
+
+   if (!dev || !dev->tx_intr || in_panic()) {
+
+      if (dev && dev->tx_intr)
+         serial_tx_drain_polling(dev);   /* preserve the order */
+
+      for (size_t i = 0; i < len; i++)
+         serial_write(port, buf[i]);
+
+      return;
+   }
+
+   while (true) {
+
+      disable_interrupts(&var);
+      {
+         n = ringbuf_write_bytes(&dev->tx_rb, (u8 *)buf, len);
+
+         /*
+          * NOTE: calling serial_tx_kick() here, not just enabling the THRE
+          * interrupt, means also that we recover from any lost interrupt.
+          */
+         serial_tx_kick(dev);
+      }
+      enable_interrupts(&var);
+
+      buf += n;
+      len -= n;
+
+      if (!len)
+         break;
+
+      serial_tx_wait(dev);
+   }
+}
+
+static void ser_rx_work(void *ctx)
+{
+   struct serial_device *const dev = ctx;
+   bool ok;
+   u8 c;
+
+   while (true) {
+
+      disable_preemption();
+      {
+         ok = ringbuf_read_elem1(&dev->rx_rb, &c);
+      }
+      enable_preemption();
+
+      if (!ok)
+         break;
+
+      tty_send_keyevent(dev->tty, make_key_event(0, (char)c, true), true);
+   }
+
+   /* The soft IRQ stops reading from the UART when `rx_rb` is full */
+   if (serial_read_ready(dev->ioport))
+      softirq_raise(dev->softirq);
+}
+
+static bool ser_softirq_handler(void *ctx, u32 budget)
 {
    struct serial_device *const dev = ctx;
-   struct tty *const t = dev->tty;
    const u16 p = dev->ioport;
-   char c;
+   u32 n = 0;
+
+   while (n < budget && serial_read_ready(p)) {
 
-   while (serial_read_ready(p)) {
+      if (ringbuf_is_full(&dev->rx_rb))
+         break; /* ser_rx_work() will raise the soft IRQ again */
 
-      c = serial_read(p);
-      tty_send_keyevent(t, make_key_event(0, c, true), true);
+      ringbuf_write_elem1(&dev->rx_rb, (u8)serial_read(p));
+      n++;
    }
 
-   dev->jobs_cnt--;
+   if (n > 0)
+      wth_queue_work(ser_rx_wth, &dev->rx_work);
+
+   return n == budget && serial_read_ready(p);
 }
 
 static enum irq_action serial_con_irq_handler(void *ctx)
 {
    struct serial_device *const dev = ctx;
+   bool tx_handled = false;
+   ulong var;
 
-   if (!serial_read_ready(dev->ioport))
-      return IRQ_UNHANDLED; /* Not an IRQ from this "device" [irq sharing] */
+   if (dev->tx_active && serial_write_ready(dev->ioport)) {
 
-   if (dev->jobs_cnt >= 2)
-      return IRQ_FULLY_HANDLED;
+      disable_interrupts(&var);
+      {
+         serial_tx_kick(dev);
+      }
+      enable_interrupts(&var);
+      tx_handled = true;
+   }
+
+   if (!serial_read_ready(dev->ioport)) {
+
+      if (tx_handled)
+         return IRQ_FULLY_HANDLED;
 
-   if (!wth_enqueue_job(dev->worker_thread_id, &ser_bh_handler, dev)) {
-      printk("[serial] WARNING: hit job queue limit\n");
-      return IRQ_FULLY_HANDLED;
+      return IRQ_UNHANDLED; /* Not an IRQ from this "device" [irq sharing] */
    }
 
-   dev->jobs_cnt++;
+   /*
+    * Just mark the bottom half as pending: while it doesn't run, further IRQs
+    * are coalesced and the bytes wait in the UART's FIFO.
+    */
+   softirq_raise(dev->softirq);
    return IRQ_REQUIRES_BH;
 }
 
@@ -93,17 +289,32 @@ DEFINE_IRQ_HANDLER_NODE(com2, serial_con_irq_handler, &legacy_serial_ports[1]);
 DEFINE_IRQ_HANDLER_NODE(com3, serial_con_irq_handler, &legacy_serial_ports[2]);
 DEFINE_IRQ_HANDLER_NODE(com4, serial_con_irq_handler, &legacy_serial_ports[3]);
 
-static void init_serial_comm(void)
+static void serial_init_tx(struct serial_device *dev)
 {
-   int worker_thread_id;
+   void *buf;
 
+   if (!serial_is_present(dev->ioport))
+      return;
+
+   if (!(buf = kmalloc(SERIAL_TX_BUF_SIZE))) {
+      printk("[serial] WARNING: no memory for the %s TX buffer\n", dev->name);
+      return;
+   }
+
+   ringbuf_init(&dev->tx_rb, SERIAL_TX_BUF_SIZE, 1, buf);
+   dev->tx_fifo_size = serial_get_tx_fifo_size(dev->ioport);
+   dev->tx_intr = true;
+}
+
+static void init_serial_comm(void)
+{
    disable_preemption();
    {
-      worker_thread_id =
-         wth_create_thread(1 /* priority */, WTH_KB_QUEUE_SIZE);
+      ser_rx_wth = wth_create_thread(SERIAL_RX_WTH_PRIO,
+                                     SERIAL_RX_WTH_QUEUE_SIZE);
 
-      if (worker_thread_id < 0)
-         panic("Serial: Unable to create a worker thread for IRQs");
+      if (ser_rx_wth < 0)
+         panic("Serial: Unable to create a worker thread for RX");
    }
    enable_preemption();
 
@@ -112,13 +323,25 @@ static void init_serial_comm(void)
       struct serial_device *dev = &legacy_serial_ports[i];
 
       dev->tty = get_serial_tty((int)i);
-      dev->worker_thread_id = worker_thread_id;
+      ringbuf_init(&dev->rx_rb, SERIAL_RX_BUF_SIZE, 1, dev->rx_buf);
+      wth_work_init(&dev->rx_work, &ser_rx_work, dev);
+
+      dev->softirq = softirq_register(dev->name,
+                                      &ser_softirq_handler,
+                                      dev,
+                                      SOFTIRQ_INPUT_BUDGET);
+
+      if (dev->softirq < 0)
+         panic("Serial: Unable to register a soft IRQ");
    }
 
    irq_install_handler(X86_PC_COM1_COM3_IRQ, &com1);
    irq_install_handler(X86_PC_COM1_COM3_IRQ, &com3);
    irq_install_handler(X86_PC_COM2_COM4_IRQ, &com2);
    irq_install_handler(X86_PC_COM2_COM4_IRQ, &com4);
+
+   for (u32 i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++)
+      serial_init_tx(&legacy_serial_ports[i]);
 }
 
 static struct module serial_module = {
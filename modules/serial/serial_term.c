@@ -56,14 +56,24 @@ static void
 sterm_action_write(term *_t, const char *buf, size_t len)
 {
    struct sterm *const t = _t;
+   char tmp[64];
+   u32 n = 0;
 
    for (u32 i = 0; i < len; i++) {
 
+      if (n >= sizeof(tmp) - 1) {
+         serial_write_buf(t->serial_port_fwd, tmp, n);
+         n = 0;
+      }
+
       if (buf[i] == '\n')
-         serial_write(t->serial_port_fwd, '\r');
+         tmp[n++] = '\r';
 
-      serial_write(t->serial_port_fwd, buf[i]);
+      tmp[n++] = buf[i];
    }
+
+   if (n)
+      serial_write_buf(t->serial_port_fwd, tmp, n);
 }
 
 static ALWAYS_INLINE void
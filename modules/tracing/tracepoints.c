@@ -0,0 +1,147 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/errno.h>
+
+#include <tilck/mods/tracing.h>
+
+struct tracepoint __tracepoints[TP_COUNT] = {
+
+   [tp_sched_switch]    = { .name = "sched_switch" },
+   [tp_page_fault]      = { .name = "page_fault" },
+   [tp_cow]             = { .name = "cow" },
+   [tp_irq]             = { .name = "irq" },
+   [tp_wth_job]         = { .name = "wth_job" },
+   [tp_kmalloc]         = { .name = "kmalloc" },
+};
+
+#if defined(__i386__) && !defined(UNIT_TEST_ENVIRONMENT)
+
+/* Defined in the linker script */
+extern struct tp_site __tp_sites_start[];
+extern struct tp_site __tp_sites_end[];
+
+static const u8 tp_nop5[5] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+
+static bool
+tp_is_nop5(const u8 *code)
+{
+   for (u32 i = 0; i < sizeof(tp_nop5); i++)
+      if (code[i] != tp_nop5[i])
+         return false;
+
+   return true;
+}
+
+static void
+tp_get_jmp_insn(struct tp_site *s, u8 insn[5])
+{
+   const s32 rel = (s32)(s->target - (s->code + 5));
+
+   insn[0] = 0xe9; /* JMP rel32 */
+   memcpy(insn + 1, &rel, sizeof(rel));
+}
+
+/*
+ * Hot-patches all the sites of the given tracepoint, in the same way the
+ * fpu_memcpy funcs are patched by simple_hot_patch(). On a single CPU, with
+ * the interrupts disabled, no one can execute the code being patched and
+ * no task can be preempted in the middle of a 5-byte NOP.
+ */
+static void
+tp_patch_sites(enum tp_id id, bool enabled)
+{
+   u8 jmp[5];
+   ulong var;
+
+   disable_interrupts(&var);
+
+   for (struct tp_site *s = __tp_sites_start; s < __tp_sites_end; s++) {
+
+      if (s->id != id)
+         continue;
+
+      if (enabled) {
+         tp_get_jmp_insn(s, jmp);
+         memcpy(TO_PTR(s->code), jmp, sizeof(jmp));
+      } else {
+         memcpy(TO_PTR(s->code), tp_nop5, sizeof(tp_nop5));
+      }
+   }
+
+   enable_interrupts(&var);
+}
+
+void
+init_tracepoints(void)
+{
+   for (struct tp_site *s = __tp_sites_start; s < __tp_sites_end; s++) {
+
+      if (s->id >= TP_COUNT)
+         panic("Invalid tracepoint id %u at %p", s->id, TO_PTR(s->code));
+
+      if (!tp_is_nop5(TO_PTR(s->code)))
+         panic("No NOP at the tracepoint site %p", TO_PTR(s->code));
+   }
+}
+
+#else
+
+static void
+tp_patch_sites(enum tp_id id, bool enabled)
+{
+   /* Nothing to do: tracepoints just check their `enabled` flag */
+}
+
+void
+init_tracepoints(void)
+{
+   /* Nothing to do */
+}
+
+#endif
+
+int
+tracepoint_set_enabled(enum tp_id id, bool enabled)
+{
+   if ((u32)id >= TP_COUNT)
+      return -EINVAL;
+
+   if (__tracepoints[id].enabled == enabled)
+      return 0;
+
+   if (enabled) {
+      __tracepoints[id].enabled = true;
+      tp_patch_sites(id, true);
+   } else {
+      tp_patch_sites(id, false);
+      __tracepoints[id].enabled = false;
+   }
+
+   return 0;
+}
+
+int
+get_enabled_tracepoints_count(void)
+{
+   int count = 0;
+
+   for (int i = 0; i < TP_COUNT; i++)
+      if (__tracepoints[i].enabled)
+         count++;
+
+   return count;
+}
+
+void
+trace_tracepoint_int(enum tp_id id, ulong a1, ulong a2, ulong a3, ulong a4)
+{
+   if (!tracing_is_enabled())
+      return;
+
+   tracing_write_tp_event(TE_FIRST_TP + id, a1, a2, a3, a4);
+}
@@ -6,8 +6,6 @@
 #include <tilck/kernel/modules.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/kmalloc.h>
-#include <tilck/kernel/sync.h>
-#include <tilck/kernel/ringbuf.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/bintree.h>
@@ -16,8 +14,6 @@
 
 #include <tilck/mods/tracing.h>
 
-#define TRACE_BUF_SIZE                       (128 * KB)
-
 struct symbol_node {
 
    struct bintree_node node;
@@ -27,11 +23,6 @@ struct symbol_node {
    const char *name;
 };
 
-static struct kmutex tracing_lock;
-static struct kcond tracing_cond;
-static struct ringbuf tracing_rb;
-static void *tracing_buf;
-
 static u32 syms_count;
 static struct symbol_node *syms_buf;
 static struct symbol_node *syms_bintree;
@@ -43,6 +34,9 @@ static s8 *syscalls_fmts;
 static char *traced_syscalls_str;
 static int traced_syscalls_count;
 
+static bool enabled_tps[TP_COUNT];
+static char enabled_tps_str[TRACED_SYSCALLS_STR_LEN];
+
 bool *traced_syscalls;
 bool __force_exp_block;
 bool __tracing_on;
@@ -211,13 +205,7 @@ trace_syscall_enter_int(u32 sys,
    };
 
    trace_syscall_enter_save_params(si, &e);
-
-   kmutex_lock(&tracing_lock);
-   {
-      ringbuf_write_elem(&tracing_rb, &e);
-      kcond_signal_one(&tracing_cond);
-   }
-   kmutex_unlock(&tracing_lock);
+   tracing_write_event(&e);
 }
 
 void
@@ -242,38 +230,7 @@ trace_syscall_exit_int(u32 sys,
    };
 
    trace_syscall_exit_save_params(si, &e);
-
-   kmutex_lock(&tracing_lock);
-   {
-      ringbuf_write_elem(&tracing_rb, &e);
-      kcond_signal_one(&tracing_cond);
-   }
-   kmutex_unlock(&tracing_lock);
-}
-
-bool read_trace_event_noblock(struct trace_event *e)
-{
-   bool ret;
-   kmutex_lock(&tracing_lock);
-   {
-      ret = ringbuf_read_elem(&tracing_rb, e);
-   }
-   kmutex_unlock(&tracing_lock);
-   return ret;
-}
-
-bool read_trace_event(struct trace_event *e, u32 timeout_ticks)
-{
-   bool ret;
-   kmutex_lock(&tracing_lock);
-   {
-      if (ringbuf_is_empty(&tracing_rb))
-         kcond_wait(&tracing_cond, &tracing_lock, timeout_ticks);
-
-      ret = ringbuf_read_elem(&tracing_rb, e);
-   }
-   kmutex_unlock(&tracing_lock);
-   return ret;
+   tracing_write_event(&e);
 }
 
 const struct syscall_info *
@@ -565,20 +522,17 @@ handle_sys_trace_arg(const char *arg)
    return 0;
 }
 
+/*
+ * Calls `handle_arg` for each sub-expression in `str`. Sub-expressions are
+ * separated by comma or space.
+ */
 static int
-set_traced_syscalls_int(const char *str)
+for_each_trace_expr_arg(const char *str, int (*handle_arg)(const char *))
 {
-   const size_t len = strlen(str);
    const char *s = str;
    char *p, buf[32];
    int rc;
 
-   if (len >= TRACED_SYSCALLS_STR_LEN)
-      return -ENAMETOOLONG;
-
-   if (len == 0)
-      return -EINVAL;
-
    for (p = buf; *s; s++) {
 
       if (p == buf + sizeof(buf))
@@ -588,7 +542,7 @@ set_traced_syscalls_int(const char *str)
          *p = 0;
          p = buf;
 
-         if ((rc = handle_sys_trace_arg(buf)))
+         if ((rc = handle_arg(buf)))
             return rc;
 
          continue;
@@ -601,10 +555,28 @@ set_traced_syscalls_int(const char *str)
 
       *p = 0;
 
-      if ((rc = handle_sys_trace_arg(buf)))
+      if ((rc = handle_arg(buf)))
          return rc;
    }
 
+   return 0;
+}
+
+static int
+set_traced_syscalls_int(const char *str)
+{
+   const size_t len = strlen(str);
+   int rc;
+
+   if (len >= TRACED_SYSCALLS_STR_LEN)
+      return -ENAMETOOLONG;
+
+   if (len == 0)
+      return -EINVAL;
+
+   if ((rc = for_each_trace_expr_arg(str, handle_sys_trace_arg)))
+      return rc;
+
    traced_syscalls_count = 0;
 
    for (int i = 0; i < MAX_SYSCALLS; i++)
@@ -637,18 +609,68 @@ set_traced_syscalls(const char *s)
    return rc;
 }
 
+static int
+handle_tp_trace_arg(const char *arg)
+{
+   bool match_sign = true;
+
+   if (!*arg)
+      return 0; /* empty string */
+
+   if (*arg == '!') {
+
+      if (!arg[1])
+         return 0; /* empty negation string */
+
+      match_sign = false;
+      arg++;
+   }
+
+   for (int i = 0; i < TP_COUNT; i++) {
+
+      if (simple_wildcard_match(__tracepoints[i].name, arg))
+         enabled_tps[i] = match_sign;
+   }
+
+   return 0;
+}
+
+/*
+ * Enables the tracepoints matching the expression `str`, which has the same
+ * syntax as the one used for the syscalls. An empty string disables all the
+ * tracepoints.
+ */
 int
-tracing_get_in_buffer_events_count(void)
+set_enabled_tracepoints(const char *str)
 {
+   const size_t len = strlen(str);
    int rc;
-   kmutex_lock(&tracing_lock);
+
+   if (len >= TRACED_SYSCALLS_STR_LEN)
+      return -ENAMETOOLONG;
+
+   disable_preemption();
    {
-      rc = (int)ringbuf_get_elems(&tracing_rb); // integer narrowing
+      bzero(enabled_tps, sizeof(enabled_tps));
+
+      if (!(rc = for_each_trace_expr_arg(str, handle_tp_trace_arg))) {
+
+         for (int i = 0; i < TP_COUNT; i++)
+            tracepoint_set_enabled(i, enabled_tps[i]);
+
+         memcpy(enabled_tps_str, str, len + 1);
+      }
    }
-   kmutex_unlock(&tracing_lock);
+   enable_preemption();
    return rc;
 }
 
+void
+get_enabled_tracepoints_str(char *buf, size_t len)
+{
+   memcpy(buf, enabled_tps_str, MIN(len, TRACED_SYSCALLS_STR_LEN));
+}
+
 static void
 tracing_init_oom_panic(const char *buf_name)
 {
@@ -658,9 +680,6 @@ tracing_init_oom_panic(const char *buf_name)
 void
 init_tracing(void)
 {
-   if (!(tracing_buf = kzmalloc(TRACE_BUF_SIZE)))
-      tracing_init_oom_panic("tracing_buf");
-
    if (!(syms_buf = kmalloc(sizeof(struct symbol_node) * MAX_SYSCALLS)))
       tracing_init_oom_panic("syms_buf");
 
@@ -679,18 +698,12 @@ init_tracing(void)
    if (!(traced_syscalls_str = kmalloc(TRACED_SYSCALLS_STR_LEN)))
       tracing_init_oom_panic("traced_syscalls_str");
 
-   ringbuf_init(&tracing_rb,
-                TRACE_BUF_SIZE / sizeof(struct trace_event),
-                sizeof(struct trace_event),
-                tracing_buf);
-
-   kmutex_init(&tracing_lock, 0);
-   kcond_init(&tracing_cond);
-
+   init_tracing_ring();
    foreach_symbol(elf_symbol_cb, NULL);
 
    tracing_populate_syscalls_info();
    tracing_allocate_slots_for_params();
+   init_tracepoints();
 
    set_traced_syscalls("*");
 }
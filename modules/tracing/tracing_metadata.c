@@ -32,6 +32,13 @@ static const struct syscall_info __tracing_metadata[] =
    SYSCALL_TYPE_1(SYS_dup, "dup"),
    SYSCALL_TYPE_1(SYS_getpgid, "pid"),
    SYSCALL_TYPE_1(SYS_getsid, "pid"),
+   SYSCALL_TYPE_1(SYS_sched_getscheduler, "pid"),
+   SYSCALL_TYPE_1(SYS_sched_get_priority_max, "policy"),
+   SYSCALL_TYPE_1(SYS_sched_get_priority_min, "policy"),
+
+#if defined(__i386__)
+   SYSCALL_TYPE_1(SYS_nice, "inc"),
+#endif
 
    SYSCALL_TYPE_2(SYS_creat, "path", "mode"),
    SYSCALL_TYPE_2(SYS_chmod, "path", "mode"),
@@ -50,6 +57,7 @@ static const struct syscall_info __tracing_metadata[] =
    SYSCALL_TYPE_5(SYS_dup2, "oldfd", "newfd"),
    SYSCALL_TYPE_5(SYS_kill, "pid", "sig"),
    SYSCALL_TYPE_5(SYS_tkill, "tid", "sig"),
+   SYSCALL_TYPE_5(SYS_getpriority, "which", "who"),
 
 #if defined(__i386__)
    SYSCALL_TYPE_6(SYS_chown16, "path", "owner", "group"),
@@ -62,6 +70,7 @@ static const struct syscall_info __tracing_metadata[] =
    SYSCALL_TYPE_6(SYS_lchown, "path", "owner", "group"),
 
    SYSCALL_TYPE_7(SYS_fchown, "fd", "owner", "group"),
+   SYSCALL_TYPE_7(SYS_setpriority, "which", "who", "prio"),
 
    SYSCALL_RW(SYS_read, "fd", "buf", &ptype_big_buf, sys_param_out, "count"),
    SYSCALL_RW(SYS_write, "fd", "buf", &ptype_big_buf, sys_param_in, "count"),
@@ -96,6 +105,17 @@ static const struct syscall_info __tracing_metadata[] =
       .params = { }
    },
 
+   {
+      .sys_n = SYS_clone,
+      .n_params = 2,
+      .exp_block = true,
+      .ret_type = &ptype_errno_or_val,
+      .params = {
+         SIMPLE_PARAM("flags", &ptype_int, sys_param_in),
+         SIMPLE_PARAM("stack", &ptype_voidp, sys_param_in),
+      }
+   },
+
    {
       .sys_n = SYS_getcwd,
       .n_params = 2,
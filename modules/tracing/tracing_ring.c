@@ -0,0 +1,545 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/atomics.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/signal.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/devfs.h>
+#include <tilck/kernel/self_tests.h>
+
+#include <tilck/mods/tracing.h>
+
+#include <fcntl.h>      // system header
+
+/*
+ * Lock-free trace ring buffer
+ * -----------------------------
+ *
+ * Like the safe_ringbuf, the producers never block and never take any locks:
+ * they reserve space in the buffer by moving `head` forward with a CAS, then
+ * fill the record and, finally, commit it by atomically writing its header
+ * with the TRACE_REC_COMMITTED flag set. Because of that, any number of
+ * producers can interrupt (or preempt) each other and the only cost of tracing
+ * a syscall is the cost of saving its params.
+ *
+ * Unlike the safe_ringbuf, the records have a variable size and a consumer can
+ * safely run in parallel with any number of producers: it just stops at the
+ * first record not committed yet. Consumers are serialized among themselves
+ * by `trace_read_lock`, which is never touched by the producers.
+ *
+ * Records never wrap around the end of the buffer: when a record wouldn't fit
+ * there, the producer reserves the rest of the buffer as well and fills it
+ * with a TRACE_REC_PAD record, skipped by the consumers.
+ *
+ * `head` and `tail` are free-running counters: their difference is the amount
+ * of used space in the buffer, even after they overflow.
+ *
+ * Consumed records are zeroed, so the free space contains only zeros: that's
+ * what makes safe for a consumer to look at the header of a record reserved,
+ * but not committed yet.
+ *
+ * There is one ring per CPU, in order to make the whole thing SMP-ready, even
+ * if Tilck runs on a single CPU at the moment.
+ */
+
+#define TRACE_RING_SIZE                             (128 * KB)
+#define TRACE_REC_COMMITTED                            (1 << 0)
+
+STATIC_ASSERT((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0);
+
+struct trace_ring {
+
+   ATOMIC(u32) head;       /* where the next record will be reserved */
+   ATOMIC(u32) tail;       /* first record not consumed yet */
+   ATOMIC(u32) nr_recs;    /* records committed and not consumed yet */
+   ATOMIC(u32) lost;       /* records dropped because the ring was full */
+   u8 *buf;
+};
+
+union trace_rec_hdr_raw {
+   struct trace_rec_hdr h;
+   u32 raw;
+};
+
+static struct trace_ring trace_ring_cpu0;
+static struct kmutex trace_read_lock;
+static struct kcond trace_cond;
+
+static ALWAYS_INLINE struct trace_ring *
+get_trace_ring(void)
+{
+   return &trace_ring_cpu0;
+}
+
+static ALWAYS_INLINE struct trace_rec *
+trace_ring_rec_at(struct trace_ring *r, u32 pos)
+{
+   return (void *)(r->buf + (pos & (TRACE_RING_SIZE - 1)));
+}
+
+static ALWAYS_INLINE void
+trace_rec_commit(struct trace_rec *rec, u32 size, u8 type)
+{
+   union trace_rec_hdr_raw hdr = {
+      .h = {
+         .size = (u16)size,
+         .type = type,
+         .flags = TRACE_REC_COMMITTED,
+      }
+   };
+
+   atomic_store_explicit(&rec->__hdr, hdr.raw, mo_release);
+}
+
+/*
+ * Reserves `size` contiguous bytes in the ring. Returns NULL when there's no
+ * space: in that case, the event is lost (we cannot wait for the consumer).
+ */
+static struct trace_rec *
+trace_ring_reserve(struct trace_ring *r, u32 size)
+{
+   u32 head, tail, off, pad, new_head;
+
+   head = atomic_load_explicit(&r->head, mo_relaxed);
+
+   do {
+
+      tail = atomic_load_explicit(&r->tail, mo_acquire);
+      off = head & (TRACE_RING_SIZE - 1);
+      pad = off + size > TRACE_RING_SIZE ? TRACE_RING_SIZE - off : 0;
+      new_head = head + pad + size;
+
+      if (new_head - tail > TRACE_RING_SIZE) {
+         atomic_fetch_add_explicit(&r->lost, 1, mo_relaxed);
+         return NULL;
+      }
+
+   } while (!atomic_cas_weak(&r->head,
+                             &head,
+                             new_head,
+                             mo_relaxed,
+                             mo_relaxed));
+
+   if (pad) {
+      trace_rec_commit(trace_ring_rec_at(r, head), pad, TRACE_REC_PAD);
+      head += pad;
+   }
+
+   return trace_ring_rec_at(r, head);
+}
+
+/*
+ * Consumes the first record in the ring, copying it to `dest`. Returns the
+ * size of the record, 0 if there are no committed records or -EINVAL if the
+ * record is bigger than `max_size` (in that case, it's not consumed).
+ */
+static int
+trace_ring_read(struct trace_ring *r, void *dest, size_t max_size)
+{
+   union trace_rec_hdr_raw hdr;
+   struct trace_rec *rec;
+   u32 tail;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&trace_read_lock));
+   tail = atomic_load_explicit(&r->tail, mo_relaxed);
+
+   while (tail != atomic_load_explicit(&r->head, mo_relaxed)) {
+
+      rec = trace_ring_rec_at(r, tail);
+      hdr.raw = atomic_load_explicit(&rec->__hdr, mo_acquire);
+
+      if (!(hdr.h.flags & TRACE_REC_COMMITTED))
+         break;  /* a producer is still writing this record */
+
+      if (hdr.h.type != TRACE_REC_PAD) {
+
+         if (hdr.h.size > max_size)
+            return -EINVAL;
+
+         memcpy(dest, rec, hdr.h.size);
+         ((struct trace_rec *)dest)->h.flags = 0;
+      }
+
+      /*
+       * Zero the whole record, not just its header: the next records might
+       * start at any offset in this space and their producers write their
+       * header last. Until then, the consumers must see zeros there, not a
+       * stale header parsed from the middle of an old record.
+       */
+      bzero(rec, hdr.h.size);
+      tail += hdr.h.size;
+      atomic_store_explicit(&r->tail, tail, mo_release);
+
+      if (hdr.h.type != TRACE_REC_PAD) {
+         atomic_fetch_sub_explicit(&r->nr_recs, 1, mo_relaxed);
+         return hdr.h.size;
+      }
+   }
+
+   return 0;
+}
+
+/* Returns the number of bytes of the slot's data, without trailing zeros */
+static u8
+trace_slot_data_len(const char *buf, size_t size)
+{
+   while (size > 0 && !buf[size - 1])
+      size--;
+
+   return (u8)size;
+}
+
+void
+tracing_write_event(struct trace_event *e)
+{
+   const struct syscall_info *si = tracing_get_syscall_info(e->sys);
+   struct trace_ring *r = get_trace_ring();
+   char *slots[6] = {0};
+   u8 lens[6] = {0};
+   struct trace_rec *rec;
+   u8 n_params = 0;
+   u32 size = sizeof(struct trace_rec);
+   size_t bs;
+   u8 *p;
+
+   for (int i = 0; si && i < si->n_params; i++) {
+
+      if (!tracing_get_slot(e, si, i, &slots[i], &bs))
+         continue;
+
+      if (!(lens[i] = trace_slot_data_len(slots[i], bs)))
+         continue;
+
+      size += 2 + lens[i];
+      n_params++;
+   }
+
+   size = pow2_round_up_at(size, TRACE_REC_ALIGN);
+   ASSERT(size <= TRACE_REC_MAX_SIZE);
+
+   if (!(rec = trace_ring_reserve(r, size)))
+      return;
+
+   rec->sys = (u16)e->sys;
+   rec->n_params = n_params;
+   rec->unused = 0;
+   rec->tid = e->tid;
+   rec->retval = e->retval;
+   rec->sys_time = e->sys_time;
+   memcpy(rec->args, e->args, sizeof(rec->args));
+
+   p = rec->params;
+
+   for (int i = 0; n_params && i < 6; i++) {
+
+      if (!lens[i])
+         continue;
+
+      *p++ = (u8)i;
+      *p++ = lens[i];
+      memcpy(p, slots[i], lens[i]);
+      p += lens[i];
+   }
+
+   /* Increment `nr_recs` first, in order to never let it underflow */
+   atomic_fetch_add_explicit(&r->nr_recs, 1, mo_relaxed);
+   trace_rec_commit(rec, size, (u8)e->type);
+
+   if (kcond_is_anyone_waiting(&trace_cond))
+      kcond_signal_all(&trace_cond);
+}
+
+/*
+ * Writes the event of a static tracepoint: just the header, no saved params.
+ * Tracepoints fire also in IRQ context, where `trace_cond` cannot be signaled:
+ * the consumers will get their events at the next wait timeout.
+ */
+void
+tracing_write_tp_event(enum trace_event_type type,
+                       ulong a1,
+                       ulong a2,
+                       ulong a3,
+                       ulong a4)
+{
+   struct trace_ring *r = get_trace_ring();
+   const u32 size = sizeof(struct trace_rec);
+   struct trace_rec *rec;
+
+   if (!(rec = trace_ring_reserve(r, size)))
+      return;
+
+   rec->sys = 0;
+   rec->n_params = 0;
+   rec->unused = 0;
+   rec->tid = get_curr_tid();
+   rec->retval = 0;
+   rec->sys_time = get_sys_time();
+   rec->args[0] = a1;
+   rec->args[1] = a2;
+   rec->args[2] = a3;
+   rec->args[3] = a4;
+   rec->args[4] = 0;
+   rec->args[5] = 0;
+
+   atomic_fetch_add_explicit(&r->nr_recs, 1, mo_relaxed);
+   trace_rec_commit(rec, size, (u8)type);
+}
+
+static void
+trace_rec_to_event(struct trace_rec *rec, struct trace_event *e)
+{
+   const struct syscall_info *si =
+      te_is_syscall(rec->h.type) ? tracing_get_syscall_info(rec->sys) : NULL;
+   const u8 *p = rec->params;
+   char *slot;
+   size_t bs;
+
+   bzero(e, sizeof(*e));
+   e->type = rec->h.type;
+   e->tid = rec->tid;
+   e->sys_time = rec->sys_time;
+   e->sys = rec->sys;
+   e->retval = rec->retval;
+   memcpy(e->args, rec->args, sizeof(e->args));
+
+   for (u8 i = 0; si && i < rec->n_params; i++) {
+
+      const u8 idx = *p++;
+      const u8 len = *p++;
+
+      if (tracing_get_slot(e, si, idx, &slot, &bs))
+         memcpy(slot, p, MIN((size_t)len, bs));
+
+      p += len;
+   }
+}
+
+bool read_trace_event_noblock(struct trace_event *e)
+{
+   char buf[TRACE_REC_MAX_SIZE] ALIGNED_AT(TRACE_REC_ALIGN);
+   int rc;
+
+   kmutex_lock(&trace_read_lock);
+   {
+      rc = trace_ring_read(get_trace_ring(), buf, sizeof(buf));
+   }
+   kmutex_unlock(&trace_read_lock);
+
+   if (rc > 0)
+      trace_rec_to_event((void *)buf, e);
+
+   return rc > 0;
+}
+
+bool read_trace_event(struct trace_event *e, u32 timeout_ticks)
+{
+   char buf[TRACE_REC_MAX_SIZE] ALIGNED_AT(TRACE_REC_ALIGN);
+   struct trace_ring *r = get_trace_ring();
+   int rc;
+
+   kmutex_lock(&trace_read_lock);
+   {
+      /*
+       * NOTE: the producers don't take `trace_read_lock`, so a wake-up might
+       * be missed if an event is written right before we start waiting. The
+       * timeout bounds the delay in that case.
+       */
+      if (!(rc = trace_ring_read(r, buf, sizeof(buf)))) {
+         kcond_wait(&trace_cond, &trace_read_lock, timeout_ticks);
+         rc = trace_ring_read(r, buf, sizeof(buf));
+      }
+   }
+   kmutex_unlock(&trace_read_lock);
+
+   if (rc > 0)
+      trace_rec_to_event((void *)buf, e);
+
+   return rc > 0;
+}
+
+int
+tracing_get_in_buffer_events_count(void)
+{
+   return (int)atomic_load_explicit(&get_trace_ring()->nr_recs, mo_relaxed);
+}
+
+u32
+tracing_get_lost_events_count(void)
+{
+   return atomic_load_explicit(&get_trace_ring()->lost, mo_relaxed);
+}
+
+/*
+ * /dev/trace: each read() consumes as many whole records as fit in the
+ * buffer, in the binary format described in tracing.h. It blocks when there
+ * are no records, unless the file has been opened with O_NONBLOCK.
+ */
+static ssize_t tracedev_read(fs_handle h, char *buf, size_t size)
+{
+   struct fs_handle_base *hb = h;
+   struct trace_ring *r = get_trace_ring();
+   ssize_t tot = 0;
+   int rc;
+
+   kmutex_lock(&trace_read_lock);
+   {
+      while (!(rc = trace_ring_read(r, buf, size))) {
+
+         if (hb->fl_flags & O_NONBLOCK) {
+            rc = -EAGAIN;
+            break;
+         }
+
+         kcond_wait(&trace_cond, &trace_read_lock, TIMER_HZ / 10);
+
+         if (pending_signals()) {
+            rc = -EINTR;
+            break;
+         }
+      }
+
+      while (rc > 0) {
+         tot += rc;
+         rc = trace_ring_read(r, buf + tot, size - (size_t)tot);
+      }
+   }
+   kmutex_unlock(&trace_read_lock);
+   return tot ? tot : rc;
+}
+
+static int tracedev_read_ready(fs_handle h)
+{
+   return tracing_get_in_buffer_events_count() > 0;
+}
+
+static struct kcond *tracedev_get_rready_cond(fs_handle h)
+{
+   return &trace_cond;
+}
+
+static int
+create_tracedev_file(int minor,
+                     const struct file_ops **fops_ref,
+                     enum vfs_entry_type *t,
+                     int *spec_flags_ref)
+{
+   static const struct file_ops static_ops_tracedev = {
+      .read = tracedev_read,
+      .read_ready = tracedev_read_ready,
+      .get_rready_cond = tracedev_get_rready_cond,
+   };
+
+   *t = VFS_CHAR_DEV;
+   *fops_ref = &static_ops_tracedev;
+   return 0;
+}
+
+static void
+init_tracedev(void)
+{
+   struct driver_info *di;
+   int major, rc;
+
+   if (!(di = kzmalloc(sizeof(struct driver_info))))
+      panic("Unable to allocate the driver info for /dev/trace");
+
+   di->name = "trace";
+   di->create_dev_file = create_tracedev_file;
+   major = register_driver(di, -1);
+
+   if ((rc = create_dev_file("trace", (u16)major, 0 /* minor */)))
+      panic("Unable to create /dev/trace (error: %d)", rc);
+}
+
+void
+init_tracing_ring(void)
+{
+   struct trace_ring *r = get_trace_ring();
+
+   if (!(r->buf = kzmalloc(TRACE_RING_SIZE)))
+      panic("Unable to allocate the trace ring buffer");
+
+   kmutex_init(&trace_read_lock, KMUTEX_FL_ADAPTIVE);
+   kcond_init(&trace_cond);
+   init_tracedev();
+}
+
+/*
+ * Interleaves reserve, commit and read on a private ring, with records of
+ * varied sizes, until it wraps around a few times. The records' bodies are
+ * filled with 0xff: a stale header left in the free space would look like a
+ * committed record, bigger than any valid one.
+ */
+void selftest_tracing_ring_short(void)
+{
+   const u32 min_size = sizeof(struct trace_rec);
+   const u32 n_sizes = (TRACE_REC_MAX_SIZE - min_size) / TRACE_REC_ALIGN + 1;
+   char buf[TRACE_REC_MAX_SIZE] ALIGNED_AT(TRACE_REC_ALIGN);
+   struct trace_ring ring = {0};
+   struct trace_ring *r = &ring;
+   struct trace_rec *recs[3];
+   u32 sizes[3], pads = 0;
+   int k, seq = 0;
+
+   if (!(r->buf = kzmalloc(TRACE_RING_SIZE)))
+      panic("Unable to allocate the test trace ring");
+
+   kmutex_lock(&trace_read_lock);
+
+   for (u32 i = 0; r->head < 4 * TRACE_RING_SIZE; i++) {
+
+      k = 1 + (int)(i % 3);
+
+      for (int j = 0; j < k; j++) {
+
+         sizes[j] = min_size + ((i * 3 + (u32)j) * 11 % n_sizes) * 8;
+
+         if (((r->head + sizes[j] - 1) ^ r->head) & TRACE_RING_SIZE)
+            pads++;  /* this record will not fit before the end */
+
+         recs[j] = trace_ring_reserve(r, sizes[j]);
+         VERIFY(recs[j] != NULL);
+
+         memset((char *)recs[j] + 4, 0xff, sizes[j] - 4);
+         recs[j]->tid = seq + j;
+      }
+
+      /* Nothing committed yet, including the pad records */
+      VERIFY(trace_ring_read(r, buf, sizeof(buf)) == 0);
+
+      /* Commit in reverse order: the reader must stop at the first record */
+      for (int j = k - 1; j >= 0; j--) {
+         atomic_fetch_add_explicit(&r->nr_recs, 1, mo_relaxed);
+         trace_rec_commit(recs[j], sizes[j], (u8)te_sys_exit);
+
+         if (j > 0)
+            VERIFY(trace_ring_read(r, buf, sizeof(buf)) == 0);
+      }
+
+      for (int j = 0; j < k; j++) {
+         VERIFY(trace_ring_read(r, buf, sizeof(buf)) == (int)sizes[j]);
+         VERIFY(((struct trace_rec *)buf)->tid == seq++);
+      }
+
+      VERIFY(trace_ring_read(r, buf, sizeof(buf)) == 0);
+      VERIFY(r->nr_recs == 0);
+   }
+
+   kmutex_unlock(&trace_read_lock);
+
+   VERIFY(r->lost == 0);
+   VERIFY(pads > 0);
+
+   printk("records: %d, wrap-arounds: %u\n", seq, r->head / TRACE_RING_SIZE);
+   kfree2(r->buf, TRACE_RING_SIZE);
+   regular_self_test_end();
+}
@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/syscalls.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/self_tests.h>
+
+#include <tilck/mods/tracing.h>
+
+#include <fcntl.h>      // system header
+
+#define SE_TRACING_BATCH                                  1000
+#define SE_TRACING_ITERS                                    10
+
+static const char se_tracing_path[] = "/tmp/se_tracing_test_file";
+
+static void se_tracing_drain(void)
+{
+   struct trace_event e;
+   while (read_trace_event_noblock(&e)) { }
+}
+
+static void se_tracing_check_open_event(struct trace_event *e, int tid)
+{
+   const struct syscall_info *si = tracing_get_syscall_info(SYS_open);
+   char *buf;
+   size_t bs;
+
+   VERIFY(e->type == te_sys_exit);
+   VERIFY(e->sys == SYS_open);
+   VERIFY(e->tid == tid);
+   VERIFY(e->retval == -ENOENT);
+   VERIFY(e->args[0] == (ulong)se_tracing_path);
+   VERIFY(e->args[1] == O_RDONLY);
+
+   VERIFY(si != NULL);
+   VERIFY(tracing_get_slot(e, si, 0, &buf, &bs));
+   VERIFY(!strcmp(buf, se_tracing_path));
+}
+
+/*
+ * Measures the cost of tracing a syscall: saving its params, encoding the
+ * record and committing it in the trace buffer. Syscalls without saved params
+ * (getpid) and with a path param (open) are measured separately, along with
+ * the cost of reading back and decoding the events (consumer side).
+ */
+void selftest_tracing_perf_short(void)
+{
+   const int tid = get_curr_tid();
+   const u32 lost = tracing_get_lost_events_count();
+   u64 start, c_getpid = 0, c_open = 0, c_read = 0;
+   struct trace_event e;
+   int n = 0;
+
+   if (get_traced_tasks_count() > 0) {
+      printk("Skipping the test: other tasks are being traced\n");
+      regular_self_test_end();
+      return;
+   }
+
+   /* Discard any event already in the buffer */
+   se_tracing_drain();
+
+   for (int i = 0; i < SE_TRACING_ITERS; i++) {
+
+      start = RDTSC();
+
+      for (int j = 0; j < SE_TRACING_BATCH; j++)
+         trace_syscall_exit_int(SYS_getpid, tid, 0, 0, 0, 0, 0, 0);
+
+      c_getpid += RDTSC() - start;
+      VERIFY(tracing_get_in_buffer_events_count() == SE_TRACING_BATCH);
+
+      start = RDTSC();
+
+      for (int j = 0; j < SE_TRACING_BATCH; j++) {
+         VERIFY(read_trace_event_noblock(&e));
+         VERIFY(e.sys == SYS_getpid && e.retval == tid);
+      }
+
+      c_read += RDTSC() - start;
+      start = RDTSC();
+
+      for (int j = 0; j < SE_TRACING_BATCH; j++) {
+         trace_syscall_exit_int(SYS_open,
+                                -ENOENT,
+                                (ulong)se_tracing_path,
+                                O_RDONLY,
+                                0, 0, 0, 0);
+      }
+
+      c_open += RDTSC() - start;
+      VERIFY(tracing_get_in_buffer_events_count() == SE_TRACING_BATCH);
+
+      start = RDTSC();
+
+      for (int j = 0; j < SE_TRACING_BATCH; j++) {
+         VERIFY(read_trace_event_noblock(&e));
+         se_tracing_check_open_event(&e, tid);
+      }
+
+      c_read += RDTSC() - start;
+      n += SE_TRACING_BATCH;
+
+      if (se_is_stop_requested())
+         break;
+   }
+
+   VERIFY(!read_trace_event_noblock(&e));
+   VERIFY(tracing_get_lost_events_count() == lost);
+
+   printk("Tracing overhead, cycles per event:\n");
+   printk("    getpid() [no params]:   %6llu\n", c_getpid / (u64)n);
+   printk("    open()   [path param]:  %6llu\n", c_open / (u64)n);
+   printk("    read + decode:          %6llu\n", c_read / (u64)(2 * n));
+   regular_self_test_end();
+}
+
+/*
+ * Checks that enabling a static tracepoint really patches its sites (events
+ * appear in the trace buffer) and that disabling it restores the NOPs. Also,
+ * it measures the cost of kmalloc() + kfree() with and without the kmalloc
+ * tracepoint enabled.
+ */
+void selftest_tracepoints_short(void)
+{
+   u64 start, c_off, c_on;
+   struct trace_event e;
+   bool found = false;
+   int events = 0;
+   void *ptr;
+
+   if (get_traced_tasks_count() > 0 || get_enabled_tracepoints_count() > 0) {
+      printk("Skipping the test: tracing is in use\n");
+      regular_self_test_end();
+      return;
+   }
+
+   se_tracing_drain();
+   tracing_set_enabled(true);
+
+   start = RDTSC();
+
+   for (int i = 0; i < SE_TRACING_BATCH; i++) {
+      ptr = kmalloc(32);
+      VERIFY(ptr != NULL);
+      kfree2(ptr, 32);
+   }
+
+   c_off = RDTSC() - start;
+   VERIFY(tracing_get_in_buffer_events_count() == 0);
+
+   VERIFY(set_enabled_tracepoints("kmalloc") == 0);
+   VERIFY(get_enabled_tracepoints_count() == 1);
+
+   start = RDTSC();
+
+   for (int i = 0; i < SE_TRACING_BATCH; i++) {
+      ptr = kmalloc(32);
+      VERIFY(ptr != NULL);
+      kfree2(ptr, 32);
+   }
+
+   c_on = RDTSC() - start;
+
+   VERIFY(set_enabled_tracepoints("") == 0);
+   VERIFY(get_enabled_tracepoints_count() == 0);
+   tracing_set_enabled(false);
+
+   /* Other tasks might have called kmalloc() meanwhile: look for our event */
+   while (read_trace_event_noblock(&e)) {
+
+      events++;
+      VERIFY(e.type == te_kmalloc);
+
+      if (e.args[0] == 32 && e.args[1] == (ulong)ptr)
+         found = true;
+   }
+
+   VERIFY(found);
+   VERIFY(events >= SE_TRACING_BATCH);
+
+   printk("kmalloc() + kfree(), cycles:\n");
+   printk("    tracepoint off:   %6llu\n", c_off / SE_TRACING_BATCH);
+   printk("    tracepoint on:    %6llu\n", c_on / SE_TRACING_BATCH);
+   printk("    events:           %6d\n", events);
+   regular_self_test_end();
+}
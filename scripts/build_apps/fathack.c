@@ -2,7 +2,6 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/fat32_base.h>
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,7 +12,10 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include <tilck/common/lz4_compress.c.h>
+
 #define MAX_ACTIONS                                     3
+#define COMPR_CHUNK_SIZE                         (64 * KB)
 #define NO_ACTIONS()           { NULL, NULL, NULL, NULL }
 #define ACTIONS_1(a1)          {   a1, NULL, NULL, NULL }
 #define ACTIONS_2(a1, a2)      {   a1,   a2, NULL, NULL }
@@ -163,6 +165,111 @@ static int action_do_align(struct action_ctx *ctx)
    return 0;
 }
 
+static int action_do_compress(struct action_ctx *ctx)
+{
+   static u32 ht[LZ4_HASH_SIZE];
+
+   struct fat_hdr *hdr = ctx->vaddr;
+   const enum fat_type ft = fat_get_type(hdr);
+   const u32 bps = fat_get_sector_size(hdr);
+   const u32 cs = fat_get_cluster_size(hdr);
+   const u32 clu_count = fat_get_cluster_count(hdr);
+   const u32 bad_val = ft == fat16_type ? 0xFFF7 : 0x0FFFFFF7;
+   const u32 chunks = (used_bytes + COMPR_CHUNK_SIZE - 1) / COMPR_CHUNK_SIZE;
+   struct fat_compr_rd_info *info;
+   u32 data_size, data_off, first_clu, clu_needed;
+   u8 *buf;
+
+   if (ft != fat16_type && ft != fat32_type) {
+      fprintf(stderr, "FATAL ERROR: unsupported FAT type\n");
+      return 1;
+   }
+
+   if (fat_get_compr_rd_info(hdr)) {
+      fprintf(stderr, "FATAL ERROR: the fat part is already compressed\n");
+      return 1;
+   }
+
+   buf = malloc(chunks * (LZ4_CHUNK_HDR_SIZE +
+                          LZ4_COMPRESS_BOUND(COMPR_CHUNK_SIZE)));
+
+   if (!buf) {
+      fprintf(stderr, "FATAL ERROR: out of memory\n");
+      return 1;
+   }
+
+   data_size =
+      lz4_compress_chunked(hdr, used_bytes, buf, COMPR_CHUNK_SIZE, ht);
+
+   /*
+    * Put the compressed data in the first clusters entirely after the used
+    * bytes. Because of how fat_calculate_used_bytes() works, they are all
+    * free clusters.
+    */
+   first_clu = 2;
+
+   while (fat_get_sector_for_cluster(hdr, first_clu) * bps < used_bytes)
+      first_clu++;
+
+   clu_needed = (data_size + cs - 1) / cs;
+   data_off = fat_get_sector_for_cluster(hdr, first_clu) * bps;
+
+   if (first_clu + clu_needed > clu_count + 2) {
+      fprintf(stderr, "FATAL ERROR: no space for the compressed data\n");
+      free(buf);
+      return 1;
+   }
+
+   if (action_munmap(ctx) < 0)
+      goto err;
+
+   if (ftruncate(ctx->fd, data_off + clu_needed * cs) < 0) {
+      perror("ftruncate() failed");
+      goto err;
+   }
+
+   if (fstat(ctx->fd, &ctx->statbuf) < 0) {
+      perror("stat() failed");
+      goto err;
+   }
+
+   if (action_mmap(ctx) < 0)
+      goto err;
+
+   hdr = ctx->vaddr;
+   memcpy((char *)hdr + data_off, buf, data_size);
+   free(buf);
+
+   /* Mark the clusters as BAD, so that no FAT driver will ever use them */
+   for (u32 clu = first_clu; clu < first_clu + clu_needed; clu++)
+      for (u32 fatN = 0; fatN < hdr->BPB_NumFATs; fatN++)
+         fat_write_fat_entry(hdr, ft, fatN, clu, bad_val);
+
+   if (ft == fat32_type) {
+
+      /* Invalidate FSInfo's free cluster count: it's just a hint anyway */
+      struct fat32_header2 *h2 = (void *)(hdr + 1);
+
+      if (h2->BPB_FSInfo)
+         *(u32 *)((char *)hdr + h2->BPB_FSInfo * bps + 488) = 0xFFFFFFFF;
+   }
+
+   info = (void *)((char *)hdr + FAT_COMPR_RD_INFO_OFF);
+   memcpy(info->magic, FAT_COMPR_RD_MAGIC, sizeof(info->magic));
+   info->data_off = data_off;
+   info->data_size = data_size;
+   info->raw_size = used_bytes;
+   info->chunk_size = COMPR_CHUNK_SIZE;
+
+   printf("INFO: ramdisk compressed: %u -> %u bytes (%u%%)\n",
+          used_bytes, data_size, data_size * 100 / used_bytes);
+   return 0;
+
+err:
+   free(buf);
+   return 1;
+}
+
 struct action actions[] = {
 
    {
@@ -185,6 +292,13 @@ struct action actions[] = {
       ACTIONS_2(action_calc_used_bytes, action_do_align),
       NO_ACTIONS(),
    },
+
+   {
+      {"-z", "--compress"},
+      NO_ACTIONS(),
+      ACTIONS_2(action_calc_used_bytes, action_do_compress),
+      NO_ACTIONS(),
+   },
 };
 
 void show_help_and_exit(int argc, char **argv)
@@ -193,6 +307,7 @@ void show_help_and_exit(int argc, char **argv)
    printf("    %s -t, --truncate <fat part file>\n", argv[0]);
    printf("    %s -c, --calc_used_bytes <fat part file>\n", argv[0]);
    printf("    %s -a, --align_first_data_sector <fat part file>\n", argv[0]);
+   printf("    %s -z, --compress <fat part file>\n", argv[0]);
    exit(1);
 }
 
@@ -2,6 +2,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
+#include <tilck/common/string_util.h>
 
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/sync.h>
@@ -88,3 +89,150 @@ void selftest_kcond_short()
    kcond_destory(&cond);
    regular_self_test_end();
 }
+
+#define KCOND_SE_CONSUMERS          8
+#define KCOND_SE_ITEMS             64
+
+/*
+ * A simple producer/consumers queue: KCOND_SE_CONSUMERS threads wait for
+ * items on the same kcond, plus one extra thread waiting for a different
+ * event (KCOND_KEY_WRITE) on the same kcond. We count the wake-ups that found
+ * nothing to do: with signal_all() they're the majority, while with targeted
+ * wake-ups they should be (almost) zero.
+ */
+static struct {
+
+   struct kmutex m;
+   struct kcond c;
+   bool broadcast;
+   bool done;
+   int items;
+   int consumed;
+   int wakeups;
+   int spurious;
+   int writer_wakeups;
+
+} kq;
+
+static void kcond_se_consumer(void *unused)
+{
+   kmutex_lock(&kq.m);
+
+   while (true) {
+
+      while (!kq.items && !kq.done) {
+
+         kcond_wait_key(&kq.c,
+                        &kq.m,
+                        KCOND_WAIT_FOREVER,
+                        KCOND_KEY_READ | KCOND_KEY_HUP);
+
+         kq.wakeups++;
+
+         if (!kq.items && !kq.done)
+            kq.spurious++;
+      }
+
+      if (!kq.items)
+         break; /* done */
+
+      kq.items--;
+      kq.consumed++;
+
+      /* Simulate some work on the item */
+      kmutex_unlock(&kq.m);
+      kernel_yield();
+      kmutex_lock(&kq.m);
+   }
+
+   kmutex_unlock(&kq.m);
+}
+
+static void kcond_se_writer(void *unused)
+{
+   kmutex_lock(&kq.m);
+
+   while (!kq.done) {
+
+      kcond_wait_key(&kq.c, &kq.m, KCOND_WAIT_FOREVER, KCOND_KEY_WRITE);
+      kq.writer_wakeups++;
+
+      if (!kq.done)
+         kq.spurious++;
+   }
+
+   kmutex_unlock(&kq.m);
+}
+
+static void kcond_se_producer(void *unused)
+{
+   /* Give the consumers the time to block on the kcond */
+   kernel_sleep(TIMER_HZ / 10);
+
+   for (int i = 0; i < KCOND_SE_ITEMS; i++) {
+
+      kmutex_lock(&kq.m);
+      {
+         kq.items++;
+
+         if (kq.broadcast)
+            kcond_signal_all(&kq.c);
+         else
+            kcond_signal_key_one(&kq.c, KCOND_KEY_READ);
+      }
+      kmutex_unlock(&kq.m);
+      kernel_sleep(1);
+   }
+
+   kmutex_lock(&kq.m);
+   {
+      kq.done = true;
+      kcond_signal_key_all(&kq.c, KCOND_KEY_HUP | KCOND_KEY_WRITE);
+   }
+   kmutex_unlock(&kq.m);
+}
+
+static int kcond_se_run_queue(bool broadcast)
+{
+   int tids[KCOND_SE_CONSUMERS + 2];
+
+   bzero(&kq, sizeof(kq));
+   kmutex_init(&kq.m, 0);
+   kcond_init(&kq.c);
+   kq.broadcast = broadcast;
+
+   for (int i = 0; i < KCOND_SE_CONSUMERS; i++) {
+      tids[i] = kthread_create(&kcond_se_consumer, 0, NULL);
+      VERIFY(tids[i] > 0);
+   }
+
+   tids[KCOND_SE_CONSUMERS] = kthread_create(&kcond_se_writer, 0, NULL);
+   VERIFY(tids[KCOND_SE_CONSUMERS] > 0);
+
+   tids[KCOND_SE_CONSUMERS + 1] = kthread_create(&kcond_se_producer, 0, NULL);
+   VERIFY(tids[KCOND_SE_CONSUMERS + 1] > 0);
+
+   kthread_join_all(tids, ARRAY_SIZE(tids));
+
+   printk("[kcond excl] %s: wake-ups: %d, spurious: %d\n",
+          broadcast ? "signal_all" : "signal_key_one",
+          kq.wakeups + kq.writer_wakeups, kq.spurious);
+
+   VERIFY(kq.consumed == KCOND_SE_ITEMS);
+   VERIFY(!kcond_is_anyone_waiting(&kq.c));
+
+   kcond_destory(&kq.c);
+   kmutex_destroy(&kq.m);
+   return kq.spurious;
+}
+
+void selftest_kcond_excl_short()
+{
+   int herd = kcond_se_run_queue(true);
+   int targeted = kcond_se_run_queue(false);
+
+   /* The writer must have been woken up only by the final signal */
+   VERIFY(kq.writer_wakeups == 1);
+   VERIFY(targeted < herd);
+   regular_self_test_end();
+}
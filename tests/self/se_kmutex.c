@@ -4,6 +4,7 @@
 #include <tilck/common/printk.h>
 #include <tilck/common/utils.h>
 
+#include <tilck/kernel/hal.h>
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/debug_utils.h>
@@ -333,3 +334,174 @@ void selftest_kmutex_ord_med()
    kmutex_destroy(&test_mutex);
    regular_self_test_end();
 }
+
+/* -------------------------------------------------- */
+/*               Contention benchmarks                */
+/* -------------------------------------------------- */
+
+#define KMUTEX_PERF_THREADS           4
+#define KMUTEX_PERF_ITERS         20000
+#define KMUTEX_PERF_WORK            200
+
+static ATOMIC(u32) kmutex_perf_counter;
+
+static NO_INLINE void kmutex_perf_work(void)
+{
+   for (int i = 0; i < KMUTEX_PERF_WORK; i++)
+      atomic_fetch_add_explicit(&kmutex_perf_counter, 1, mo_relaxed);
+}
+
+static void kmutex_perf_th(void *unused)
+{
+   for (int i = 0; i < KMUTEX_PERF_ITERS; i++) {
+
+      kmutex_lock(&test_mutex);
+      {
+         /* A short critical section, which might get preempted anyway */
+         kmutex_perf_work();
+      }
+      kmutex_unlock(&test_mutex);
+      kmutex_perf_work();
+   }
+}
+
+static u64 kmutex_perf_run(u32 flags)
+{
+   int local_tids[KMUTEX_PERF_THREADS];
+   u64 start, duration;
+
+   kmutex_init(&test_mutex, flags);
+   start = RDTSC();
+
+   for (int i = 0; i < KMUTEX_PERF_THREADS; i++) {
+      local_tids[i] = kthread_create(&kmutex_perf_th, 0, NULL);
+      VERIFY(local_tids[i] > 0);
+   }
+
+   kthread_join_all(local_tids, ARRAY_SIZE(local_tids));
+   duration = RDTSC() - start;
+   kmutex_destroy(&test_mutex);
+
+   return duration / (KMUTEX_PERF_THREADS * KMUTEX_PERF_ITERS);
+}
+
+void selftest_kmutex_perf_med()
+{
+   const int iters = 100000;
+   u64 start, duration;
+
+   kmutex_init(&test_mutex, 0);
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++) {
+      kmutex_lock(&test_mutex);
+      kmutex_unlock(&test_mutex);
+   }
+
+   duration = RDTSC() - start;
+   kmutex_destroy(&test_mutex);
+
+   printk("uncontended lock + unlock: %llu cycles\n", duration / iters);
+   printk("contended, sleeping: %llu cycles/iter\n", kmutex_perf_run(0));
+   printk("contended, adaptive: %llu cycles/iter\n",
+          kmutex_perf_run(KMUTEX_FL_ADAPTIVE));
+
+   regular_self_test_end();
+}
+
+/* -------------------------------------------------- */
+/*               Priority inheritance test            */
+/* -------------------------------------------------- */
+
+/*
+ * A chain of three threads: `low2` holds M2, `low` holds M1 and waits on M2,
+ * while `high` waits on M1. Because of priority inheritance, both `low` and
+ * `low2` must run with the priority of `high`, until they release the locks.
+ */
+
+#define PI_NICE_HIGH                -10
+#define PI_NICE_LOW                  10
+#define PI_NICE_LOW2                 15
+
+static struct kmutex pi_m1, pi_m2;
+
+static void kmutex_pi_low2(void *unused)
+{
+   struct task *curr = get_curr_task();
+   sched_set_task_prio(curr, NICE_TO_PRIO(PI_NICE_LOW2));
+
+   kmutex_lock(&pi_m2);
+   {
+      /* Wait for `high` to block on M1 */
+      while (list_is_empty(&pi_m1.wait_list))
+         kernel_yield();
+
+      VERIFY(curr->prio == NICE_TO_PRIO(PI_NICE_HIGH));
+   }
+   kmutex_unlock(&pi_m2);
+
+   VERIFY(curr->prio == NICE_TO_PRIO(PI_NICE_LOW2));
+}
+
+static void kmutex_pi_low(void *unused)
+{
+   struct task *curr = get_curr_task();
+   sched_set_task_prio(curr, NICE_TO_PRIO(PI_NICE_LOW));
+
+   kmutex_lock(&pi_m1);
+   {
+      while (!pi_m2.owner_task)
+         kernel_yield();
+
+      kmutex_lock(&pi_m2);
+      {
+         VERIFY(curr->prio == NICE_TO_PRIO(PI_NICE_HIGH));
+      }
+      kmutex_unlock(&pi_m2);
+
+      /* Still holding M1, with `high` waiting on it: still boosted */
+      VERIFY(curr->prio == NICE_TO_PRIO(PI_NICE_HIGH));
+   }
+   kmutex_unlock(&pi_m1);
+
+   VERIFY(curr->prio == NICE_TO_PRIO(PI_NICE_LOW));
+}
+
+static void kmutex_pi_high(void *unused)
+{
+   struct task *curr = get_curr_task();
+   sched_set_task_prio(curr, NICE_TO_PRIO(PI_NICE_HIGH));
+
+   /* Wait for `low` to block on M2, while holding M1 */
+   while (list_is_empty(&pi_m2.wait_list))
+      kernel_yield();
+
+   kmutex_lock(&pi_m1);
+   {
+      VERIFY(curr->prio == NICE_TO_PRIO(PI_NICE_HIGH));
+   }
+   kmutex_unlock(&pi_m1);
+}
+
+void selftest_kmutex_pi_short()
+{
+   int local_tids[3];
+
+   kmutex_init(&pi_m1, 0);
+   kmutex_init(&pi_m2, 0);
+
+   local_tids[0] = kthread_create(&kmutex_pi_low2, 0, NULL);
+   VERIFY(local_tids[0] > 0);
+
+   local_tids[1] = kthread_create(&kmutex_pi_low, 0, NULL);
+   VERIFY(local_tids[1] > 0);
+
+   local_tids[2] = kthread_create(&kmutex_pi_high, 0, NULL);
+   VERIFY(local_tids[2] > 0);
+
+   kthread_join_all(local_tids, ARRAY_SIZE(local_tids));
+
+   kmutex_destroy(&pi_m2);
+   kmutex_destroy(&pi_m1);
+   regular_self_test_end();
+}
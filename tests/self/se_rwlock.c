@@ -3,6 +3,7 @@
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
 
+#include <tilck/kernel/hal.h>
 #include <tilck/kernel/rwlock.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/sync.h>
@@ -17,6 +18,7 @@
 
 static struct rwlock_rp test_rwlrp;
 static struct rwlock_wp test_rwlwp;
+static struct rwlock_rb test_rwlrb;
 
 static int se_rwlock_vars[3];
 static const int se_rwlock_set_1[3] = {1, 2, 3};
@@ -51,6 +53,19 @@ static struct se_rwlock_ctx se_wp_ctx =
    .arg = (void *) &test_rwlwp,
 };
 
+/* The read side of rwlock_rb is inline: wrap it */
+static void se_rb_shlock(void *arg) { rwlock_rb_shlock(arg); }
+static void se_rb_shunlock(void *arg) { rwlock_rb_shunlock(arg); }
+
+static struct se_rwlock_ctx se_rb_ctx =
+{
+   .shlock = se_rb_shlock,
+   .shunlock = se_rb_shunlock,
+   .exlock = (void *) rwlock_rb_exlock,
+   .exunlock = (void *) rwlock_rb_exunlock,
+   .arg = (void *) &test_rwlrb,
+};
+
 
 static void se_rwlock_set_vars(const int *set)
 {
@@ -246,3 +261,121 @@ void selftest_rwlock_wp_med()
    rwlock_wp_destroy(&test_rwlwp);
    regular_self_test_end();
 }
+
+void selftest_rwlock_rb_med()
+{
+   int rt[RWLOCK_READERS];
+   int wt[RWLOCK_WRITERS];
+
+   readers_running = writers_running = 0;
+   rwlock_rb_init(&test_rwlrb, true);
+
+   /* Recursive exlock, then check that readers can get the lock again */
+   rwlock_rb_exlock(&test_rwlrb);
+   rwlock_rb_exlock(&test_rwlrb);
+   VERIFY(test_rwlrb.rc == 2);
+   rwlock_rb_exunlock(&test_rwlrb);
+   VERIFY(test_rwlrb.ex_owner == get_curr_task());
+   rwlock_rb_exunlock(&test_rwlrb);
+   VERIFY(test_rwlrb.ex_owner == NULL);
+
+   rwlock_rb_shlock(&test_rwlrb);
+   rwlock_rb_shlock(&test_rwlrb);
+   VERIFY(atomic_load_explicit(&test_rwlrb.cnt, mo_relaxed) == 2);
+   rwlock_rb_shunlock(&test_rwlrb);
+   rwlock_rb_shunlock(&test_rwlrb);
+
+   /*
+    * Readers and writers mixed: the checks in the threads verify that readers
+    * never see a half-written set and that writers are exclusive. No ordering
+    * is expected between readers and writers woken up by a writer leaving.
+    */
+   se_rwlock_common(rt, wt, &se_rb_ctx);
+   kthread_join_all(wt, ARRAY_SIZE(wt));
+   kthread_join_all(rt, ARRAY_SIZE(rt));
+
+   VERIFY(atomic_load_explicit(&test_rwlrb.cnt, mo_relaxed) == 0);
+   rwlock_rb_destroy(&test_rwlrb);
+   regular_self_test_end();
+}
+
+/* -------------------------------------------------- */
+/*               Throughput benchmarks                */
+/* -------------------------------------------------- */
+
+#define RWLOCK_PERF_THREADS           8
+#define RWLOCK_PERF_ITERS         20000
+#define RWLOCK_PERF_WRITE_EVERY    1000     /* for the read-mostly workload */
+
+static int rwlock_perf_write_every;
+
+static void rwlock_perf_th(void *arg)
+{
+   struct se_rwlock_ctx *ctx = arg;
+   const int write_every = rwlock_perf_write_every;
+
+   for (int i = 0; i < RWLOCK_PERF_ITERS; i++) {
+
+      if (write_every && (i % write_every) == 0) {
+
+         ctx->exlock(ctx->arg);
+         {
+            se_rwlock_vars[1]++;
+            se_rwlock_vars[2]++;
+         }
+         ctx->exunlock(ctx->arg);
+         continue;
+      }
+
+      ctx->shlock(ctx->arg);
+      {
+         /* Reading while other readers get preempted in here */
+         VERIFY(se_rwlock_vars[1] == se_rwlock_vars[2]);
+      }
+      ctx->shunlock(ctx->arg);
+   }
+}
+
+static u64 rwlock_perf_run(struct se_rwlock_ctx *ctx, int write_every)
+{
+   int tids[RWLOCK_PERF_THREADS];
+   u64 start, duration;
+
+   rwlock_perf_write_every = write_every;
+   start = RDTSC();
+
+   for (int i = 0; i < RWLOCK_PERF_THREADS; i++) {
+      tids[i] = kthread_create(&rwlock_perf_th, 0, ctx);
+      VERIFY(tids[i] > 0);
+   }
+
+   kthread_join_all(tids, ARRAY_SIZE(tids));
+   duration = RDTSC() - start;
+   return duration / (RWLOCK_PERF_THREADS * RWLOCK_PERF_ITERS);
+}
+
+static void rwlock_perf_all(const char *name, struct se_rwlock_ctx *ctx)
+{
+   printk("%s: read-only: %llu cycles/iter, read-mostly: %llu cycles/iter\n",
+          name,
+          rwlock_perf_run(ctx, 0),
+          rwlock_perf_run(ctx, RWLOCK_PERF_WRITE_EVERY));
+}
+
+void selftest_rwlock_perf_med()
+{
+   se_rwlock_vars[1] = se_rwlock_vars[2] = 0;
+
+   rwlock_rp_init(&test_rwlrp);
+   rwlock_wp_init(&test_rwlwp, false);
+   rwlock_rb_init(&test_rwlrb, false);
+
+   rwlock_perf_all("rwlock_rp", &se_rp_ctx);
+   rwlock_perf_all("rwlock_wp", &se_wp_ctx);
+   rwlock_perf_all("rwlock_rb", &se_rb_ctx);
+
+   rwlock_rb_destroy(&test_rwlrb);
+   rwlock_wp_destroy(&test_rwlwp);
+   rwlock_rp_destroy(&test_rwlrp);
+   regular_self_test_end();
+}
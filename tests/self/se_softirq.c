@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/softirq.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/self_tests.h>
+
+#define FLOOD_BURSTS                 50
+#define FLOOD_BURST_SIZE            500
+#define FLOOD_BUDGET                 32
+
+/*
+ * An IRQ flood: the "top half" just counts an event and raises the soft IRQ,
+ * while the handler consumes the events, at most FLOOD_BUDGET per run.
+ */
+
+static u32 flood_produced;
+static u32 flood_consumed;
+static u32 flood_max_per_run;
+
+static bool se_flood_handler(void *ctx, u32 budget)
+{
+   u32 n = 0;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      while (n < budget && flood_consumed < flood_produced) {
+         flood_consumed++;
+         n++;
+      }
+   }
+   enable_interrupts(&var);
+
+   flood_max_per_run = MAX(flood_max_per_run, n);
+   return flood_consumed < flood_produced;
+}
+
+static void se_flood_top_half(int nr)
+{
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      flood_produced++;
+   }
+   enable_interrupts(&var);
+
+   softirq_raise(nr);
+}
+
+void selftest_softirq_flood_short(void)
+{
+   const u32 tot = FLOOD_BURSTS * FLOOD_BURST_SIZE;
+   struct softirq_stats st;
+   u64 start;
+   int nr;
+
+   flood_produced = flood_consumed = flood_max_per_run = 0;
+   nr = softirq_register("selftest", &se_flood_handler, NULL, FLOOD_BUDGET);
+   VERIFY(nr >= 0);
+
+   for (int b = 0; b < FLOOD_BURSTS; b++) {
+
+      /* Like in IRQ context, the soft IRQ cannot run during the burst */
+      disable_preemption();
+      {
+         for (int i = 0; i < FLOOD_BURST_SIZE; i++)
+            se_flood_top_half(nr);
+      }
+      enable_preemption();
+   }
+
+   /*
+    * Wait for the backlog to be drained. Sleeping requires the timer soft IRQ
+    * to run as well: the flood must not starve it.
+    */
+   start = get_ticks();
+
+   while (flood_consumed < flood_produced) {
+      VERIFY(get_ticks() - start < 5 * TIMER_HZ);
+      kernel_sleep(1);
+   }
+
+   VERIFY(softirq_get_stats(nr, &st));
+   softirq_unregister(nr);
+
+   printk("events: %u, raised: %u, coalesced: %u\n",
+          flood_produced, st.raised, st.coalesced);
+   printk("runs: %u, over budget: %u, max events per run: %u\n",
+          st.runs, st.over_budget, flood_max_per_run);
+
+   VERIFY(flood_produced == tot);
+   VERIFY(flood_consumed == tot);
+   VERIFY(st.raised == tot);
+
+   /* Each burst gets coalesced, and then split in budget-sized runs */
+   VERIFY(st.coalesced >= tot - FLOOD_BURSTS);
+   VERIFY(st.runs <= tot / FLOOD_BUDGET + 2 * FLOOD_BURSTS);
+   VERIFY(st.over_budget > 0);
+   VERIFY(flood_max_per_run <= FLOOD_BUDGET);
+
+   regular_self_test_end();
+}
+
+/*
+ * A soft IRQ that always has more work to do must not hold its thread
+ * forever: the work items queued there have to run as well.
+ */
+
+static volatile bool endless_stop;
+
+static bool se_endless_handler(void *ctx, u32 budget)
+{
+   return !endless_stop;
+}
+
+static void se_endless_stop_work(void *arg)
+{
+   endless_stop = true;
+}
+
+void selftest_softirq_restart_short(void)
+{
+   struct wth_work w;
+   u64 start;
+   int nr;
+
+   endless_stop = false;
+   wth_work_init(&w, &se_endless_stop_work, NULL);
+   nr = softirq_register("selftest", &se_endless_handler, NULL, 1);
+   VERIFY(nr >= 0);
+
+   disable_preemption();
+   {
+      softirq_raise(nr);
+      VERIFY(softirq_queue_work(&w));
+   }
+   enable_preemption();
+
+   start = get_ticks();
+
+   while (!endless_stop) {
+      VERIFY(get_ticks() - start < 5 * TIMER_HZ);
+      kernel_sleep(1);
+   }
+
+   softirq_unregister(nr);
+   regular_self_test_end();
+}
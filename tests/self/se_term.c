@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/color_defs.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/term.h>
+#include <tilck/kernel/self_tests.h>
+
+static u64 term_perf_write_lines(const char *line, int lines)
+{
+   const size_t len = strlen(line);
+   u64 start = RDTSC();
+
+   for (int i = 0; i < lines; i++)
+      term_write(line, len, DEFAULT_COLOR16);
+
+   return RDTSC() - start;
+}
+
+void selftest_term_write_perf_short(void)
+{
+   static const char plain_line[] =
+      "The quick brown fox jumps over the lazy dog. "
+      "0123456789 ABCDEFGHIJKLMNOPQRSTUVWXYZ\n";
+
+   /* Same text, broken by escape sequences every few chars */
+   static const char esc_line[] =
+      "The quick \033[1mbrown\033[0m fox \033[32mjumps\033[0m over "
+      "the \033[33mlazy\033[0m dog. 0123456789 \033[7mABCDEFGHIJ\033[0m"
+      "KLMNOPQRSTUVWXYZ\n";
+
+   const int lines = 500;
+   u64 plain, esc;
+
+   if (get_curr_term_intf()->get_type() != term_type_video) {
+      printk("term_write_perf: not a video term, skipping the test\n");
+      regular_self_test_end();
+      return;
+   }
+
+   plain = term_perf_write_lines(plain_line, lines);
+   esc = term_perf_write_lines(esc_line, lines);
+
+   printk("term_write_perf: plain text: %llu cycles/byte\n",
+          plain / (lines * (sizeof(plain_line) - 1)));
+
+   printk("term_write_perf: with escape seqs: %llu cycles/byte\n",
+          esc / (lines * (sizeof(esc_line) - 1)));
+
+   regular_self_test_end();
+}
+
+void selftest_term_scroll_perf_short(void)
+{
+   const int lines = 1000;
+   u64 duration;
+
+   if (get_curr_term_intf()->get_type() != term_type_video) {
+      printk("term_scroll_perf: not a video term, skipping the test\n");
+      regular_self_test_end();
+      return;
+   }
+
+   /* Almost empty lines: the cost is dominated by scrolling */
+   duration = term_perf_write_lines("x\n", lines);
+
+   printk("term_scroll_perf: %llu cycles per scrolled line\n",
+          duration / lines);
+
+   regular_self_test_end();
+}
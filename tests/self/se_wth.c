@@ -10,6 +10,7 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/self_tests.h>
+#include <tilck/kernel/timer.h>
 
 static ATOMIC(u32) g_counter;
 static u64 g_cycles_begin;
@@ -181,3 +182,122 @@ void selftest_wth_perf_short(void)
    printk("Avg. job enqueue cycles: %llu [%i jobs]\n", elapsed/n, n);
    regular_self_test_end();
 }
+
+/* -------------------------------------------------- */
+/*                    Work items                      */
+/* -------------------------------------------------- */
+
+#define SE_WORKS_COUNT                             200
+
+static struct wth_work se_works[SE_WORKS_COUNT];
+static ATOMIC(u32) se_works_runs;
+static u64 se_work_run_ticks;
+static ATOMIC(bool) se_long_job_started;
+static ATOMIC(bool) se_long_job_done;
+
+static void se_work_func(void *arg)
+{
+   se_works_runs++;
+}
+
+static void se_delayed_work_func(void *arg)
+{
+   se_work_run_ticks = get_ticks();
+   se_works_runs++;
+}
+
+static void se_long_work_func(void *arg)
+{
+   const u64 end = get_ticks() + 3 * WTH_LONG_JOB_TICKS;
+   se_long_job_started = true;
+
+   while (get_ticks() < end) {
+      /* burn the CPU, with preemption enabled */
+   }
+
+   se_long_job_done = true;
+}
+
+static void se_works_wait(u32 expected_runs)
+{
+   const u64 start = get_ticks();
+
+   while (se_works_runs < expected_runs) {
+      VERIFY(get_ticks() - start < 10 * TIMER_HZ);
+      kernel_sleep(1);
+   }
+}
+
+void selftest_wth_work_short(void)
+{
+   const u32 n = MIN((u32)SE_WORKS_COUNT, 4 * wth_get_queue_size(0));
+   struct wth_work long_work;
+   u64 start;
+
+   /* Far more work items than the job queue can hold, all queued at once */
+   se_works_runs = 0;
+   disable_preemption();
+   {
+      for (u32 i = 0; i < n; i++) {
+         wth_work_init(&se_works[i], &se_work_func, NULL);
+         VERIFY(wth_queue_work(0, &se_works[i]));
+      }
+   }
+   enable_preemption();
+   se_works_wait(n);
+   printk("[se_wth] %u work items run\n", n);
+
+   /* The same work item queued many times runs just once */
+   se_works_runs = 0;
+   disable_preemption();
+   {
+      VERIFY(wth_queue_work(0, &se_works[0]));
+
+      for (u32 i = 0; i < n; i++)
+         VERIFY(!wth_queue_work(0, &se_works[0]));
+   }
+   enable_preemption();
+   se_works_wait(1);
+   kernel_sleep(2);
+   VERIFY(se_works_runs == 1);
+
+   /* Delayed work item: it must not run before its time */
+   se_works_runs = 0;
+   wth_work_init(&se_works[0], &se_delayed_work_func, NULL);
+   start = get_ticks();
+   VERIFY(wth_queue_delayed_work(0, &se_works[0], 5));
+   se_works_wait(1);
+   printk("[se_wth] delayed work: 5 ticks, run after %llu\n",
+          se_work_run_ticks - start);
+   VERIFY(se_work_run_ticks - start >= 5);
+
+   /* A cancelled delayed work item never runs */
+   se_works_runs = 0;
+   VERIFY(wth_queue_delayed_work(0, &se_works[0], 2));
+   VERIFY(wth_cancel_work(&se_works[0]));
+   VERIFY(!wth_cancel_work(&se_works[0]));
+   kernel_sleep(5);
+   VERIFY(se_works_runs == 0);
+
+   /*
+    * A long job: the work items queued behind it must migrate to the helper
+    * thread and complete before the long job does.
+    */
+   se_works_runs = 0;
+   se_long_job_started = se_long_job_done = false;
+   wth_work_init(&long_work, &se_long_work_func, NULL);
+   wth_work_init(&se_works[0], &se_work_func, NULL);
+   VERIFY(wth_queue_work(0, &long_work));
+
+   while (!se_long_job_started)
+      kernel_sleep(1);
+
+   VERIFY(wth_queue_work(0, &se_works[0]));
+   se_works_wait(1);
+   VERIFY(!se_long_job_done);
+
+   while (!se_long_job_done)
+      kernel_sleep(1);
+
+   regular_self_test_end();
+}
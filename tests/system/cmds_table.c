@@ -17,6 +17,9 @@ DECL_CMD(bad_read);
 DECL_CMD(bad_write);
 DECL_CMD(fork_perf);
 DECL_CMD(vfork_perf);
+DECL_CMD(fork_storm);
+DECL_CMD(fork_exit);
+DECL_CMD(spawn_perf);
 DECL_CMD(syscall_perf);
 DECL_CMD(fpu);
 DECL_CMD(fpu_loop);
@@ -36,6 +39,7 @@ DECL_CMD(sigill);
 DECL_CMD(sigfpe);
 DECL_CMD(sigabrt);
 DECL_CMD(sig1);
+DECL_CMD(pgrp_lat);
 DECL_CMD(select1);
 DECL_CMD(select2);
 DECL_CMD(select3);
@@ -59,8 +63,21 @@ DECL_CMD(fmmap4);
 DECL_CMD(fmmap5);
 DECL_CMD(fmmap6);
 DECL_CMD(fmmap7);
+DECL_CMD(fadvise1);
+DECL_CMD(fstatat1);
+DECL_CMD(lsr_perf);
+DECL_CMD(prof1);
+DECL_CMD(procfs1);
+DECL_CMD(rusage1);
+DECL_CMD(sched_rt1);
+DECL_CMD(sched_rt2);
+DECL_CMD(sched_rt3);
+DECL_CMD(serial_perf);
+DECL_CMD(kmsg1);
 DECL_CMD(fs_perf1);
 DECL_CMD(fs_perf2);
+DECL_CMD(pio1);
+DECL_CMD(pio_perf);
 DECL_CMD(pipe1);
 DECL_CMD(pipe2);
 DECL_CMD(pipe3);
@@ -87,6 +104,9 @@ static struct test_cmd_entry _cmds_table[] =
    CMD_ENTRY(bad_write,    TT_SHORT,  true),
    CMD_ENTRY(fork_perf,    TT_LONG,   true),
    CMD_ENTRY(vfork_perf,   TT_LONG,   true),
+   CMD_ENTRY(fork_storm,   TT_MED,    true),
+   CMD_ENTRY(fork_exit,    TT_SHORT,  true),
+   CMD_ENTRY(spawn_perf,   TT_MED,    true),
    CMD_ENTRY(syscall_perf, TT_SHORT,  true),
    CMD_ENTRY(fpu,          TT_SHORT,  true),
    CMD_ENTRY(fpu_loop,     TT_LONG,  false),
@@ -106,6 +126,7 @@ static struct test_cmd_entry _cmds_table[] =
    CMD_ENTRY(sigfpe,       TT_SHORT,  true),
    CMD_ENTRY(sigabrt,      TT_SHORT,  true),
    CMD_ENTRY(sig1,         TT_SHORT,  true),
+   CMD_ENTRY(pgrp_lat,     TT_MED,    true),
    CMD_ENTRY(bigargv,      TT_SHORT,  true),
    CMD_ENTRY(cloexec,      TT_SHORT,  true),
    CMD_ENTRY(fs1,          TT_SHORT,  true),
@@ -117,6 +138,8 @@ static struct test_cmd_entry _cmds_table[] =
    CMD_ENTRY(fs7,          TT_SHORT,  true),
    CMD_ENTRY(fs_perf1,     TT_SHORT,  true),
    CMD_ENTRY(fs_perf2,     TT_SHORT,  true),
+   CMD_ENTRY(pio1,         TT_SHORT,  true),
+   CMD_ENTRY(pio_perf,     TT_SHORT,  true),
    CMD_ENTRY(fmmap1,       TT_SHORT,  true),
    CMD_ENTRY(fmmap2,       TT_SHORT,  true),
    CMD_ENTRY(fmmap3,       TT_SHORT,  true),
@@ -124,6 +147,17 @@ static struct test_cmd_entry _cmds_table[] =
    CMD_ENTRY(fmmap5,       TT_SHORT,  true),
    CMD_ENTRY(fmmap6,       TT_SHORT,  true),
    CMD_ENTRY(fmmap7,       TT_SHORT,  true),
+   CMD_ENTRY(fadvise1,     TT_SHORT,  true),
+   CMD_ENTRY(fstatat1,     TT_SHORT,  true),
+   CMD_ENTRY(lsr_perf,     TT_MED,    true),
+   CMD_ENTRY(prof1,        TT_SHORT,  true),
+   CMD_ENTRY(procfs1,      TT_SHORT,  true),
+   CMD_ENTRY(rusage1,      TT_SHORT,  true),
+   CMD_ENTRY(sched_rt1,    TT_SHORT,  true),
+   CMD_ENTRY(sched_rt2,    TT_SHORT,  true),
+   CMD_ENTRY(sched_rt3,    TT_SHORT,  true),
+   CMD_ENTRY(serial_perf,  TT_SHORT,  true),
+   CMD_ENTRY(kmsg1,        TT_SHORT,  true),
    CMD_ENTRY(pipe1,        TT_SHORT,  true),
    CMD_ENTRY(pipe2,        TT_SHORT,  true),
    CMD_ENTRY(pipe3,        TT_SHORT,  true),
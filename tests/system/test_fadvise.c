@@ -0,0 +1,146 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+static const char fadvise_test_file[] = "/tmp/fadvise_test";
+
+/*
+ * Reads one byte per page of the memory-mapped file `fd` and returns the
+ * number of page faults that took, or 0 when not running on Tilck.
+ */
+static int
+fadvise_mmap_read_all(int fd, size_t file_size, int advice, bool willneed)
+{
+   const size_t page_size = getpagesize();
+   int faults = 0;
+   char *vaddr;
+   int rc, sum = 0;
+
+   rc = posix_fadvise(fd, 0, 0, advice);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   vaddr = mmap(NULL,                   /* addr */
+                file_size,              /* length */
+                PROT_READ | PROT_WRITE, /* prot */
+                MAP_SHARED,             /* flags */
+                fd,                     /* fd */
+                0);                     /* offset */
+
+   DEVSHELL_CMD_ASSERT(vaddr != (void *)-1);
+
+   if (willneed) {
+      rc = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   if (running_on_tilck())
+      faults = tilck_get_faults_cnt();
+
+   for (size_t off = 0; off < file_size; off += page_size)
+      sum += vaddr[off];
+
+   if (running_on_tilck())
+      faults = tilck_get_faults_cnt() - faults;
+
+   DEVSHELL_CMD_ASSERT(sum == 0);
+   rc = munmap(vaddr, file_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return faults;
+}
+
+/* mmap a sparse file and count the page faults, with different fadvise() */
+int cmd_fadvise1(int argc, char **argv)
+{
+   const size_t page_size = getpagesize();
+   const size_t file_size = 1 * MB;
+   const int pages = (int)(file_size / page_size);
+   int fd, rc, pipefd[2];
+   int f_normal, f_random, f_seq, f_willneed;
+   char *vaddr, buf[16];
+
+   fd = open(fadvise_test_file, O_CREAT | O_RDWR, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   rc = ftruncate(fd, file_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   f_normal = fadvise_mmap_read_all(fd, file_size, POSIX_FADV_NORMAL, false);
+   f_random = fadvise_mmap_read_all(fd, file_size, POSIX_FADV_RANDOM, false);
+   f_seq = fadvise_mmap_read_all(fd, file_size, POSIX_FADV_SEQUENTIAL, false);
+   f_willneed = fadvise_mmap_read_all(fd, file_size, POSIX_FADV_NORMAL, true);
+
+   if (running_on_tilck()) {
+
+      printf("Page faults reading %d pages:\n", pages);
+      printf("    POSIX_FADV_NORMAL:     %d\n", f_normal);
+      printf("    POSIX_FADV_RANDOM:     %d\n", f_random);
+      printf("    POSIX_FADV_SEQUENTIAL: %d\n", f_seq);
+      printf("    POSIX_FADV_WILLNEED:   %d\n", f_willneed);
+
+      /* Allow a couple of extra faults, for the CoW pages of our stack */
+      DEVSHELL_CMD_ASSERT(f_random >= pages);
+      DEVSHELL_CMD_ASSERT(f_normal <= pages / 8);
+      DEVSHELL_CMD_ASSERT(f_seq <= pages / 16 + 2);
+      DEVSHELL_CMD_ASSERT(f_willneed <= 2);
+   }
+
+   printf("- Write on a hole mapped to the zero page\n");
+   vaddr = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   DEVSHELL_CMD_ASSERT(vaddr != (void *)-1);
+
+   DEVSHELL_CMD_ASSERT(vaddr[5 * page_size] == 0);
+   DEVSHELL_CMD_ASSERT(vaddr[6 * page_size] == 0);
+   vaddr[5 * page_size + 10] = 'x';
+
+   rc = pread(fd, buf, 1, 5 * page_size + 10);
+   DEVSHELL_CMD_ASSERT(rc == 1 && buf[0] == 'x');
+   DEVSHELL_CMD_ASSERT(vaddr[6 * page_size + 10] == 0);
+
+   printf("- Write with pwrite() on a hole already mapped\n");
+   DEVSHELL_CMD_ASSERT(vaddr[7 * page_size + 20] == 0);
+   rc = pwrite(fd, "y", 1, 7 * page_size + 20);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(vaddr[7 * page_size + 20] == 'y');
+   DEVSHELL_CMD_ASSERT(vaddr[8 * page_size + 20] == 0);
+
+   rc = munmap(vaddr, file_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   printf("- readahead() and invalid fadvise() calls\n");
+   rc = readahead(fd, 0, file_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = posix_fadvise(fd, 0, 0, 1234);
+   DEVSHELL_CMD_ASSERT(rc == EINVAL);
+
+   rc = pipe(pipefd);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = posix_fadvise(pipefd[0], 0, 0, POSIX_FADV_SEQUENTIAL);
+   DEVSHELL_CMD_ASSERT(rc == ESPIPE);
+
+   rc = readahead(pipefd[0], 0, 4096);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   close(pipefd[0]);
+   close(pipefd[1]);
+   close(fd);
+
+   rc = unlink(fadvise_test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
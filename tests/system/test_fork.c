@@ -13,6 +13,7 @@
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
+#include <spawn.h>
 
 #include "devshell.h"
 #include "sysenter.h"
@@ -83,9 +84,8 @@ int cmd_fork0(int argc, char **argv)
    return fork_test(&fork);
 }
 
-static int do_fork_perf(int (*fork_func)(void))
+static int do_fork_perf(int (*fork_func)(void), int iters)
 {
-   const int iters = 150000;
    int rc, wstatus, child_pid;
    ull_t start, duration;
 
@@ -128,12 +128,165 @@ int cmd_fork_se(int argc, char **argv)
 
 int cmd_fork_perf(int argc, char **argv)
 {
-   return do_fork_perf(&fork);
+   return do_fork_perf(&fork, 150000);
 }
 
 int cmd_vfork_perf(int argc, char **argv)
 {
-   return do_fork_perf(&vfork);
+   return do_fork_perf(&vfork, 150000);
+}
+
+/*
+ * Short fork + exit + waitpid loop, the typical life of a fork-per-request
+ * service's child: after the first iteration, the kernel stack, the copy
+ * buffers and the task + process block come from the kernel's caches.
+ */
+int cmd_fork_exit(int argc, char **argv)
+{
+   return do_fork_perf(&fork, 2000);
+}
+
+/*
+ * Fork-storm: keep forking children that stay alive, blocked on a pipe, in
+ * order to check that the cost of fork() does not grow with the number of
+ * existing processes.
+ */
+int cmd_fork_storm(int argc, char **argv)
+{
+   const int n = 500, batch = 100;
+   static int pids[500];
+   ull_t start, first_batch = 0, last_batch = 0, dur;
+   int rc, wstatus, fds[2];
+   char c;
+
+   rc = pipe(fds);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   for (int i = 0; i < n; i++) {
+
+      start = RDTSC();
+      pids[i] = fork();
+      dur = RDTSC() - start;
+
+      if (pids[i] < 0) {
+
+         perror("fork() failed");
+
+         /* Let the children created so far die, before failing */
+         close(fds[1]);
+
+         for (int j = 0; j < i; j++)
+            waitpid(pids[j], &wstatus, 0);
+
+         return 1;
+      }
+
+      if (!pids[i]) {
+         close(fds[1]);
+         rc = read(fds[0], &c, 1);   /* returns 0 when the parent closes it */
+         exit(rc);
+      }
+
+      if (i < batch)
+         first_batch += dur;
+      else if (i >= n - batch)
+         last_batch += dur;
+   }
+
+   printf("fork() with    0-%3d live children: %llu cycles\n",
+          batch, first_batch / batch);
+   printf("fork() with %3d-%3d live children: %llu cycles\n",
+          n - batch, n, last_batch / batch);
+
+   close(fds[0]);
+   close(fds[1]);
+
+   for (int i = 0; i < n; i++) {
+      rc = waitpid(pids[i], &wstatus, 0);
+      DEVSHELL_CMD_ASSERT(rc == pids[i]);
+      DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   }
+
+   return 0;
+}
+
+#define SPAWN_TEST_PROG                        "/initrd/bin/busybox"
+
+enum spawn_method {
+   SPAWN_FORK_EXEC,
+   SPAWN_VFORK_EXEC,
+   SPAWN_POSIX_SPAWN,
+};
+
+static int spawn_true(enum spawn_method m)
+{
+   extern char **environ;
+   char *argv[] = { "true", NULL };
+   int pid, rc;
+
+   switch (m) {
+
+      case SPAWN_FORK_EXEC:
+         pid = fork();
+         break;
+
+      case SPAWN_VFORK_EXEC:
+         pid = vfork();
+         break;
+
+      case SPAWN_POSIX_SPAWN:
+         rc = posix_spawn(&pid, SPAWN_TEST_PROG, NULL, NULL, argv, environ);
+         return rc ? -rc : pid;
+
+      default:
+         abort();
+   }
+
+   if (!pid) {
+      execve(SPAWN_TEST_PROG, argv, environ);
+      _exit(127);
+   }
+
+   return pid;
+}
+
+static ull_t spawn_perf(enum spawn_method m, int iters)
+{
+   int pid, rc, wstatus;
+   ull_t start = RDTSC();
+
+   for (int i = 0; i < iters; i++) {
+
+      pid = spawn_true(m);
+      DEVSHELL_CMD_ASSERT(pid > 0);
+
+      rc = waitpid(pid, &wstatus, 0);
+      DEVSHELL_CMD_ASSERT(rc == pid);
+      DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   }
+
+   return (RDTSC() - start) / iters;
+}
+
+/*
+ * Compare the latency of spawning a program with fork + execve, vfork + execve
+ * and posix_spawn(), which uses clone(CLONE_VM | CLONE_VFORK).
+ */
+int cmd_spawn_perf(int argc, char **argv)
+{
+   const int n = 200;
+   char *bad_argv[] = { "none", NULL };
+   extern char **environ;
+   int rc, pid;
+
+   /* The exec failure must be reported by posix_spawn() itself */
+   rc = posix_spawn(&pid, "/bad/path", NULL, NULL, bad_argv, environ);
+   DEVSHELL_CMD_ASSERT(rc == ENOENT);
+
+   printf("fork + execve:  %llu cycles\n", spawn_perf(SPAWN_FORK_EXEC, n));
+   printf("vfork + execve: %llu cycles\n", spawn_perf(SPAWN_VFORK_EXEC, n));
+   printf("posix_spawn():  %llu cycles\n", spawn_perf(SPAWN_POSIX_SPAWN, n));
+   return 0;
 }
 
 int cmd_execve0(int argc, char **argv)
@@ -0,0 +1,442 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+#ifndef AT_EMPTY_PATH
+   #define AT_EMPTY_PATH                                             0x1000
+#endif
+
+#if defined(__i386__) && !defined(SYS_statx)
+   #define SYS_statx                                                    383
+#endif
+
+/* The part of struct statx we care about, from its man page */
+struct test_statx {
+   unsigned stx_mask;
+   unsigned stx_blksize;
+   unsigned long long stx_attributes;
+   unsigned stx_nlink;
+   unsigned stx_uid;
+   unsigned stx_gid;
+   unsigned short stx_mode;
+   unsigned short __spare0;
+   unsigned long long stx_ino;
+   unsigned long long stx_size;
+   unsigned long long stx_blocks;
+   char rest[256 - 64];
+};
+
+static const char lsr_test_dir[] = "/tmp/lsr_test";
+
+static void lsr_make_tree(int dirs, int files)
+{
+   char path[128];
+   int rc, fd;
+
+   rc = mkdir(lsr_test_dir, 0755);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   for (int i = 0; i < dirs; i++) {
+
+      sprintf(path, "%s/dir%03d", lsr_test_dir, i);
+      rc = mkdir(path, 0755);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+
+      for (int j = 0; j < files; j++) {
+
+         sprintf(path, "%s/dir%03d/file%03d", lsr_test_dir, i, j);
+         fd = open(path, O_CREAT | O_WRONLY, 0644);
+         DEVSHELL_CMD_ASSERT(fd > 0);
+
+         /* Give each file a different size, to check the attributes */
+         rc = write(fd, path, (size_t)(j % 32));
+         DEVSHELL_CMD_ASSERT(rc == j % 32);
+         close(fd);
+      }
+   }
+}
+
+static void lsr_remove_tree(int dirs, int files)
+{
+   char path[128];
+   int rc;
+
+   for (int i = 0; i < dirs; i++) {
+
+      for (int j = 0; j < files; j++) {
+         sprintf(path, "%s/dir%03d/file%03d", lsr_test_dir, i, j);
+         rc = unlink(path);
+         DEVSHELL_CMD_ASSERT(rc == 0);
+      }
+
+      sprintf(path, "%s/dir%03d", lsr_test_dir, i);
+      rc = rmdir(path);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   rc = rmdir(lsr_test_dir);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+}
+
+static bool same_stat(const struct stat *a, const struct stat *b)
+{
+   return a->st_ino == b->st_ino &&
+          a->st_mode == b->st_mode &&
+          a->st_size == b->st_size &&
+          a->st_nlink == b->st_nlink &&
+          a->st_mtime == b->st_mtime;
+}
+
+/* Walks the tree with readdir() + lstat() on the full path of each entry */
+static int lsr_walk_lstat(const char *dirpath)
+{
+   char path[512];
+   struct dirent *de;
+   struct stat st;
+   int count = 0;
+   DIR *d;
+
+   d = opendir(dirpath);
+   DEVSHELL_CMD_ASSERT(d != NULL);
+
+   while ((de = readdir(d))) {
+
+      if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+         continue;
+
+      snprintf(path, sizeof(path), "%s/%s", dirpath, de->d_name);
+      DEVSHELL_CMD_ASSERT(lstat(path, &st) == 0);
+      count++;
+
+      if (S_ISDIR(st.st_mode))
+         count += lsr_walk_lstat(path);
+   }
+
+   closedir(d);
+   return count;
+}
+
+/* Walks the tree with readdir() + fstatat() relative to the directory fd */
+static int lsr_walk_fstatat(const char *dirpath)
+{
+   char path[512];
+   struct dirent *de;
+   struct stat st;
+   int count = 0;
+   DIR *d;
+   int dfd;
+
+   d = opendir(dirpath);
+   DEVSHELL_CMD_ASSERT(d != NULL);
+   dfd = dirfd(d);
+
+   while ((de = readdir(d))) {
+
+      if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+         continue;
+
+      DEVSHELL_CMD_ASSERT(
+         fstatat(dfd, de->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0
+      );
+
+      count++;
+
+      if (S_ISDIR(st.st_mode)) {
+         snprintf(path, sizeof(path), "%s/%s", dirpath, de->d_name);
+         count += lsr_walk_fstatat(path);
+      }
+   }
+
+   closedir(d);
+   return count;
+}
+
+/* Walks the tree with TILCK_CMD_GETDENTS_STAT: no stat() calls at all */
+static int lsr_walk_getdents_stat(const char *dirpath, unsigned buf_size)
+{
+   struct tilck_dirent_stat *de;
+   char path[256];
+   int count = 0;
+   int rc, dfd;
+   char *buf;
+
+   buf = malloc(buf_size);
+   DEVSHELL_CMD_ASSERT(buf != NULL);
+
+   dfd = open(dirpath, O_RDONLY | O_DIRECTORY);
+   DEVSHELL_CMD_ASSERT(dfd > 0);
+
+   while ((rc = tilck_getdents_stat(dfd, (void *)buf, buf_size)) > 0) {
+
+      for (int off = 0; off < rc; off += de->d_reclen) {
+
+         de = (void *)(buf + off);
+
+         if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+            continue;
+
+         count++;
+
+         if (S_ISDIR(de->mode)) {
+            snprintf(path, sizeof(path), "%s/%s", dirpath, de->d_name);
+            count += lsr_walk_getdents_stat(path, buf_size);
+         }
+      }
+   }
+
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   close(dfd);
+   free(buf);
+   return count;
+}
+
+static void fstatat_check_getdents_stat(void)
+{
+   char buf[2048], path[256];
+   struct tilck_dirent_stat *de;
+   struct stat st;
+   int fd, rc, count = 0;
+
+   printf("- Check TILCK_CMD_GETDENTS_STAT vs lstat()\n");
+   fd = open(lsr_test_dir, O_RDONLY | O_DIRECTORY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   while ((rc = tilck_getdents_stat(fd, (void *)buf, sizeof(buf))) > 0) {
+
+      for (int off = 0; off < rc; off += de->d_reclen) {
+
+         de = (void *)(buf + off);
+         DEVSHELL_CMD_ASSERT((de->d_reclen % 8) == 0);
+
+         snprintf(path, sizeof(path), "%s/%s", lsr_test_dir, de->d_name);
+         DEVSHELL_CMD_ASSERT(lstat(path, &st) == 0);
+
+         DEVSHELL_CMD_ASSERT(de->d_ino == st.st_ino);
+         DEVSHELL_CMD_ASSERT(de->mode == st.st_mode);
+         DEVSHELL_CMD_ASSERT(de->size == (unsigned long long)st.st_size);
+         DEVSHELL_CMD_ASSERT(de->nlink == st.st_nlink);
+         DEVSHELL_CMD_ASSERT(de->mtime == st.st_mtime);
+         count++;
+      }
+   }
+
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(count == 2 + 4);   /* ".", ".." and 4 dirs */
+
+   printf("- A too small buffer must fail with EINVAL\n");
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+   rc = tilck_getdents_stat(fd, (void *)buf, 16);
+   DEVSHELL_CMD_ASSERT(rc == -EINVAL);
+   close(fd);
+
+   printf("- Entries of mount points have the attributes of the target root\n");
+   fd = open("/", O_RDONLY | O_DIRECTORY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   while ((rc = tilck_getdents_stat(fd, (void *)buf, sizeof(buf))) > 0) {
+      for (int off = 0; off < rc; off += de->d_reclen) {
+
+         de = (void *)(buf + off);
+
+         if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+            continue;
+
+         snprintf(path, sizeof(path), "/%s", de->d_name);
+         DEVSHELL_CMD_ASSERT(lstat(path, &st) == 0);
+         DEVSHELL_CMD_ASSERT(de->mode == st.st_mode);
+         DEVSHELL_CMD_ASSERT(de->dev == st.st_dev);
+      }
+   }
+
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   close(fd);
+}
+
+/* fstatat() with a dirfd, AT_EMPTY_PATH, AT_SYMLINK_NOFOLLOW and statx() */
+int cmd_fstatat1(int argc, char **argv)
+{
+   struct stat st1, st2;
+   struct test_statx stx;
+   int dfd, fd, rc;
+
+   lsr_make_tree(4, 8);
+
+   dfd = open(lsr_test_dir, O_RDONLY | O_DIRECTORY);
+   DEVSHELL_CMD_ASSERT(dfd > 0);
+
+   printf("- fstatat() relative to a dirfd vs stat() of the full path\n");
+   rc = fstatat(dfd, "dir001/file005", &st1, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = stat("/tmp/lsr_test/dir001/file005", &st2);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(same_stat(&st1, &st2));
+   DEVSHELL_CMD_ASSERT(st1.st_size == 5);
+
+   printf("- fstatat() with '..' relative to a dirfd\n");
+   rc = fstatat(dfd, "dir001/../dir002", &st1, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = stat("/tmp/lsr_test/dir002", &st2);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(same_stat(&st1, &st2));
+
+   printf("- fstatat() with an absolute path ignores the dirfd\n");
+   rc = fstatat(12345, "/tmp/lsr_test", &st1, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(S_ISDIR(st1.st_mode));
+
+   printf("- fstatat() with AT_FDCWD\n");
+   rc = fstatat(AT_FDCWD, "/tmp/lsr_test/dir003", &st1, AT_SYMLINK_NOFOLLOW);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(S_ISDIR(st1.st_mode));
+
+   printf("- fstatat() with AT_SYMLINK_NOFOLLOW on a symlink\n");
+   rc = symlink("dir001/file003", "/tmp/lsr_test/link");
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = fstatat(dfd, "link", &st1, AT_SYMLINK_NOFOLLOW);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(S_ISLNK(st1.st_mode));
+   rc = fstatat(dfd, "link", &st1, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(S_ISREG(st1.st_mode) && st1.st_size == 3);
+   rc = unlink("/tmp/lsr_test/link");
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   printf("- fstatat() with AT_EMPTY_PATH\n");
+   fd = open("/tmp/lsr_test/dir000/file007", O_RDONLY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+   rc = fstatat(fd, "", &st1, AT_EMPTY_PATH);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = fstat(fd, &st2);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(same_stat(&st1, &st2));
+
+   printf("- fstatat() with an empty path and no AT_EMPTY_PATH\n");
+   rc = fstatat(fd, "", &st1, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ENOENT);
+
+   printf("- fstatat() relative to a file fd must fail with ENOTDIR\n");
+   rc = fstatat(fd, "abc", &st1, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ENOTDIR);
+   close(fd);
+
+   printf("- fstatat() with a bad dirfd must fail with EBADF\n");
+   rc = fstatat(12345, "abc", &st1, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EBADF);
+
+   printf("- fstatat() with invalid flags must fail with EINVAL\n");
+   rc = fstatat(dfd, "dir000", &st1, 0x40000000);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+#ifdef SYS_statx
+
+   printf("- statx() vs fstatat()\n");
+   rc = syscall(SYS_statx, dfd, "dir002/file009", 0, 0x7ff, &stx);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = fstatat(dfd, "dir002/file009", &st1, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   DEVSHELL_CMD_ASSERT((stx.stx_mask & 0x7ff) == 0x7ff);
+   DEVSHELL_CMD_ASSERT(stx.stx_ino == st1.st_ino);
+   DEVSHELL_CMD_ASSERT(stx.stx_mode == st1.st_mode);
+   DEVSHELL_CMD_ASSERT(stx.stx_size == 9);
+   DEVSHELL_CMD_ASSERT(stx.stx_nlink == st1.st_nlink);
+
+#else
+   (void)stx;
+#endif
+
+   if (running_on_tilck())
+      fstatat_check_getdents_stat();
+
+   close(dfd);
+   lsr_remove_tree(4, 8);
+   return 0;
+}
+
+static u64 lsr_run_ls(void)
+{
+   int child_pid, wstatus, fd;
+   u64 start;
+
+   start = RDTSC();
+   child_pid = fork();
+   DEVSHELL_CMD_ASSERT(child_pid >= 0);
+
+   if (!child_pid) {
+
+      fd = open("/dev/null", O_WRONLY);
+
+      if (fd < 0 || dup2(fd, 1) < 0)
+         exit(1);
+
+      if (running_on_tilck())
+         execl("/initrd/bin/busybox", "ls", "-lR", lsr_test_dir, NULL);
+      else
+         execlp("ls", "ls", "-lR", lsr_test_dir, NULL);
+
+      exit(1);
+   }
+
+   waitpid(child_pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   return RDTSC() - start;
+}
+
+/*
+ * Times `ls -lR` on a tree of 10 dirs x 100 files and compares the three ways
+ * of getting the attributes of all the entries in a directory tree. The times
+ * are reported in Kcycles, since we don't know the CPU frequency.
+ */
+int cmd_lsr_perf(int argc, char **argv)
+{
+   const int dirs = 10, files = 100;
+   const int exp_count = dirs + dirs * files;
+   u64 start, c_ls, c_lstat, c_fstatat, c_gds = 0;
+   int count;
+
+   lsr_make_tree(dirs, files);
+
+   c_ls = lsr_run_ls();
+
+   start = RDTSC();
+   count = lsr_walk_lstat(lsr_test_dir);
+   c_lstat = RDTSC() - start;
+   DEVSHELL_CMD_ASSERT(count == exp_count);
+
+   start = RDTSC();
+   count = lsr_walk_fstatat(lsr_test_dir);
+   c_fstatat = RDTSC() - start;
+   DEVSHELL_CMD_ASSERT(count == exp_count);
+
+   if (running_on_tilck()) {
+      start = RDTSC();
+      count = lsr_walk_getdents_stat(lsr_test_dir, 4 * KB);
+      c_gds = RDTSC() - start;
+      DEVSHELL_CMD_ASSERT(count == exp_count);
+   }
+
+   printf("Tree of %d dirs x %d files:\n", dirs, files);
+   printf("    ls -lR:                 %8llu Kcycles\n", c_ls / 1000);
+   printf("    readdir + lstat:        %8llu Kcycles\n", c_lstat / 1000);
+   printf("    readdir + fstatat:      %8llu Kcycles\n", c_fstatat / 1000);
+
+   if (running_on_tilck())
+      printf("    getdents_stat:          %8llu Kcycles\n", c_gds / 1000);
+
+   lsr_remove_tree(dirs, files);
+   return 0;
+}
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+/* A clock id unsupported by the kernel, which logs a warning about it */
+#define KMSG_TEST_CLK_ID                               1234567
+
+static char kmsg_buf[64 * 1024];
+
+static int kmsg_read_all(int fd)
+{
+   int rc, tot = 0;
+
+   while ((rc = read(fd, kmsg_buf + tot, sizeof(kmsg_buf) - 1 - tot)) > 0) {
+      tot += rc;
+      DEVSHELL_CMD_ASSERT(tot < (int)sizeof(kmsg_buf) - 1);
+   }
+
+   /* O_NONBLOCK: no more messages */
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+   kmsg_buf[tot] = 0;
+   return tot;
+}
+
+/* Returns the beginning of the line in `kmsg_buf` containing `str` */
+static char *kmsg_find_line(const char *str)
+{
+   char *p = strstr(kmsg_buf, str);
+
+   if (!p)
+      return NULL;
+
+   while (p > kmsg_buf && p[-1] != '\n')
+      p--;
+
+   return p;
+}
+
+int cmd_kmsg1(int argc, char **argv)
+{
+   struct stat statbuf;
+   struct timespec ts;
+   char small_buf[4], msg[64];
+   unsigned sec, ms;
+   int fd, fd2, rc, tot, n = 0;
+   char *line;
+
+   rc = stat("/dev/kmsg", &statbuf);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(S_ISCHR(statbuf.st_mode));
+
+   /* Make the kernel log a message we know */
+   snprintf(msg, sizeof(msg), "unsupported clk_id: %d\n", KMSG_TEST_CLK_ID);
+   rc = clock_getres(KMSG_TEST_CLK_ID, &ts);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   fd = open("/dev/kmsg", O_RDONLY | O_NONBLOCK);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   tot = kmsg_read_all(fd);
+   printf("Read %d bytes from /dev/kmsg\n", tot);
+   DEVSHELL_CMD_ASSERT(tot > 0);
+
+   /* Our message starts with its timestamp: "[<sec>.<ms>] " */
+   line = kmsg_find_line(msg);
+   DEVSHELL_CMD_ASSERT(line != NULL);
+
+   rc = sscanf(line, "[%u.%3u] %n", &sec, &ms, &n);
+   DEVSHELL_CMD_ASSERT(rc == 2 && n > 0 && line[n - 2] == ']');
+   DEVSHELL_CMD_ASSERT(ms < 1000);
+   DEVSHELL_CMD_ASSERT(strstr(line + n, msg) != NULL);
+
+   if (!strstr(kmsg_buf, "{_DROPPED_"))
+      DEVSHELL_CMD_ASSERT(strstr(kmsg_buf, "Hello from Tilck") != NULL);
+
+   /* Every open file has its own position and starts from the beginning */
+   fd2 = open("/dev/kmsg", O_RDONLY | O_NONBLOCK);
+   DEVSHELL_CMD_ASSERT(fd2 > 0);
+
+   rc = read(fd2, small_buf, sizeof(small_buf));
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL); /* too small for a msg */
+
+   rc = read(fd2, kmsg_buf, sizeof(kmsg_buf));
+   DEVSHELL_CMD_ASSERT(rc > 0);
+   close(fd2);
+
+   /* /dev/kmsg is read-only */
+   rc = write(fd, "x", 1);
+   DEVSHELL_CMD_ASSERT(rc < 0);
+
+   close(fd);
+   return 0;
+}
@@ -0,0 +1,227 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+static const char pio_test_file[] = "/tmp/pio_test";
+
+static void fill_pattern(char *buf, size_t len, size_t off)
+{
+   for (size_t i = 0; i < len; i++)
+      buf[i] = (char)('a' + (off + i) % 26);
+}
+
+static bool check_pattern(const char *buf, size_t len, size_t off)
+{
+   for (size_t i = 0; i < len; i++)
+      if (buf[i] != (char)('a' + (off + i) % 26))
+         return false;
+
+   return true;
+}
+
+static void pio_check_file(int fd, size_t file_size)
+{
+   char buf[1000];
+   struct iovec iov[3];
+   off_t pos;
+   int rc;
+
+   pos = lseek(fd, 123, SEEK_SET);
+   DEVSHELL_CMD_ASSERT(pos == 123);
+
+   printf("- pread() at many offsets, the position must not change\n");
+
+   for (size_t off = 0; off < file_size; off += 997) {
+
+      const size_t exp = MIN(sizeof(buf), file_size - off);
+
+      rc = pread(fd, buf, sizeof(buf), (off_t)off);
+      DEVSHELL_CMD_ASSERT(rc == (int)exp);
+      DEVSHELL_CMD_ASSERT(check_pattern(buf, exp, off));
+   }
+
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_CUR) == 123);
+
+   printf("- pread() past the end\n");
+   rc = pread(fd, buf, sizeof(buf), (off_t)file_size + 10);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   printf("- pread() with a negative offset\n");
+   rc = pread(fd, buf, sizeof(buf), -1);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   printf("- preadv() across multiple buffers\n");
+   iov[0] = (struct iovec) { .iov_base = buf +   0, .iov_len = 100 };
+   iov[1] = (struct iovec) { .iov_base = buf + 100, .iov_len = 300 };
+   iov[2] = (struct iovec) { .iov_base = buf + 400, .iov_len = 600 };
+
+   rc = preadv(fd, iov, 3, 1500);
+   DEVSHELL_CMD_ASSERT(rc == 1000);
+   DEVSHELL_CMD_ASSERT(check_pattern(buf, 1000, 1500));
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_CUR) == 123);
+}
+
+/* pread, pwrite, preadv and pwritev on ramfs and on the (r/o) initrd */
+int cmd_pio1(int argc, char **argv)
+{
+   const size_t file_size = 64 * KB;
+   struct iovec iov[2];
+   int fd, rc, pipefd[2];
+   char *buf;
+
+   buf = malloc(file_size);
+   DEVSHELL_CMD_ASSERT(buf != NULL);
+
+   printf("- Using '%s' as test file\n", pio_test_file);
+   fd = open(pio_test_file, O_CREAT | O_RDWR, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   printf("- pwrite() in reverse order, in chunks of 4000 bytes\n");
+
+   for (size_t off = file_size; off > 0; ) {
+
+      const size_t len = MIN((size_t)4000, off);
+      off -= len;
+
+      fill_pattern(buf, len, off);
+      rc = pwrite(fd, buf, len, (off_t)off);
+      DEVSHELL_CMD_ASSERT(rc == (int)len);
+   }
+
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_CUR) == 0);
+   pio_check_file(fd, file_size);
+
+   printf("- pwritev() in the middle of the file\n");
+   fill_pattern(buf, 300, 5000);
+   iov[0] = (struct iovec) { .iov_base = buf +   0, .iov_len = 100 };
+   iov[1] = (struct iovec) { .iov_base = buf + 100, .iov_len = 200 };
+   rc = pwritev(fd, iov, 2, 5000);
+   DEVSHELL_CMD_ASSERT(rc == 300);
+
+   rc = pread(fd, buf, 300, 5000);
+   DEVSHELL_CMD_ASSERT(rc == 300);
+   DEVSHELL_CMD_ASSERT(check_pattern(buf, 300, 5000));
+
+   close(fd);
+   rc = unlink(pio_test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   printf("- pread() on a pipe must fail with ESPIPE\n");
+   rc = pipe(pipefd);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = pread(pipefd[0], buf, 10, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ESPIPE);
+   close(pipefd[0]);
+   close(pipefd[1]);
+
+   if (running_on_tilck()) {
+
+      struct stat statbuf;
+      char buf2[512];
+
+      printf("- pread() on the initrd (fat)\n");
+      fd = open(DEVSHELL_PATH, O_RDONLY);
+      DEVSHELL_CMD_ASSERT(fd > 0);
+
+      rc = fstat(fd, &statbuf);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+
+      for (off_t off = 0; off < statbuf.st_size; off += 7 * KB + 13) {
+
+         rc = pread(fd, buf, sizeof(buf2), off);
+         DEVSHELL_CMD_ASSERT(rc >= 0);
+
+         DEVSHELL_CMD_ASSERT(lseek(fd, off, SEEK_SET) == off);
+         DEVSHELL_CMD_ASSERT(read(fd, buf2, sizeof(buf2)) == rc);
+         DEVSHELL_CMD_ASSERT(!memcmp(buf, buf2, (size_t)rc));
+      }
+
+      close(fd);
+   }
+
+   free(buf);
+   return 0;
+}
+
+/*
+ * Random reads at known offsets: lseek() + read() vs pread(). The throughput
+ * is reported in bytes per 1000 cycles, since we don't know the CPU frequency.
+ */
+int cmd_pio_perf(int argc, char **argv)
+{
+   const size_t file_size = 1 * MB;
+   const int iters = 4096;
+   const size_t rd_size = 512;
+   u64 start, c_seek_read, c_pread;
+   unsigned seed = 1234;
+   char *buf;
+   int fd, rc;
+
+   buf = malloc(file_size);
+   DEVSHELL_CMD_ASSERT(buf != NULL);
+
+   fd = open(pio_test_file, O_CREAT | O_RDWR, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   fill_pattern(buf, file_size, 0);
+
+   for (size_t off = 0; off < file_size; off += 4 * KB) {
+      rc = write(fd, buf + off, 4 * KB);
+      DEVSHELL_CMD_ASSERT(rc == 4 * KB);
+   }
+
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++) {
+
+      const off_t off = (off_t)(rand_r(&seed) % (file_size - rd_size));
+
+      rc = lseek(fd, off, SEEK_SET);
+      DEVSHELL_CMD_ASSERT(rc == off);
+
+      rc = read(fd, buf, rd_size);
+      DEVSHELL_CMD_ASSERT(rc == (int)rd_size);
+   }
+
+   c_seek_read = RDTSC() - start;
+   seed = 1234;
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++) {
+
+      const off_t off = (off_t)(rand_r(&seed) % (file_size - rd_size));
+
+      rc = pread(fd, buf, rd_size, off);
+      DEVSHELL_CMD_ASSERT(rc == (int)rd_size);
+   }
+
+   c_pread = RDTSC() - start;
+
+   printf("Random reads of %u bytes, %d iterations:\n",
+          (unsigned)rd_size, iters);
+   printf("    lseek + read: %6llu cycles/op, %4llu bytes/Kcycle\n",
+          c_seek_read / iters, rd_size * iters * 1000ull / c_seek_read);
+   printf("    pread:        %6llu cycles/op, %4llu bytes/Kcycle\n",
+          c_pread / iters, rd_size * iters * 1000ull / c_pread);
+
+   close(fd);
+   rc = unlink(pio_test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   free(buf);
+   return 0;
+}
@@ -0,0 +1,180 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+static char procfs_buf[16 * 1024];
+
+static int procfs_read_file(const char *path)
+{
+   int fd, rc, tot = 0;
+
+   fd = open(path, O_RDONLY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   /* Read in small chunks, to check that the snapshot stays consistent */
+   while ((rc = read(fd, procfs_buf + tot, 64)) > 0) {
+      tot += rc;
+      DEVSHELL_CMD_ASSERT(tot < (int)sizeof(procfs_buf) - 64);
+   }
+
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   procfs_buf[tot] = 0;
+   close(fd);
+   return tot;
+}
+
+static void procfs_check_meminfo(void)
+{
+   unsigned long tot = 0, free = 0;
+   char *p;
+
+   procfs_read_file("/proc/meminfo");
+
+   p = strstr(procfs_buf, "MemTotal:");
+   DEVSHELL_CMD_ASSERT(p != NULL);
+   DEVSHELL_CMD_ASSERT(sscanf(p, "MemTotal: %lu kB", &tot) == 1);
+
+   p = strstr(procfs_buf, "MemFree:");
+   DEVSHELL_CMD_ASSERT(p != NULL);
+   DEVSHELL_CMD_ASSERT(sscanf(p, "MemFree: %lu kB", &free) == 1);
+
+   printf("MemTotal: %lu kB, MemFree: %lu kB\n", tot, free);
+   DEVSHELL_CMD_ASSERT(tot > 0);
+   DEVSHELL_CMD_ASSERT(free <= tot);
+}
+
+static void procfs_check_pid_files(int pid)
+{
+   unsigned long size, resident, shared, text, lib, data, dt;
+   unsigned long vsize, start, end;
+   char path[64], comm[32], state;
+   long rss;
+   int rpid, ppid, rc;
+   char *line;
+   bool found_stack = false;
+
+   sprintf(path, "/proc/%d/stat", pid);
+   procfs_read_file(path);
+
+   rc = sscanf(procfs_buf, "%d (%31[^)]) %c %d", &rpid, comm, &state, &ppid);
+   DEVSHELL_CMD_ASSERT(rc == 4);
+   DEVSHELL_CMD_ASSERT(rpid == pid);
+   DEVSHELL_CMD_ASSERT(ppid == getppid());
+   DEVSHELL_CMD_ASSERT(state == 'R');
+
+   /* Skip 22 fields after `comm`, to get vsize (23) and rss (24) */
+   line = strchr(procfs_buf, ')') + 2;
+
+   for (int i = 0; i < 20; i++)
+      line = strchr(line, ' ') + 1;
+
+   rc = sscanf(line, "%lu %ld", &vsize, &rss);
+   DEVSHELL_CMD_ASSERT(rc == 2);
+   DEVSHELL_CMD_ASSERT(vsize > 0);
+   DEVSHELL_CMD_ASSERT(rss > 0);
+
+   sprintf(path, "/proc/%d/statm", pid);
+   procfs_read_file(path);
+
+   rc = sscanf(procfs_buf, "%lu %lu %lu %lu %lu %lu %lu",
+               &size, &resident, &shared, &text, &lib, &data, &dt);
+
+   DEVSHELL_CMD_ASSERT(rc == 7);
+   DEVSHELL_CMD_ASSERT(size * getpagesize() == vsize);
+   DEVSHELL_CMD_ASSERT(resident <= size);
+   DEVSHELL_CMD_ASSERT(text > 0);
+
+   sprintf(path, "/proc/%d/maps", pid);
+   procfs_read_file(path);
+
+   for (line = strtok(procfs_buf, "\n"); line; line = strtok(NULL, "\n")) {
+
+      rc = sscanf(line, "%lx-%lx", &start, &end);
+      DEVSHELL_CMD_ASSERT(rc == 2);
+      DEVSHELL_CMD_ASSERT(start < end);
+
+      if (strstr(line, "[stack]")) {
+         DEVSHELL_CMD_ASSERT(start <= (unsigned long)&rc);
+         found_stack = true;
+      }
+   }
+
+   DEVSHELL_CMD_ASSERT(found_stack);
+}
+
+static bool procfs_dir_has_pid(int pid)
+{
+   struct dirent *de;
+   char name[16];
+   bool found = false;
+   DIR *d;
+
+   sprintf(name, "%d", pid);
+   d = opendir("/proc");
+   DEVSHELL_CMD_ASSERT(d != NULL);
+
+   while ((de = readdir(d)))
+      if (!strcmp(de->d_name, name))
+         found = true;
+
+   closedir(d);
+   return found;
+}
+
+int cmd_procfs1(int argc, char **argv)
+{
+   struct stat statbuf;
+   char path[64];
+   int fd, rc;
+
+   procfs_check_meminfo();
+
+   procfs_read_file("/proc/interrupts");
+   DEVSHELL_CMD_ASSERT(strstr(procfs_buf, "CPU0") != NULL);
+
+   procfs_read_file("/proc/kmalloc");
+   DEVSHELL_CMD_ASSERT(strstr(procfs_buf, "small heaps") != NULL);
+
+   procfs_read_file("/proc/uptime");
+   procfs_read_file("/proc/stat");
+   DEVSHELL_CMD_ASSERT(!strncmp(procfs_buf, "cpu ", 4));
+
+   procfs_check_pid_files(getpid());
+   DEVSHELL_CMD_ASSERT(procfs_dir_has_pid(getpid()));
+
+   rc = stat("/proc/meminfo", &statbuf);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(S_ISREG(statbuf.st_mode));
+
+   /* procfs is read-only */
+   fd = open("/proc/meminfo", O_WRONLY);
+   DEVSHELL_CMD_ASSERT(fd < 0 && errno == EROFS);
+
+   fd = open("/proc/new_file", O_CREAT | O_WRONLY, 0644);
+   DEVSHELL_CMD_ASSERT(fd < 0 && errno == EROFS);
+
+   rc = stat("/proc/99999/stat", &statbuf);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ENOENT);
+
+   /* Regular files are not directories */
+   sprintf(path, "/proc/%d/stat/x", getpid());
+   rc = stat(path, &statbuf);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ENOTDIR);
+
+   fd = open("/proc/meminfo/x", O_RDONLY);
+   DEVSHELL_CMD_ASSERT(fd < 0 && errno == ENOTDIR);
+   return 0;
+}
@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+#define PROF_TEST_SAMPLES        64
+
+/*
+ * Burn some CPU time both in user and in kernel mode, until the profiler
+ * collected at least `n` samples.
+ */
+static void prof_burn_cpu(u32 n)
+{
+   struct tilck_prof_info info;
+   volatile u32 sum = 0;
+   struct stat statbuf;
+   int rc;
+
+   do {
+
+      for (int i = 0; i < 100 * 1000; i++)
+         sum += (u32)i;
+
+      for (int i = 0; i < 100; i++)
+         stat("/initrd", &statbuf);
+
+      rc = tilck_prof(TILCK_PROF_GET_INFO, (ulong)&info, 0, 0);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+      DEVSHELL_CMD_ASSERT(info.running);
+
+   } while (info.samples < n);
+}
+
+/* Basic checks of the timer-driven sampling profiler (TILCK_CMD_PROF) */
+int cmd_prof1(int argc, char **argv)
+{
+   struct tilck_prof_sample *samples;
+   struct tilck_prof_info info;
+   u32 user_samples = 0, kernel_samples = 0, kernel_frames = 0;
+   char name[64];
+   int rc;
+
+   if (!running_on_tilck()) {
+      not_on_tilck_message();
+      return 0;
+   }
+
+   samples = calloc(PROF_TEST_SAMPLES, sizeof(samples[0]));
+   DEVSHELL_CMD_ASSERT(samples != NULL);
+
+   printf("- Invalid parameters\n");
+   rc = tilck_prof(TILCK_PROF_START, 0x80, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc == -EINVAL);
+   rc = tilck_prof(TILCK_PROF_START, 0, TILCK_PROF_MAX_SAMPLES + 1, 0);
+   DEVSHELL_CMD_ASSERT(rc == -EINVAL);
+
+   printf("- Start the profiler with stack walks\n");
+   rc = tilck_prof(TILCK_PROF_START,
+                   TILCK_PROF_FL_STACKS,
+                   PROF_TEST_SAMPLES,
+                   0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = tilck_prof(TILCK_PROF_START, 0, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc == -EBUSY);
+
+   rc = tilck_prof(TILCK_PROF_READ, 0, (ulong)samples, PROF_TEST_SAMPLES);
+   DEVSHELL_CMD_ASSERT(rc == -EBUSY);
+
+   /* Fill the buffer and then make sure that extra samples are lost */
+   prof_burn_cpu(PROF_TEST_SAMPLES);
+   usleep(100 * 1000);
+
+   rc = tilck_prof(TILCK_PROF_STOP, 0, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc == PROF_TEST_SAMPLES);
+
+   rc = tilck_prof(TILCK_PROF_GET_INFO, (ulong)&info, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(!info.running);
+   DEVSHELL_CMD_ASSERT(info.samples == PROF_TEST_SAMPLES);
+   DEVSHELL_CMD_ASSERT(info.max_samples == PROF_TEST_SAMPLES);
+   DEVSHELL_CMD_ASSERT(info.lost > 0);
+
+   printf("- Read the samples\n");
+   rc = tilck_prof(TILCK_PROF_READ, 0, (ulong)samples, PROF_TEST_SAMPLES);
+   DEVSHELL_CMD_ASSERT(rc == PROF_TEST_SAMPLES);
+
+   rc = tilck_prof(TILCK_PROF_READ, PROF_TEST_SAMPLES, (ulong)samples, 1);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   for (int i = 0; i < PROF_TEST_SAMPLES; i++) {
+
+      struct tilck_prof_sample *s = &samples[i];
+      DEVSHELL_CMD_ASSERT(s->n_frames <= TILCK_PROF_MAX_FRAMES);
+
+      if (s->flags & TILCK_PROF_SAMPLE_USER) {
+         DEVSHELL_CMD_ASSERT(s->ip < KERNEL_BASE_VA);
+         user_samples++;
+         continue;
+      }
+
+      DEVSHELL_CMD_ASSERT(s->ip >= KERNEL_BASE_VA);
+      kernel_samples++;
+      kernel_frames += s->n_frames;
+
+      rc = tilck_prof(TILCK_PROF_GET_SYM, s->ip, (ulong)name, sizeof(name));
+      DEVSHELL_CMD_ASSERT(rc >= 0);
+   }
+
+   printf("- Samples: %u user, %u kernel (%u frames)\n",
+          user_samples, kernel_samples, kernel_frames);
+
+   DEVSHELL_CMD_ASSERT(user_samples > 0);
+
+   printf("- Symbol lookup\n");
+   rc = tilck_prof(TILCK_PROF_GET_SYM, 0x1000, (ulong)name, sizeof(name));
+   DEVSHELL_CMD_ASSERT(rc == -ENOENT);
+
+   rc = tilck_prof(TILCK_PROF_RESET, 0, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = tilck_prof(TILCK_PROF_GET_INFO, (ulong)&info, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(info.samples == 0 && info.max_samples == 0);
+
+   free(samples);
+   return 0;
+}
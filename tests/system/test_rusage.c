@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/times.h>
+#include <sys/resource.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+static unsigned long long tv_to_us(struct timeval tv)
+{
+   return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void burn_cpu(int ms)
+{
+   struct timeval start, now;
+   volatile unsigned x = 0;
+
+   gettimeofday(&start, NULL);
+
+   do {
+
+      for (int i = 0; i < 100000; i++)
+         x += i;
+
+      gettimeofday(&now, NULL);
+
+   } while (tv_to_us(now) - tv_to_us(start) < (unsigned long long)ms * 1000);
+}
+
+static unsigned long get_proc_io_counter(const char *name)
+{
+   char buf[512];
+   unsigned long val;
+   char *p;
+   int fd, rc;
+
+   sprintf(buf, "/proc/%d/io", getpid());
+   fd = open(buf, O_RDONLY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+   rc = read(fd, buf, sizeof(buf) - 1);
+   DEVSHELL_CMD_ASSERT(rc > 0);
+   buf[rc] = 0;
+   close(fd);
+
+   p = strstr(buf, name);
+   DEVSHELL_CMD_ASSERT(p != NULL);
+   DEVSHELL_CMD_ASSERT(sscanf(p + strlen(name), ": %lu", &val) == 1);
+   return val;
+}
+
+int cmd_rusage1(int argc, char **argv)
+{
+   struct rusage ru, ru_ch;
+   struct tms t;
+   unsigned long rchar0, rchar1;
+   char buf[64];
+   int rc, wstatus, child, fd;
+
+   /* A child burning CPU in user mode, and then sleeping */
+   child = fork();
+   DEVSHELL_CMD_ASSERT(child >= 0);
+
+   if (!child) {
+      burn_cpu(200);
+      usleep(10 * 1000);
+      exit(0);
+   }
+
+   rc = wait4(child, &wstatus, 0, &ru);
+   DEVSHELL_CMD_ASSERT(rc == child);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   printf("child utime: %llu us, stime: %llu us\n",
+          tv_to_us(ru.ru_utime), tv_to_us(ru.ru_stime));
+   printf("child minflt: %ld, nvcsw: %ld, nivcsw: %ld\n",
+          ru.ru_minflt, ru.ru_nvcsw, ru.ru_nivcsw);
+
+   DEVSHELL_CMD_ASSERT(tv_to_us(ru.ru_utime) + tv_to_us(ru.ru_stime) > 0);
+   DEVSHELL_CMD_ASSERT(ru.ru_minflt > 0);     /* at least the CoW faults */
+   DEVSHELL_CMD_ASSERT(ru.ru_nvcsw > 0);      /* usleep() */
+
+   /* The reaped child must be accounted in RUSAGE_CHILDREN */
+   rc = getrusage(RUSAGE_CHILDREN, &ru_ch);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(tv_to_us(ru_ch.ru_utime) >= tv_to_us(ru.ru_utime));
+   DEVSHELL_CMD_ASSERT(ru_ch.ru_minflt >= ru.ru_minflt);
+
+   rc = getrusage(RUSAGE_SELF, &ru);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = getrusage(12345, &ru);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   times(&t);
+   DEVSHELL_CMD_ASSERT(t.tms_cutime + t.tms_cstime > 0);
+
+   /* Check the I/O accounting in /proc/<pid>/io */
+   rchar0 = get_proc_io_counter("rchar");
+
+   fd = open("/proc/meminfo", O_RDONLY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+   rc = read(fd, buf, sizeof(buf));
+   DEVSHELL_CMD_ASSERT(rc == sizeof(buf));
+   close(fd);
+
+   rchar1 = get_proc_io_counter("rchar");
+
+   /* The last read of /proc/<pid>/io is also included */
+   DEVSHELL_CMD_ASSERT(rchar1 >= rchar0 + sizeof(buf));
+   return 0;
+}
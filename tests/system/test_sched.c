@@ -0,0 +1,258 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+#define LAT_HOGS                     3
+#define LAT_ITERS                   50
+#define LAT_SLEEP_NS           1000000       /* 1 ms */
+#define LAT_MAX_NS            30000000       /* 30 ms: 3 ticks at 100 Hz */
+
+/*
+ * NOTE: musl's wrappers for sched_setscheduler() and friends just return
+ * ENOSYS, because the Linux syscalls act on threads, not on processes as
+ * POSIX requires. Therefore, we have to call the syscalls directly.
+ */
+
+static int set_sched(int pid, int policy, int prio)
+{
+   struct sched_param p = { .sched_priority = prio };
+   return syscall(SYS_sched_setscheduler, pid, policy, &p);
+}
+
+static int get_sched(int pid)
+{
+   return syscall(SYS_sched_getscheduler, pid);
+}
+
+static int get_sched_prio(int pid)
+{
+   struct sched_param p = { .sched_priority = -1 };
+   int rc = syscall(SYS_sched_getparam, pid, &p);
+   return rc ? rc : p.sched_priority;
+}
+
+static unsigned long long get_mono_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void burn_cpu_forever(void)
+{
+   volatile unsigned x = 0;
+
+   while (true)
+      x++;
+}
+
+int cmd_sched_rt1(int argc, char **argv)
+{
+   struct sched_param p = { .sched_priority = 20 };
+   struct timespec ts;
+   int rc, child, wstatus;
+
+   if (!running_on_tilck()) {
+      not_on_tilck_message();
+      return 0;
+   }
+
+   DEVSHELL_CMD_ASSERT(sched_get_priority_min(SCHED_FIFO) == 1);
+   DEVSHELL_CMD_ASSERT(sched_get_priority_max(SCHED_FIFO) == 99);
+   DEVSHELL_CMD_ASSERT(sched_get_priority_max(SCHED_RR) == 99);
+   DEVSHELL_CMD_ASSERT(sched_get_priority_max(SCHED_OTHER) == 0);
+   DEVSHELL_CMD_ASSERT(sched_get_priority_max(1234) < 0 && errno == EINVAL);
+
+   DEVSHELL_CMD_ASSERT(get_sched(0) == SCHED_OTHER);
+   DEVSHELL_CMD_ASSERT(get_sched_prio(0) == 0);
+
+   /* Invalid priorities and policies */
+   rc = set_sched(0, SCHED_FIFO, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = set_sched(0, SCHED_FIFO, 100);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = set_sched(0, SCHED_OTHER, 10);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = set_sched(0, 1234, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = set_sched(32000, SCHED_FIFO, 10);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ESRCH);
+
+   rc = set_sched(0, SCHED_FIFO, 10);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(get_sched(getpid()) == SCHED_FIFO);
+   DEVSHELL_CMD_ASSERT(get_sched_prio(0) == 10);
+
+   /* sched_setparam() keeps the policy */
+   rc = syscall(SYS_sched_setparam, 0, &p);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(get_sched(0) == SCHED_FIFO);
+   DEVSHELL_CMD_ASSERT(get_sched_prio(0) == 20);
+
+   /* SCHED_FIFO tasks have no time slice */
+   rc = sched_rr_get_interval(0, &ts);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(ts.tv_sec == 0 && ts.tv_nsec == 0);
+
+   rc = set_sched(0, SCHED_RR, 30);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = sched_rr_get_interval(0, &ts);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(ts.tv_sec > 0 || ts.tv_nsec > 0);
+
+   /* The children inherit the scheduling policy */
+   child = fork();
+   DEVSHELL_CMD_ASSERT(child >= 0);
+
+   if (!child)
+      exit(get_sched(0) == SCHED_RR && get_sched_prio(0) == 30 ? 0 : 1);
+
+   rc = waitpid(child, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == child);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   rc = set_sched(0, SCHED_OTHER, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(get_sched(0) == SCHED_OTHER);
+   return 0;
+}
+
+/*
+ * Measures how late the wake-ups of short sleeps are, with a few CPU hogs
+ * running in background. Returns the max latency, in ns.
+ */
+static unsigned long long measure_wakeup_latency(void)
+{
+   const struct timespec req = { .tv_sec = 0, .tv_nsec = LAT_SLEEP_NS };
+   unsigned long long start, lat, max_lat = 0, tot_lat = 0;
+
+   for (int i = 0; i < LAT_ITERS; i++) {
+
+      start = get_mono_ns();
+      nanosleep(&req, NULL);
+      lat = get_mono_ns() - start - LAT_SLEEP_NS;
+
+      tot_lat += lat;
+
+      if (lat > max_lat)
+         max_lat = lat;
+   }
+
+   printf("    avg: %llu us, max: %llu us\n",
+          tot_lat / LAT_ITERS / 1000, max_lat / 1000);
+
+   return max_lat;
+}
+
+int cmd_sched_rt2(int argc, char **argv)
+{
+   unsigned long long max_lat;
+   int hogs[LAT_HOGS];
+   int rc, wstatus;
+
+   if (!running_on_tilck()) {
+      not_on_tilck_message();
+      return 0;
+   }
+
+   for (int i = 0; i < LAT_HOGS; i++) {
+
+      hogs[i] = fork();
+      DEVSHELL_CMD_ASSERT(hogs[i] >= 0);
+
+      if (!hogs[i])
+         burn_cpu_forever();
+   }
+
+   printf("Wake-up latency with %d CPU hogs, SCHED_OTHER:\n", LAT_HOGS);
+   measure_wakeup_latency();
+
+   rc = set_sched(0, SCHED_FIFO, 50);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   printf("Wake-up latency with %d CPU hogs, SCHED_FIFO:\n", LAT_HOGS);
+   max_lat = measure_wakeup_latency();
+
+   rc = set_sched(0, SCHED_OTHER, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   for (int i = 0; i < LAT_HOGS; i++) {
+      kill(hogs[i], SIGKILL);
+      rc = waitpid(hogs[i], &wstatus, 0);
+      DEVSHELL_CMD_ASSERT(rc == hogs[i]);
+   }
+
+   /* The regular tasks get no guarantees, the real-time ones do */
+   DEVSHELL_CMD_ASSERT(max_lat <= LAT_MAX_NS);
+   return 0;
+}
+
+/*
+ * Throttling: a SCHED_FIFO task burning the CPU must not prevent the regular
+ * tasks from running. Without it, this test would hang until the child's
+ * loop ends and then fail.
+ */
+int cmd_sched_rt3(int argc, char **argv)
+{
+   unsigned long long end;
+   int rc, child, wstatus, fds[2];
+   int iters = 0;
+   char c;
+
+   if (!running_on_tilck()) {
+      not_on_tilck_message();
+      return 0;
+   }
+
+   rc = pipe(fds);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   child = fork();
+   DEVSHELL_CMD_ASSERT(child >= 0);
+
+   if (!child) {
+
+      if (set_sched(0, SCHED_FIFO, 50))
+         exit(1);
+
+      end = get_mono_ns() + 2000000000ull;  /* 2 seconds */
+      rc = write(fds[1], "x", 1);
+
+      while (get_mono_ns() < end) {
+         /* burn the CPU */
+      }
+
+      exit(0);
+   }
+
+   close(fds[1]);
+   rc = read(fds[0], &c, 1);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   close(fds[0]);
+
+   /* The child is now a SCHED_FIFO task, running for a while */
+   while ((rc = waitpid(child, &wstatus, WNOHANG)) == 0) {
+      iters++;
+      usleep(10 * 1000);
+   }
+
+   printf("Iterations while the SCHED_FIFO task was running: %d\n", iters);
+   DEVSHELL_CMD_ASSERT(rc == child);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   DEVSHELL_CMD_ASSERT(iters > 0);
+   return 0;
+}
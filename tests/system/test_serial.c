@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+static unsigned long long tv_to_us(struct timeval tv)
+{
+   return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+int cmd_serial_perf(int argc, char **argv)
+{
+   const char *path = argc > 0 ? argv[0] : "/dev/ttyS0";
+   const int lines = 256;
+   struct timeval start, end;
+   struct rusage ru0, ru1;
+   unsigned long long elapsed, cpu;
+   char buf[64];
+   int fd, rc, len, tot = 0;
+
+   fd = open(path, O_WRONLY);
+
+   if (fd < 0) {
+      printf("Unable to open '%s': %s. Skipping the test.\n",
+             path, strerror(errno));
+      return 0;
+   }
+
+   getrusage(RUSAGE_SELF, &ru0);
+   gettimeofday(&start, NULL);
+
+   for (int i = 0; i < lines; i++) {
+
+      len = sprintf(buf, "[serial_perf] line %03d: %s\n", i,
+                    "0123456789abcdefghijklmnopqrstuv");
+
+      rc = write(fd, buf, len);
+      DEVSHELL_CMD_ASSERT(rc == len);
+      tot += rc;
+   }
+
+   gettimeofday(&end, NULL);
+   getrusage(RUSAGE_SELF, &ru1);
+   close(fd);
+
+   elapsed = tv_to_us(end) - tv_to_us(start);
+   cpu = tv_to_us(ru1.ru_stime) - tv_to_us(ru0.ru_stime);
+   cpu += tv_to_us(ru1.ru_utime) - tv_to_us(ru0.ru_utime);
+
+   printf("Written %d bytes to %s in %llu us\n", tot, path, elapsed);
+
+   if (elapsed)
+      printf("Throughput: %llu bytes/sec\n", tot * 1000000ull / elapsed);
+
+   printf("CPU time: %llu us (%llu%% of the elapsed time)\n",
+          cpu, elapsed ? 100 * cpu / elapsed : 0);
+
+   return 0;
+}
@@ -151,3 +151,97 @@ int cmd_sig1(int argc, char **argv)
 {
    return test_sig(child_generate_and_ignore_sigint, NULL, 0, 0);
 }
+
+static unsigned long long pgrp_ops_cycles(int child, int iters)
+{
+   unsigned long long start = RDTSC();
+   int rc;
+
+   for (int i = 0; i < iters; i++) {
+
+      rc = kill(-child, 0);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+
+      rc = setpgid(child, getpgrp());
+      DEVSHELL_CMD_ASSERT(rc == 0);
+
+      rc = setpgid(child, child);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   return (RDTSC() - start) / iters;
+}
+
+static int fork_blocked_on_pipe(int *fds)
+{
+   int pid = fork();
+   char c;
+
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+      close(fds[1]);
+      exit(read(fds[0], &c, 1));   /* returns 0 when the parent closes it */
+   }
+
+   return pid;
+}
+
+/*
+ * Check that job control operations on a small process group (kill(-pgid),
+ * setpgid()) don't get slower when many other processes exist and that
+ * killing a whole background group, reaches all of its members.
+ */
+int cmd_pgrp_lat(int argc, char **argv)
+{
+   const int n = 300, iters = 1000;
+   static int bg[300];
+   unsigned long long before, after;
+   int rc, wstatus, child, fds[2];
+
+   rc = pipe(fds);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   child = fork_blocked_on_pipe(fds);
+   rc = setpgid(child, child);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   before = pgrp_ops_cycles(child, iters);
+
+   /* Create a big background process group */
+   for (int i = 0; i < n; i++) {
+      bg[i] = fork_blocked_on_pipe(fds);
+      rc = setpgid(bg[i], bg[0]);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   after = pgrp_ops_cycles(child, iters);
+
+   printf("kill(-pgid) + 2 x setpgid(), %3d other procs: %llu cycles\n",
+          0, before);
+   printf("kill(-pgid) + 2 x setpgid(), %3d other procs: %llu cycles\n",
+          n, after);
+
+   /* Kill the whole background group: the other child must survive */
+   rc = kill(-bg[0], SIGKILL);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   for (int i = 0; i < n; i++) {
+      rc = waitpid(bg[i], &wstatus, 0);
+      DEVSHELL_CMD_ASSERT(rc == bg[i]);
+      DEVSHELL_CMD_ASSERT(WIFSIGNALED(wstatus));
+      DEVSHELL_CMD_ASSERT(WTERMSIG(wstatus) == SIGKILL);
+   }
+
+   /* The group does not exist anymore */
+   rc = kill(-bg[0], 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ESRCH);
+
+   close(fds[0]);
+   close(fds[1]);
+
+   rc = waitpid(child, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == child);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   return 0;
+}
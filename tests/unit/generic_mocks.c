@@ -62,6 +62,11 @@ int __wrap_fat_ramdisk_prepare_for_mmap(void *hdr, size_t rd_size)
    return -1;
 }
 
+void __wrap_fat_ramdisk_set_rw(void *d, size_t rd_size, bool rw)
+{
+   /* do nothing */
+}
+
 int __wrap_wth_create_thread_for(void *t) { return 0; }
 void __wrap_wth_wakeup() { /* do nothing */ }
 void __wrap_check_in_irq_handler() { /* do nothing */ }
@@ -119,6 +124,7 @@ void fpu_context_end() { }
 void map_zero_pages() { NOT_REACHED(); }
 void dump_var_mtrrs() { }
 void set_page_rw() { }
+void get_mapping2() { NOT_REACHED(); }
 int get_irq_num(void *ctx) { return -1; }
 int get_int_num(void *ctx) { return -1; }
 void retain_pageframes_mapped_at() { }
@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <cstdio>
+#include <random>
+#include <set>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+extern "C" {
+   #include <tilck/kernel/id_bitmap.h>
+}
+
+template <int max_id>
+struct test_id_bitmap {
+
+   ulong bits[ID_BITMAP_WORDS(max_id)];
+   ulong full[ID_BITMAP_FULL_WORDS(max_id)];
+   struct id_bitmap bm;
+
+   test_id_bitmap() {
+      id_bitmap_init(&bm, bits, full, max_id);
+   }
+};
+
+TEST(id_bitmap, next_free_basic)
+{
+   test_id_bitmap<100> b;
+
+   for (int i = 0; i <= 100; i++) {
+      ASSERT_EQ(id_bitmap_next_free(&b.bm), i);
+      id_bitmap_set(&b.bm, i);
+   }
+
+   /* All the IDs are in use */
+   ASSERT_EQ(id_bitmap_next_free(&b.bm), -1);
+   ASSERT_EQ(id_bitmap_find_free(&b.bm, 0), -1);
+
+   /* The cursor moves forward, after the last returned ID */
+   id_bitmap_clear(&b.bm, 5);
+   id_bitmap_clear(&b.bm, 70);
+   ASSERT_EQ(id_bitmap_next_free(&b.bm), 5);
+   ASSERT_EQ(id_bitmap_next_free(&b.bm), 70);
+   ASSERT_EQ(id_bitmap_next_free(&b.bm), 5);
+
+   id_bitmap_set(&b.bm, 5);
+   ASSERT_EQ(id_bitmap_next_free(&b.bm), 70);
+   ASSERT_TRUE(id_bitmap_test(&b.bm, 5));
+   ASSERT_FALSE(id_bitmap_test(&b.bm, 70));
+}
+
+TEST(id_bitmap, max_id_boundary)
+{
+   test_id_bitmap<NBITS * NBITS> b;    /* one more word than a full level */
+
+   for (int i = 0; i < NBITS * NBITS; i++)
+      id_bitmap_set(&b.bm, i);
+
+   ASSERT_EQ(id_bitmap_find_free(&b.bm, 0), NBITS * NBITS);
+   id_bitmap_set(&b.bm, NBITS * NBITS);
+   ASSERT_EQ(id_bitmap_find_free(&b.bm, 0), -1);
+   ASSERT_EQ(id_bitmap_find_free(&b.bm, NBITS * NBITS + 1), -1);
+}
+
+TEST(id_bitmap, random_vs_std_set)
+{
+   constexpr int max_id = 8191;
+   test_id_bitmap<max_id> b;
+   set<int> used;
+   random_device rdev;
+   const auto seed = rdev();
+   default_random_engine e(seed);
+   uniform_int_distribution<int> dist(0, max_id);
+
+   cout << "[ INFO     ] random seed: " << seed << endl;
+
+   for (int iter = 0; iter < 100000; iter++) {
+
+      const int id = dist(e);
+
+      if (used.count(id)) {
+         used.erase(id);
+         id_bitmap_clear(&b.bm, id);
+      } else {
+         used.insert(id);
+         id_bitmap_set(&b.bm, id);
+      }
+
+      const int from = dist(e);
+      int expected = -1;
+
+      for (int i = from; i <= max_id; i++) {
+         if (!used.count(i)) {
+            expected = i;
+            break;
+         }
+      }
+
+      ASSERT_EQ(id_bitmap_find_free(&b.bm, from), expected);
+   }
+}
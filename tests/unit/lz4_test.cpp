@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C" {
+   #include <tilck/common/basic_defs.h>
+   #include <tilck/common/string_util.h>
+   #include <tilck/common/lz4_compress.c.h>
+}
+
+using namespace std;
+
+static vector<u8> gen_text_like_data(u32 len, u32 seed)
+{
+   static const char *words[] = {
+      "tilck ", "kernel ", "fat32 ", "ramdisk ", "bootloader ", "\n", "0000",
+   };
+
+   mt19937 e(seed);
+   uniform_int_distribution<u32> dist(0, ARRAY_SIZE(words) - 1);
+   vector<u8> v;
+
+   while (v.size() < len) {
+      for (const char *p = words[dist(e)]; *p && v.size() < len; p++)
+         v.push_back((u8)*p);
+   }
+
+   return v;
+}
+
+static vector<u8> gen_random_data(u32 len, u32 seed)
+{
+   mt19937 e(seed);
+   uniform_int_distribution<u32> dist(0, 255);
+   vector<u8> v(len);
+
+   for (auto &b : v)
+      b = (u8)dist(e);
+
+   return v;
+}
+
+static vector<u8> compress_chunked(const vector<u8> &in, u32 chunk_size)
+{
+   const u32 chunks = ((u32)in.size() + chunk_size - 1) / chunk_size;
+   vector<u8> out(chunks * (LZ4_CHUNK_HDR_SIZE+LZ4_COMPRESS_BOUND(chunk_size)));
+   vector<u32> ht(LZ4_HASH_SIZE);
+   u32 clen;
+
+   clen = lz4_compress_chunked(in.data(), (u32)in.size(),
+                               out.data(), chunk_size, ht.data());
+   out.resize(clen);
+   return out;
+}
+
+static void
+check_roundtrip(const vector<u8> &in, u32 chunk_size, u32 read_step)
+{
+   const vector<u8> c = compress_chunked(in, chunk_size);
+   vector<u8> out(in.size());
+   struct lz4_chunked_ctx ctx;
+
+   lz4_chunked_ctx_init(&ctx, c.data(), out.data(), (u32)in.size(), chunk_size);
+
+   /* Simulate the bootloaders: data becomes available `read_step` at a time */
+   for (u32 avail = 0; !lz4_chunked_done(&ctx); ) {
+      avail = MIN(avail + read_step, (u32)c.size());
+      ASSERT_EQ(lz4_chunked_decompress(&ctx, avail), 0);
+
+      if (avail == c.size())
+         break;
+   }
+
+   ASSERT_TRUE(lz4_chunked_done(&ctx));
+   ASSERT_EQ(ctx.src_off, c.size());
+   ASSERT_TRUE(out == in);
+}
+
+TEST(lz4, block_roundtrip)
+{
+   for (u32 len : {0u, 1u, 5u, 12u, 13u, 100u, 4096u, 65536u + 123u}) {
+
+      const vector<u8> in = gen_text_like_data(len, len);
+      vector<u8> c(LZ4_COMPRESS_BOUND(len));
+      vector<u8> out(len);
+      vector<u32> ht(LZ4_HASH_SIZE);
+      u32 clen;
+
+      clen = lz4_compress_block(in.data(), len, c.data(), ht.data());
+      ASSERT_LE(clen, c.size());
+
+      if (len >= 4096) {
+         ASSERT_LT(clen, len / 2);
+      }
+
+      ASSERT_EQ(lz4_decompress_block(c.data(), clen, out.data(), len),
+                (int)len);
+      ASSERT_TRUE(out == in);
+   }
+}
+
+TEST(lz4, block_overlapping_match)
+{
+   const vector<u8> in(10000, 'a');
+   vector<u8> c(LZ4_COMPRESS_BOUND(in.size()));
+   vector<u8> out(in.size());
+   vector<u32> ht(LZ4_HASH_SIZE);
+   u32 clen;
+
+   clen = lz4_compress_block(in.data(), (u32)in.size(), c.data(), ht.data());
+   ASSERT_LT(clen, 100u);
+   ASSERT_EQ(lz4_decompress_block(c.data(), clen, out.data(), (u32)in.size()),
+             (int)in.size());
+   ASSERT_TRUE(out == in);
+}
+
+TEST(lz4, chunked_streaming)
+{
+   const vector<u8> text = gen_text_like_data(1 * MB + 1234, 1);
+   const vector<u8> rnd = gen_random_data(300 * KB + 7, 2);
+
+   for (u32 step : {1u * KB, 4u * KB, 64u * KB, 3u * MB}) {
+      check_roundtrip(text, 64 * KB, step);
+      check_roundtrip(rnd, 64 * KB, step);
+   }
+
+   check_roundtrip(text, 4 * KB, 512);
+}
+
+TEST(lz4, incompressible_chunks_are_stored)
+{
+   const vector<u8> rnd = gen_random_data(128 * KB, 3);
+   const vector<u8> c = compress_chunked(rnd, 64 * KB);
+
+   ASSERT_EQ(c.size(), rnd.size() + 2 * LZ4_CHUNK_HDR_SIZE);
+   ASSERT_TRUE(c[3] & 0x80);
+}
+
+TEST(lz4, corrupted_input)
+{
+   const vector<u8> in = gen_text_like_data(64 * KB, 4);
+   vector<u8> c = compress_chunked(in, 64 * KB);
+   vector<u8> out(in.size());
+   struct lz4_chunked_ctx ctx;
+
+   /* Truncate the chunk: the decompressed size won't match */
+   c[0] = (u8)(c[0] - 1);
+   lz4_chunked_ctx_init(&ctx, c.data(), out.data(), (u32)in.size(), 64 * KB);
+   ASSERT_EQ(lz4_chunked_decompress(&ctx, (u32)c.size()), -1);
+
+   /* Offset pointing before the beginning of the output */
+   const u8 bad[] = { 0x10, 'x', 0x10, 0x00, 0x00 };
+   ASSERT_EQ(lz4_decompress_block(bad, sizeof(bad), out.data(), 100), -1);
+}
@@ -228,6 +228,15 @@ TEST_F(vfs_resolve_test, basic_test)
    ASSERT_EQ(rc, -ENOTDIR);
    ASSERT_STREQ(p.last_comp, nullptr);
    ASSERT_NO_FATAL_FAILURE({ check_all_fs_refcounts(); });
+
+   /* A path going through a file, as if it were a directory */
+   rc = resolve("/a/b/c/f1/x", &p, true);
+   ASSERT_EQ(rc, -ENOTDIR);
+   ASSERT_NO_FATAL_FAILURE({ check_all_fs_refcounts(); });
+
+   rc = resolve("/a/b/c/f1/x/y", &p, true);
+   ASSERT_EQ(rc, -ENOTDIR);
+   ASSERT_NO_FATAL_FAILURE({ check_all_fs_refcounts(); });
 }
 
 TEST_F(vfs_resolve_test, corner_cases)
@@ -1,11 +1,14 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include <iostream>
 #include <random>
+#include <memory>
+#include <cstring>
 
 #include "vfs_test.h"
 
@@ -166,6 +169,307 @@ TEST_F(vfs_misc, fseek)
    close(fd);
 }
 
+/* Extra space after the used part of the partition, for new clusters */
+static const size_t extra_space = 256 * KB;
+
+class vfs_fat_rw : public vfs_test_base {
+
+protected:
+
+   struct fs *fat_fs;
+   unique_ptr<char[]> buf;
+   size_t buf_size;
+
+   void SetUp() override {
+
+      size_t fatpart_size;
+      vfs_test_base::SetUp();
+
+      const char *orig = load_once_file(TEST_FATPART_FILE, &fatpart_size);
+
+      buf_size = fatpart_size + extra_space;
+      buf.reset(new char[buf_size]);
+      memcpy(buf.get(), orig, fatpart_size);
+      memset(buf.get() + fatpart_size, 0, extra_space);
+
+      fat_fs = fat_mount_ramdisk(buf.get(), buf_size, VFS_FS_RW);
+      ASSERT_TRUE(fat_fs != NULL);
+
+      mp_init(fat_fs);
+   }
+
+   void TearDown() override {
+
+      fat_umount_ramdisk(fat_fs);
+      vfs_test_base::TearDown();
+   }
+
+   string read_file(const char *path) {
+
+      string res;
+      fs_handle h = NULL;
+      char tmp[97];        /* odd size, on purpose */
+      ssize_t rc;
+
+      if (vfs_open(path, &h, O_RDONLY, 0))
+         return "<open failed>";
+
+      while ((rc = vfs_read(h, tmp, sizeof(tmp))) > 0)
+         res.append(tmp, (size_t)rc);
+
+      vfs_close(h);
+      return res;
+   }
+};
+
+static string gen_test_data(size_t len, unsigned seed)
+{
+   string s(len, '\0');
+   default_random_engine e(seed);
+
+   for (size_t i = 0; i < len; i++)
+      s[i] = (char)('a' + e() % 26);
+
+   return s;
+}
+
+TEST_F(vfs_fat_rw, create_write_read)
+{
+   const string data = gen_test_data(10 * 1000, 1);
+   fs_handle h = NULL;
+
+   ASSERT_EQ(vfs_open("/new_file_with_long_name.txt",
+                      &h, O_CREAT | O_WRONLY, 0644), 0);
+
+   /* Write it in odd-sized chunks, crossing many clusters */
+   for (size_t off = 0; off < data.size(); off += 333) {
+      const size_t n = min((size_t)333, data.size() - off);
+      ASSERT_EQ(vfs_write(h, (void *)(data.c_str() + off), n), (ssize_t)n);
+   }
+
+   vfs_close(h);
+   EXPECT_EQ(read_file("/new_file_with_long_name.txt"), data);
+
+   /* Check that the entry is visible with the regular FAT functions too */
+   struct fat_entry *e =
+      fat_search_entry((struct fat_hdr *)buf.get(),
+                       fat_unknown, "/new_file_with_long_name.txt", NULL);
+
+   ASSERT_TRUE(e != NULL);
+   EXPECT_EQ(e->DIR_FileSize, data.size());
+
+   /* O_EXCL must fail now */
+   EXPECT_EQ(vfs_open("/new_file_with_long_name.txt",
+                      &h, O_CREAT | O_EXCL | O_WRONLY, 0644), -EEXIST);
+}
+
+TEST_F(vfs_fat_rw, overwrite_append_and_seek_past_end)
+{
+   string expected = gen_test_data(3000, 2);
+   const string patch = gen_test_data(1500, 3);
+   fs_handle h = NULL;
+
+   ASSERT_EQ(vfs_open("/f1", &h, O_CREAT | O_RDWR, 0644), 0);
+   ASSERT_EQ(vfs_write(h, (void *)expected.c_str(), expected.size()), 3000);
+
+   /* Overwrite a range spanning several clusters */
+   ASSERT_EQ(vfs_seek(h, 700, SEEK_SET), 700);
+   ASSERT_EQ(vfs_write(h, (void *)patch.c_str(), patch.size()), 1500);
+   expected.replace(700, patch.size(), patch);
+
+   /* Write past the end: the gap must read as zeros */
+   ASSERT_EQ(vfs_seek(h, 1000, SEEK_END), 4000);
+   ASSERT_EQ(vfs_write(h, (void *)"xyz", 3), 3);
+   expected += string(1000, '\0') + "xyz";
+   vfs_close(h);
+
+   ASSERT_EQ(vfs_open("/f1", &h, O_WRONLY | O_APPEND, 0), 0);
+   ASSERT_EQ(vfs_write(h, (void *)"_end", 4), 4);
+   expected += "_end";
+   vfs_close(h);
+
+   EXPECT_EQ(read_file("/f1"), expected);
+}
+
+TEST_F(vfs_fat_rw, truncate)
+{
+   const string data = gen_test_data(5000, 4);
+   fs_handle h = NULL;
+
+   ASSERT_EQ(vfs_open("/f2", &h, O_CREAT | O_WRONLY, 0644), 0);
+   ASSERT_EQ(vfs_write(h, (void *)data.c_str(), data.size()), 5000);
+   vfs_close(h);
+
+   ASSERT_EQ(vfs_truncate("/f2", 1234), 0);
+   EXPECT_EQ(read_file("/f2"), data.substr(0, 1234));
+
+   /* Extending it again must expose zeros, not the old data */
+   ASSERT_EQ(vfs_truncate("/f2", 2000), 0);
+   EXPECT_EQ(read_file("/f2"), data.substr(0, 1234) + string(766, '\0'));
+
+   /* O_TRUNC */
+   ASSERT_EQ(vfs_open("/f2", &h, O_WRONLY | O_TRUNC, 0), 0);
+   ASSERT_EQ(vfs_write(h, (void *)"abc", 3), 3);
+   vfs_close(h);
+   EXPECT_EQ(read_file("/f2"), "abc");
+
+   /* Directories cannot be truncated */
+   EXPECT_EQ(vfs_truncate("/testdir", 0), -EISDIR);
+}
+
+TEST_F(vfs_fat_rw, mkdir)
+{
+   fs_handle h = NULL;
+
+   ASSERT_EQ(vfs_mkdir("/new_dir", 0755), 0);
+   ASSERT_EQ(vfs_mkdir("/new_dir", 0755), -EEXIST);
+   ASSERT_EQ(vfs_mkdir("/new_dir/a_sub_directory", 0755), 0);
+
+   ASSERT_EQ(vfs_open("/new_dir/a_sub_directory/file.txt",
+                      &h, O_CREAT | O_WRONLY, 0644), 0);
+   ASSERT_EQ(vfs_write(h, (void *)"hello", 5), 5);
+   vfs_close(h);
+
+   EXPECT_EQ(read_file("/new_dir/a_sub_directory/file.txt"), "hello");
+   EXPECT_EQ(read_file("/new_dir/a_sub_directory/../a_sub_directory/file.txt"),
+             "hello");
+
+   /* Fill a directory with many entries, to force it to grow */
+   for (int i = 0; i < 100; i++) {
+
+      char path[64];
+      sprintf(path, "/new_dir/file_with_a_longer_name_%d", i);
+
+      ASSERT_EQ(vfs_open(path, &h, O_CREAT | O_WRONLY, 0644), 0) << path;
+      ASSERT_EQ(vfs_write(h, path, strlen(path)), (ssize_t)strlen(path));
+      vfs_close(h);
+   }
+
+   for (int i = 0; i < 100; i++) {
+      char path[64];
+      sprintf(path, "/new_dir/file_with_a_longer_name_%d", i);
+      EXPECT_EQ(read_file(path), path);
+   }
+
+   /* Pre-existing files must be still readable */
+   EXPECT_EQ(read_file("/testdir/This_is_a_file_with_a_veeeery_long_name.txt"),
+             "Content of file with a long name\n");
+}
+
+TEST_F(vfs_fat_rw, mmap_is_read_only)
+{
+   struct fat_fs_device_data *d = (struct fat_fs_device_data *)
+      fat_fs->device_data;
+
+   struct user_mapping um = {0};
+   fs_handle h = NULL;
+
+   ASSERT_EQ(vfs_open("/f3", &h, O_CREAT | O_RDWR, 0644), 0);
+   ASSERT_EQ(vfs_write(h, (void *)"hello", 5), 5);
+
+   um.h = h;
+   um.len = PAGE_SIZE;
+   um.prot = PROT_READ | PROT_WRITE;
+
+   /* A writable mapping must fail in mmap(), not with a fault later */
+   EXPECT_EQ(vfs_mmap(&um, NULL, VFS_MM_DONT_MMAP), -EACCES);
+
+   /* Read-only mappings depend just on the cluster size */
+   um.prot = PROT_READ;
+   EXPECT_EQ(vfs_mmap(&um, NULL, VFS_MM_DONT_MMAP),
+             d->mmap_support ? 0 : -ENODEV);
+
+   vfs_close(h);
+}
+
+TEST_F(vfs_fat_rw, enospc_drops_new_clusters)
+{
+   struct fat_fs_device_data *d = (struct fat_fs_device_data *)
+      fat_fs->device_data;
+
+   struct fat_hdr *hdr = (struct fat_hdr *)buf.get();
+   const string chunk = gen_test_data(4096, 6);
+   fs_handle h = NULL;
+   size_t tot = 0;
+   int clusters = 0;
+   ssize_t rc;
+   u32 clu;
+
+   ASSERT_EQ(vfs_open("/f4", &h, O_CREAT | O_RDWR, 0644), 0);
+   ASSERT_EQ(vfs_write(h, (void *)"abc", 3), 3);
+
+   /* The gap alone doesn't fit: both must fail, leaving the file as it was */
+   ASSERT_EQ(vfs_seek(h, 2 * extra_space, SEEK_SET), (offt)(2 * extra_space));
+   EXPECT_EQ(vfs_write(h, (void *)"x", 1), -ENOSPC);
+   EXPECT_EQ(vfs_ftruncate(h, 2 * extra_space), -ENOSPC);
+   vfs_close(h);
+
+   struct fat_entry *e = fat_search_entry(hdr, fat_unknown, "/f4", NULL);
+   ASSERT_TRUE(e != NULL);
+   EXPECT_EQ(e->DIR_FileSize, 3u);
+
+   /* Its cluster chain must match the size */
+   clu = fat_get_first_cluster(e);
+
+   while (!fat_is_end_of_clusterchain(d->type, clu)) {
+      clusters++;
+      clu = fat_read_fat_entry(hdr, d->type, 0, clu);
+   }
+
+   EXPECT_EQ(clusters, 1);
+   EXPECT_EQ(read_file("/f4"), "abc");
+
+   /* The space used by the failed operations must be available again */
+   ASSERT_EQ(vfs_open("/f5", &h, O_CREAT | O_WRONLY, 0644), 0);
+
+   while ((rc = vfs_write(h, (void *)chunk.c_str(), chunk.size())) > 0)
+      tot += (size_t)rc;
+
+   vfs_close(h);
+   EXPECT_EQ(rc, -ENOSPC);
+   EXPECT_GT(tot, extra_space - 8 * KB);
+}
+
+TEST_F(vfs_fat_rw, flush_and_enospc)
+{
+   struct fat_fs_device_data *d = (struct fat_fs_device_data *)
+      fat_fs->device_data;
+
+   const string chunk = gen_test_data(4096, 5);
+   fs_handle h = NULL;
+   size_t tot = 0;
+   ssize_t rc;
+
+   ASSERT_EQ(vfs_open("/big", &h, O_CREAT | O_WRONLY, 0644), 0);
+
+   while ((rc = vfs_write(h, (void *)chunk.c_str(), chunk.size())) > 0)
+      tot += (size_t)rc;
+
+   EXPECT_EQ(rc, -ENOSPC);
+   EXPECT_GT(tot, extra_space / 2);
+   EXPECT_LT(tot, extra_space + 4 * KB);
+   EXPECT_GT(d->dirty_fat_secs_cnt, 0u);
+   EXPECT_GT(d->dirty_clusters_cnt, 0u);
+
+   EXPECT_GT(fat_flush(fat_fs), 0u);
+   EXPECT_EQ(d->dirty_fat_secs_cnt, 0u);
+   EXPECT_EQ(d->dirty_clusters_cnt, 0u);
+
+   /* After truncation, the space must be available again */
+   ASSERT_EQ(vfs_ftruncate(h, 0), 0);
+   ASSERT_EQ(vfs_seek(h, 0, SEEK_SET), 0);
+   ASSERT_EQ(vfs_write(h, (void *)chunk.c_str(), chunk.size()), 4096);
+   vfs_close(h);
+
+   /* All the FATs must be equal after the flush */
+   struct fat_hdr *hdr = (struct fat_hdr *)buf.get();
+   const size_t fat_bytes = fat_get_FATSz(hdr) * hdr->BPB_BytsPerSec;
+   const char *fat0 = buf.get() + hdr->BPB_RsvdSecCnt * hdr->BPB_BytsPerSec;
+
+   for (u32 i = 1; i < hdr->BPB_NumFATs; i++)
+      EXPECT_EQ(memcmp(fat0, fat0 + i * fat_bytes, fat_bytes), 0);
+}
+
 class compute_abs_path_test :
    public TestWithParam<
       tuple<const char *, const char *, const char *>
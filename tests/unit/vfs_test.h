@@ -9,6 +9,7 @@ extern "C" {
    #include <tilck/kernel/sched.h>
    #include <tilck/kernel/process.h>
    #include <tilck/kernel/fs/fat32.h>
+   #include <tilck/kernel/process_mm.h>
    #include "kernel/fs/fs_int.h"
 
    struct fs *ramfs_create(void);
@@ -19,6 +19,7 @@ extern "C" {
 
    #include <tilck/kernel/kmalloc.h>
    #include <tilck/kernel/worker_thread.h>
+   #include <tilck/kernel/timer.h>
    #include "kernel/wth_int.h" // private header
 
    extern u32 worker_threads_cnt;
@@ -51,7 +52,8 @@ class worker_thread_test : public Test {
    }
 
    void TearDown() override {
-      destroy_last_worker_thread();
+      while (worker_threads_cnt > 0)
+         destroy_last_worker_thread();
    }
 };
 
@@ -191,3 +193,240 @@ TEST_F(worker_thread_test, chaos)
       }
    }
 }
+
+static vector<int> works_run;
+
+static void record_work_func(void *arg)
+{
+   works_run.push_back((int)(long)arg);
+}
+
+TEST_F(worker_thread_test, work_coalescing)
+{
+   struct wth_work w;
+   works_run.clear();
+   wth_work_init(&w, &record_work_func, TO_PTR(1));
+
+   ASSERT_FALSE(wth_is_work_pending(&w));
+   ASSERT_TRUE(wth_queue_work(0, &w));
+   ASSERT_TRUE(wth_is_work_pending(&w));
+
+   // Already pending: the work item is not queued again.
+   ASSERT_FALSE(wth_queue_work(0, &w));
+   ASSERT_FALSE(wth_queue_delayed_work(0, &w, 10));
+
+   ASSERT_TRUE(wth_process_single_work(0));
+   ASSERT_FALSE(wth_process_single_work(0));
+   ASSERT_FALSE(wth_is_work_pending(&w));
+   ASSERT_EQ(works_run, vector<int>({1}));
+
+   // Once run, it can be queued again.
+   ASSERT_TRUE(wth_queue_work(0, &w));
+   ASSERT_TRUE(wth_process_single_work(0));
+   ASSERT_EQ(works_run, vector<int>({1, 1}));
+}
+
+TEST_F(worker_thread_test, works_never_fail)
+{
+   const int max_jobs = wth_get_queue_size(0);
+   const int n = 4 * max_jobs;
+   vector<struct wth_work> works(n);
+   works_run.clear();
+
+   // Fill the job queue first
+   for (int i = 0; i < max_jobs; i++)
+      ASSERT_TRUE(wth_enqueue_job(0, &simple_func1, TO_PTR(1234)));
+
+   ASSERT_FALSE(wth_enqueue_job(0, &simple_func1, TO_PTR(1234)));
+
+   // Work items don't need any space in the queue
+   for (int i = 0; i < n; i++) {
+      wth_work_init(&works[i], &record_work_func, TO_PTR(i));
+      ASSERT_TRUE(wth_queue_work(0, &works[i]));
+   }
+
+   for (int i = 0; i < max_jobs; i++)
+      ASSERT_TRUE(wth_process_single_job(0));
+
+   for (int i = 0; i < n; i++)
+      ASSERT_TRUE(wth_process_single_work(0));
+
+   ASSERT_FALSE(wth_process_single_work(0));
+   ASSERT_EQ((int)works_run.size(), n);
+
+   // FIFO order
+   for (int i = 0; i < n; i++)
+      ASSERT_EQ(works_run[i], i);
+}
+
+static int requeue_runs;
+
+static void requeue_work_func(void *arg)
+{
+   struct wth_work *w = (struct wth_work *)arg;
+
+   // The work item is idle while running: it can be requeued.
+   if (++requeue_runs == 1) {
+      ASSERT_TRUE(wth_queue_work(0, w));
+   }
+}
+
+TEST_F(worker_thread_test, work_requeue_while_running)
+{
+   struct wth_work w;
+   requeue_runs = 0;
+   wth_work_init(&w, &requeue_work_func, &w);
+
+   ASSERT_TRUE(wth_queue_work(0, &w));
+   ASSERT_TRUE(wth_process_single_work(0));
+   ASSERT_TRUE(wth_is_work_pending(&w));
+   ASSERT_TRUE(wth_process_single_work(0));
+   ASSERT_FALSE(wth_process_single_work(0));
+   ASSERT_EQ(requeue_runs, 2);
+}
+
+TEST_F(worker_thread_test, delayed_works)
+{
+   struct wth_work w1, w2, w3;
+   works_run.clear();
+
+   wth_work_init(&w1, &record_work_func, TO_PTR(1));
+   wth_work_init(&w2, &record_work_func, TO_PTR(2));
+   wth_work_init(&w3, &record_work_func, TO_PTR(3));
+
+   ASSERT_FALSE(wth_any_delayed_work());
+   ASSERT_TRUE(wth_queue_delayed_work(0, &w1, 3));
+   ASSERT_TRUE(wth_queue_delayed_work(0, &w2, 1));
+   ASSERT_TRUE(wth_any_delayed_work());
+   ASSERT_FALSE(wth_queue_delayed_work(0, &w1, 5));
+   ASSERT_FALSE(wth_queue_work(0, &w1));
+
+   // Not expired yet
+   ASSERT_FALSE(wth_process_single_work(0));
+
+   wth_tick_delayed_works(1);
+   ASSERT_TRUE(wth_process_single_work(0));
+   ASSERT_FALSE(wth_process_single_work(0));
+   ASSERT_EQ(works_run, vector<int>({2}));
+
+   wth_tick_delayed_works(1);
+   ASSERT_FALSE(wth_process_single_work(0));
+
+   // Many ticks at once, as after a soft IRQ delay
+   wth_tick_delayed_works(5);
+   ASSERT_FALSE(wth_any_delayed_work());
+   ASSERT_TRUE(wth_process_single_work(0));
+   ASSERT_EQ(works_run, vector<int>({2, 1}));
+
+   // A cancelled work item never runs
+   ASSERT_TRUE(wth_queue_delayed_work(0, &w3, 2));
+   ASSERT_TRUE(wth_cancel_work(&w3));
+   ASSERT_FALSE(wth_cancel_work(&w3));
+   ASSERT_FALSE(wth_any_delayed_work());
+   wth_tick_delayed_works(10);
+   ASSERT_FALSE(wth_process_single_work(0));
+
+   ASSERT_TRUE(wth_queue_work(0, &w3));
+   ASSERT_TRUE(wth_cancel_work(&w3));
+   ASSERT_FALSE(wth_process_single_work(0));
+   ASSERT_EQ(works_run, vector<int>({2, 1}));
+}
+
+TEST_F(worker_thread_test, long_job_migration)
+{
+   struct worker_thread *t = worker_threads[0];
+   struct wth_work w1, w2;
+   works_run.clear();
+
+   ASSERT_GE(wth_helper, 0);
+   wth_work_init(&w1, &record_work_func, TO_PTR(1));
+   wth_work_init(&w2, &record_work_func, TO_PTR(2));
+   ASSERT_TRUE(wth_queue_work(0, &w1));
+   ASSERT_TRUE(wth_queue_work(0, &w2));
+
+   // A short job: nothing changes
+   t->in_job = true;
+   t->job_start = (u32)get_ticks();
+   wth_check_long_jobs();
+   ASSERT_TRUE(list_is_empty(&worker_threads[wth_helper]->works));
+
+   // A long job: the pending works move to the helper thread
+   t->job_start = (u32)get_ticks() - WTH_LONG_JOB_TICKS;
+   wth_check_long_jobs();
+   t->in_job = false;
+
+   ASSERT_FALSE(wth_process_single_work(0));
+   ASSERT_TRUE(wth_process_single_work(wth_helper));
+   ASSERT_TRUE(wth_process_single_work(wth_helper));
+   ASSERT_FALSE(wth_process_single_work(wth_helper));
+   ASSERT_EQ(works_run, vector<int>({1, 2}));
+}
+
+static struct wth_work *reentr_work;
+static int reentr_runs;
+
+static void long_requeue_work_func(void *arg)
+{
+   struct worker_thread *t = worker_threads[0];
+   reentr_runs++;
+
+   // Requeue itself, then take long enough to trigger the migration
+   ASSERT_TRUE(wth_queue_work(0, reentr_work));
+   t->job_start = (u32)get_ticks() - WTH_LONG_JOB_TICKS;
+   wth_check_long_jobs();
+
+   // Its first instance is still running here: it must not move
+   ASSERT_TRUE(list_is_empty(&worker_threads[wth_helper]->works));
+   ASSERT_FALSE(wth_process_single_work(wth_helper));
+}
+
+TEST_F(worker_thread_test, long_job_migration_non_reentrant)
+{
+   struct wth_work w;
+   reentr_runs = 0;
+   reentr_work = &w;
+   wth_work_init(&w, &long_requeue_work_func, NULL);
+
+   ASSERT_TRUE(wth_queue_work(0, &w));
+   ASSERT_TRUE(wth_process_single_work(0));
+   ASSERT_EQ(reentr_runs, 1);
+
+   // The second instance runs on its own thread, after the first one
+   ASSERT_TRUE(wth_is_work_pending(&w));
+   ASSERT_TRUE(wth_cancel_work(&w));
+}
+
+static void requeue_on_other_thread_func(void *arg)
+{
+   reentr_runs++;
+
+   // Running on the helper: its own thread must not start it again
+   if (reentr_runs == 1) {
+      ASSERT_TRUE(wth_queue_work(0, reentr_work));
+      ASSERT_FALSE(wth_process_single_work(0));
+   }
+}
+
+TEST_F(worker_thread_test, migrated_work_non_reentrant)
+{
+   struct worker_thread *t = worker_threads[0];
+   struct wth_work w;
+   reentr_runs = 0;
+   reentr_work = &w;
+   wth_work_init(&w, &requeue_on_other_thread_func, NULL);
+
+   // Migrate the work, queued behind a long job
+   ASSERT_TRUE(wth_queue_work(0, &w));
+   t->in_job = true;
+   t->job_start = (u32)get_ticks() - WTH_LONG_JOB_TICKS;
+   wth_check_long_jobs();
+   t->in_job = false;
+
+   ASSERT_TRUE(wth_process_single_work(wth_helper));
+   ASSERT_EQ(reentr_runs, 1);
+
+   // The helper's instance returned: now it can run again
+   ASSERT_TRUE(wth_process_single_work(0));
+   ASSERT_EQ(reentr_runs, 2);
+   ASSERT_FALSE(wth_process_single_work(0));
+}
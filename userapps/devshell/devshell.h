@@ -126,3 +126,25 @@ tilck_set_sched_alive_thread_enabled(bool enabled)
                          TILCK_CMD_SET_SAT_ENABLED,
                          enabled);
 }
+
+static inline int
+tilck_get_faults_cnt(void)
+{
+   return sysenter_call1(TILCK_CMD_SYSCALL, TILCK_CMD_GET_FAULTS_CNT);
+}
+
+static inline int
+tilck_getdents_stat(int fd, struct tilck_dirent_stat *buf, unsigned size)
+{
+   return sysenter_call4(TILCK_CMD_SYSCALL,
+                         TILCK_CMD_GETDENTS_STAT,
+                         fd,
+                         buf,
+                         size);
+}
+
+static inline int
+tilck_prof(enum tilck_prof_op op, ulong a1, ulong a2, ulong a3)
+{
+   return sysenter_call5(TILCK_CMD_SYSCALL, TILCK_CMD_PROF, op, a1, a2, a3);
+}
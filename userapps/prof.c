@@ -0,0 +1,389 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * Runs a command while Tilck's sampling profiler is enabled and then dumps a
+ * flat profile of the kernel functions and, optionally, the folded stacks
+ * (one line per unique stack: "outer;...;inner count"), in the format used by
+ * the FlameGraph scripts.
+ *
+ * User-mode samples are not symbolized: they're accounted as [user] in the
+ * flat profile and their addresses are shown in hex in the folded stacks.
+ */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/syscalls.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+#define SYM_NAME_MAX                      64
+#define MAX_SYMS                        4096
+#define ADDR_CACHE_SIZE                 8192   /* must be a power of 2 */
+#define READ_CHUNK                       256
+
+struct sym {
+   char name[SYM_NAME_MAX];
+   unsigned self;       /* samples having this symbol as leaf */
+   unsigned total;      /* samples having this symbol anywhere in the stack */
+   unsigned last_seen;  /* last sample (+1) which counted this symbol */
+};
+
+struct addr_cache_entry {
+   ulong addr;
+   int sym;             /* index in syms[], -1 if the entry is empty */
+};
+
+static struct sym syms[MAX_SYMS];
+static int syms_count;
+static struct addr_cache_entry addr_cache[ADDR_CACHE_SIZE];
+
+static struct tilck_prof_sample *samples;
+static struct tilck_prof_info info;
+
+static int prof_cmd(enum tilck_prof_op op, ulong a1, ulong a2, ulong a3)
+{
+   return (int)syscall(TILCK_CMD_SYSCALL, TILCK_CMD_PROF, op, a1, a2, a3);
+}
+
+static int get_sym_by_name(const char *name)
+{
+   for (int i = 0; i < syms_count; i++)
+      if (!strcmp(syms[i].name, name))
+         return i;
+
+   if (syms_count == MAX_SYMS)
+      return 0; /* the [unknown] symbol */
+
+   strncpy(syms[syms_count].name, name, SYM_NAME_MAX - 1);
+   return syms_count++;
+}
+
+/*
+ * Returns the index of the kernel symbol containing `addr`. When `addr` is a
+ * return address, the function containing the call instruction is the one
+ * containing `addr - 1`: that matters for calls to NORETURN functions.
+ */
+static int resolve_kernel_addr(ulong addr, bool ret_addr)
+{
+   const ulong va = ret_addr ? addr - 1 : addr;
+   u32 h = (u32)(va * 2654435761u) & (ADDR_CACHE_SIZE - 1);
+   char name[SYM_NAME_MAX];
+   int rc;
+
+   for (u32 i = 0; i < ADDR_CACHE_SIZE; i++) {
+
+      struct addr_cache_entry *e = &addr_cache[(h + i) & (ADDR_CACHE_SIZE-1)];
+
+      if (e->sym >= 0 && e->addr == va)
+         return e->sym;
+
+      if (e->sym < 0) {
+
+         rc = prof_cmd(TILCK_PROF_GET_SYM, va, (ulong)name, sizeof(name));
+         e->addr = va;
+         e->sym = rc >= 0 ? get_sym_by_name(name) : 0;
+         return e->sym;
+      }
+   }
+
+   /* The cache is full: just don't cache the result */
+   rc = prof_cmd(TILCK_PROF_GET_SYM, va, (ulong)name, sizeof(name));
+   return rc >= 0 ? get_sym_by_name(name) : 0;
+}
+
+static void
+account_sym(int sym, unsigned sample_n, bool leaf)
+{
+   if (leaf)
+      syms[sym].self++;
+
+   if (syms[sym].last_seen != sample_n + 1) {
+      syms[sym].total++;
+      syms[sym].last_seen = sample_n + 1;
+   }
+}
+
+static int sym_cmp_self(const void *a, const void *b)
+{
+   const struct sym *s1 = a;
+   const struct sym *s2 = b;
+
+   if (s1->self != s2->self)
+      return s1->self < s2->self ? 1 : -1;
+
+   return strcmp(s1->name, s2->name);
+}
+
+static void dump_flat_profile(int top, bool stacks)
+{
+   const int user_sym = get_sym_by_name("[user]");
+   int n;
+
+   for (u32 i = 0; i < info.samples; i++) {
+
+      struct tilck_prof_sample *s = &samples[i];
+
+      if (s->flags & TILCK_PROF_SAMPLE_USER) {
+         account_sym(user_sym, i, true);
+         continue;
+      }
+
+      account_sym(resolve_kernel_addr(s->ip, false), i, true);
+
+      for (u32 j = 0; j < s->n_frames; j++)
+         if (s->frames[j] >= KERNEL_BASE_VA)
+            account_sym(resolve_kernel_addr(s->frames[j], true), i, false);
+   }
+
+   qsort(syms, (size_t)syms_count, sizeof(syms[0]), sym_cmp_self);
+   n = top > 0 ? MIN(top, syms_count) : syms_count;
+
+   printf("\nFlat profile: %u samples, %u lost, %u Hz\n\n",
+          info.samples, info.lost, info.hz);
+
+   if (stacks)
+      printf("  self%%   self  total%%  total  symbol\n");
+   else
+      printf("  self%%   self  symbol\n");
+
+   for (int i = 0; i < n && syms[i].self + syms[i].total > 0; i++) {
+
+      const struct sym *sym = &syms[i];
+      const double self_p = 100.0 * sym->self / info.samples;
+      const double total_p = 100.0 * sym->total / info.samples;
+
+      if (stacks)
+         printf("%6.2f %6u %6.2f %6u  %s\n",
+                self_p, sym->self, total_p, sym->total, sym->name);
+      else
+         printf("%6.2f %6u  %s\n", self_p, sym->self, sym->name);
+   }
+
+   printf("\n");
+}
+
+static int str_ptr_cmp(const void *a, const void *b)
+{
+   return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static const char *frame_name(char *buf, ulong addr, bool user, bool ret_addr)
+{
+   if (user || addr < KERNEL_BASE_VA) {
+      sprintf(buf, "0x%08lx", addr);
+      return buf;
+   }
+
+   return syms[resolve_kernel_addr(addr, ret_addr)].name;
+}
+
+static char *make_folded_stack(struct tilck_prof_sample *s)
+{
+   const bool user = !!(s->flags & TILCK_PROF_SAMPLE_USER);
+   const size_t max_len = (TILCK_PROF_MAX_FRAMES + 2) * (SYM_NAME_MAX + 1);
+   char buf[32];
+   char *str, *p;
+
+   if (!(str = malloc(max_len)))
+      return NULL;
+
+   p = str;
+
+   if (user)
+      p += sprintf(p, "[user];");
+
+   /* The frames go from the innermost caller to the outermost one */
+   for (int j = s->n_frames - 1; j >= 0; j--)
+      p += sprintf(p, "%s;", frame_name(buf, s->frames[j], user, true));
+
+   sprintf(p, "%s", frame_name(buf, s->ip, user, false));
+   return str;
+}
+
+static int dump_folded_stacks(FILE *fh)
+{
+   char **stacks;
+   u32 count = 0;
+
+   /* The flat profile sorted syms[]: invalidate the address cache */
+   for (int i = 0; i < ADDR_CACHE_SIZE; i++)
+      addr_cache[i].sym = -1;
+
+   if (!(stacks = calloc(info.samples, sizeof(char *))))
+      return -ENOMEM;
+
+   for (u32 i = 0; i < info.samples; i++)
+      if (!(stacks[i] = make_folded_stack(&samples[i])))
+         return -ENOMEM;
+
+   qsort(stacks, info.samples, sizeof(char *), str_ptr_cmp);
+
+   for (u32 i = 0; i < info.samples; i++) {
+
+      count++;
+
+      if (i + 1 == info.samples || strcmp(stacks[i], stacks[i + 1])) {
+         fprintf(fh, "%s %u\n", stacks[i], count);
+         count = 0;
+      }
+   }
+
+   for (u32 i = 0; i < info.samples; i++)
+      free(stacks[i]);
+
+   free(stacks);
+   return 0;
+}
+
+static int read_samples(void)
+{
+   int rc;
+
+   if (prof_cmd(TILCK_PROF_GET_INFO, (ulong)&info, 0, 0) < 0)
+      return -errno;
+
+   if (!info.samples)
+      return 0;
+
+   if (!(samples = malloc(info.samples * sizeof(samples[0]))))
+      return -ENOMEM;
+
+   for (u32 i = 0; i < info.samples; i += (u32)rc) {
+
+      rc = prof_cmd(TILCK_PROF_READ,
+                    i,
+                    (ulong)(samples + i),
+                    MIN((u32)READ_CHUNK, info.samples - i));
+
+      if (rc <= 0)
+         return rc < 0 ? -errno : -EIO;
+   }
+
+   return 0;
+}
+
+static int run_cmd(char **argv)
+{
+   int pid, wstatus;
+
+   if ((pid = fork()) < 0) {
+      perror("fork");
+      return -1;
+   }
+
+   if (!pid) {
+      execvp(argv[0], argv);
+      perror("execvp");
+      exit(127);
+   }
+
+   if (waitpid(pid, &wstatus, 0) != pid) {
+      perror("waitpid");
+      return -1;
+   }
+
+   return WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : -1;
+}
+
+static void show_help_and_exit(const char *prog)
+{
+   fprintf(stderr,
+           "Usage: %s [-g] [-n samples] [-t top] [-o file] cmd [args...]\n\n"
+           "   -g          walk the stacks and dump the folded stacks\n"
+           "   -n samples  size of the sample buffer [default: %u]\n"
+           "   -t top      show only the top N symbols in the flat profile\n"
+           "   -o file     write the folded stacks in `file` [implies -g]\n",
+           prog, TILCK_PROF_DEFAULT_SAMPLES);
+   exit(1);
+}
+
+int main(int argc, char **argv)
+{
+   const char *out_file = NULL;
+   u32 flags = 0, max_samples = 0;
+   int opt, top = 0, rc;
+   FILE *fh = stdout;
+
+   while ((opt = getopt(argc, argv, "+gn:t:o:h")) != -1) {
+
+      switch (opt) {
+
+         case 'g':
+            flags |= TILCK_PROF_FL_STACKS;
+            break;
+
+         case 'n':
+            max_samples = (u32)atoi(optarg);
+            break;
+
+         case 't':
+            top = atoi(optarg);
+            break;
+
+         case 'o':
+            out_file = optarg;
+            flags |= TILCK_PROF_FL_STACKS;
+            break;
+
+         default:
+            show_help_and_exit(argv[0]);
+      }
+   }
+
+   if (optind == argc)
+      show_help_and_exit(argv[0]);
+
+   for (int i = 0; i < ADDR_CACHE_SIZE; i++)
+      addr_cache[i].sym = -1;
+
+   get_sym_by_name("[unknown]");
+
+   if (prof_cmd(TILCK_PROF_START, flags, max_samples, 0) < 0) {
+      perror("Unable to start the profiler");
+      return 1;
+   }
+
+   rc = run_cmd(argv + optind);
+   prof_cmd(TILCK_PROF_STOP, 0, 0, 0);
+
+   if (rc)
+      fprintf(stderr, "[prof] command exit status: %d\n", rc);
+
+   if ((rc = read_samples()) < 0) {
+      fprintf(stderr, "[prof] unable to read the samples: %s\n", strerror(-rc));
+      return 1;
+   }
+
+   if (!info.samples) {
+      fprintf(stderr, "[prof] no samples collected\n");
+      return 0;
+   }
+
+   dump_flat_profile(top, !!(flags & TILCK_PROF_FL_STACKS));
+
+   if (flags & TILCK_PROF_FL_STACKS) {
+
+      if (out_file && !(fh = fopen(out_file, "w"))) {
+         perror("fopen");
+         return 1;
+      }
+
+      if (!out_file)
+         printf("Folded stacks:\n\n");
+
+      if ((rc = dump_folded_stacks(fh)) < 0) {
+         fprintf(stderr, "[prof] error: %s\n", strerror(-rc));
+         return 1;
+      }
+
+      if (out_file)
+         fclose(fh);
+   }
+
+   prof_cmd(TILCK_PROF_RESET, 0, 0, 0);
+   return 0;
+}